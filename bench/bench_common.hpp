@@ -0,0 +1,178 @@
+#pragma once
+// helpers of the benchmarks on the simulated backend; results go to stderr, LOG_* of the library to stdout
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "camera_manager.hpp"
+#include "host_allocator.hpp"
+#include "sim_backend.hpp"
+namespace qnx_screen_camera {
+    // one latency or cost measurement, percentiles of the sorted samples
+    class bench_samples {
+    public:
+        void add(uint64_t ns) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            samples_.push_back(ns);
+        }
+        void clear() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            samples_.clear();
+        }
+        size_t count() const {
+            std::lock_guard<std::mutex> guard(mutex_);
+            return samples_.size();
+        }
+        double mean_ms() const {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (samples_.empty()) {
+                return 0;
+            }
+            double sum = 0;
+            for (uint64_t ns : samples_) {
+                sum += ns;
+            }
+            return sum / samples_.size() / 1e6;
+        }
+        // in ms, q in [0, 1]
+        double percentile_ms(double q) const {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (samples_.empty()) {
+                return 0;
+            }
+            std::vector<uint64_t> sorted(samples_);
+            std::sort(sorted.begin(), sorted.end());
+            size_t rank = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+            return sorted[rank] / 1e6;
+        }
+        void print(const char *label) const {
+            fprintf(stderr, "%-24s n %5zu mean %8.3f p50 %8.3f p90 %8.3f p99 %8.3f p99.9 %8.3f max %8.3f ms\n",
+                    label, count(), mean_ms(), percentile_ms(0.5), percentile_ms(0.9), percentile_ms(0.99),
+                    percentile_ms(0.999), percentile_ms(1.0));
+        }
+    private:
+        mutable std::mutex mutex_;
+        std::vector<uint64_t> samples_;
+    };
+    // busy threads at the default policy, competing with the pipeline for every CPU while alive
+    class cpu_hog {
+    public:
+        explicit cpu_hog(int threads) {
+            for (int i = 0;i < threads;++i) {
+                threads_.emplace_back([this]() {
+                    volatile uint64_t spin = 0;
+                    while (!stop_.load(std::memory_order_relaxed)) {
+                        ++spin;
+                    }
+                });
+            }
+        }
+        ~cpu_hog() {
+            stop_ = true;
+            for (auto &thread : threads_) {
+                thread.join();
+            }
+        }
+    private:
+        std::atomic<bool> stop_{false};
+        std::vector<std::thread> threads_;
+    };
+    inline uint64_t clock_ns(clockid_t clock) {
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+    }
+    inline uint64_t thread_cpu_ns() {
+        return clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    }
+    inline uint64_t process_cpu_ns() {
+        return clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    }
+    inline void bench_sleep_ms(int ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+    // synthetic frame of a textured background and a bright box moving with t, UYVY or NV12
+    class bench_frame {
+    public:
+        bench_frame(qcarcam_color_fmt_t format, uint32_t width, uint32_t height, int t) {
+            bool nv12 = QCARCAM_FMT_NV12 == format;
+            frame_.format = format;
+            frame_.width = width;
+            frame_.height = height;
+            frame_.stride = nv12 ? width : width * 2;
+            frame_.plane_offset = nv12 ? frame_.stride * height : 0;
+            frame_.seq_no = t;
+            frame_.timestamp = static_cast<unsigned long long>(t) * 33333333ULL;
+            data_.resize(nv12 ? frame_.stride * height * 3 / 2 : frame_.stride * height);
+            frame_.data = data_.data();
+            uint32_t box = height / 5;
+            uint32_t box_x = (static_cast<uint32_t>(t) * 12) % (width - box);
+            uint32_t box_y = height / 3;
+            for (uint32_t y = 0;y < height;++y) {
+                uint8_t *row = data_.data() + static_cast<size_t>(y) * frame_.stride;
+                for (uint32_t x = 0;x < width;++x) {
+                    bool inside = x >= box_x && x < box_x + box && y >= box_y && y < box_y + box;
+                    uint8_t luma = inside ? 235 : static_cast<uint8_t>(64 + ((x * 7 + y * 13) ^ (x * y)) % 96);
+                    if (nv12) {
+                        row[x] = luma;
+                    }
+                    else {
+                        row[x * 2 + 1] = luma;
+                        row[x * 2] = static_cast<uint8_t>(x & 1 ? 128 + y % 32 : 128 - x % 32);
+                    }
+                }
+            }
+            for (uint32_t y = 0;nv12 && y < height / 2;++y) {
+                uint8_t *row = data_.data() + frame_.plane_offset + static_cast<size_t>(y) * frame_.stride;
+                for (uint32_t x = 0;x < width;x += 2) {
+                    row[x] = static_cast<uint8_t>(128 - x % 32);
+                    row[x + 1] = static_cast<uint8_t>(128 + y % 32);
+                }
+            }
+        }
+        bench_frame(const bench_frame &) = delete;
+        bench_frame &operator=(const bench_frame &) = delete;
+        inline const camera_frame &frame() const {
+            return frame_;
+        }
+    private:
+        std::vector<uint8_t> data_;
+        camera_frame frame_;
+    };
+    // sim configuration and manager init; stdout carries the library log and is dropped unless verbose
+    inline bool bench_init(const sim_config &config, bool verbose) {
+        if (!verbose && nullptr == freopen("/dev/null", "w", stdout)) {
+            return false;
+        }
+        sim_configure(config);
+        if (!G_CAMERA_MANAGER.init()) {
+            fprintf(stderr, "camera manager init failed\n");
+            return false;
+        }
+        return true;
+    }
+    // an input without window on unlocked shared memory buffers
+    inline capture_attr bench_headless(int id) {
+        static std::shared_ptr<buffer_allocator> allocator = std::make_shared<host_allocator>();
+        capture_attr attr;
+        attr.input_id = static_cast<qcarcam_input_desc_t>(id);
+        attr.headless = true;
+        attr.allocator = allocator;
+        return attr;
+    }
+    // capture timestamp to listener latency of every frame of the input into samples
+    inline void bench_listen_latency(int id, bench_samples &samples) {
+        auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+        if (nullptr == ptr) {
+            return;
+        }
+        ptr->add_frame_listener([&samples](const camera_frame &frame) {
+            uint64_t now = monotonic_ns();
+            samples.add(now > frame.timestamp ? now - frame.timestamp : 0);
+        });
+    }
+}
@@ -0,0 +1,210 @@
+// lossless frame codec on synthetic 1920x1080 scenes: a smooth gradient, the same with sensor noise, the
+// sim texture and random bytes. Per scene the compression ratio, the encode and decode rate of one core
+// from the slice time summed over threads, the encode on pools of 2 and 4 threads in wall time and a byte
+// exact round trip, then a live recording of one input through camera_manager
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_SCENE_FRAMES = 4, BENCH_WIDTH = 1920, BENCH_HEIGHT = 1080 };
+    enum codec_content { CONTENT_SMOOTH, CONTENT_NOISY, CONTENT_TEXTURE, CONTENT_RANDOM };
+    const char *const BENCH_RECORDING = "/tmp/bench_codec.rec";
+    // a synthetic frame, planes tightly packed as the decoder writes them; the moving box of bench_frame
+    // over a gradient, the gradient with +-4 of sensor noise, the bench_frame texture or random bytes
+    class codec_scene {
+    public:
+        codec_scene(qcarcam_color_fmt_t format, codec_content content, int t) : seed_(0x9E3779B9u * (t + 1)) {
+            bench_frame source(format, BENCH_WIDTH, BENCH_HEIGHT, t);
+            frame_ = source.frame();
+            const bool nv12 = QCARCAM_FMT_NV12 == format;
+            data_.assign(frame_.data, frame_.data + (nv12 ? frame_.plane_offset + frame_.stride * BENCH_HEIGHT / 2
+                                                          : static_cast<size_t>(frame_.stride) * BENCH_HEIGHT));
+            frame_.data = data_.data();
+            if (CONTENT_TEXTURE == content) {
+                return;
+            }
+            const int box = BENCH_HEIGHT / 5, box_x = (t * 12) % (BENCH_WIDTH - box), box_y = BENCH_HEIGHT / 3;
+            for (int y = 0;y < BENCH_HEIGHT;++y) {
+                uint8_t *row = data_.data() + static_cast<size_t>(y) * frame_.stride;
+                for (int x = 0;x < BENCH_WIDTH;++x) {
+                    bool inside = x >= box_x && x < box_x + box && y >= box_y && y < box_y + box;
+                    int luma = inside ? 235 : 40 + x * 120 / BENCH_WIDTH + y * 60 / BENCH_HEIGHT;
+                    luma += CONTENT_NOISY == content ? static_cast<int>(next() % 9) - 4 : 0;
+                    uint8_t *pixel = nv12 ? row + x : row + x * 2 + 1;
+                    *pixel = static_cast<uint8_t>(CONTENT_RANDOM == content ? next() : luma);
+                    if (!nv12) {
+                        pixel[-1] = chroma(content, x, y);
+                    }
+                }
+            }
+            for (int y = 0;nv12 && y < BENCH_HEIGHT / 2;++y) {
+                uint8_t *row = data_.data() + frame_.plane_offset + static_cast<size_t>(y) * frame_.stride;
+                for (int x = 0;x < BENCH_WIDTH;++x) {
+                    row[x] = chroma(content, x, y * 2);
+                }
+            }
+        }
+        inline const camera_frame &frame() const {
+            return frame_;
+        }
+        inline const std::vector<uint8_t> &bytes() const {
+            return data_;
+        }
+    private:
+        inline uint32_t next() {
+            seed_ ^= seed_ << 13;
+            seed_ ^= seed_ >> 17;
+            seed_ ^= seed_ << 5;
+            return seed_ >> 8;
+        }
+        // slow colour ramps, U on even and V on odd bytes as in both layouts
+        uint8_t chroma(codec_content content, int x, int y) {
+            if (CONTENT_RANDOM == content) {
+                return static_cast<uint8_t>(next());
+            }
+            int value = x & 1 ? 112 + y * 32 / BENCH_HEIGHT : 144 - x * 32 / BENCH_WIDTH;
+            return static_cast<uint8_t>(value + (CONTENT_NOISY == content ? static_cast<int>(next() % 3) - 1 : 0));
+        }
+    private:
+        uint32_t seed_;
+        std::vector<uint8_t> data_;
+        camera_frame frame_;
+    };
+    void print_rate(const char *what, double bytes, uint64_t ns, size_t frames) {
+        fprintf(stderr, "%-24s %s %.0f MB/s per core\n", "", what, bytes * frames / ns * 1e3);
+    }
+    // false when a round trip is not exact or random bytes grow by more than the frame and slice headers
+    bool scene_phase(const char *label, qcarcam_color_fmt_t format, codec_content content, int frames) {
+        std::vector<std::unique_ptr<codec_scene>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new codec_scene(format, content, t));
+        }
+        const double raw = static_cast<double>(scene[0]->bytes().size());
+        frame_codec codec;
+        std::vector<uint8_t> coded, decoded(scene[0]->bytes().size());
+        uint64_t coded_bytes = 0, encode_busy = 0, decode_busy = 0;
+        size_t differ = 0;
+        bench_samples encode, decode;
+        for (int i = 0;i < frames;++i) {
+            const codec_scene &source = *scene[i % BENCH_SCENE_FRAMES];
+            uint64_t busy = 0;
+            uint64_t begin = thread_cpu_ns();
+            if (!codec.encode(source.frame(), coded, nullptr, &busy)) {
+                return false;
+            }
+            uint64_t middle = thread_cpu_ns();
+            if (!codec.decode(coded.data(), coded.size(), decoded.data(), decoded.size(), nullptr)) {
+                return false;
+            }
+            decode.add(thread_cpu_ns() - middle);
+            encode.add(middle - begin);
+            encode_busy += busy;
+            decode_busy += thread_cpu_ns() - middle;
+            coded_bytes += coded.size();
+            differ += decoded != source.bytes();
+        }
+        fprintf(stderr, "%s %dx%d %s, %.0f KB a frame\n", label, BENCH_WIDTH, BENCH_HEIGHT,
+                QCARCAM_FMT_NV12 == format ? "NV12" : "UYVY", raw / 1024);
+        fprintf(stderr, "%-24s ratio %.2f, %.0f KB coded a frame\n", "", raw * frames / coded_bytes,
+                static_cast<double>(coded_bytes) / frames / 1024);
+        encode.print("encode 1 thread");
+        print_rate("encode", raw, encode_busy, frames);
+        decode.print("decode 1 thread");
+        print_rate("decode", raw, decode_busy, frames);
+        const int threads[] = { 2, 4 };
+        for (int n : threads) {
+            thread_pool pool(n - 1);
+            bench_samples wall;
+            uint64_t busy_sum = 0;
+            for (int i = 0;i < frames;++i) {
+                uint64_t busy = 0;
+                uint64_t begin = monotonic_ns();
+                if (!codec.encode(scene[i % BENCH_SCENE_FRAMES]->frame(), coded, &pool, &busy)) {
+                    return false;
+                }
+                wall.add(monotonic_ns() - begin);
+                busy_sum += busy;
+            }
+            char title[32];
+            snprintf(title, sizeof(title), "encode %d threads", n);
+            wall.print(title);
+            fprintf(stderr, "%-24s %.0f MB/s, %.0f MB/s per core, p50\n", "", raw / wall.percentile_ms(0.5) / 1e3,
+                    raw * frames / busy_sum * 1e3);
+        }
+        if (0 != differ) {
+            fprintf(stderr, "%-24s %zu frames differ after the round trip\n", "", differ);
+        }
+        const double header = sizeof(codec_frame_header) + sizeof(codec_slice) * (BENCH_HEIGHT * 3 / 2);
+        return 0 == differ && (CONTENT_RANDOM != content || coded_bytes <= (raw + header) * frames);
+    }
+    // one 720p input at 30 fps recorded for seconds, read back frame by frame
+    bool record_phase(int seconds) {
+        screen_attribute screenAttr;
+        capture_attr capAttr = bench_headless(0);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            return false;
+        }
+        G_CAMERA_MANAGER.control_camera(0, CAM_CMD_START);
+        recorder_stats stats;
+        bool ok = G_CAMERA_MANAGER.start_recording(0, BENCH_RECORDING);
+        bench_sleep_ms(seconds * 1000);
+        ok = ok && G_CAMERA_MANAGER.get_recording_stats(0, stats);
+        G_CAMERA_MANAGER.stop_recording(0);
+        G_CAMERA_MANAGER.destroy_camera_connect(0);
+        recording_reader reader;
+        recording_frame_header header;
+        std::vector<uint8_t> coded;
+        size_t read = 0;
+        if (ok && reader.open(BENCH_RECORDING)) {
+            for (size_t i = 0;i < reader.frames() && reader.read(i, header, coded);++i) {
+                ++read;
+            }
+            reader.close();
+        }
+        unlink(BENCH_RECORDING);
+        fprintf(stderr, "recording of a live 720p input at 30 fps, %d s\n", seconds);
+        fprintf(stderr, "%-24s %llu frames, %llu dropped, %zu read back\n", "",
+                static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.dropped), read);
+        fprintf(stderr, "%-24s ratio %.2f, %.0f MB/s per core\n", "", stats.ratio, stats.mb_per_s_per_core);
+        return ok && stats.frames > 0 && read >= stats.frames;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 20;
+    int seconds = 5;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per case] [-t seconds of recording] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    config.fill = true;
+    if (!bench_init(config, verbose) || frames <= 0 || seconds <= 0) {
+        return 2;
+    }
+    fprintf(stderr, "frame codec, 1 thread in thread cpu time, pools in wall time, %ld cpus\n",
+            sysconf(_SC_NPROCESSORS_ONLN));
+    bool ok = scene_phase("smooth", QCARCAM_FMT_UYVY_8, CONTENT_SMOOTH, frames);
+    ok = scene_phase("noisy", QCARCAM_FMT_UYVY_8, CONTENT_NOISY, frames) && ok;
+    ok = scene_phase("noisy", QCARCAM_FMT_NV12, CONTENT_NOISY, frames) && ok;
+    ok = scene_phase("texture", QCARCAM_FMT_UYVY_8, CONTENT_TEXTURE, frames) && ok;
+    ok = scene_phase("random", QCARCAM_FMT_UYVY_8, CONTENT_RANDOM, frames) && ok;
+    ok = record_phase(seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// round trip of control socket commands against four running windowed inputs, single and batched,
+// then the server with a full client table and next to a client that never reads its replies
+#include <getopt.h>
+#include <stdlib.h>
+#include <atomic>
+#include "bench_common.hpp"
+#include "control_client.hpp"
+#include "control_server.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { CAM_INPUTS = 4, CTL_CLIENTS = 8 };
+    const char *const bench_socket = "/tmp/qnx_screen_camera_bench.sock";
+    using control_batch = std::vector<control_request>;
+    // the batches submitted in turn, alternating ones so unchanged values are not skipped; flushes from the sim,
+    // a batch must take exactly flushes of them however many windows it changes
+    bool measure(control_client &client, const char *label, const std::vector<control_batch> &batches, int rounds,
+                 int flushes_per_batch) {
+        bench_samples samples;
+        std::vector<control_reply> replies(CTL_MAX_BATCH);
+        uint64_t flushes = sim_get_counters().flushes;
+        for (int i = 0;i < rounds;++i) {
+            const control_batch &batch = batches[i % batches.size()];
+            uint64_t begin = monotonic_ns();
+            if (!client.submit(batch.data(), static_cast<uint16_t>(batch.size()), replies.data())) {
+                fprintf(stderr, "%s: submit failed\n", label);
+                return false;
+            }
+            samples.add(monotonic_ns() - begin);
+            for (size_t j = 0;j < batch.size();++j) {
+                const control_reply &reply = replies[j];
+                if (reply.status != CTL_STATUS_OK) {
+                    fprintf(stderr, "%s: opcode %d of input %d status %d\n", label, reply.opcode, reply.input_id,
+                            reply.status);
+                    return false;
+                }
+            }
+        }
+        samples.print(label);
+        flushes = sim_get_counters().flushes - flushes;
+        fprintf(stderr, "%-24s %.2f flushes per batch\n", "", static_cast<double>(flushes) / rounds);
+        if (flushes != static_cast<uint64_t>(flushes_per_batch) * rounds) {
+            fprintf(stderr, "%s: expected %d flushes per batch\n", label, flushes_per_batch);
+            return false;
+        }
+        return true;
+    }
+    // process cpu over a second while nobody talks to the server, then with one connection more than its
+    // table holds waiting in the listen backlog
+    bool crowd_phase() {
+        uint64_t cpu = process_cpu_ns();
+        bench_sleep_ms(1000);
+        double idle = (process_cpu_ns() - cpu) / 1e7;
+        std::vector<std::unique_ptr<control_client>> crowd;
+        for (int i = 0;i < CTL_CLIENTS;++i) {
+            crowd.emplace_back(new control_client());
+            if (!crowd.back()->connect(bench_socket)) {
+                fprintf(stderr, "crowd client %d: connect failed\n", i);
+                return false;
+            }
+        }
+        cpu = process_cpu_ns();
+        bench_sleep_ms(1000);
+        double full = (process_cpu_ns() - cpu) / 1e7;
+        crowd.clear();
+        fprintf(stderr, "%-24s process %.1f%% of a core idle, %.1f%% with a client behind the full table\n",
+                "full table", idle, full);
+        return full < idle + 20;
+    }
+    // a client pushing stats batches without reading a reply: the server must drop it instead of waiting
+    // on it while the measured client keeps its round trip
+    bool stalled_phase(control_client &client, int rounds) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, bench_socket, sizeof(addr.sun_path) - 1);
+        if (fd < 0 || ::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            fprintf(stderr, "stalled client: connect failed\n");
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        std::atomic<int> sent{0};
+        std::atomic<bool> dropped{false};
+        std::thread flood([&]() {
+            struct {
+                control_header header;
+                control_request requests[CTL_MAX_BATCH];
+            } batch;
+            batch.header.count = CTL_MAX_BATCH;
+            for (int i = 0;i < CTL_MAX_BATCH;++i) {
+                batch.requests[i] = make_control_request(CTL_OP_STATS, i % CAM_INPUTS);
+            }
+            uint64_t begin = monotonic_ns();
+            while (monotonic_ns() - begin < 5000000000ULL) {
+                if (!send_all(fd, &batch, sizeof(batch))) {
+                    dropped = true;
+                    break;
+                }
+                ++sent;
+            }
+        });
+        bool ok = measure(client, "stats, reader stalled", { { make_control_request(CTL_OP_STATS, 0) } }, rounds, 0);
+        flood.join();
+        close(fd);
+        fprintf(stderr, "%-24s stalled client %s after %d batches\n", "", dropped ? "dropped" : "NOT dropped",
+                sent.load());
+        return ok && dropped;
+    }
+}
+int main(int argc, char **argv) {
+    int rounds = 2000;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n rounds] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = CAM_INPUTS;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    for (int id = 0;id < CAM_INPUTS;++id) {
+        screen_attribute screenAttr;
+        screenAttr.display_id = 0;
+        screenAttr.window_size = { 0.5, 0.5 };
+        screenAttr.window_pos = { 0.5 * (id % 2), 0.5 * (id / 2) };
+        capture_attr capAttr;
+        capAttr.input_id = static_cast<qcarcam_input_desc_t>(id);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr) ||
+            !G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START)) {
+            fprintf(stderr, "input %d: create or start failed\n", id);
+            return 1;
+        }
+    }
+    control_server server;
+    control_client client;
+    if (!server.start(bench_socket) || !client.connect(bench_socket)) {
+        fprintf(stderr, "control socket %s failed\n", bench_socket);
+        return 1;
+    }
+    fprintf(stderr, "control round trip, %d rounds each, %d running inputs\n", rounds, CAM_INPUTS);
+    control_batch stats = { make_control_request(CTL_OP_STATS, 0) };
+    control_batch small = { make_resize_request(0, 0.4, 0.4, 0.1, 0.1) };
+    control_batch large = { make_resize_request(0, 0.5, 0.5, 0, 0) };
+    control_batch grid;
+    control_batch cascade;
+    for (int id = 0;id < CAM_INPUTS;++id) {
+        grid.push_back(make_resize_request(id, 0.5, 0.5, 0.5 * (id % 2), 0.5 * (id / 2)));
+        cascade.push_back(make_resize_request(id, 0.4, 0.4, 0.1 * id, 0.1 * id));
+    }
+    // the gear signal case: the rear view takes the screen from the others in one batch, and gives it back
+    control_batch rear;
+    control_batch surround;
+    rear.push_back(make_resize_request(0, 1.0, 1.0, 0, 0));
+    surround.push_back(make_resize_request(0, 0.5, 0.5, 0, 0));
+    for (int id = 1;id < CAM_INPUTS;++id) {
+        rear.push_back(make_control_request(CTL_OP_VISIBLE, id, 0));
+        surround.push_back(make_control_request(CTL_OP_VISIBLE, id, 1));
+    }
+    control_batch pause = { make_control_request(CTL_OP_PAUSE, 1) };
+    control_batch resume = { make_control_request(CTL_OP_RESUME, 1) };
+    bool ok = measure(client, "stats", { stats }, rounds, 0);
+    ok = ok && measure(client, "resize", { small, large }, rounds, 1);
+    ok = ok && measure(client, "4 resizes in a batch", { cascade, grid }, rounds, 1);
+    ok = ok && measure(client, "camera switch batch", { rear, surround }, rounds, 1);
+    ok = ok && measure(client, "pause, resume", { pause, resume }, std::min(rounds, 100), 0);
+    ok = ok && stalled_phase(client, rounds);
+    ok = ok && crowd_phase();
+    client.disconnect();
+    server.stop();
+    for (int id = 0;id < CAM_INPUTS;++id) {
+        G_CAMERA_MANAGER.destroy_camera_connect(id);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// delivered frame rate and cadence against the target with ISP drop patterns and with the software
+// fallback, changed at runtime on one 30 fps input, with the wakeups and buffer writes each leaves.
+// Kept frames sit on the 33.3 ms sensor grid, so a rate that does not divide 30 alternates intervals
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_WIDTH = 1280, BENCH_HEIGHT = 720, BENCH_SETTLE_MS = 300 };
+    const char *const mode_names[] = { "none", "isp", "software" };
+    // intervals between the capture timestamps of delivered frames
+    struct cadence {
+        bench_samples intervals;
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> last{0};
+        void reset() {
+            intervals.clear();
+            frames = 0;
+            last = 0;
+        }
+    };
+    bool run_mode(bool reject, const std::vector<float> &targets, int seconds) {
+        sim_config config;
+        config.inputs = 1;
+        config.reject_frame_drop = reject;
+        sim_configure(config);
+        screen_attribute screenAttr;
+        capture_attr capAttr = bench_headless(0);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            return false;
+        }
+        cadence seen;
+        G_CAMERA_MANAGER.find_camera_connect_by_id(0)->add_frame_listener([&seen](const camera_frame &frame) {
+            uint64_t last = seen.last.exchange(frame.timestamp);
+            if (last != 0) {
+                seen.intervals.add(frame.timestamp - last);
+            }
+            ++seen.frames;
+        });
+        G_CAMERA_MANAGER.control_camera(0, CAM_CMD_START);
+        bool ok = true;
+        for (float target : targets) {
+            ok = G_CAMERA_MANAGER.set_camera_frame_rate(0, target) && ok;
+            bench_sleep_ms(BENCH_SETTLE_MS);
+            camera_stats before;
+            G_CAMERA_MANAGER.get_camera_stats(0, before);
+            sim_counters written = sim_get_counters();
+            seen.reset();
+            uint64_t begin = monotonic_ns();
+            bench_sleep_ms(seconds * 1000);
+            double elapsed = (monotonic_ns() - begin) / 1e9;
+            camera_stats after;
+            G_CAMERA_MANAGER.get_camera_stats(0, after);
+            double writes = (sim_get_counters().frames_produced - written.frames_produced) / elapsed;
+            double fps = seen.intervals.count() > 0 ? 1e3 / seen.intervals.mean_ms() : 0;
+            double want = target > 0 ? target : 30.0;
+            fprintf(stderr, "%6.1f %-8s %7.2f %+7.2f%% %8.1f %8.1f %8.1f %9.2f %9.1f %10.1f\n", want,
+                    mode_names[after.decimation], fps, 100.0 * (fps - want) / want, seen.intervals.percentile_ms(0),
+                    seen.intervals.percentile_ms(0.5), seen.intervals.percentile_ms(1.0),
+                    (after.frames - before.frames) / elapsed, writes,
+                    writes * BENCH_WIDTH * BENCH_HEIGHT * 2 / 1e6);
+            ok = ok && fabs(fps - want) / want < 0.05;
+        }
+        G_CAMERA_MANAGER.destroy_camera_connect(0);
+        return ok;
+    }
+}
+int main(int argc, char **argv) {
+    int seconds = 4;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:v")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per target] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    const std::vector<float> targets = { 0, 24, 20, 15, 12, 10, 7.5f, 5, 1 };
+    fprintf(stderr, "30 fps 720p UYVY sensor, %d s per target, fps from the mean interval of delivered frames\n",
+            seconds);
+    fprintf(stderr, "target mode     fps     error   min ms   p50 ms   max ms  wakeup/s  writes/s  write MB/s\n");
+    bool ok = run_mode(false, targets, seconds);
+    ok = run_mode(true, targets, seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// fisheye dewarp per frame: the lut build, a scalar remap of the same lut and the tiled SIMD remap on
+// 1, 2 and 4 threads, UYVY at 1280x720 and 1920x1080 into a same size 100 degree perspective view
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+#include "dewarp.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_SCENE_FRAMES = 4, BENCH_LUT_BUILDS = 5 };
+    // a 190 degree lens calibrated at 1280x720, scaled to the frame by the lut build
+    fisheye_intrinsics bench_lens() {
+        fisheye_intrinsics lens;
+        lens.fx = 360;
+        lens.fy = 360;
+        lens.cx = 640;
+        lens.cy = 360;
+        lens.k[0] = -0.02;
+        lens.k[1] = 0.003;
+        lens.width = 1280;
+        lens.height = 720;
+        return lens;
+    }
+    inline uint8_t bilinear(int p00, int p01, int p10, int p11, int fx, int fy) {
+        const int one = REMAP_ONE;
+        return static_cast<uint8_t>(((p00 * (one - fx) + p01 * fx) * (one - fy) + (p10 * (one - fx) + p11 * fx) * fy +
+                                     128) >> 8);
+    }
+    // the remap_engine arithmetic one pixel at a time, untiled: the chroma pair is sampled where the even
+    // pixel of the pair maps, an output pixel seeing nothing is black
+    void scalar_remap(const remap_lut &lut, const camera_frame &frame, uint8_t *dst, uint32_t dst_stride) {
+        const int stride = static_cast<int>(frame.stride);
+        const int chroma_last = lut.src_width / 2 - 1;
+        for (int y = 0;y < lut.height;++y) {
+            const uint32_t *map = lut.map.data() + static_cast<size_t>(y) * lut.width;
+            uint8_t *out = dst + static_cast<size_t>(y) * dst_stride;
+            for (int x = 0;x < lut.width;++x) {
+                uint32_t m = map[x];
+                uint8_t *pixel = out + x * 2;
+                if (REMAP_INVALID == m) {
+                    pixel[1] = 16;
+                    if (0 == (x & 1)) {
+                        pixel[0] = pixel[2] = 128;
+                    }
+                    continue;
+                }
+                uint32_t sx = m & 0xFFFF, sy = m >> 16;
+                int fx = sx & (REMAP_ONE - 1), fy = sy & (REMAP_ONE - 1);
+                const uint8_t *row = frame.data + static_cast<size_t>(sy >> REMAP_FRACTION_BITS) * stride;
+                const uint8_t *a = row + (sx >> REMAP_FRACTION_BITS) * 2 + 1;
+                pixel[1] = bilinear(a[0], a[2], a[stride], a[stride + 2], fx, fy);
+                if (x & 1) {
+                    continue;
+                }
+                uint32_t cx = sx >> 1;
+                int g0 = cx >> REMAP_FRACTION_BITS;
+                int g1 = std::min(g0 + 1, chroma_last);
+                int cfx = cx & (REMAP_ONE - 1);
+                for (int k = 0;k < 2;++k) {
+                    pixel[2 * k] = bilinear(row[g0 * 4 + 2 * k], row[g1 * 4 + 2 * k], row[g0 * 4 + 2 * k + stride],
+                                            row[g1 * 4 + 2 * k + stride], cfx, fy);
+                }
+            }
+        }
+    }
+    bool size_phase(uint32_t width, uint32_t height, int frames) {
+        std::vector<std::unique_ptr<bench_frame>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new bench_frame(QCARCAM_FMT_UYVY_8, width, height, t));
+        }
+        dewarp_projection view;
+        view.width = static_cast<int>(width);
+        view.height = static_cast<int>(height);
+        remap_lut lut;
+        bench_samples build;
+        for (int i = 0;i < BENCH_LUT_BUILDS;++i) {
+            uint64_t begin = monotonic_ns();
+            if (!build_fisheye_lut(bench_lens(), view, width, height, nullptr, lut)) {
+                return false;
+            }
+            build.add(monotonic_ns() - begin);
+        }
+        fprintf(stderr, "%ux%u UYVY fisheye to %dx%d perspective, %.0f deg\n", width, height, view.width,
+                view.height, view.hfov_deg);
+        build.print("lut build");
+        const uint32_t dst_stride = width * 2;
+        std::vector<uint8_t> reference(static_cast<size_t>(dst_stride) * height);
+        std::vector<uint8_t> out(reference.size());
+        bench_samples scalar;
+        for (int i = 0;i < frames;++i) {
+            uint64_t begin = monotonic_ns();
+            scalar_remap(lut, scene[i % BENCH_SCENE_FRAMES]->frame(), reference.data(), dst_stride);
+            scalar.add(monotonic_ns() - begin);
+        }
+        scalar.print("scalar remap");
+        bool ok = scalar.count() > 0;
+        const int threads[] = { 1, 2, 4 };
+        for (int n : threads) {
+            thread_pool pool(n - 1);
+            remap_engine engine;
+            bench_samples cost;
+            for (int i = 0;i < frames;++i) {
+                const camera_frame &frame = scene[i % BENCH_SCENE_FRAMES]->frame();
+                uint64_t begin = monotonic_ns();
+                if (!engine.remap(lut, frame.data, frame.stride, frame.format, out.data(), dst_stride,
+                                  n > 1 ? &pool : nullptr)) {
+                    return false;
+                }
+                cost.add(monotonic_ns() - begin);
+            }
+            char label[32];
+            snprintf(label, sizeof(label), "simd remap %d thread%s", n, n > 1 ? "s" : "");
+            cost.print(label);
+            fprintf(stderr, "%-24s %.2fx the scalar speed, %.0f fps\n", "", scalar.mean_ms() / cost.mean_ms(),
+                    1000 / cost.mean_ms());
+        }
+        // the last remap and the scalar pass over the same frame have to agree byte for byte
+        const camera_frame &frame = scene[(frames - 1) % BENCH_SCENE_FRAMES]->frame();
+        scalar_remap(lut, frame, reference.data(), dst_stride);
+        size_t differ = 0, invalid = 0;
+        for (size_t i = 0;i < out.size();++i) {
+            differ += out[i] != reference[i];
+        }
+        for (uint32_t m : lut.map) {
+            invalid += REMAP_INVALID == m;
+        }
+        fprintf(stderr, "%-24s %zu bytes differ from scalar, %.1f%% of the view outside the lens\n", "", differ,
+                100.0 * invalid / lut.map.size());
+        return ok && 0 == differ;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 100;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per case] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    if (!bench_init(config, verbose) || frames <= 0) {
+        return 2;
+    }
+    fprintf(stderr, "dewarp per frame, wall time, %ld cpus\n", sysconf(_SC_NPROCESSORS_ONLN));
+    bool ok = size_phase(1280, 720, frames);
+    ok = size_phase(1920, 1080, frames) && ok;
+    return ok ? 0 : 1;
+}
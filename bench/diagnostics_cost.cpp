@@ -0,0 +1,137 @@
+// CPU cost of the driver diagnostics poller by interval on eight running inputs with injected driver
+// faults, the counters it merges into the stats, and the capture latency next to it, idle and under load
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+#include "diagnostics_poller.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_INPUTS = 8 };
+    // the integration side decoder, for the layout of the simulated driver
+    bool decode_sim_diag(const void *info, size_t size, std::vector<driver_counters> &out) {
+        sim_diag_info header;
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, info, sizeof(header));
+        const uint8_t *entries = static_cast<const uint8_t *>(info) + sizeof(header);
+        for (uint32_t i = 0;i < header.count && sizeof(header) + (i + 1) * sizeof(sim_diag_input) <= size;++i) {
+            sim_diag_input entry;
+            memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+            driver_counters counters;
+            counters.input_id = entry.input_id;
+            counters.csi_errors = entry.csi_errors;
+            counters.ife_overflows = entry.ife_overflows;
+            counters.frame_drops = entry.frame_drops;
+            counters.other_errors = entry.other_errors;
+            out.push_back(counters);
+        }
+        return true;
+    }
+    uint64_t merged_faults() {
+        uint64_t total = 0;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            camera_stats stats;
+            if (G_CAMERA_MANAGER.get_camera_stats(id, stats)) {
+                total += stats.csi_errors + stats.ife_overflows + stats.driver_drops + stats.driver_errors;
+            }
+        }
+        return total;
+    }
+    uint64_t injected_faults() {
+        sim_counters counters = sim_get_counters();
+        return counters.injected_signal_losses + counters.injected_errors + counters.frames_starved;
+    }
+    // interval_ms 0 runs without the poller
+    bool run_phase(const char *label, int interval_ms, int hogs, int seconds, bench_samples &latency) {
+        diag_config config;
+        config.interval_ms = interval_ms;
+        std::shared_ptr<diagnostics_poller> poller;
+        if (interval_ms > 0) {
+            poller = std::make_shared<diagnostics_poller>(config, decode_sim_diag, [](const driver_counters &delta) {
+                auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(delta.input_id);
+                if (ptr != nullptr) {
+                    ptr->add_driver_counters(delta);
+                }
+            });
+            if (!poller->start()) {
+                return false;
+            }
+        }
+        uint64_t merged = merged_faults();
+        uint64_t injected = injected_faults();
+        std::unique_ptr<cpu_hog> hog(hogs > 0 ? new cpu_hog(hogs) : nullptr);
+        latency.clear();
+        uint64_t begin = monotonic_ns();
+        bench_sleep_ms(seconds * 1000);
+        double wall = static_cast<double>(monotonic_ns() - begin);
+        hog.reset();
+        uint64_t polls = 0;
+        double cpu_us = 0;
+        if (poller) {
+            poller->stop();
+            polls = poller->polls();
+            cpu_us = poller->average_poll_cpu_us();
+        }
+        latency.print(label);
+        fprintf(stderr, "%-24s %llu polls, %.1f us cpu each, %.4f%% of one core; %llu of %llu injected faults "
+                "merged into the stats\n", "", static_cast<unsigned long long>(polls), cpu_us,
+                100.0 * polls * cpu_us * 1e3 / wall, static_cast<unsigned long long>(merged_faults() - merged),
+                static_cast<unsigned long long>(injected_faults() - injected));
+        return latency.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    int seconds = 5;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:v")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per phase] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    config.error_event_rate = 0.01;
+    config.signal_loss_rate = 0.002;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    bench_samples latency;
+    screen_attribute screenAttr;
+    for (int id = 0;id < BENCH_INPUTS;++id) {
+        capture_attr capAttr = bench_headless(id);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            fprintf(stderr, "input %d: create failed\n", id);
+            return 1;
+        }
+        bench_listen_latency(id, latency);
+        G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+    }
+    int hogs = 4 * static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(stderr, "%d inputs at 30 fps with driver faults, capture latency and diagnostics poller cost, %d s each\n",
+            BENCH_INPUTS, seconds);
+    bool ok = run_phase("no poller", 0, 0, seconds, latency);
+    const int intervals[] = { 1000, 100, 10, 1 };
+    for (int interval : intervals) {
+        std::string label = "poll every " + std::to_string(interval) + " ms";
+        ok = run_phase(label.c_str(), interval, 0, seconds, latency) && ok;
+    }
+    std::string label = "10 ms, " + std::to_string(hogs) + " busy threads";
+    ok = run_phase("no poller, busy threads", 0, hogs, seconds, latency) && ok;
+    ok = run_phase(label.c_str(), 10, hogs, seconds, latency) && ok;
+    for (int id = 0;id < BENCH_INPUTS;++id) {
+        G_CAMERA_MANAGER.destroy_camera_connect(id);
+    }
+    return ok ? 0 : 1;
+}
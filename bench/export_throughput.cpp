@@ -0,0 +1,261 @@
+// frame export from the capture side to reader processes: cost of a publish on the shared ring with zero
+// copy buffers and with twin copies (skipped without a reader), and what readers in other processes
+// receive from running inputs, windowed ones through twins and headless ones by descriptor
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "bench_common.hpp"
+#include "frame_reader.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum export_bench_param : int {
+        BENCH_WIDTH = 1280,
+        BENCH_HEIGHT = 720,
+        BENCH_STRIDE = BENCH_WIDTH * 2,             // < UYVY
+        BENCH_BUFFERS = 5,
+        BENCH_CONNECT_MS = 5000,
+        BENCH_INPUTS = 4,
+    };
+    struct reader_report {
+        int connected = 0;
+        uint64_t frames = 0;
+        uint64_t skipped = 0;                       // < Published frames the reader never saw
+        uint64_t unmapped = 0;                      // < Frames without data
+        uint64_t invalidated = 0;                   // < Frames refilled before the reader was done with them
+        double p50_ms = 0;
+        double p99_ms = 0;
+        double max_ms = 0;
+    };
+    // in memory shared with the reader process
+    struct reader_channel {
+        std::atomic<int> stop;
+        reader_report report;
+    };
+    reader_channel *make_channel() {
+        void *addr = mmap(nullptr, sizeof(reader_channel), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == addr) {
+            return nullptr;
+        }
+        reader_channel *channel = new (addr) reader_channel();
+        channel->stop = 0;
+        return channel;
+    }
+    // reader process body: follows the ring until told to stop, touching the first and last byte of each frame
+    void read_frames(const std::string &path, reader_channel *channel, int poll_us) {
+        frame_reader reader;
+        uint64_t deadline = monotonic_ns() + BENCH_CONNECT_MS * 1000000ULL;
+        while (!reader.connect(path)) {
+            if (monotonic_ns() > deadline || channel->stop) {
+                return;
+            }
+            bench_sleep_ms(10);
+        }
+        channel->report.connected = 1;
+        bench_samples latency;
+        reader_report &report = channel->report;
+        uint64_t last = 0;
+        volatile uint8_t sink = 0;
+        while (!channel->stop) {
+            frame_view view;
+            if (!reader.next(last, view)) {
+                if (poll_us > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(poll_us));
+                }
+                else {
+                    sched_yield();
+                }
+                continue;
+            }
+            uint64_t now = monotonic_ns();
+            latency.add(now > view.timestamp ? now - view.timestamp : 0);
+            if (last > 0 && view.frame_count > last + 1) {
+                report.skipped += view.frame_count - last - 1;
+            }
+            last = view.frame_count;
+            ++report.frames;
+            if (nullptr == view.data) {
+                ++report.unmapped;
+            }
+            else {
+                sink = sink + view.data[0] + view.data[view.stride * view.height - 1];
+            }
+            if (!reader.still_valid(view)) {
+                ++report.invalidated;
+            }
+        }
+        report.p50_ms = latency.percentile_ms(0.5);
+        report.p99_ms = latency.percentile_ms(0.99);
+        report.max_ms = latency.percentile_ms(1.0);
+    }
+    pid_t spawn_reader(const std::string &path, reader_channel *channel, int poll_us) {
+        pid_t pid = fork();
+        if (0 == pid) {
+            read_frames(path, channel, poll_us);
+            _exit(0);
+        }
+        return pid;
+    }
+    bool wait_connected(reader_channel *channel) {
+        for (int i = 0;i < BENCH_CONNECT_MS / 10 && !channel->report.connected;++i) {
+            bench_sleep_ms(10);
+        }
+        return channel->report.connected != 0;
+    }
+    void finish_reader(pid_t pid, reader_channel *channel) {
+        channel->stop = 1;
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+    void print_report(const char *label, const reader_report &report, double seconds) {
+        fprintf(stderr, "%-24s reader %llu frames (%.1f/s), %llu skipped, %llu unmapped, %llu reused under it, "
+                "latency p50 %.3f p99 %.3f max %.3f ms\n", label, static_cast<unsigned long long>(report.frames),
+                report.frames / seconds, static_cast<unsigned long long>(report.skipped),
+                static_cast<unsigned long long>(report.unmapped), static_cast<unsigned long long>(report.invalidated),
+                report.p50_ms, report.p99_ms, report.max_ms);
+    }
+    // publish as fast as possible with one reader process following or none; twin copies frames from heap
+    // buffers standing in for Screen buffers without a descriptor
+    bool ring_phase(const char *label, bool twin, int publishes, bool reader) {
+        const std::string path = "/tmp/qnx_screen_camera_bench_ring.sock";
+        const uint32_t size = BENCH_STRIDE * BENCH_HEIGHT;
+        reader_channel *channel = make_channel();
+        if (nullptr == channel) {
+            return false;
+        }
+        pid_t pid = reader ? spawn_reader(path, channel, 0) : 0;
+        std::vector<std::unique_ptr<uint8_t[]>> heap;
+        std::vector<int> fds;
+        frame_exporter exporter;
+        bool ok = exporter.init(BENCH_BUFFERS);
+        for (int i = 0;ok && i < BENCH_BUFFERS;++i) {
+            if (twin) {
+                heap.emplace_back(new uint8_t[size]());
+                ok = exporter.add_buffer(i, -1, 0, size, BENCH_STRIDE, heap.back().get());
+            }
+            else {
+                int fd = create_anon_shm("bench_buffer", size);
+                fds.push_back(fd);
+                ok = fd >= 0 && exporter.add_buffer(i, fd, 0, size, BENCH_STRIDE);
+            }
+        }
+        ok = ok && exporter.start(path) && (!reader || wait_connected(channel));
+        if (ok) {
+            uint64_t begin = monotonic_ns();
+            for (int i = 0;i < publishes;++i) {
+                exporter.publish(i % BENCH_BUFFERS, i, monotonic_ns(), BENCH_WIDTH, BENCH_HEIGHT, BENCH_STRIDE,
+                                 QCARCAM_FMT_UYVY_8);
+            }
+            double ns = static_cast<double>(monotonic_ns() - begin);
+            fprintf(stderr, "%-24s %d publishes, %.1f ns each, %.0f per second", label, publishes, ns / publishes,
+                    publishes / ns * 1e9);
+            if (twin && reader) {
+                fprintf(stderr, ", %.2f GB/s copied", static_cast<double>(size) * publishes / ns);
+            }
+            fprintf(stderr, "\n");
+            if (reader) {
+                bench_sleep_ms(50);
+                finish_reader(pid, channel);
+                print_report("", channel->report, ns / 1e9);
+            }
+        }
+        else {
+            fprintf(stderr, "%s: exporter or reader setup failed\n", label);
+            if (reader) {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+        exporter.stop();
+        for (int fd : fds) {
+            close(fd);
+        }
+        munmap(channel, sizeof(reader_channel));
+        return ok;
+    }
+    // running inputs exporting to one reader process each, half windowed and half headless
+    bool capture_phase(int seconds) {
+        reader_channel *channels[BENCH_INPUTS] = { nullptr };
+        pid_t pids[BENCH_INPUTS] = { 0 };
+        std::string paths[BENCH_INPUTS];
+        bool ok = true;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            paths[id] = "/tmp/qnx_screen_camera_bench_export" + std::to_string(id) + ".sock";
+            channels[id] = make_channel();
+            if (nullptr == channels[id]) {
+                return false;
+            }
+            pids[id] = spawn_reader(paths[id], channels[id], 200);
+        }
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            screen_attribute screenAttr;
+            screenAttr.display_id = 0;
+            screenAttr.window_size = { 0.5, 0.5 };
+            screenAttr.window_pos = { 0.5 * (id % 2), 0.5 * (id / 2) };
+            capture_attr capAttr = bench_headless(id);
+            capAttr.headless = id >= BENCH_INPUTS / 2;
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+                ok = false;
+                continue;
+            }
+            auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+            ok = ptr->enable_frame_export(paths[id]) && wait_connected(channels[id]) && ok;
+        }
+        uint64_t begin = monotonic_ns();
+        for (int id = 0;ok && id < BENCH_INPUTS;++id) {
+            ok = G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+        }
+        if (ok) {
+            bench_sleep_ms(seconds * 1000);
+        }
+        double elapsed = (monotonic_ns() - begin) / 1e9;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            finish_reader(pids[id], channels[id]);
+            G_CAMERA_MANAGER.destroy_camera_connect(id);
+            std::string label = std::string("input ") + std::to_string(id) + (id >= BENCH_INPUTS / 2 ? " headless" : " windowed");
+            print_report(label.c_str(), channels[id]->report, elapsed);
+            ok = ok && channels[id]->report.frames > 0 && 0 == channels[id]->report.unmapped;
+            munmap(channels[id], sizeof(reader_channel));
+        }
+        return ok;
+    }
+}
+int main(int argc, char **argv) {
+    int seconds = 10;
+    int publishes = 1000000;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:n:v")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'n':
+            publishes = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds of capture] [-n zero copy publishes] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    config.fill = true;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "frame export, %dx%d UYVY, %d buffers, readers in child processes\n", BENCH_WIDTH, BENCH_HEIGHT,
+            BENCH_BUFFERS);
+    bool ok = ring_phase("zero copy publish", false, publishes, true);
+    ok = ring_phase("twin copy publish", true, std::max(publishes / 500, 1), true) && ok;
+    ok = ring_phase("twin, no reader", true, publishes, false) && ok;
+    fprintf(stderr, "%d inputs at 30 fps for %d s:\n", BENCH_INPUTS, seconds);
+    ok = capture_phase(seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// hidden window power mode with 1 visible and 3 hidden windowed inputs: posts, buffer writes and
+// composition reads per second and CPU per frame against all four visible, and how fast a reveal shows.
+// The sim writes one line per frame so the CPU is the pipeline's; the MB/s are what full frames would move
+#include <getopt.h>
+#include <stdlib.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_INPUTS = 4, BENCH_WIDTH = 1280, BENCH_HEIGHT = 720, BENCH_REVEALS = 10 };
+    const double frame_mb = BENCH_WIDTH * BENCH_HEIGHT * 2 / 1e6;
+    bool create_all(float hidden_fps) {
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            screen_attribute screenAttr;
+            screenAttr.display_id = 0;
+            screenAttr.window_size = { 0.5, 0.5 };
+            screenAttr.window_pos = { 0.5 * (id % 2), 0.5 * (id / 2) };
+            capture_attr capAttr;
+            capAttr.input_id = static_cast<qcarcam_input_desc_t>(id);
+            capAttr.hidden_fps = hidden_fps;
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr) ||
+                !G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START)) {
+                fprintf(stderr, "input %d: create or start failed\n", id);
+                return false;
+            }
+        }
+        return true;
+    }
+    void destroy_all() {
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            G_CAMERA_MANAGER.destroy_camera_connect(id);
+        }
+    }
+    uint64_t posts_of(int id) {
+        camera_stats stats;
+        return G_CAMERA_MANAGER.get_camera_stats(id, stats) ? stats.posts : 0;
+    }
+    void run_phase(const char *label, int seconds) {
+        bench_sleep_ms(300);
+        uint64_t frames = 0;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            camera_stats stats;
+            G_CAMERA_MANAGER.get_camera_stats(id, stats);
+            frames -= stats.frames;
+        }
+        sim_counters before = sim_get_counters();
+        uint64_t cpu = process_cpu_ns();
+        uint64_t begin = monotonic_ns();
+        bench_sleep_ms(seconds * 1000);
+        double elapsed = (monotonic_ns() - begin) / 1e9;
+        cpu = process_cpu_ns() - cpu;
+        sim_counters after = sim_get_counters();
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            camera_stats stats;
+            G_CAMERA_MANAGER.get_camera_stats(id, stats);
+            frames += stats.frames;
+        }
+        double posts = (after.posts - before.posts) / elapsed;
+        double writes = (after.frames_produced - before.frames_produced) / elapsed;
+        fprintf(stderr, "%-30s %6.1f posts/s %6.1f frames/s, writes %6.1f MB/s, composition reads %6.1f MB/s, "
+                "cpu %5.1f us per frame, %4.2f%% of one core\n", label, posts, writes, writes * frame_mb,
+                posts * frame_mb, frames ? cpu / 1e3 / frames : 0.0, cpu / 1e7 / elapsed);
+    }
+    // time from set_visible until the window has a post, and until it has a frame captured after the reveal
+    void reveal(const char *label) {
+        bench_samples shown;
+        bench_samples fresh;
+        for (int i = 0;i < BENCH_REVEALS;++i) {
+            int id = 1 + i % (BENCH_INPUTS - 1);
+            uint64_t posts = posts_of(id);
+            uint64_t begin = monotonic_ns();
+            G_CAMERA_MANAGER.set_camera_visible(id, 1);
+            while (posts_of(id) == posts && monotonic_ns() - begin < 1000000000ULL) {
+                std::this_thread::yield();
+            }
+            shown.add(monotonic_ns() - begin);
+            while (posts_of(id) < posts + 2 && monotonic_ns() - begin < 1000000000ULL) {
+                bench_sleep_ms(1);
+            }
+            fresh.add(monotonic_ns() - begin);
+            G_CAMERA_MANAGER.set_camera_visible(id, 0);
+            bench_sleep_ms(300);
+        }
+        std::string name = std::string(label) + " reveal shown";
+        shown.print(name.c_str());
+        name = std::string(label) + " next frame";
+        fresh.print(name.c_str());
+    }
+}
+int main(int argc, char **argv) {
+    int seconds = 5;
+    float hidden_fps = 5;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:f:v")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'f':
+            hidden_fps = static_cast<float>(atof(optarg));
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per phase] [-f hidden fps] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "%d windowed 720p UYVY inputs at 30 fps, %d s per phase\n", BENCH_INPUTS, seconds);
+    if (!create_all(0)) {
+        return 1;
+    }
+    run_phase("4 visible", seconds);
+    for (int id = 1;id < BENCH_INPUTS;++id) {
+        G_CAMERA_MANAGER.set_camera_visible(id, 0);
+    }
+    run_phase("1 visible, 3 hidden", seconds);
+    reveal("keep rate");
+    destroy_all();
+    if (!create_all(hidden_fps)) {
+        return 1;
+    }
+    for (int id = 1;id < BENCH_INPUTS;++id) {
+        G_CAMERA_MANAGER.set_camera_visible(id, 0);
+    }
+    std::string label = "1 visible, 3 hidden at " + std::to_string(static_cast<int>(hidden_fps)) + " fps";
+    run_phase(label.c_str(), seconds);
+    reveal("hidden fps");
+    destroy_all();
+    return 0;
+}
@@ -0,0 +1,189 @@
+// lens health monitor: the cost of one sampled frame against the 0.5 ms budget at 720p UYVY and 1080p
+// NV12, the samples it takes to raise blurred, obstructed and ok again on degraded copies of the scene,
+// then the monitor on a live input through camera_manager. The cost follows the decimated plane, the
+// budget is checked on the 320x180 plane: 720p at decimation 4, 1080p at decimation 6
+#include <getopt.h>
+#include <stdlib.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_SCENE_FRAMES = 8, BENCH_BUDGET_US = 500, BENCH_BLUR_RADIUS = 6, BENCH_MAX_SAMPLES = 200 };
+    // the monitor driven straight from the bench thread, one call per sampled frame
+    class lens_probe : public lens_monitor {
+    public:
+        lens_probe(const lens_config &config, const lens_callback &callback)
+            : lens_monitor(nullptr, config, callback) {
+        }
+        inline void sample(const camera_frame &frame) {
+            process(frame);
+        }
+    };
+    // a scene frame with its own luma the bench can degrade
+    class lens_scene {
+    public:
+        lens_scene(qcarcam_color_fmt_t format, uint32_t width, uint32_t height, int t) {
+            bench_frame source(format, width, height, t);
+            frame_ = source.frame();
+            size_t size = QCARCAM_FMT_NV12 == format ? frame_.plane_offset + frame_.stride * height / 2
+                                                      : static_cast<size_t>(frame_.stride) * height;
+            data_.assign(frame_.data, frame_.data + size);
+            frame_.data = data_.data();
+        }
+        // a wet or defocused lens: box blur of the luma, rows then columns
+        void blur(int radius) {
+            std::vector<int> line;
+            for (int pass = 0;pass < 2;++pass) {
+                int n = pass ? frame_.height : frame_.width;
+                int lines = pass ? frame_.width : frame_.height;
+                line.resize(n);
+                for (int l = 0;l < lines;++l) {
+                    for (int i = 0;i < n;++i) {
+                        line[i] = *luma(pass ? l : i, pass ? i : l);
+                    }
+                    for (int i = 0;i < n;++i) {
+                        int sum = 0, count = 0;
+                        for (int k = std::max(i - radius, 0);k <= std::min(i + radius, n - 1);++k) {
+                            sum += line[k];
+                            ++count;
+                        }
+                        *luma(pass ? l : i, pass ? i : l) = static_cast<uint8_t>(sum / count);
+                    }
+                }
+            }
+        }
+        // mud or a cover: an almost even luma over the whole frame
+        void cover() {
+            for (uint32_t y = 0;y < frame_.height;++y) {
+                for (uint32_t x = 0;x < frame_.width;++x) {
+                    *luma(x, y) = static_cast<uint8_t>(70 + (x + y) % 3);
+                }
+            }
+        }
+        inline const camera_frame &frame() const {
+            return frame_;
+        }
+    private:
+        inline uint8_t *luma(uint32_t x, uint32_t y) {
+            uint8_t *row = data_.data() + static_cast<size_t>(y) * frame_.stride;
+            return QCARCAM_FMT_NV12 == frame_.format ? row + x : row + x * 2 + 1;
+        }
+    private:
+        std::vector<uint8_t> data_;
+        camera_frame frame_;
+    };
+    // true when the p99 is within the budget
+    bool cost_phase(const char *label, qcarcam_color_fmt_t format, uint32_t width, uint32_t height, int decimation,
+                    int frames) {
+        std::vector<std::unique_ptr<lens_scene>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new lens_scene(format, width, height, t));
+        }
+        lens_config config;
+        config.decimation = decimation;
+        lens_probe probe(config, nullptr);
+        bench_samples cost;
+        for (int i = 0;i < frames;++i) {
+            uint64_t begin = thread_cpu_ns();
+            probe.sample(scene[i % BENCH_SCENE_FRAMES]->frame());
+            cost.add(thread_cpu_ns() - begin);
+        }
+        char title[48];
+        snprintf(title, sizeof(title), "%s %ux%u / %d", label, width, height, decimation);
+        cost.print(title);
+        fprintf(stderr, "%-24s %.0f%% of the 0.5 ms budget at p99\n", "",
+                100 * cost.percentile_ms(0.99) * 1000 / BENCH_BUDGET_US);
+        return cost.percentile_ms(0.99) * 1000 < BENCH_BUDGET_US;
+    }
+    // samples from the first degraded frame until the monitor raises the expected condition, -1 if never
+    int samples_until(lens_probe &probe, const std::vector<std::unique_ptr<lens_scene>> &scene,
+                      lens_condition expected) {
+        for (int i = 0;i < BENCH_MAX_SAMPLES;++i) {
+            probe.sample(scene[i % BENCH_SCENE_FRAMES]->frame());
+            if (probe.get_condition() == expected) {
+                return i + 1;
+            }
+        }
+        return -1;
+    }
+    bool detect_phase() {
+        std::vector<std::unique_ptr<lens_scene>> sharp, blurred, covered;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            sharp.emplace_back(new lens_scene(QCARCAM_FMT_UYVY_8, 1280, 720, t));
+            blurred.emplace_back(new lens_scene(QCARCAM_FMT_UYVY_8, 1280, 720, t));
+            blurred.back()->blur(BENCH_BLUR_RADIUS);
+            covered.emplace_back(new lens_scene(QCARCAM_FMT_UYVY_8, 1280, 720, t));
+            covered.back()->cover();
+        }
+        lens_config config;
+        int events = 0;
+        lens_probe probe(config, [&events](const lens_event &) { ++events; });
+        int warm = samples_until(probe, sharp, LENS_BLURRED);       // must not fire, runs out the warm up
+        int blur = samples_until(probe, blurred, LENS_BLURRED);
+        int obstruct = samples_until(probe, covered, LENS_OBSTRUCTED);
+        int clear = samples_until(probe, sharp, LENS_OK);
+        fprintf(stderr, "720p UYVY, warm up %d samples, confirm %d, blur radius %d px\n", config.warmup_samples,
+                config.confirm_samples, BENCH_BLUR_RADIUS);
+        fprintf(stderr, "%-24s %d samples\n", "sharp to blurred", blur);
+        fprintf(stderr, "%-24s %d samples\n", "blurred to obstructed", obstruct);
+        fprintf(stderr, "%-24s %d samples\n", "obstructed to ok", clear);
+        fprintf(stderr, "%-24s %d events, %s on the sharp scene\n", "", events, warm < 0 ? "none" : "one");
+        return warm < 0 && blur > 0 && obstruct > 0 && clear > 0 && 3 == events;
+    }
+    bool live_phase(int seconds) {
+        screen_attribute screenAttr;
+        capture_attr capAttr = bench_headless(0);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            return false;
+        }
+        bench_samples latency;
+        bench_listen_latency(0, latency);
+        G_CAMERA_MANAGER.control_camera(0, CAM_CMD_START);
+        bool ok = G_CAMERA_MANAGER.start_lens_monitor(0, lens_config(), nullptr);
+        bench_sleep_ms(200);
+        latency.clear();
+        uint64_t end = monotonic_ns() + static_cast<uint64_t>(seconds) * 1000000000ULL;
+        while (ok && monotonic_ns() < end) {
+            bench_sleep_ms(100);
+        }
+        G_CAMERA_MANAGER.stop_lens_monitor(0);
+        G_CAMERA_MANAGER.destroy_camera_connect(0);
+        fprintf(stderr, "live 720p input at 30 fps with the monitor at 5 samples/s, %d s\n", seconds);
+        latency.print("capture to listener");
+        return ok && latency.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 500;
+    int seconds = 5;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples per case] [-t seconds of capture] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    config.fill = true;
+    if (!bench_init(config, verbose) || frames <= 0 || seconds <= 0) {
+        return 2;
+    }
+    fprintf(stderr, "lens monitor per sampled frame, thread cpu time, size / decimation\n");
+    bool ok = cost_phase("UYVY", QCARCAM_FMT_UYVY_8, 1280, 720, 4, frames);
+    cost_phase("NV12", QCARCAM_FMT_NV12, 1920, 1080, 4, frames);
+    ok = cost_phase("NV12", QCARCAM_FMT_NV12, 1920, 1080, 6, frames) && ok;
+    ok = detect_phase() && ok;
+    ok = live_phase(seconds) && ok;
+    return ok ? 0 : 1;
+}
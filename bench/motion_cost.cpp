@@ -0,0 +1,120 @@
+// cost per frame of the motion detector: alone on synthetic scenes per format and size, then as a stage
+// on four running inputs with the share of one core it takes
+#include <getopt.h>
+#include <stdlib.h>
+#include "bench_common.hpp"
+#include "motion_detector.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_INPUTS = 4, BENCH_SCENE_FRAMES = 8 };
+    // times every process() in thread CPU time
+    class timed_motion_detector : public motion_detector {
+    public:
+        timed_motion_detector(const std::shared_ptr<camera_controller> &camera, const motion_config &config,
+                              const motion_callback &callback, bench_samples &cost)
+            : motion_detector(camera, config, callback), cost_(cost) {
+        }
+        virtual ~timed_motion_detector() {
+            stop();
+        }
+        void analyse(const camera_frame &frame) {
+            process(frame);
+        }
+    protected:
+        void process(const camera_frame &frame) override {
+            uint64_t begin = thread_cpu_ns();
+            motion_detector::process(frame);
+            cost_.add(thread_cpu_ns() - begin);
+        }
+    private:
+        bench_samples &cost_;
+    };
+    bool scene_phase(const char *label, qcarcam_color_fmt_t format, uint32_t width, uint32_t height, int frames) {
+        std::vector<std::unique_ptr<bench_frame>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new bench_frame(format, width, height, t));
+        }
+        bench_samples cost;
+        uint64_t events = 0;
+        motion_config config;
+        timed_motion_detector detector(nullptr, config, [&events](const motion_event &) { ++events; }, cost);
+        for (int i = 0;i < frames;++i) {
+            detector.analyse(scene[i % BENCH_SCENE_FRAMES]->frame());
+        }
+        cost.print(label);
+        fprintf(stderr, "%-24s %llu motion events in %d frames\n", "", static_cast<unsigned long long>(events), frames);
+        return events > 0;
+    }
+    bool pipeline_phase(int seconds) {
+        bench_samples cost;
+        std::vector<std::unique_ptr<timed_motion_detector>> detectors;
+        screen_attribute screenAttr;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            capture_attr capAttr = bench_headless(id);
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+                fprintf(stderr, "input %d: create failed\n", id);
+                return false;
+            }
+            auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+            detectors.emplace_back(new timed_motion_detector(ptr, motion_config(), nullptr, cost));
+        }
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+            detectors[id]->start();
+        }
+        uint64_t cpu = process_cpu_ns();
+        uint64_t begin = monotonic_ns();
+        bench_sleep_ms(seconds * 1000);
+        double wall = static_cast<double>(monotonic_ns() - begin);
+        double process_share = (process_cpu_ns() - cpu) / wall;
+        uint64_t skipped = 0;
+        for (auto &detector : detectors) {
+            detector->stop();
+            skipped += detector->skipped();
+        }
+        detectors.clear();
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            G_CAMERA_MANAGER.destroy_camera_connect(id);
+        }
+        cost.print("4 inputs 720p UYVY");
+        fprintf(stderr, "%-24s detectors %.2f%% of one core, whole process %.2f%% (sim sensors included), "
+                "%llu frames skipped\n", "", 100.0 * cost.mean_ms() * 1e6 * cost.count() / wall, 100.0 * process_share,
+                static_cast<unsigned long long>(skipped));
+        return cost.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 600;
+    int seconds = 10;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per scene] [-t seconds of capture] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    config.fill = true;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "motion detector per frame cost, thread cpu time, default config (decimation 4, 8x8 blocks)\n");
+    bool ok = scene_phase("720p UYVY", QCARCAM_FMT_UYVY_8, 1280, 720, frames);
+    ok = scene_phase("720p NV12", QCARCAM_FMT_NV12, 1280, 720, frames) && ok;
+    ok = scene_phase("1080p UYVY", QCARCAM_FMT_UYVY_8, 1920, 1080, frames) && ok;
+    ok = scene_phase("1080p NV12", QCARCAM_FMT_NV12, 1920, 1080, frames) && ok;
+    ok = pipeline_phase(seconds) && ok;
+    return ok ? 0 : 1;
+}
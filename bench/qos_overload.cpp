@@ -0,0 +1,139 @@
+// synthetic overload: eight 30 fps inputs whose per frame processing needs more CPU than there is,
+// run without and with the qos governor; deadline misses per class and the safety camera latency
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_INPUTS = 8 };
+    const char *const class_names[QOS_CLASS_NUM] = { "safety", "interactive", "background" };
+    inline camera_qos_class class_of(int id) {
+        return 0 == id ? QOS_SAFETY : id < 4 ? QOS_INTERACTIVE : QOS_BACKGROUND;
+    }
+    // stands in for the per frame stages of the pipeline on the capture thread
+    void burn_cpu(uint64_t ns) {
+        uint64_t begin = thread_cpu_ns();
+        while (thread_cpu_ns() - begin < ns) {
+        }
+    }
+    struct class_totals {
+        uint64_t frames = 0;
+        uint64_t misses = 0;
+        uint64_t dropped = 0;
+    };
+    void collect(class_totals (&totals)[QOS_CLASS_NUM]) {
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            camera_stats stats;
+            if (G_CAMERA_MANAGER.get_camera_stats(id, stats)) {
+                class_totals &t = totals[class_of(id)];
+                t.frames += stats.frames;
+                t.misses += stats.deadline_misses;
+                t.dropped += stats.dropped;
+            }
+        }
+    }
+    bool run_phase(const char *label, bool governed, int seconds, bench_samples &safety) {
+        if (governed) {
+            qos_config config;
+            thread_policy above;
+            above.sched_policy = SCHED_FIFO;
+            above.priority = 10;
+            config.policy = above;
+            if (!G_CAMERA_MANAGER.start_qos(config)) {
+                return false;
+            }
+        }
+        class_totals before[QOS_CLASS_NUM];
+        collect(before);
+        safety.clear();
+        uint64_t begin = monotonic_ns();
+        int worst_level = 0;
+        uint64_t escalations = 0;
+        for (int ms = 0;ms < seconds * 1000;ms += 100) {
+            bench_sleep_ms(100);
+            qos_stats stats;
+            if (governed && G_CAMERA_MANAGER.get_qos_stats(stats)) {
+                worst_level = std::max(worst_level, stats.level);
+                escalations = stats.escalations;
+            }
+        }
+        double elapsed = (monotonic_ns() - begin) / 1e9;
+        class_totals after[QOS_CLASS_NUM];
+        collect(after);
+        if (governed) {
+            G_CAMERA_MANAGER.stop_qos();
+        }
+        fprintf(stderr, "%s:\n", label);
+        for (int cls = 0;cls < QOS_CLASS_NUM;++cls) {
+            uint64_t frames = after[cls].frames - before[cls].frames;
+            uint64_t misses = after[cls].misses - before[cls].misses;
+            fprintf(stderr, "  %-12s %7.1f fps dequeued, %7.1f processed, %6llu deadline misses (%5.1f%%)\n",
+                    class_names[cls], frames / elapsed, (frames - (after[cls].dropped - before[cls].dropped)) / elapsed,
+                    static_cast<unsigned long long>(misses), frames ? 100.0 * misses / frames : 0.0);
+        }
+        safety.print("  safety latency");
+        if (governed) {
+            fprintf(stderr, "  governor reached level %d, %llu escalations\n", worst_level,
+                    static_cast<unsigned long long>(escalations));
+        }
+        return safety.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    int seconds = 10;
+    double work_ms = -1;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:w:v")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'w':
+            work_ms = atof(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per phase] [-w ms of cpu per frame] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (work_ms < 0) {
+        work_ms = 1.5 * 1000.0 * cpus / (30.0 * BENCH_INPUTS);       // half again the CPUs there are
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    bench_samples safety;
+    screen_attribute screenAttr;
+    uint64_t work_ns = static_cast<uint64_t>(work_ms * 1e6);
+    for (int id = 0;id < BENCH_INPUTS;++id) {
+        capture_attr capAttr = bench_headless(id);
+        capAttr.qos = class_of(id);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            fprintf(stderr, "input %d: create failed\n", id);
+            return 1;
+        }
+        auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+        ptr->add_frame_listener([work_ns](const camera_frame &) { burn_cpu(work_ns); });
+        if (QOS_SAFETY == capAttr.qos) {
+            bench_listen_latency(id, safety);
+        }
+        G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+    }
+    fprintf(stderr, "%d inputs at 30 fps (1 safety, 3 interactive, 4 background), %.2f ms cpu per frame each, "
+            "%.0f%% of %d cpus asked, deadline one frame period, %d s per phase\n", BENCH_INPUTS, work_ms,
+            100.0 * work_ms * 30 * BENCH_INPUTS / 1000.0 / cpus, cpus, seconds);
+    bool ok = run_phase("without governor", false, seconds, safety);
+    ok = run_phase("with qos governor", true, seconds, safety) && ok;
+    for (int id = 0;id < BENCH_INPUTS;++id) {
+        G_CAMERA_MANAGER.destroy_camera_connect(id);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// RAW to UYVY per stage on synthetic Bayer scenes: the row unpack alone, scalar against the vector path,
+// then unpack with black level and white balance and the demosaic with the UYVY conversion on 1, 2 and 4
+// threads, for MIPI RAW10, MIPI RAW12 and PLAIN16 12 bit at 1920x1080. An x86-64 host build without
+// SSSE3 has no byte shuffle instruction, the compiler then permutes the MIPI groups lane by lane
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+#include "raw_pipeline.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_SCENE_FRAMES = 4, BENCH_WIDTH = 1920, BENCH_HEIGHT = 1080 };
+    // sensor counts of the bench_frame pattern, a bright box moving with t, packed as the capture
+    // hardware writes them
+    class bench_raw_frame {
+    public:
+        bench_raw_frame(qcarcam_color_fmt_t format, int width, int height, int t, int flat = -1)
+            : stride_(raw_stride(format, width)), data_(static_cast<size_t>(stride_) * height) {
+            const uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+            const int full = (1 << bits) - 1;
+            int box = height / 5, box_x = (t * 12) % (width - box), box_y = height / 3;
+            std::vector<uint16_t> counts(width);
+            for (int y = 0;y < height;++y) {
+                for (int x = 0;x < width;++x) {
+                    bool inside = x >= box_x && x < box_x + box && y >= box_y && y < box_y + box;
+                    int level = inside ? 220 : 40 + ((x * 7 + y * 13) ^ (x * y)) % 120;
+                    counts[x] = static_cast<uint16_t>(flat >= 0 ? flat : level * full / 255);
+                }
+                pack(format, counts, data_.data() + static_cast<size_t>(y) * stride_);
+            }
+        }
+        inline const uint8_t *data() const {
+            return data_.data();
+        }
+        inline uint32_t stride() const {
+            return stride_;
+        }
+    private:
+        static void pack(qcarcam_color_fmt_t format, const std::vector<uint16_t> &counts, uint8_t *row) {
+            const uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+            const int width = static_cast<int>(counts.size());
+            if (QCARCAM_PACK_PLAIN16 == QCARCAM_COLOR_GET_PACK(format)) {
+                memcpy(row, counts.data(), counts.size() * sizeof(uint16_t));
+                return;
+            }
+            for (int x = 0;10 == bits && x < width;x += 4) {
+                uint8_t *g = row + (x / 4) * 5;
+                g[4] = 0;
+                for (int i = 0;i < 4;++i) {
+                    g[i] = static_cast<uint8_t>(counts[x + i] >> 2);
+                    g[4] |= static_cast<uint8_t>((counts[x + i] & 3) << (2 * i));
+                }
+            }
+            for (int x = 0;12 == bits && x < width;x += 2) {
+                uint8_t *g = row + (x / 2) * 3;
+                g[0] = static_cast<uint8_t>(counts[x] >> 4);
+                g[1] = static_cast<uint8_t>(counts[x + 1] >> 4);
+                g[2] = static_cast<uint8_t>((counts[x] & 15) | ((counts[x + 1] & 15) << 4));
+            }
+        }
+    private:
+        uint32_t stride_;
+        std::vector<uint8_t> data_;
+    };
+    void print_rate(const bench_samples &samples, double bytes) {
+        double ms = samples.percentile_ms(0.5);
+        fprintf(stderr, "%-24s %.0f Mpix/s, %.0f MB/s in, p50\n", "", BENCH_WIDTH * BENCH_HEIGHT / ms / 1e3,
+                bytes / ms / 1e3);
+    }
+    // the unpack of every row alone; the vector path has to match the per pixel one exactly
+    bool unpack_phase(qcarcam_color_fmt_t format, const bench_raw_frame &frame, int frames) {
+        const uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+        const bool mipi = QCARCAM_PACK_MIPI == QCARCAM_COLOR_GET_PACK(format);
+        std::vector<uint16_t> scalar_row(BENCH_WIDTH), vector_row(BENCH_WIDTH);
+        bench_samples scalar, vector;
+        bool same = true;
+        for (int i = 0;i < frames;++i) {
+            uint64_t begin = thread_cpu_ns();
+            for (int y = 0;mipi && y < BENCH_HEIGHT;++y) {
+                const uint8_t *src = frame.data() + static_cast<size_t>(y) * frame.stride();
+                for (int x = 0;x < BENCH_WIDTH;++x) {
+                    scalar_row[x] = raw_detail::mipi_pixel(src, x, bits);
+                }
+            }
+            uint64_t middle = thread_cpu_ns();
+            for (int y = 0;y < BENCH_HEIGHT;++y) {
+                const uint8_t *src = frame.data() + static_cast<size_t>(y) * frame.stride();
+                unpack_raw_row(src, frame.stride(), format, BENCH_WIDTH, vector_row.data());
+                if (0 == i && mipi) {
+                    for (int x = 0;x < BENCH_WIDTH;++x) {
+                        same = same && vector_row[x] == raw_detail::mipi_pixel(src, x, bits);
+                    }
+                }
+            }
+            scalar.add(middle - begin);
+            vector.add(thread_cpu_ns() - middle);
+        }
+        const double bytes = static_cast<double>(frame.stride()) * BENCH_HEIGHT;
+        if (mipi) {
+            scalar.print("unpack scalar");
+            print_rate(scalar, bytes);
+        }
+        vector.print(mipi ? "unpack vector" : "unpack copy");
+        print_rate(vector, bytes);
+        if (!same) {
+            fprintf(stderr, "%-24s vector unpack differs from the per pixel one\n", "");
+        }
+        return same;
+    }
+    // a grey field through the whole pipeline comes out grey: one luma value, chroma at 128
+    bool grey_check(qcarcam_color_fmt_t format) {
+        const uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+        bench_raw_frame grey(format, BENCH_WIDTH, BENCH_HEIGHT, 0, 1 << (bits - 1));
+        raw_processor processor;
+        std::vector<uint8_t> out(static_cast<size_t>(BENCH_WIDTH) * 2 * BENCH_HEIGHT);
+        if (!processor.configure(raw_config(), format, BENCH_WIDTH, BENCH_HEIGHT) ||
+            !processor.process(grey.data(), grey.stride(), out.data(), BENCH_WIDTH * 2, nullptr)) {
+            return false;
+        }
+        int worst_chroma = 0, luma_min = 255, luma_max = 0;
+        for (size_t i = 0;i < out.size();i += 2) {
+            worst_chroma = std::max(worst_chroma, abs(out[i] - 128));
+            luma_min = std::min<int>(luma_min, out[i + 1]);
+            luma_max = std::max<int>(luma_max, out[i + 1]);
+        }
+        fprintf(stderr, "%-24s grey field: luma %d..%d, chroma within %d of 128\n", "", luma_min, luma_max,
+                worst_chroma);
+        return worst_chroma <= 1 && luma_max - luma_min <= 1;
+    }
+    bool format_phase(const char *label, qcarcam_color_fmt_t format, int frames) {
+        std::vector<std::unique_ptr<bench_raw_frame>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new bench_raw_frame(format, BENCH_WIDTH, BENCH_HEIGHT, t));
+        }
+        fprintf(stderr, "%s %dx%d, stride %u\n", label, BENCH_WIDTH, BENCH_HEIGHT, scene[0]->stride());
+        bool ok = unpack_phase(format, *scene[0], frames);
+        const double bytes = static_cast<double>(scene[0]->stride()) * BENCH_HEIGHT;
+        raw_config config;
+        config.wb_gain[0] = 1.9f;
+        config.wb_gain[2] = 1.6f;
+        std::vector<uint8_t> out(static_cast<size_t>(BENCH_WIDTH) * 2 * BENCH_HEIGHT);
+        const int threads[] = { 1, 2, 4 };
+        for (int n : threads) {
+            thread_pool pool(n - 1);
+            raw_processor processor;
+            if (!processor.configure(config, format, BENCH_WIDTH, BENCH_HEIGHT)) {
+                return false;
+            }
+            bench_samples levels, demosaic, total;
+            for (int i = 0;i < frames;++i) {
+                const bench_raw_frame &frame = *scene[i % BENCH_SCENE_FRAMES];
+                uint64_t begin = monotonic_ns();
+                if (!processor.process(frame.data(), frame.stride(), out.data(), BENCH_WIDTH * 2,
+                                       n > 1 ? &pool : nullptr)) {
+                    return false;
+                }
+                total.add(monotonic_ns() - begin);
+                levels.add(processor.get_timing().unpack_ns);
+                demosaic.add(processor.get_timing().demosaic_ns);
+            }
+            char label[32];
+            snprintf(label, sizeof(label), "%d thread%s:", n, n > 1 ? "s" : "");
+            fprintf(stderr, "%s\n", label);
+            levels.print("  unpack + levels");
+            print_rate(levels, bytes);
+            demosaic.print("  demosaic + uyvy");
+            print_rate(demosaic, bytes);
+            total.print("  frame");
+            fprintf(stderr, "%-24s %.0f fps\n", "", 1000 / total.percentile_ms(0.5));
+        }
+        return grey_check(format) && ok;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 50;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per case] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    if (!bench_init(config, verbose) || frames <= 0) {
+        return 2;
+    }
+    fprintf(stderr, "RAW to UYVY per stage, unpack alone in thread cpu time, pipeline in wall time, %ld cpus\n",
+            sysconf(_SC_NPROCESSORS_ONLN));
+    bool ok = format_phase("MIPI RAW10", QCARCAM_FMT_MIPIRAW_10, frames);
+    ok = format_phase("MIPI RAW12", QCARCAM_FMT_MIPIRAW_12, frames) && ok;
+    ok = format_phase("PLAIN16 12 bit", QCARCAM_FMT_PLAIN16_12, frames) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,407 @@
+// JPEG encode time of a 1080p frame on 1, 2 and 4 threads with the PSNR of the decoded image, and
+// snapshots of a running 1080p input with the capture latency they leave
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "bench_common.hpp"
+#include "jpeg_encoder.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { JPEG_MIN_PSNR_DB = 30 };
+    // baseline decoder for what jpeg_encoder writes (SOF0, Huffman tables in the file, restart
+    // intervals), planes are kept at their padded MCU size
+    class jpeg_check {
+    public:
+        bool decode(const std::vector<uint8_t> &jpeg) {
+            data_ = jpeg.data();
+            size_ = jpeg.size();
+            if (size_ < 4 || data_[0] != 0xFF || data_[1] != 0xD8) {
+                return false;
+            }
+            size_t pos = 2;
+            while (pos + 4 <= size_ && 0xFF == data_[pos]) {
+                int marker = data_[pos + 1];
+                size_t len = static_cast<size_t>(data_[pos + 2]) << 8 | data_[pos + 3];
+                const uint8_t *seg = data_ + pos + 4;
+                if (len < 2 || pos + 2 + len > size_) {
+                    return false;
+                }
+                size_t n = len - 2;
+                if (0xDB == marker) {
+                    for (size_t i = 0;i + 65 <= n;i += 65) {
+                        for (int k = 0;k < 64;++k) {
+                            quant_[seg[i] & 3][jpeg_tables::ZIGZAG[k]] = seg[i + 1 + k];
+                        }
+                    }
+                }
+                else if (0xC0 == marker) {
+                    height_ = seg[1] << 8 | seg[2];
+                    width_ = seg[3] << 8 | seg[4];
+                    components_ = std::min<int>(seg[5], 3);
+                    for (int c = 0;c < components_;++c) {
+                        comp_[c].h = seg[7 + 3 * c] >> 4;
+                        comp_[c].v = seg[7 + 3 * c] & 15;
+                        comp_[c].tq = seg[8 + 3 * c] & 3;
+                    }
+                }
+                else if (0xC4 == marker) {
+                    for (size_t i = 0;i + 17 <= n;) {
+                        huffman &table = huff_[seg[i] >> 4 ? 1 : 0][seg[i] & 1];
+                        int count = build(table, seg + i + 1, seg + i + 17);
+                        i += 17 + count;
+                    }
+                }
+                else if (0xDD == marker) {
+                    restart_ = seg[0] << 8 | seg[1];
+                }
+                else if (0xDA == marker) {
+                    for (int c = 0;c < components_ && 1 + 2 * c + 1 < static_cast<int>(n);++c) {
+                        comp_[c].td = seg[2 + 2 * c] >> 4 & 1;
+                        comp_[c].ta = seg[2 + 2 * c] & 1;
+                    }
+                    pos_ = pos + 2 + len;
+                    return scan();
+                }
+                pos += 2 + len;
+            }
+            return false;
+        }
+        // PSNR in dB of the decoded luma and chroma against the source expanded from video range
+        void psnr(const camera_frame &frame, double &luma, double &chroma) const {
+            bool nv12 = QCARCAM_FMT_NV12 == frame.format;
+            double se[2] = { 0, 0 };
+            size_t count[2] = { 0, 0 };
+            for (uint32_t y = 0;y < frame.height;++y) {
+                const uint8_t *row = frame.data + static_cast<size_t>(y) * frame.stride;
+                for (uint32_t x = 0;x < frame.width;++x) {
+                    double ref = std::min(std::max((row[nv12 ? x : 2 * x + 1] - 16) * 255.0 / 219.0, 0.0), 255.0);
+                    double diff = plane_[0][static_cast<size_t>(y) * stride_[0] + x] - ref;
+                    se[0] += diff * diff;
+                    ++count[0];
+                }
+            }
+            uint32_t chroma_h = nv12 ? (frame.height + 1) / 2 : frame.height;
+            for (uint32_t y = 0;y < chroma_h;++y) {
+                const uint8_t *row = frame.data + frame.plane_offset + static_cast<size_t>(y) * frame.stride;
+                for (uint32_t x = 0;x < (frame.width + 1) / 2;++x) {
+                    for (int c = 1;c < 3;++c) {
+                        int sample = nv12 ? row[2 * x + c - 1] : row[4 * x + 2 * (c - 1)];
+                        double ref = std::min(std::max((sample - 128) * 255.0 / 224.0 + 128, 0.0), 255.0);
+                        double diff = plane_[c][static_cast<size_t>(y) * stride_[c] + x] - ref;
+                        se[1] += diff * diff;
+                        ++count[1];
+                    }
+                }
+            }
+            luma = 10 * log10(255.0 * 255.0 / std::max(se[0] / count[0], 1e-9));
+            chroma = 10 * log10(255.0 * 255.0 / std::max(se[1] / count[1], 1e-9));
+        }
+        inline int width() const {
+            return width_;
+        }
+        inline int height() const {
+            return height_;
+        }
+    private:
+        struct huffman {
+            int maxcode[17];
+            int valptr[17];
+            int mincode[17];
+            uint8_t vals[256];
+        };
+        struct component {
+            int h = 1, v = 1, tq = 0, td = 0, ta = 0;
+        };
+        static int build(huffman &table, const uint8_t *bits, const uint8_t *vals) {
+            int code = 0, k = 0;
+            for (int len = 1;len <= 16;++len) {
+                table.valptr[len] = k;
+                table.mincode[len] = code;
+                code += bits[len - 1];
+                k += bits[len - 1];
+                table.maxcode[len] = bits[len - 1] ? code - 1 : -1;
+                code <<= 1;
+            }
+            memcpy(table.vals, vals, std::min(k, 256));
+            return k;
+        }
+        int bit() {
+            if (0 == count_) {
+                if (pos_ >= size_) {
+                    return 0;
+                }
+                uint8_t byte = data_[pos_];
+                if (0xFF == byte) {
+                    if (pos_ + 1 < size_ && 0 == data_[pos_ + 1]) {
+                        pos_ += 2;
+                    }
+                    else {
+                        return 0;               // a marker ends the data, pad with zeros
+                    }
+                }
+                else {
+                    ++pos_;
+                }
+                acc_ = byte;
+                count_ = 8;
+            }
+            --count_;
+            return acc_ >> count_ & 1;
+        }
+        int bits(int n) {
+            int v = 0;
+            for (int i = 0;i < n;++i) {
+                v = v << 1 | bit();
+            }
+            return v;
+        }
+        int symbol(const huffman &table) {
+            int code = 0;
+            for (int len = 1;len <= 16;++len) {
+                code = code << 1 | bit();
+                if (table.maxcode[len] >= 0 && code <= table.maxcode[len]) {
+                    return table.vals[table.valptr[len] + code - table.mincode[len]];
+                }
+            }
+            return -1;
+        }
+        int extend(int n) {
+            int v = bits(n);
+            return n && v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+        }
+        bool block(const component &comp, int &pred, uint8_t *dst, size_t stride) {
+            float coef[64] = { 0 };
+            int s = symbol(huff_[0][comp.td]);
+            if (s < 0) {
+                return false;
+            }
+            pred += extend(s);
+            coef[0] = static_cast<float>(pred * quant_[comp.tq][0]);
+            for (int k = 1;k < 64;) {
+                int rs = symbol(huff_[1][comp.ta]);
+                if (rs < 0) {
+                    return false;
+                }
+                if (0 == rs) {
+                    break;
+                }
+                k += rs >> 4;
+                if (k > 63) {
+                    return false;
+                }
+                int n = jpeg_tables::ZIGZAG[k];
+                coef[n] = static_cast<float>(extend(rs & 15) * quant_[comp.tq][n]);
+                ++k;
+            }
+            float tmp[64];
+            for (int y = 0;y < 8;++y) {                 // rows of the spatial block from the vertical frequencies
+                for (int u = 0;u < 8;++u) {
+                    float sum = 0;
+                    for (int v = 0;v < 8;++v) {
+                        sum += cos_[y][v] * coef[v * 8 + u];
+                    }
+                    tmp[y * 8 + u] = sum;
+                }
+            }
+            for (int y = 0;y < 8;++y) {
+                for (int x = 0;x < 8;++x) {
+                    float sum = 0;
+                    for (int u = 0;u < 8;++u) {
+                        sum += cos_[x][u] * tmp[y * 8 + u];
+                    }
+                    dst[y * stride + x] = static_cast<uint8_t>(std::min(std::max(sum / 4 + 128.5f, 0.0f), 255.0f));
+                }
+            }
+            return true;
+        }
+        bool scan() {
+            for (int x = 0;x < 8;++x) {
+                for (int u = 0;u < 8;++u) {
+                    cos_[x][u] = static_cast<float>((u ? 1.0 : 1 / sqrt(2.0)) * cos((2 * x + 1) * u * M_PI / 16));
+                }
+            }
+            int hmax = 1, vmax = 1;
+            for (int c = 0;c < components_;++c) {
+                hmax = std::max(hmax, comp_[c].h);
+                vmax = std::max(vmax, comp_[c].v);
+            }
+            int mcus_x = (width_ + 8 * hmax - 1) / (8 * hmax);
+            int mcus_y = (height_ + 8 * vmax - 1) / (8 * vmax);
+            for (int c = 0;c < components_;++c) {
+                stride_[c] = static_cast<size_t>(mcus_x) * comp_[c].h * 8;
+                plane_[c].assign(stride_[c] * mcus_y * comp_[c].v * 8, 0);
+            }
+            int pred[3] = { 0, 0, 0 };
+            count_ = 0;
+            for (int m = 0;m < mcus_x * mcus_y;++m) {
+                if (restart_ > 0 && m > 0 && 0 == m % restart_) {
+                    count_ = 0;
+                    if (pos_ + 1 >= size_ || data_[pos_] != 0xFF || (data_[pos_ + 1] & 0xF8) != 0xD0) {
+                        return false;
+                    }
+                    pos_ += 2;
+                    pred[0] = pred[1] = pred[2] = 0;
+                }
+                int mx = m % mcus_x, my = m / mcus_x;
+                for (int c = 0;c < components_;++c) {
+                    for (int v = 0;v < comp_[c].v;++v) {
+                        for (int h = 0;h < comp_[c].h;++h) {
+                            size_t x = static_cast<size_t>(mx * comp_[c].h + h) * 8;
+                            size_t y = static_cast<size_t>(my * comp_[c].v + v) * 8;
+                            if (!block(comp_[c], pred[c], plane_[c].data() + y * stride_[c] + x, stride_[c])) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+    private:
+        const uint8_t *data_ = nullptr;
+        size_t size_ = 0;
+        size_t pos_ = 0;
+        uint32_t acc_ = 0;
+        int count_ = 0;
+        uint8_t quant_[4][64] = { { 0 } };
+        huffman huff_[2][2];                    // < [DC, AC][table id]
+        component comp_[3];
+        int components_ = 0;
+        int width_ = 0;
+        int height_ = 0;
+        int restart_ = 0;
+        float cos_[8][8];
+        std::vector<uint8_t> plane_[3];
+        size_t stride_[3] = { 0, 0, 0 };
+    };
+    bool encode_phase(const char *label, qcarcam_color_fmt_t format, int threads, int rounds) {
+        bench_frame scene(format, 1920, 1080, 0);
+        const camera_frame &frame = scene.frame();
+        std::unique_ptr<thread_pool> pool(threads > 1 ? new thread_pool(threads - 1) : nullptr);
+        jpeg_encoder encoder;
+        std::vector<uint8_t> jpeg;
+        bench_samples wall;
+        for (int i = 0;i < rounds;++i) {
+            uint64_t begin = monotonic_ns();
+            if (!encoder.encode(frame.data, frame.stride, frame.width, frame.height, format, pool.get(), jpeg)) {
+                return false;
+            }
+            wall.add(monotonic_ns() - begin);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s, %d thread%s", label, threads, threads > 1 ? "s" : "");
+        wall.print(name);
+        fprintf(stderr, "%-24s %zu bytes, %.1f Mpixel/s\n", "", jpeg.size(),
+                frame.width * frame.height / (wall.mean_ms() * 1e3));
+        jpeg_check check;
+        if (!check.decode(jpeg) || check.width() != static_cast<int>(frame.width) ||
+            check.height() != static_cast<int>(frame.height)) {
+            fprintf(stderr, "%-24s does not decode\n", "");
+            return false;
+        }
+        double luma = 0, chroma = 0;
+        check.psnr(frame, luma, chroma);
+        fprintf(stderr, "%-24s decoded PSNR luma %.1f dB, chroma %.1f dB\n", "", luma, chroma);
+        return luma >= JPEG_MIN_PSNR_DB && chroma >= JPEG_MIN_PSNR_DB;
+    }
+    // capture latency of the input with one snapshot every interval_ms, or none
+    bool snapshot_phase(int seconds, int interval_ms) {
+        screen_attribute screenAttr;
+        capture_attr capAttr = bench_headless(0);
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            return false;
+        }
+        bench_samples latency;
+        bench_samples total;
+        bench_samples copy;
+        bench_samples encode;
+        bench_listen_latency(0, latency);
+        G_CAMERA_MANAGER.control_camera(0, CAM_CMD_START);
+        bench_sleep_ms(200);
+        latency.clear();
+        uint64_t end = monotonic_ns() + seconds * 1000000000ULL;
+        int failed = 0;
+        while (monotonic_ns() < end) {
+            if (interval_ms > 0) {
+                uint64_t begin = monotonic_ns();
+                snapshot_result result = G_CAMERA_MANAGER.snapshot(0).get();
+                if (result.ok) {
+                    total.add(monotonic_ns() - begin);
+                    copy.add(static_cast<uint64_t>(result.copy_ms * 1e6));
+                    encode.add(static_cast<uint64_t>(result.encode_ms * 1e6));
+                }
+                else {
+                    ++failed;
+                }
+            }
+            bench_sleep_ms(interval_ms > 0 ? interval_ms : 100);
+        }
+        G_CAMERA_MANAGER.destroy_camera_connect(0);
+        if (interval_ms > 0) {
+            total.print("snapshot request to jpeg");
+            copy.print("  buffer pinned for copy");
+            encode.print("  encode");
+            latency.print("capture with snapshots");
+            fprintf(stderr, "%-24s %d snapshots failed\n", "", failed);
+        }
+        else {
+            latency.print("capture alone");
+        }
+        return 0 == failed;
+    }
+}
+int main(int argc, char **argv) {
+    int rounds = 50;
+    int seconds = 10;
+    int snapshot_threads = 2;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:j:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'j':
+            snapshot_threads = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n encodes per case] [-t seconds of capture] [-j snapshot threads] [-v]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    config.width = 1920;
+    config.height = 1080;
+    config.fill = true;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "1080p JPEG encode, quality 85, %ld cpus\n", sysconf(_SC_NPROCESSORS_ONLN));
+    bool ok = true;
+    const int threads[] = { 1, 2, 4 };
+    for (int n : threads) {
+        ok = encode_phase("UYVY 4:2:2", QCARCAM_FMT_UYVY_8, n, rounds) && ok;
+    }
+    for (int n : threads) {
+        ok = encode_phase("NV12 4:2:0", QCARCAM_FMT_NV12, n, rounds) && ok;
+    }
+    fprintf(stderr, "1080p input at 30 fps, snapshot every 200 ms on %d threads, %d s:\n", snapshot_threads, seconds);
+    G_CAMERA_MANAGER.configure_snapshot(snapshot_threads, jpeg_options());
+    // an input that is not open fails at once, without waiting on the engine
+    std::future<snapshot_result> missing = G_CAMERA_MANAGER.snapshot(1);
+    bool at_once = std::future_status::ready == missing.wait_for(std::chrono::seconds(0)) && !missing.get().ok;
+    fprintf(stderr, "%-24s %s\n", "snapshot of no input", at_once ? "failed at once" : "not failed at once");
+    ok = at_once && ok;
+    ok = snapshot_phase(seconds, 0) && ok;
+    ok = snapshot_phase(seconds, 200) && ok;
+    return ok ? 0 : 1;
+}
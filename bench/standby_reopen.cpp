@@ -0,0 +1,118 @@
+// open and close latency on the simulated backend: cold open, close, park into warm standby and the warm
+// reopen of the parked input, each as the call alone and as open to the first frame delivered to a listener
+// both "to frame" times have a floor of one sim frame period after the start, 33 ms at 30 fps
+#include <getopt.h>
+#include <stdlib.h>
+#include <condition_variable>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_FIRST_FRAME_TIMEOUT_MS = 2000 };
+    struct reopen_samples {
+        bench_samples cold_open, cold_first, close, park, warm_open, warm_first;
+    };
+    // start the input and wait for its first frame; the time from begin to the listener call, 0 on timeout
+    uint64_t first_frame(int id, uint64_t begin) {
+        auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+        if (nullptr == ptr) {
+            return 0;
+        }
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint64_t arrival = 0;
+        int listener = ptr->add_frame_listener([&](const camera_frame &) {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (0 == arrival) {
+                arrival = monotonic_ns();
+                cv.notify_all();
+            }
+        });
+        G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait_for(lk, std::chrono::milliseconds(BENCH_FIRST_FRAME_TIMEOUT_MS), [&arrival]() {
+                return 0 != arrival; });
+        }
+        ptr->remove_frame_listener(listener);
+        std::lock_guard<std::mutex> guard(mutex);
+        return arrival > begin ? arrival - begin : 0;
+    }
+    // open, with the time of the call and to the first frame into the samples
+    bool open_phase(int id, bool headless, bench_samples &open, bench_samples &first) {
+        screen_attribute screenAttr;
+        screenAttr.display_id = 0;
+        capture_attr capAttr = headless ? bench_headless(id) : capture_attr();
+        capAttr.input_id = static_cast<qcarcam_input_desc_t>(id);
+        uint64_t begin = monotonic_ns();
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            fprintf(stderr, "input %d: create failed\n", id);
+            return false;
+        }
+        open.add(monotonic_ns() - begin);
+        uint64_t latency = first_frame(id, begin);
+        if (0 == latency) {
+            fprintf(stderr, "input %d: no frame within %d ms\n", id, BENCH_FIRST_FRAME_TIMEOUT_MS);
+            return false;
+        }
+        first.add(latency);
+        return true;
+    }
+    bool close_phase(int id, bool park, bench_samples &samples) {
+        uint64_t begin = monotonic_ns();
+        if (!G_CAMERA_MANAGER.destroy_camera_connect(id, park)) {
+            return false;
+        }
+        samples.add(monotonic_ns() - begin);
+        return true;
+    }
+    // per round: cold open and close, then cold open, park and warm reopen, closing the reopened input
+    bool round_phase(const char *label, bool headless, int rounds) {
+        reopen_samples s;
+        bool ok = true;
+        for (int i = 0;i < rounds && ok;++i) {
+            ok = open_phase(0, headless, s.cold_open, s.cold_first) && close_phase(0, false, s.close) &&
+                 open_phase(0, headless, s.cold_open, s.cold_first) && close_phase(0, true, s.park) &&
+                 open_phase(0, headless, s.warm_open, s.warm_first) && close_phase(0, false, s.close);
+        }
+        G_CAMERA_MANAGER.drop_standby();
+        fprintf(stderr, "%s\n", label);
+        s.cold_open.print("cold open");
+        s.cold_first.print("cold open to frame");
+        s.close.print("close");
+        s.park.print("park");
+        s.warm_open.print("warm reopen");
+        s.warm_first.print("warm reopen to frame");
+        if (ok && s.warm_open.count() > 0) {
+            fprintf(stderr, "%-24s warm reopen %.1fx faster than cold, p50\n", "",
+                    s.cold_open.percentile_ms(0.5) / std::max(s.warm_open.percentile_ms(0.5), 1e-6));
+        }
+        return ok && s.warm_open.count() == static_cast<size_t>(rounds);
+    }
+}
+int main(int argc, char **argv) {
+    int rounds = 20;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n rounds] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = 1;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "open and close of one 720p input, wall time, %d rounds\n", rounds);
+    bool ok = round_phase("windowed", false, rounds);
+    ok = round_phase("headless", true, rounds) && ok;
+    return ok ? 0 : 1;
+}
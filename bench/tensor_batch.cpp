@@ -0,0 +1,232 @@
+// tensor conversion and batching: the fused converter per layout and type against the naive pipeline
+// (whole frame to RGB888, then a second pass to resize and normalize) on synthetic scenes, then the
+// batcher on four synchronized inputs from capture to batch delivery
+#include <getopt.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_INPUTS = 4, BENCH_SCENE_FRAMES = 8 };
+    tensor_config imagenet_config(tensor_layout layout, tensor_type type) {
+        tensor_config config;
+        const float mean[3] = { 123.675f, 116.28f, 103.53f };
+        const float std_dev[3] = { 58.395f, 57.12f, 57.375f };
+        for (int c = 0;c < 3;++c) {
+            config.mean[c] = mean[c];
+            config.std[c] = std_dev[c];
+        }
+        config.layout = layout;
+        config.type = type;
+        config.quant_scale = 1.0f / 64;
+        return config;
+    }
+    inline uint8_t clamp_u8(float v) {
+        return static_cast<uint8_t>(std::min(std::max(v, 0.0f), 255.0f) + 0.5f);
+    }
+    // the pipeline the batcher replaces, scalar throughout: the whole frame to RGB888 first, then a
+    // second pass resizes, normalizes and reorders into NCHW floats
+    class naive_pipeline {
+    public:
+        explicit naive_pipeline(const tensor_config &config) : config_(config) {
+        }
+        void run(const camera_frame &frame, float *dst) {
+            const int w = static_cast<int>(frame.width), h = static_cast<int>(frame.height);
+            const bool nv12 = QCARCAM_FMT_NV12 == frame.format;
+            rgb_.resize(static_cast<size_t>(w) * h * 3);
+            for (int y = 0;y < h;++y) {
+                const uint8_t *row = frame.data + static_cast<size_t>(y) * frame.stride;
+                const uint8_t *chroma = frame.data + frame.plane_offset + static_cast<size_t>(y / 2) * frame.stride;
+                uint8_t *out = rgb_.data() + static_cast<size_t>(y) * w * 3;
+                for (int x = 0;x < w;++x) {
+                    float luma = 1.164f * ((nv12 ? row[x] : row[x * 2 + 1]) - 16.0f);
+                    float u = (nv12 ? chroma[x & ~1] : row[(x & ~1) * 2]) - 128.0f;
+                    float v = (nv12 ? chroma[(x & ~1) + 1] : row[(x & ~1) * 2 + 2]) - 128.0f;
+                    out[x * 3] = clamp_u8(luma + 1.596f * v);
+                    out[x * 3 + 1] = clamp_u8(luma - 0.392f * u - 0.813f * v);
+                    out[x * 3 + 2] = clamp_u8(luma + 2.017f * u);
+                }
+            }
+            const size_t plane = static_cast<size_t>(config_.width) * config_.height;
+            for (int y = 0;y < config_.height;++y) {
+                int y0 = 0, y1 = 0;
+                float fy = taps(y, config_.height, h, y0, y1);
+                for (int x = 0;x < config_.width;++x) {
+                    int x0 = 0, x1 = 0;
+                    float fx = taps(x, config_.width, w, x0, x1);
+                    for (int c = 0;c < 3;++c) {
+                        float a = rgb_[(static_cast<size_t>(y0) * w + x0) * 3 + c];
+                        float b = rgb_[(static_cast<size_t>(y0) * w + x1) * 3 + c];
+                        float d = rgb_[(static_cast<size_t>(y1) * w + x0) * 3 + c];
+                        float e = rgb_[(static_cast<size_t>(y1) * w + x1) * 3 + c];
+                        float top = a + (b - a) * fx;
+                        float bottom = d + (e - d) * fx;
+                        float value = top + (bottom - top) * fy;
+                        dst[c * plane + static_cast<size_t>(y) * config_.width + x] = (value - config_.mean[c]) / config_.std[c];
+                    }
+                }
+            }
+        }
+    private:
+        static inline float taps(int i, int out, int in, int &t0, int &t1) {
+            float pos = (i + 0.5f) * in / out - 0.5f;
+            pos = std::min(std::max(pos, 0.0f), static_cast<float>(in - 1));
+            t0 = static_cast<int>(pos);
+            t1 = std::min(t0 + 1, in - 1);
+            return pos - t0;
+        }
+    private:
+        tensor_config config_;
+        std::vector<uint8_t> rgb_;
+    };
+    bool scene_phase(const char *label, qcarcam_color_fmt_t format, uint32_t width, uint32_t height, int frames) {
+        std::vector<std::unique_ptr<bench_frame>> scene;
+        for (int t = 0;t < BENCH_SCENE_FRAMES;++t) {
+            scene.emplace_back(new bench_frame(format, width, height, t));
+        }
+        const tensor_config reference = imagenet_config(TENSOR_NCHW, TENSOR_FLOAT32);
+        std::vector<float> naive_out(tensor_frame_bytes(reference) / sizeof(float));
+        naive_pipeline naive(reference);
+        bench_samples naive_cost;
+        for (int i = 0;i < frames;++i) {
+            uint64_t begin = thread_cpu_ns();
+            naive.run(scene[i % BENCH_SCENE_FRAMES]->frame(), naive_out.data());
+            naive_cost.add(thread_cpu_ns() - begin);
+        }
+        fprintf(stderr, "%s %ux%u to 224x224\n", label, width, height);
+        naive_cost.print("naive nchw f32");
+        struct variant {
+            const char *label;
+            tensor_layout layout;
+            tensor_type type;
+        };
+        const variant variants[] = {
+            { "fused nchw f32", TENSOR_NCHW, TENSOR_FLOAT32 },
+            { "fused nhwc f32", TENSOR_NHWC, TENSOR_FLOAT32 },
+            { "fused nchw int8", TENSOR_NCHW, TENSOR_INT8 },
+            { "fused nhwc int8", TENSOR_NHWC, TENSOR_INT8 },
+        };
+        bool ok = naive_cost.count() > 0;
+        for (const variant &v : variants) {
+            tensor_config config = imagenet_config(v.layout, v.type);
+            tensor_converter converter;
+            std::vector<uint8_t> out(tensor_frame_bytes(config));
+            if (!converter.configure(config)) {
+                return false;
+            }
+            bench_samples cost;
+            for (int i = 0;i < frames;++i) {
+                const camera_frame &frame = scene[i % BENCH_SCENE_FRAMES]->frame();
+                uint64_t begin = thread_cpu_ns();
+                if (!converter.prepare(frame)) {
+                    return false;
+                }
+                converter.convert(frame, out.data(), 0, config.height);
+                cost.add(thread_cpu_ns() - begin);
+            }
+            cost.print(v.label);
+            fprintf(stderr, "%-24s %.1fx faster than naive\n", "", naive_cost.mean_ms() / cost.mean_ms());
+            if (TENSOR_NCHW != v.layout || TENSOR_FLOAT32 != v.type) {
+                continue;
+            }
+            // same scene through both: the fused pass interpolates YUV before the conversion and the chroma
+            // bilinearly at its own resolution, so single pixels at the box edge differ, the mean stays small
+            const camera_frame &frame = scene[0]->frame();
+            naive.run(frame, naive_out.data());
+            converter.convert(frame, out.data(), 0, config.height);
+            const float *fused = reinterpret_cast<const float *>(out.data());
+            const size_t plane = static_cast<size_t>(config.width) * config.height;
+            double worst = 0, sum = 0;
+            for (size_t i = 0;i < naive_out.size();++i) {
+                double diff = fabs(fused[i] - naive_out[i]) * config.std[i / plane];
+                worst = std::max(worst, diff);
+                sum += diff;
+            }
+            fprintf(stderr, "%-24s vs naive: mean |diff| %.3f, max %.3f (0-255 units)\n", "",
+                    sum / naive_out.size(), worst);
+            ok = ok && sum / naive_out.size() < 2;
+        }
+        return ok;
+    }
+    bool batch_phase(int seconds) {
+        screen_attribute screenAttr;
+        std::vector<int> ids;
+        for (int id = 0;id < BENCH_INPUTS;++id) {
+            capture_attr capAttr = bench_headless(id);
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+                fprintf(stderr, "input %d: create failed\n", id);
+                return false;
+            }
+            ids.push_back(id);
+        }
+        for (int id : ids) {
+            G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+        }
+        bench_samples oldest, newest, convert;
+        std::mutex mutex;
+        // capture of the oldest and of the newest frame of the set to the callback
+        auto batcher = G_CAMERA_MANAGER.create_tensor_batcher(ids, imagenet_config(TENSOR_NCHW, TENSOR_FLOAT32),
+                                                              16 * 1000 * 1000, [&](const tensor_batch &batch) {
+            uint64_t now = monotonic_ns();
+            uint64_t first = batch.frames[0].timestamp, last = first;
+            for (const tensor_frame_info &info : batch.frames) {
+                first = std::min(first, static_cast<uint64_t>(info.timestamp));
+                last = std::max(last, static_cast<uint64_t>(info.timestamp));
+            }
+            std::lock_guard<std::mutex> guard(mutex);
+            oldest.add(now > first ? now - first : 0);
+            newest.add(now > last ? now - last : 0);
+            convert.add(batch.convert_ns);
+        });
+        bool ok = nullptr != batcher;
+        if (ok) {
+            bench_sleep_ms(seconds * 1000);
+            batcher->stop();
+        }
+        uint64_t skipped = ok ? batcher->skipped() : 0;
+        batcher = nullptr;
+        for (int id : ids) {
+            G_CAMERA_MANAGER.destroy_camera_connect(id);
+        }
+        fprintf(stderr, "batch of %d x 720p UYVY to 4x3x224x224 f32\n", BENCH_INPUTS);
+        convert.print("convert");
+        oldest.print("oldest capture to batch");
+        newest.print("newest capture to batch");
+        fprintf(stderr, "%-24s %llu batches, %llu sets skipped\n", "", static_cast<unsigned long long>(convert.count()),
+                static_cast<unsigned long long>(skipped));
+        return ok && convert.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 200;
+    int seconds = 10;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per scene] [-t seconds of capture] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_INPUTS;
+    config.fill = true;
+    if (!bench_init(config, verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "tensor conversion per frame, thread cpu time, imagenet mean/std\n");
+    bool ok = scene_phase("720p UYVY", QCARCAM_FMT_UYVY_8, 1280, 720, frames);
+    ok = scene_phase("1080p NV12", QCARCAM_FMT_NV12, 1920, 1080, frames) && ok;
+    ok = batch_phase(seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// capture latency of one input with and without a real-time thread policy while busy threads load every CPU
+#include <getopt.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    struct bench_options {
+        int seconds = 10;               // < Per phase
+        int hogs = 0;                   // < Busy threads, 0 is four per CPU
+        int priority = 20;
+        bool verbose = false;
+    };
+    bool run_phase(const char *label, const thread_policy &policy, int hogs, int seconds) {
+        screen_attribute screenAttr;
+        capture_attr capAttr = bench_headless(0);
+        capAttr.name = "rear";
+        capAttr.thread_attr = policy;
+        if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+            fprintf(stderr, "%s: create failed\n", label);
+            return false;
+        }
+        bench_samples samples;
+        bench_listen_latency(0, samples);
+        auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(0);
+        if (!G_CAMERA_MANAGER.control_camera(0, CAM_CMD_START)) {
+            fprintf(stderr, "%s: start failed\n", label);
+            return false;
+        }
+        {
+            std::unique_ptr<cpu_hog> hog(hogs > 0 ? new cpu_hog(hogs) : nullptr);
+            bench_sleep_ms(seconds * 1000);
+        }
+        G_CAMERA_MANAGER.control_camera(0, CAM_CMD_STOP);
+        thread_policy effective = ptr->get_effective_policy();
+        ptr.reset();
+        G_CAMERA_MANAGER.destroy_camera_connect(0);
+        samples.print(label);
+        fprintf(stderr, "%-24s in effect: policy %d priority %d cpu mask 0x%llx mlock %d\n", "", effective.sched_policy,
+                effective.priority, static_cast<unsigned long long>(effective.cpu_mask), effective.lock_memory);
+        return samples.count() > 0;
+    }
+}
+int main(int argc, char **argv) {
+    bench_options options;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:n:p:v")) != -1) {
+        switch (opt) {
+        case 't':
+            options.seconds = atoi(optarg);
+            break;
+        case 'n':
+            options.hogs = atoi(optarg);
+            break;
+        case 'p':
+            options.priority = atoi(optarg);
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per phase] [-n busy threads] [-p fifo priority] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int hogs = options.hogs > 0 ? options.hogs : 4 * cpus;
+    sim_config config;
+    config.inputs = 1;
+    config.fps = 60;
+    if (!bench_init(config, options.verbose)) {
+        return 2;
+    }
+    fprintf(stderr, "capture to listener latency, 60 fps, %d s per phase, %d busy threads on %d cpus\n",
+            options.seconds, hogs, cpus);
+    thread_policy inherit;
+    thread_policy fifo;
+    fifo.sched_policy = SCHED_FIFO;
+    fifo.priority = options.priority;
+    bool ok = run_phase("idle, inherited policy", inherit, 0, options.seconds);
+    ok = run_phase("loaded, inherited policy", inherit, hogs, options.seconds) && ok;
+    ok = run_phase("loaded, SCHED_FIFO", fifo, hogs, options.seconds) && ok;
+    G_CAMERA_MANAGER.drop_standby();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// bird's-eye view from four fisheye cameras: the table build, the render pass on 1, 2 and 4 threads
+// against the 30 fps frame budget, the incremental patch after a calibration change, then the stage
+// on four synchronized inputs from capture to the posted view
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_common.hpp"
+#include "top_view_stage.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum { BENCH_CAMERAS = 4, BENCH_SCENE_FRAMES = 4, BENCH_TABLE_BUILDS = 5, BENCH_BUDGET_US = 33333 };
+    // front, rear, left and right 190 degree fisheyes around a 4.8 x 1.9 m car, 1280x720
+    std::vector<top_view_camera> bench_rig() {
+        const double poses[BENCH_CAMERAS][5] = {       // x, y, z, yaw, pitch
+            { 2.4, 0, 0.7, 0, 30 }, { -2.4, 0, 0.9, 180, 30 }, { 0.9, 0.95, 1.0, 90, 45 }, { 0.9, -0.95, 1.0, -90, 45 },
+        };
+        std::vector<top_view_camera> rig(BENCH_CAMERAS);
+        for (int i = 0;i < BENCH_CAMERAS;++i) {
+            top_view_camera &cam = rig[i];
+            cam.lens.fx = cam.lens.fy = 360;
+            cam.lens.cx = 640;
+            cam.lens.cy = 360;
+            cam.lens.k[0] = -0.02;
+            cam.lens.k[1] = 0.003;
+            cam.lens.width = cam.src_width = 1280;
+            cam.lens.height = cam.src_height = 720;
+            cam.pose.x = poses[i][0];
+            cam.pose.y = poses[i][1];
+            cam.pose.z = poses[i][2];
+            cam.pose.yaw_deg = poses[i][3];
+            cam.pose.pitch_deg = poses[i][4];
+        }
+        return rig;
+    }
+    bool engine_phase(const top_view_config &config, int frames) {
+        std::vector<std::unique_ptr<bench_frame>> scene;
+        for (int i = 0;i < BENCH_CAMERAS * BENCH_SCENE_FRAMES;++i) {
+            scene.emplace_back(new bench_frame(QCARCAM_FMT_UYVY_8, 1280, 720, i));
+        }
+        std::vector<top_view_camera> rig = bench_rig();
+        top_view_engine engine;
+        bench_samples build;
+        for (int i = 0;i < BENCH_TABLE_BUILDS;++i) {
+            uint64_t begin = monotonic_ns();
+            if (!engine.configure(config, rig, nullptr)) {
+                return false;
+            }
+            build.add(monotonic_ns() - begin);
+        }
+        fprintf(stderr, "%d x 1280x720 UYVY to %dx%d at %.0f mm per pixel\n", BENCH_CAMERAS, config.width,
+                config.height, config.meters_per_pixel * 1000);
+        build.print("table build");
+        const uint32_t stride = static_cast<uint32_t>(config.width) * 2;
+        std::vector<uint8_t> out(static_cast<size_t>(stride) * config.height);
+        std::vector<camera_frame> set(BENCH_CAMERAS);
+        double single_ms = 0;
+        const int threads[] = { 1, 2, 4 };
+        for (int n : threads) {
+            thread_pool pool(n - 1);
+            bench_samples cost;
+            for (int i = 0;i < frames;++i) {
+                for (int c = 0;c < BENCH_CAMERAS;++c) {
+                    set[c] = scene[(i % BENCH_SCENE_FRAMES) * BENCH_CAMERAS + c]->frame();
+                }
+                uint64_t begin = monotonic_ns();
+                if (!engine.render(set, out.data(), stride, n > 1 ? &pool : nullptr)) {
+                    return false;
+                }
+                cost.add(monotonic_ns() - begin);
+            }
+            char label[32];
+            snprintf(label, sizeof(label), "render %d thread%s", n, n > 1 ? "s" : "");
+            cost.print(label);
+            fprintf(stderr, "%-24s %.0f%% of the 30 fps frame budget at p99\n", "",
+                    100 * cost.percentile_ms(0.99) * 1000 / BENCH_BUDGET_US);
+            single_ms = 1 == n ? cost.percentile_ms(0.99) : single_ms;
+        }
+        // a calibration change of one camera: its layer is rebuilt and only the tiles it touches re-fused
+        bench_samples patch;
+        int tiles = 0;
+        for (int i = 0;i < BENCH_TABLE_BUILDS;++i) {
+            top_view_camera moved = rig[2];
+            moved.pose.pitch_deg += 1 + i % 2;
+            engine.set_camera(2, moved);
+            uint64_t begin = monotonic_ns();
+            tiles = engine.update(nullptr);
+            patch.add(monotonic_ns() - begin);
+        }
+        const int total = ((config.width + TOP_VIEW_TILE_W - 1) / TOP_VIEW_TILE_W) *
+                          ((config.height + TOP_VIEW_TILE_H - 1) / TOP_VIEW_TILE_H);
+        patch.print("patch one camera");
+        fprintf(stderr, "%-24s %d of %d tiles re-fused, %.1fx faster than the full build\n", "", tiles, total,
+                build.mean_ms() / patch.mean_ms());
+        return single_ms * 1000 < BENCH_BUDGET_US;
+    }
+    bool stage_phase(const top_view_config &config, int seconds) {
+        screen_attribute screenAttr;
+        std::vector<int> ids;
+        for (int id = 0;id < BENCH_CAMERAS;++id) {
+            capture_attr capAttr = bench_headless(id);
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+                fprintf(stderr, "input %d: create failed\n", id);
+                return false;
+            }
+            ids.push_back(id);
+        }
+        for (int id : ids) {
+            G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+        }
+        screen_attribute viewAttr;
+        viewAttr.display_id = 0;
+        viewAttr.window_size = { 0.33, 0.9 };
+        auto stage = G_CAMERA_MANAGER.create_top_view(ids, config, bench_rig(), viewAttr, 16 * 1000 * 1000);
+        bench_samples render;
+        uint64_t rendered = 0, skipped = 0;
+        if (stage != nullptr) {
+            bench_sleep_ms(500);
+            uint64_t first = stage->rendered(), first_skipped = stage->skipped();
+            uint64_t end = monotonic_ns() + static_cast<uint64_t>(seconds) * 1000000000ULL;
+            uint64_t seen = first;
+            while (monotonic_ns() < end) {
+                bench_sleep_ms(10);
+                if (stage->rendered() != seen) {
+                    seen = stage->rendered();
+                    render.add(static_cast<uint64_t>(stage->last_render_ms() * 1e6));
+                }
+            }
+            rendered = stage->rendered() - first;
+            skipped = stage->skipped() - first_skipped;
+            stage->stop();
+        }
+        stage = nullptr;
+        for (int id : ids) {
+            G_CAMERA_MANAGER.destroy_camera_connect(id);
+        }
+        double fps = static_cast<double>(rendered) / seconds;
+        fprintf(stderr, "stage on %d inputs at 30 fps, %d s\n", BENCH_CAMERAS, seconds);
+        render.print("render in the stage");
+        fprintf(stderr, "%-24s %.1f views per second, %llu sets skipped\n", "", fps,
+                static_cast<unsigned long long>(skipped));
+        return fps >= 28.5;
+    }
+}
+int main(int argc, char **argv) {
+    int frames = 100;
+    int seconds = 10;
+    bool verbose = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "n:t:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames per case] [-t seconds of capture] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_config config;
+    config.inputs = BENCH_CAMERAS;
+    if (!bench_init(config, verbose) || frames <= 0 || seconds <= 0) {
+        return 2;
+    }
+    fprintf(stderr, "top view, wall time, %ld cpus\n", sysconf(_SC_NPROCESSORS_ONLN));
+    top_view_config view;
+    bool ok = engine_phase(view, frames);
+    ok = stage_phase(view, seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <memory>
+#include "qcarcam_types.h"
+#include "color_log.hpp"
+#include "anon_shm.hpp"
+namespace qnx_screen_camera {
+    enum buffer_alloc_param : uint32_t {
+        BUFFER_STRIDE_ALIGN = 64,           // < Row pitch of headless buffers, what the IFE write masters burst
+    };
+    struct capture_memory {                 // one capture buffer of an allocator
+        void *handle = nullptr;             // < What qcarcam gets as p_buf
+        uint8_t *ptr = nullptr;             // < CPU mapping
+        uint32_t size = 0;
+        long long phys_addr = 0;            // < 0 if the memory is not physically contiguous
+        int fd = -1;                        // < Shareable descriptor of the memory if the allocator has one
+    };
+    // memory of capture buffers nothing displays; implementations must be usable from any thread
+    class buffer_allocator {
+    public:
+        virtual ~buffer_allocator() {
+        }
+        virtual bool allocate(uint32_t size, capture_memory &mem) = 0;
+        virtual void release(capture_memory &mem) = 0;
+        // qcarcam_buffers_t flags describing handle and caching of what allocate() returns
+        virtual uint32_t buffer_flags() const = 0;
+    };
+#ifdef __QNX__
+    // physically contiguous shared memory object per buffer: the ISP writes it by physical address and
+    // the fd lets the frame exporter hand it to other processes
+    class pmem_allocator : public buffer_allocator {
+    public:
+        bool allocate(uint32_t size, capture_memory &mem) override {
+            int fd = shm_open(SHM_ANON, O_RDWR | O_CREAT, 0600);
+            if (fd < 0) {
+                LOG_E("shm_open error:%d", errno);
+                return false;
+            }
+            if (shm_ctl(fd, SHMCTL_ANON | SHMCTL_PHYS, 0, size) == -1) {
+                LOG_E("shm_ctl %u bytes contiguous error:%d", size, errno);
+                ::close(fd);
+                return false;
+            }
+            void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (MAP_FAILED == addr) {
+                LOG_E("mmap pmem error:%d", errno);
+                ::close(fd);
+                return false;
+            }
+            off64_t phys = 0;
+            if (mem_offset64(addr, NOFD, 1, &phys, nullptr) == -1) {
+                LOG_E("mem_offset64 error:%d", errno);
+                munmap(addr, size);
+                ::close(fd);
+                return false;
+            }
+            mem.handle = addr;
+            mem.ptr = static_cast<uint8_t *>(addr);
+            mem.size = size;
+            mem.phys_addr = phys;
+            mem.fd = fd;
+            return true;
+        }
+        void release(capture_memory &mem) override {
+            if (mem.ptr != nullptr) {
+                munmap(mem.ptr, mem.size);
+            }
+            if (mem.fd >= 0) {
+                ::close(mem.fd);
+            }
+            mem = capture_memory();
+        }
+        uint32_t buffer_flags() const override {
+            return QCARCAM_BUFFER_FLAG_CACHE;
+        }
+    };
+#endif
+    // page aligned anonymous shared memory, locked in RAM unless asked otherwise, for drivers that map
+    // user pointers themselves; the fd lets the frame exporter hand it to other processes without a copy
+    class anon_allocator : public buffer_allocator {
+    public:
+        explicit anon_allocator(bool lock = true) : lock_(lock) {
+        }
+        bool allocate(uint32_t size, capture_memory &mem) override {
+            int fd = create_anon_shm("capture_buffer", size);
+            if (fd < 0) {
+                return false;
+            }
+            void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (MAP_FAILED == addr) {
+                LOG_E("mmap %u bytes error:%d", size, errno);
+                ::close(fd);
+                return false;
+            }
+            if (lock_ && mlock(addr, size)) {   // also faults every page in before the first frame
+                LOG_E("mlock %u bytes error:%d", size, errno);
+                munmap(addr, size);
+                ::close(fd);
+                return false;
+            }
+            mem.handle = addr;
+            mem.ptr = static_cast<uint8_t *>(addr);
+            mem.size = size;
+            mem.phys_addr = 0;
+            mem.fd = fd;
+            return true;
+        }
+        void release(capture_memory &mem) override {
+            if (mem.ptr != nullptr) {
+                if (lock_) {
+                    munlock(mem.ptr, mem.size);
+                }
+                munmap(mem.ptr, mem.size);
+            }
+            if (mem.fd >= 0) {
+                ::close(mem.fd);
+            }
+            mem = capture_memory();
+        }
+        uint32_t buffer_flags() const override {
+            return QCARCAM_BUFFER_FLAG_CACHE;
+        }
+    private:
+        bool lock_;
+    };
+    // pmem on target, locked anonymous memory on a development host
+    inline std::shared_ptr<buffer_allocator> make_default_allocator() {
+#ifdef __QNX__
+        return std::make_shared<pmem_allocator>();
+#else
+        return std::make_shared<anon_allocator>();
+#endif
+    }
+}
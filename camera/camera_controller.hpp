@@ -1,12 +1,33 @@
 #pragma once
+#include <string.h>
 #include <string>
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <vector>
 #include "qcarcam.h"
 #include "qcarcam_types.h"
+#include "clock.hpp"
+#include "trace.hpp"
+#include "buffer_allocator.hpp"
+#include "camera_stats.hpp"
+#include "diagnostics_poller.hpp"
+#include "thread_policy.hpp"
+#include "frame_exporter.hpp"
+#include "frame_decimation.hpp"
+#include "raw_pipeline.hpp"
 #include "screen_window.hpp"
+#include "display_mirror.hpp"
+#include "viewport_animator.hpp"
 namespace qnx_screen_camera {
+    enum camera_qos_class : int {       // who yields first when the cameras overload the SoC
+        QOS_SAFETY = 0,                 // < Never throttled, its latency drives the others
+        QOS_INTERACTIVE,
+        QOS_BACKGROUND,
+        QOS_CLASS_NUM
+    };
     struct capture_attr {
         std::string name;
         qcarcam_input_desc_t input_id = QCARCAM_INPUT_MAX;
@@ -14,13 +35,23 @@ namespace qnx_screen_camera {
         int width = -1;                  // < Output buffer width
         int height = -1;                 // < Output buffer height
         int num_buffers = 5;             // < Number of buffers for output of ISP
+        float fps = 0;                   // < Sensor frame rate, 0 takes it from the input description
+        float target_fps = 0;            // < Delivered frame rate, 0 keeps every sensor frame
+        float hidden_fps = 0;            // < Frame rate while the window and its mirrors are hidden, 0 keeps target_fps
+        thread_policy thread_attr;       // < Scheduling, affinity and mlock for every pipeline thread
+        raw_config raw;                  // < Processing of RAW formats into the displayed UYVY buffers
+        camera_qos_class qos = QOS_INTERACTIVE;
+        uint64_t deadline_ns = 0;        // < Capture to dequeue latency budget, 0 is one sensor frame period
+        bool headless = false;           // < No window: frames only reach listeners and the exporter
+        std::shared_ptr<buffer_allocator> allocator;   // < Of the headless buffers, nullptr takes the platform default
     };
     enum camera_state {
         CAM_STATE_ERROR = -1,
         CAM_STATE_START,
         CAM_STATE_STOP,
         CAM_STATE_INIT,
-        CAM_STATE_OPEN
+        CAM_STATE_OPEN,
+        CAM_STATE_PAUSE
     };
     enum camera_frame_param : int {
         CAM_FRAME_TIMEOUT = 500000000,
@@ -28,18 +59,52 @@ namespace qnx_screen_camera {
     enum camera_ctl_command {
         CAM_CMD_START = 0,
         CAM_CMD_STOP,
+        CAM_CMD_PAUSE,
+        CAM_CMD_RESUME,
+    };
+
+    struct camera_frame {               // a captured buffer as seen by frame listeners
+        int input_id = -1;
+        unsigned int idx = 0;           // < qcarcam buffer index, the handle for hold/release
+        unsigned int seq_no = 0;
+        unsigned long long timestamp = 0;
+        uint8_t *data = nullptr;        // < CPU address of plane 0, nullptr if not mapped
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        uint32_t plane_offset = 0;      // < Bytes from data to plane 1 of two plane formats, stride is shared
+        qcarcam_color_fmt_t format = QCARCAM_FMT_MAX;
     };
+    // called on the capture thread for every frame; keep it short and call hold_frame()
+    // before returning to keep the buffer for later, it then needs a matching release_frame()
+    using frame_listener = std::function<void(const camera_frame &)>;
     class camera_controller
     {
     public:
         explicit camera_controller(const capture_attr& attr) : attr_(attr) {}
         virtual ~camera_controller() {
-            if (cap_thread_ != nullptr) {
-                if (cap_thread_->joinable()) {
-                    cap_thread_->join();
-                }
-                delete cap_thread_;
-                cap_thread_ = nullptr;
+            close();
+        }
+        // stop and give back the qcarcam handle, the windows and their buffers; bounded by one frame timeout.
+        // Stages still holding frames of this input must be stopped first, the controller stays in INIT after
+        void close() {
+            std::lock_guard<std::mutex> guard(control_mutex_);
+            if (win_ptr_) {
+                win_ptr_->set_visibility_listener(nullptr);
+            }
+            for (auto &mirror : take_mirrors()) {
+                mirror->stop();
+            }
+            stop_capture_thread();
+            if (qcarcam_ctx_ && (CAM_STATE_START == camera_state_ || CAM_STATE_PAUSE == camera_state_)) {
+                qcarcam_stop(qcarcam_ctx_);
+            }
+            camera_state_ = CAM_STATE_INIT;
+            exporter_ = nullptr;
+            viewport_ = nullptr;
+            if (qcarcam_ctx_) {
+                qcarcam_close(qcarcam_ctx_);
+                qcarcam_ctx_ = nullptr;
             }
             if (cap_buf_ != nullptr) {
                 if (cap_buf_->buffers != nullptr) {
@@ -49,28 +114,22 @@ namespace qnx_screen_camera {
                 delete cap_buf_;
                 cap_buf_ = nullptr;
             }
-            if (qcarcam_ctx_) {
-                qcarcam_close(qcarcam_ctx_);
-                qcarcam_ctx_ = nullptr;
+            for (auto &mem : headless_bufs_) {
+                attr_.allocator->release(mem);
             }
+            headless_bufs_.clear();
+            raw_pool_.reset();
+            raw_win_ptr_ = nullptr;
+            win_ptr_ = nullptr;
         }
         bool create_window(const screen_attribute &screenAttr) {
-            win_ptr_ = std::make_shared<screen_window>(std::make_shared<screen_context>());
+            win_ptr_ = std::make_shared<screen_window>(shared_screen_context());
             return win_ptr_ && win_ptr_->init(screenAttr);
         }
         qcarcam_hndl_t init(screen_attribute &screenAttr, void *eventCallback) {
-            screenAttr.buffer_size = { attr_.width, attr_.height };
-            screenAttr.format = SCREEN_FORMAT_UYVY;
-            LOG_D("creat window buffer: %d, size:%d*%d, format:%d", attr_.num_buffers, attr_.width, attr_.height, attr_.format);
-            if (false == create_window(screenAttr)) {
-                return nullptr;
-            }
-            window_buffer_attr bufferAttr;
-            bufferAttr.num = attr_.num_buffers + 1;
-            bufferAttr.size[0] = attr_.width;
-            bufferAttr.size[1] = attr_.height;
-            if (!win_ptr_->init_buffer(bufferAttr)) {
-                LOG_E("win ptr init buffer error!");
+            TRACE_SCOPE("camera_init", attr_.input_id);
+            if (attr_.num_buffers <= 0 || attr_.num_buffers > QCARCAM_MAX_NUM_BUFFERS) {
+                LOG_E("invalid buffer number:%d", attr_.num_buffers);
                 return nullptr;
             }
             cap_buf_ = new qcarcam_buffers_t;
@@ -87,19 +146,8 @@ namespace qnx_screen_camera {
                 return nullptr;
             }
             memset(cap_buf_->buffers, 0, cap_buf_->n_buffers * sizeof(qcarcam_buffers_t));
-            for (unsigned int i = 0;i < cap_buf_->n_buffers;++i) {
-                cap_buf_->buffers[i].n_planes = 1;
-                cap_buf_->buffers[i].planes[0].width = attr_.width;
-                cap_buf_->buffers[i].planes[0].height = attr_.height;
-            }
-            auto& buffer = win_ptr_->get_win_buf();
-            for (unsigned int i = 0;i < buffer.handles.size();++i) {
-                cap_buf_->buffers[i].planes[0].p_buf = buffer.handles[i].mem_handle;
-                cap_buf_->buffers[i].planes[0].stride = buffer.stride[0];
-                cap_buf_->buffers[i].planes[0].size = buffer.stride[0] * cap_buf_->buffers[i].planes[0].height;
-                LOG_D("[%d] %p %dx%d %d, size:%d", i, cap_buf_->buffers[i].planes[0].p_buf,
-                               cap_buf_->buffers[i].planes[0].width, cap_buf_->buffers[i].planes[0].height,
-                               cap_buf_->buffers[i].planes[0].stride, cap_buf_->buffers[i].planes[0].size);
+            if (attr_.headless ? !init_headless() : !init_window(screenAttr)) {
+                return nullptr;
             }
             if (!setup_capture(eventCallback)) {
                 LOG_E("setupCapture failed!");
@@ -132,51 +180,116 @@ namespace qnx_screen_camera {
             LOG_E("qcarcam_s_param setmask failed!");
             return false;
         }
+        {
+            std::lock_guard<std::mutex> guard(rate_mutex_);
+            apply_frame_rate();
+        }
         camera_state_ = CAM_STATE_OPEN;
         return true;
     }
+    // counted so a FRAME_READY arriving while the capture thread is busy is not lost
     void notify_new_frame() {
-        frame_cv_.notify_all();
+        {
+            std::lock_guard<std::mutex> guard(frame_mutex_);
+            ++pending_frames_;
+        }
+        frame_cv_.notify_one();
     }
     void handle_new_frame() {
-        uint32_t width = 0;
-        uint32_t height = 0;
-        win_ptr_->get_buffer_size(width, height);
+        uint32_t width = attr_.width;
+        uint32_t height = attr_.height;
+        if (win_ptr_) {
+            win_ptr_->get_buffer_size(width, height);
+        }
         uint8_t *yuvBuffer = NULL;
         while (true) {
             std::unique_lock<std::mutex> lk(frame_mutex_);
-            frame_cv_.wait(lk);
+            frame_cv_.wait(lk, [this]() { return !keep_running_ || pending_frames_ > 0; });
             if (!keep_running_) {
                 break;
             }
+            --pending_frames_;
+            lk.unlock();
+            trace_scope frame_scope("handle_new_frame", -1);
             qcarcam_ret_t ret;
             qcarcam_frame_info_t frameInfo;
-            ret = qcarcam_get_frame(qcarcam_ctx_, &frameInfo, CAM_FRAME_TIMEOUT, 0);
+            {
+                TRACE_SCOPE("qcarcam_get_frame");
+                ret = qcarcam_get_frame(qcarcam_ctx_, &frameInfo, CAM_FRAME_TIMEOUT, 0);
+            }
             if (QCARCAM_RET_TIMEOUT == ret) {
+                ++stat_timeouts_;
                 LOG_E("get frame timeout!");
                 continue;
             }
             if (QCARCAM_RET_OK != ret) {
+                ++stat_errors_;
                 LOG_E("get frame failed %d", ret);
                 continue;
             }
-            if (frameInfo.idx >= attr_.num_buffers) {
+            if (frameInfo.idx >= static_cast<unsigned int>(attr_.num_buffers)) {
+                continue;
+            }
+            frame_scope.set_arg(frameInfo.seq_no);
+            update_frame_stats(frameInfo);
+            if (!decimator_.keep(frameInfo.timestamp, sw_interval_ns_) || !qos_keep()) {
+                ++stat_dropped_;
+                if (qcarcam_release_frame(qcarcam_ctx_, frameInfo.idx) != QCARCAM_RET_OK) {
+                    ++stat_errors_;
+                }
+                continue;
+            }
+            if (raw_win_ptr_ && !process_raw(frameInfo.idx)) {
+                ++stat_errors_;
+                if (qcarcam_release_frame(qcarcam_ctx_, frameInfo.idx) != QCARCAM_RET_OK) {
+                    ++stat_errors_;
+                }
                 continue;
             }
+            if (exporter_) {
+                exporter_->publish(frameInfo.idx, frameInfo.seq_no, frameInfo.timestamp, width, height,
+                                   frame_stride(frameInfo.idx), frame_format());
+            }
             LOG_D("=== get frame num: %d", frameInfo.seq_no);
             LOG_D("=== get frame timestamp: %llu", frameInfo.timestamp);
             LOG_D("=== get frame width: %d, height: %d", width, height);
-            win_ptr_->get_yuv_buffer(frameInfo.idx, &yuvBuffer);
-            win_ptr_->handle_new_buffer(frameInfo.idx);
-            if (pre_buffer_idx_ != -1 && pre_buffer_idx_ < attr_.num_buffers) {
-                ret = qcarcam_release_frame(qcarcam_ctx_, pre_buffer_idx_);
-                if (QCARCAM_RET_OK != ret) {
-                    LOG_E("release frame failed %d", ret);
-                    pre_buffer_idx_  = frameInfo.idx;
-                    continue;
+            buf_refs_[frameInfo.idx] = 1;          // reference of the display until the next post
+            if (win_ptr_) {
+                win_ptr_->get_yuv_buffer(frameInfo.idx, &yuvBuffer);
+            }
+            else {
+                yuvBuffer = headless_bufs_[frameInfo.idx].ptr;
+            }
+            int previous = -1;
+            {
+                // hidden windows are not posted to, the newest buffer stays held for the reveal
+                std::lock_guard<std::mutex> guard(post_mutex_);
+                if (nullptr == win_ptr_) {
+                    // headless, the reference only keeps the newest frame for hold_latest_frame
+                }
+                else if (shown_locked()) {
+                    post_locked(frameInfo.idx);
                 }
+                else {
+                    ++stat_hidden_skips_;
+                    unposted_ = true;
+                }
+                previous = pre_buffer_idx_;
+                pre_buffer_idx_ = frameInfo.idx;
+            }
+            camera_frame frame = make_frame(frameInfo, yuvBuffer);
+            {
+                std::lock_guard<std::mutex> guard(latest_mutex_);
+                latest_frame_ = frame;
+                has_latest_ = true;
+            }
+            {
+                TRACE_SCOPE("notify_listeners", frameInfo.seq_no);
+                notify_listeners(frame);
+            }
+            if (previous != -1 && previous < attr_.num_buffers) {
+                release_frame(previous);
             }
-            pre_buffer_idx_ = frameInfo.idx;
         }
         yuvBuffer = NULL;
     }
@@ -189,63 +302,82 @@ namespace qnx_screen_camera {
             break;
         }
     }
-    bool start_capture() {
+    bool start_capture(bool flush = true) {
+        TRACE_SCOPE("start_capture", attr_.input_id);
         if (CAM_STATE_START == camera_state_) {
             return true;
         }
         if (CAM_STATE_INIT == camera_state_) {
             return false;
         }
-        keep_running_ = true;
+        {
+            std::lock_guard<std::mutex> guard(frame_mutex_);
+            keep_running_ = true;
+            pending_frames_ = 0;        // events of an earlier run were flushed with it
+        }
         if (nullptr == cap_thread_) {
             cap_thread_ = new std::thread([&]() {
+                thread_policy effective = apply_thread_policy(attr_.thread_attr, thread_name("cap"));
+                {
+                    std::lock_guard<std::mutex> guard(policy_mutex_);
+                    effective_policy_ = effective;
+                }
                 this->handle_new_frame();
             });
         }
         qcarcam_ret_t ret = qcarcam_start(qcarcam_ctx_);
         if (ret != QCARCAM_RET_OK) {
             LOG_E("start capture failed %d", ret);
+            stop_capture_thread();
             return false;
         }
         camera_state_ = CAM_STATE_START;
-        win_ptr_->set_visible(1);
+        if (win_ptr_) {
+            win_ptr_->set_visible(1, flush);
+        }
+        for (auto &mirror : mirror_list()) {
+            mirror->get_window()->set_visible(1, flush);
+        }
         return true;
     }
-    bool control_command(int command) {
+    // flush = false leaves the window changes pending so a caller can commit several at once
+    bool control_command(int command, bool flush = true) {
         std::lock_guard<std::mutex> guard(control_mutex_);
         bool ret = true;
         LOG_I("controlCamera: %d", command);
         switch (command) {
             case CAM_CMD_START:
-                start_capture();
-                win_ptr_->set_visible(1);
+                ret = start_capture(flush);
                 break;
             case CAM_CMD_STOP:
-                stop_capture();
-                win_ptr_->set_visible(0);
+                ret = stop_capture(flush);
+                break;
+            case CAM_CMD_PAUSE:
+                ret = pause_capture();
+                break;
+            case CAM_CMD_RESUME:
+                ret = resume_capture();
                 break;
             default: 
                 break;
         }
         return ret;
     }
-    bool stop_capture() {
+    bool stop_capture(bool flush = true) {
+        TRACE_SCOPE("stop_capture", attr_.input_id);
         if (CAM_STATE_STOP == camera_state_) {
             return true;
         }
         if (CAM_STATE_INIT == camera_state_) {
             return false;
         }
-        keep_running_ = false;
-        frame_cv_.notify_all();
-        if (cap_thread_ != nullptr){
-            if (cap_thread_->joinable()) {
-                cap_thread_->join();
-            }
-            delete cap_thread_;
-            cap_thread_ = nullptr;
+        stop_capture_thread();
+        if (win_ptr_) {
+            win_ptr_->set_visible(0, flush);
+        }
+        for (auto &mirror : mirror_list()) {
+            mirror->get_window()->set_visible(0, flush);
         }
-        win_ptr_->set_visible(0);
         qcarcam_ret_t ret = qcarcam_stop(qcarcam_ctx_);
         if (ret != QCARCAM_RET_OK) {
             LOG_E("start capture failed %d", ret);
@@ -254,18 +386,686 @@ namespace qnx_screen_camera {
         camera_state_ = CAM_STATE_STOP;
         return true;
     }
+    int add_frame_listener(const frame_listener &listener) {
+        std::lock_guard<std::mutex> guard(listener_mutex_);
+        listeners_.emplace_back(++listener_seq_, listener);
+        return listener_seq_;
+    }
+    // after it returns the listener is not running and will not be called again
+    void remove_frame_listener(int id) {
+        std::lock_guard<std::mutex> guard(listener_mutex_);
+        for (auto it = listeners_.begin();it != listeners_.end();++it) {
+            if (it->first == id) {
+                listeners_.erase(it);
+                break;
+            }
+        }
+    }
+    // take an extra reference on a buffer that is currently held (e.g. inside a frame listener)
+    bool hold_frame(unsigned int idx) {
+        if (idx >= static_cast<unsigned int>(attr_.num_buffers)) {
+            return false;
+        }
+        int refs = buf_refs_[idx];
+        do {
+            if (refs <= 0) {
+                return false;
+            }
+        } while (!buf_refs_[idx].compare_exchange_weak(refs, refs + 1));
+        return true;
+    }
+    // pin the newest captured buffer from any thread, release it with release_frame(frame.idx)
+    bool hold_latest_frame(camera_frame &frame) {
+        std::lock_guard<std::mutex> guard(latest_mutex_);
+        if (!has_latest_ || !hold_frame(latest_frame_.idx)) {
+            return false;
+        }
+        frame = latest_frame_;
+        return true;
+    }
+    // drop a reference, the buffer goes back to qcarcam when the last one is gone
+    bool release_frame(unsigned int idx) {
+        if (idx >= static_cast<unsigned int>(attr_.num_buffers)) {
+            return false;
+        }
+        int left = --buf_refs_[idx];
+        if (left > 0) {
+            return true;
+        }
+        if (left < 0) {
+            LOG_E("buffer %u released too often!", idx);
+            buf_refs_[idx] = 0;
+            return false;
+        }
+        qcarcam_ret_t ret = qcarcam_release_frame(qcarcam_ctx_, idx);
+        if (QCARCAM_RET_OK != ret) {
+            ++stat_errors_;
+            LOG_E("release frame failed %d", ret);
+            return false;
+        }
+        return true;
+    }
+    inline const capture_attr &get_attr() const {
+        return attr_;
+    }
+    // share the capture buffers with other processes through path, call after init and before start
+    bool enable_frame_export(const std::string &path) {
+        if (nullptr == cap_buf_ || CAM_STATE_START == camera_state_) {
+            LOG_E("frame export must be enabled between init and start!");
+            return false;
+        }
+        auto exporter = std::make_shared<frame_exporter>();
+        if (!exporter->init(cap_buf_->n_buffers)) {
+            return false;
+        }
+        if (win_ptr_) {
+            auto& buffer = win_ptr_->get_win_buf();
+            for (unsigned int i = 0;i < cap_buf_->n_buffers && i < buffer.handles.size();++i) {
+                exporter->add_buffer(i, buffer.handles[i].fd, buffer.handles[i].phys_addr,
+                                     buffer.handles[i].size, buffer.stride[0],
+                                     static_cast<const uint8_t *>(buffer.handles[i].ptr[0]));
+            }
+        }
+        for (unsigned int i = 0;i < headless_bufs_.size();++i) {
+            if (headless_bufs_[i].fd < 0 && 0 == headless_bufs_[i].phys_addr) {
+                LOG_E("headless buffer %u has neither fd nor physical address to export", i);
+                return false;
+            }
+            exporter->add_buffer(i, headless_bufs_[i].fd, headless_bufs_[i].phys_addr,
+                                 headless_bufs_[i].size, layout_.stride[0]);
+        }
+        if (!exporter->start(path, attr_.thread_attr)) {
+            return false;
+        }
+        exporter_ = exporter;
+        return true;
+    }
+    bool pause_capture() {
+        if (camera_state_ != CAM_STATE_START) {
+            return false;
+        }
+        qcarcam_ret_t ret = qcarcam_pause(qcarcam_ctx_);
+        if (ret != QCARCAM_RET_OK) {
+            LOG_E("pause capture failed %d", ret);
+            return false;
+        }
+        camera_state_ = CAM_STATE_PAUSE;
+        return true;
+    }
+    bool resume_capture() {
+        if (camera_state_ != CAM_STATE_PAUSE) {
+            return false;
+        }
+        qcarcam_ret_t ret = qcarcam_resume(qcarcam_ctx_);
+        if (ret != QCARCAM_RET_OK) {
+            LOG_E("resume capture failed %d", ret);
+            return false;
+        }
+        camera_state_ = CAM_STATE_START;
+        return true;
+    }
+    // target fps for the delivered stream, 0 for every frame; dropped in the ISP when the
+    // pattern is accepted, by the capture thread otherwise
+    bool set_frame_rate(float target_fps) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        std::lock_guard<std::mutex> rate_guard(rate_mutex_);
+        attr_.target_fps = target_fps < 0 ? 0 : target_fps;
+        return nullptr == qcarcam_ctx_ || apply_frame_rate();
+    }
+    // a parked controller takes the attributes of a new open: qos, deadline and frame rates only matter per
+    // frame and are reapplied, false if anything baked into the handle, the buffers or threads that outlive
+    // a park differs, the caller then opens cold
+    bool reattach(const capture_attr &attr) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        bool allocator = attr.allocator == attr_.allocator || (nullptr == attr.allocator && default_allocator_);
+        if (attr.input_id != attr_.input_id || attr.format != attr_.format || attr.width != attr_.width ||
+            attr.height != attr_.height || attr.num_buffers != attr_.num_buffers || attr.fps != attr_.fps ||
+            attr.headless != attr_.headless || attr.name != attr_.name || !allocator ||
+            !same_thread_policy(attr.thread_attr, attr_.thread_attr) ||
+            (is_raw_format(attr_.format) && !same_raw_config(attr.raw, attr_.raw))) {
+            return false;
+        }
+        std::lock_guard<std::mutex> rate_guard(rate_mutex_);
+        attr_.qos = attr.qos;
+        attr_.deadline_ns = attr.deadline_ns;
+        attr_.hidden_fps = attr.hidden_fps;
+        attr_.target_fps = attr.target_fps < 0 ? 0 : attr.target_fps;
+        return nullptr == qcarcam_ctx_ || apply_frame_rate();
+    }
+    bool change_window(DVECT size, DVECT pos, bool flush = true) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        return win_ptr_ && win_ptr_->change_win_attr(size, pos, flush);
+    }
+    bool set_window_visible(int visible, bool flush = true) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        return win_ptr_ && win_ptr_->set_visible(visible, flush);
+    }
+    // crop and zoom through the window source rectangle (buffer ratios), animated per vsync
+    // over duration_ms; the compositor scales, no pixel is copied. An immediate change goes into
+    // txn when given, committed with the rest of the batch, and is flushed right away otherwise
+    bool set_viewport(const DVECT &pos, const DVECT &size, int duration_ms = 0, window_transaction *txn = nullptr) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        if (!win_ptr_) {
+            return false;
+        }
+        if (nullptr == viewport_) {
+            if (duration_ms <= 0) {
+                if (txn != nullptr) {
+                    txn->set_viewport(win_ptr_, pos, size);
+                    return true;
+                }
+                return win_ptr_->set_viewport(pos, size);
+            }
+            viewport_ = std::make_shared<viewport_animator>(win_ptr_, attr_.thread_attr, thread_name("vp"));
+            if (!viewport_->start()) {
+                viewport_ = nullptr;
+                return false;
+            }
+        }
+        window_viewport target;
+        target.pos = pos;
+        target.size = size;
+        viewport_->animate_to(target, duration_ms);
+        return true;
+    }
+    // show the stream on one more display at its own size, position and viewport (attr; buffer size and
+    // format follow the camera window). The mirror shares the capture buffers, no pixel is copied and
+    // a buffer goes back to capture only when every display showing it has moved on. -1 on error
+    int add_mirror(const screen_attribute &attr) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        if (!win_ptr_ || win_ptr_->get_win_buf().handles.empty()) {
+            LOG_E("a mirror needs the camera window and its buffers!");
+            return -1;
+        }
+        auto mirror = std::make_shared<display_mirror>(win_ptr_, [this](int idx) { this->release_frame(idx); },
+                                                       attr_.thread_attr, thread_name("mirror"));
+        if (!mirror->start(attr, [this](bool) { this->on_visibility(); })) {
+            return -1;
+        }
+        int id = 0;
+        {
+            std::lock_guard<std::mutex> post_guard(post_mutex_);
+            id = ++mirror_seq_;
+            mirrors_.emplace_back(id, mirror);
+        }
+        on_visibility();            // a visible mirror of a hidden window shows the held frame and lifts hidden_fps
+        return id;
+    }
+    bool remove_mirror(int id) {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        std::shared_ptr<display_mirror> mirror;
+        {
+            std::lock_guard<std::mutex> post_guard(post_mutex_);
+            for (auto it = mirrors_.begin();it != mirrors_.end();++it) {
+                if (it->first == id) {
+                    mirror = it->second;
+                    mirrors_.erase(it);
+                    break;
+                }
+            }
+        }
+        if (nullptr == mirror) {
+            return false;
+        }
+        mirror->stop();
+        on_visibility();            // the last visible window may have gone
+        return true;
+    }
+    void remove_mirrors() {
+        std::lock_guard<std::mutex> guard(control_mutex_);
+        for (auto &mirror : take_mirrors()) {
+            mirror->stop();
+        }
+        if (win_ptr_) {
+            on_visibility();
+        }
+    }
+    // the window of mirror id for its own size, position and viewport changes, nullptr if none
+    std::shared_ptr<screen_window> get_mirror_window(int id) {
+        std::lock_guard<std::mutex> guard(post_mutex_);
+        for (auto &mirror : mirrors_) {
+            if (mirror.first == id) {
+                return mirror.second->get_window();
+            }
+        }
+        return nullptr;
+    }
+    // connect latencies measured by camera_manager
+    inline void note_open(uint64_t ns, bool warm) {
+        stat_open_ns_ = ns;
+        if (warm) {
+            ++stat_warm_opens_;
+        }
+    }
+    inline void note_park(uint64_t ns) {
+        stat_park_ns_ = ns;
+    }
+    // merge an increase of the driver diagnostics into the stats, lock free
+    void add_driver_counters(const driver_counters &delta) {
+        stat_csi_errors_ += delta.csi_errors;
+        stat_ife_overflows_ += delta.ife_overflows;
+        stat_driver_drops_ += delta.frame_drops;
+        stat_driver_errors_ += delta.other_errors;
+    }
+    inline uint64_t deadline_ns() const {
+        return attr_.deadline_ns ? attr_.deadline_ns
+             : static_cast<uint64_t>(1e9 / (attr_.fps > 0 ? attr_.fps : 30.0f));
+    }
+    // worst latency since the previous call, for the qos governor
+    inline uint64_t take_window_latency() {
+        return stat_window_latency_ns_.exchange(0);
+    }
+    // software decimation of the qos governor on top of the frame rate setting: one frame in divisor
+    inline void set_qos_divisor(int divisor) {
+        qos_divisor_ = divisor < 1 ? 1 : divisor;
+    }
+    inline int get_qos_divisor() const {
+        return qos_divisor_;
+    }
+    inline qcarcam_hndl_t get_handle() const {
+        return qcarcam_ctx_;
+    }
+    inline std::shared_ptr<screen_window> get_window() const {
+        return win_ptr_;
+    }
+    camera_stats get_stats() const {
+        camera_stats stats;
+        stats.frames = stat_frames_;
+        stats.timeouts = stat_timeouts_;
+        stats.errors = stat_errors_;
+        stats.last_seq_no = stat_last_seq_no_;
+        stats.last_timestamp = stat_last_timestamp_;
+        stats.last_latency_ns = stat_last_latency_ns_;
+        stats.max_latency_ns = stat_max_latency_ns_;
+        stats.state = camera_state_;
+        stats.dropped = stat_dropped_;
+        stats.decimation = decimation_;
+        stats.qos_class = attr_.qos;
+        stats.deadline_misses = stat_deadline_misses_;
+        stats.qos_divisor = qos_divisor_;
+        stats.csi_errors = stat_csi_errors_;
+        stats.ife_overflows = stat_ife_overflows_;
+        stats.driver_drops = stat_driver_drops_;
+        stats.driver_errors = stat_driver_errors_;
+        stats.posts = stat_posts_;
+        stats.hidden_skips = stat_hidden_skips_;
+        stats.open_ns = stat_open_ns_;
+        stats.park_ns = stat_park_ns_;
+        stats.warm_opens = stat_warm_opens_;
+        return stats;
+    }
+    std::string thread_name(const char *role) const {
+        return attr_.name.empty() ? std::string(role) + std::to_string(static_cast<int>(attr_.input_id))
+                                  : std::string(role) + "_" + attr_.name;
+    }
+    thread_policy get_effective_policy() {
+        std::lock_guard<std::mutex> guard(policy_mutex_);
+        return effective_policy_;
+    }
+    private:
+        // safe to call from any state and more than once, the thread is gone afterwards
+        void stop_capture_thread() {
+            {
+                std::lock_guard<std::mutex> guard(frame_mutex_);
+                keep_running_ = false;
+            }
+            frame_cv_.notify_all();
+            if (cap_thread_ != nullptr) {
+                if (cap_thread_->joinable()) {
+                    cap_thread_->join();
+                }
+                delete cap_thread_;
+                cap_thread_ = nullptr;
+            }
+            {
+                std::lock_guard<std::mutex> guard(post_mutex_);
+                unposted_ = false;      // the held buffer belongs to the stopped run
+            }
+            for (auto &mirror : mirror_list()) {
+                mirror->release_all();  // qcarcam writes none of them before the next start
+            }
+        }
+        // from set_visible of the window or a mirror, under control_mutex_ when it came through this
+        // controller; a reveal posts the held newest buffer at once instead of waiting for the next frame
+        void on_visibility() {
+            bool visible = false;
+            {
+                std::lock_guard<std::mutex> guard(post_mutex_);
+                visible = shown_locked();
+                if (visible && unposted_ && keep_running_ && pre_buffer_idx_ >= 0) {
+                    post_locked(pre_buffer_idx_);
+                }
+            }
+            std::lock_guard<std::mutex> guard(rate_mutex_);
+            if (hidden_ != !visible) {
+                hidden_ = !visible;
+                if (attr_.hidden_fps > 0 && qcarcam_ctx_) {
+                    apply_frame_rate();
+                }
+            }
+        }
+        // under post_mutex_: the window or any mirror is visible
+        bool shown_locked() const {
+            if (win_ptr_->is_visible()) {
+                return true;
+            }
+            for (auto &mirror : mirrors_) {
+                if (mirror.second->is_visible()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        // under post_mutex_: post idx to the window, its buffers show in the mirrors too; every visible
+        // mirror gets a reference of its own, dropped once its display has latched a newer buffer
+        void post_locked(int idx) {
+            win_ptr_->handle_new_buffer(idx);
+            ++stat_posts_;
+            unposted_ = false;
+            for (auto &mirror : mirrors_) {
+                if (mirror.second->is_visible() && hold_frame(idx)) {
+                    mirror.second->post(idx);
+                }
+            }
+        }
+        std::vector<std::shared_ptr<display_mirror>> mirror_list() {
+            std::vector<std::shared_ptr<display_mirror>> list;
+            std::lock_guard<std::mutex> guard(post_mutex_);
+            for (auto &mirror : mirrors_) {
+                list.push_back(mirror.second);
+            }
+            return list;
+        }
+        std::vector<std::shared_ptr<display_mirror>> take_mirrors() {
+            std::vector<std::shared_ptr<display_mirror>> list;
+            std::lock_guard<std::mutex> guard(post_mutex_);
+            for (auto &mirror : mirrors_) {
+                list.push_back(mirror.second);
+            }
+            mirrors_.clear();
+            return list;
+        }
+        camera_frame make_frame(const qcarcam_frame_info_t &frameInfo, uint8_t *data) const {
+            camera_frame frame;
+            frame.input_id = static_cast<int>(attr_.input_id);
+            frame.idx = frameInfo.idx;
+            frame.seq_no = frameInfo.seq_no;
+            frame.timestamp = frameInfo.timestamp;
+            frame.data = data;
+            frame.width = cap_buf_->buffers[frameInfo.idx].planes[0].width;
+            frame.height = cap_buf_->buffers[frameInfo.idx].planes[0].height;
+            frame.stride = frame_stride(frameInfo.idx);
+            frame.format = frame_format();
+            frame.plane_offset = raw_win_ptr_ || layout_.planes < 2 ? 0 : layout_.offset[1];
+            return frame;
+        }
+        // what listeners and the exporter see: RAW inputs are delivered as the processed UYVY
+        inline qcarcam_color_fmt_t frame_format() const {
+            return raw_win_ptr_ ? QCARCAM_FMT_UYVY_8 : attr_.format;
+        }
+        inline uint32_t frame_stride(unsigned int idx) const {
+            return raw_win_ptr_ ? win_ptr_->get_win_buf().stride[0] : cap_buf_->buffers[idx].planes[0].stride;
+        }
+        // capture into the buffers of the camera window, which screen allocates and the display shows
+        bool init_window(screen_attribute &screenAttr) {
+            screenAttr.buffer_size = { attr_.width, attr_.height };
+            // the window shows the capture as is when screen has the format; RAW is shown as the processed UYVY
+            // and a format screen lacks lands in UYVY buffers (2 bytes per pixel) without a correct picture
+            const format_traits traits = format_traits_of(attr_.format);
+            screenAttr.format = traits.screen_format >= 0 ? traits.screen_format : SCREEN_FORMAT_UYVY;
+            if (traits.screen_format < 0 && !is_raw_format(attr_.format)) {
+                if (0 == traits.planes || traits.bits_per_pixel > 16) {
+                    LOG_E("format 0x%x has no buffer layout", attr_.format);
+                    return false;
+                }
+                LOG_W("format 0x%x is not displayable, captured into UYVY buffers", attr_.format);
+            }
+            LOG_D("creat window buffer: %d, size:%d*%d, format:%d", attr_.num_buffers, attr_.width, attr_.height, attr_.format);
+            if (false == create_window(screenAttr)) {
+                return false;
+            }
+            hidden_ = !win_ptr_->is_visible();
+            win_ptr_->set_visibility_listener([this](bool) { this->on_visibility(); });
+            window_buffer_attr bufferAttr;
+            bufferAttr.num = attr_.num_buffers + 1;
+            bufferAttr.size[0] = attr_.width;
+            bufferAttr.size[1] = attr_.height;
+            if (!win_ptr_->init_buffer(bufferAttr)) {
+                LOG_E("win ptr init buffer error!");
+                return false;
+            }
+            if (is_raw_format(attr_.format) && !init_raw(screenAttr)) {
+                return false;
+            }
+            // RAW is captured into the hidden window and processed into the displayed buffer of the same index;
+            // the buffer pitch only applies when the window holds the capture format itself
+            auto& buffer = raw_win_ptr_ ? raw_win_ptr_->get_win_buf() : win_ptr_->get_win_buf();
+            uint32_t stride = raw_win_ptr_ ? raw_stride(attr_.format, attr_.width)
+                            : traits.screen_format >= 0 ? buffer.stride[0] : 0;
+            uint32_t offset = traits.screen_format >= 0 ? buffer.offset[1] : 0;
+            if (!get_plane_layout(attr_.format, attr_.width, attr_.height, stride, offset, layout_) ||
+                buffer.handles.empty() || layout_.size > buffer.handles[0].size) {
+                LOG_E("format 0x%x %dx%d does not fit the window buffers", attr_.format, attr_.width, attr_.height);
+                return false;
+            }
+            for (unsigned int i = 0;i < buffer.handles.size() && i < cap_buf_->n_buffers;++i) {
+                set_capture_planes(i, buffer.handles[i].mem_handle);
+            }
+            return true;
+        }
+        // buffers of the allocator and no screen object at all, for inputs only algorithms consume
+        bool init_headless() {
+            if (is_raw_format(attr_.format)) {
+                LOG_E("raw format 0x%x needs the window buffers", attr_.format);
+                return false;
+            }
+            if (nullptr == attr_.allocator) {
+                attr_.allocator = make_default_allocator();
+                default_allocator_ = true;
+            }
+            uint32_t stride = (min_stride(attr_.format, attr_.width) + BUFFER_STRIDE_ALIGN - 1) & ~(BUFFER_STRIDE_ALIGN - 1);
+            if (!get_plane_layout(attr_.format, attr_.width, attr_.height, stride, 0, layout_)) {
+                LOG_E("format 0x%x has no buffer layout", attr_.format);
+                return false;
+            }
+            cap_buf_->flags = attr_.allocator->buffer_flags();
+            headless_bufs_.resize(cap_buf_->n_buffers);
+            for (unsigned int i = 0;i < cap_buf_->n_buffers;++i) {
+                if (!attr_.allocator->allocate(layout_.size, headless_bufs_[i])) {
+                    LOG_E("allocate headless buffer %u of %u bytes error!", i, layout_.size);
+                    return false;
+                }
+                set_capture_planes(i, headless_bufs_[i].handle);
+            }
+            LOG_I("headless capture 0x%x %dx%d stride:%u, %u buffers", attr_.format, attr_.width, attr_.height,
+                  stride, cap_buf_->n_buffers);
+            return true;
+        }
+        void set_capture_planes(unsigned int i, void *p_buf) {
+            const format_traits traits = format_traits_of(attr_.format);
+            cap_buf_->buffers[i].n_planes = layout_.planes;
+            for (int p = 0;p < layout_.planes;++p) {
+                qcarcam_plane_t &plane = cap_buf_->buffers[i].planes[p];
+                plane.width = p ? attr_.width >> traits.chroma_h_shift : attr_.width;
+                plane.height = layout_.height[p];
+                plane.stride = layout_.stride[p];
+                plane.size = p + 1 < layout_.planes ? layout_.offset[p + 1] - layout_.offset[p]
+                                                    : layout_.size - layout_.offset[p];
+                plane.p_buf = p_buf;
+            }
+            LOG_D("[%d] %p %dx%d %d, planes:%d size:%d", i, cap_buf_->buffers[i].planes[0].p_buf,
+                           cap_buf_->buffers[i].planes[0].width, cap_buf_->buffers[i].planes[0].height,
+                           cap_buf_->buffers[i].planes[0].stride, layout_.planes, layout_.size);
+        }
+        bool init_raw(const screen_attribute &screenAttr) {
+            uint32_t stride = raw_stride(attr_.format, attr_.width);
+            if (0 == stride || !raw_.configure(attr_.raw, attr_.format, attr_.width, attr_.height)) {
+                LOG_E("raw format 0x%x is not supported", attr_.format);
+                return false;
+            }
+            // UYVY buffers of the capture size hold every handled packing, 2 bytes per pixel at most
+            screen_attribute rawAttr = screenAttr;
+            rawAttr.visibility = 0;
+            rawAttr.format = SCREEN_FORMAT_UYVY;
+            rawAttr.usage = SCREEN_USAGE_WRITE | SCREEN_USAGE_CAPTURE;
+            raw_win_ptr_ = std::make_shared<screen_window>(std::make_shared<screen_context>());
+            window_buffer_attr bufferAttr;
+            bufferAttr.num = attr_.num_buffers;
+            bufferAttr.size[0] = attr_.width;
+            bufferAttr.size[1] = attr_.height;
+            if (!raw_win_ptr_->init(rawAttr) || !raw_win_ptr_->init_buffer(bufferAttr) ||
+                static_cast<uint32_t>(raw_win_ptr_->get_win_buf().stride[0]) < stride) {
+                LOG_E("raw capture buffers error!");
+                raw_win_ptr_ = nullptr;
+                return false;
+            }
+            int threads = attr_.raw.threads;
+            if (threads <= 0) {
+                threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+            }
+            raw_pool_.reset(new thread_pool(threads - 1, attr_.thread_attr, thread_name("raw")));
+            LOG_I("raw capture 0x%x %dx%d stride:%u on %d threads", attr_.format, attr_.width, attr_.height,
+                  stride, threads);
+            return true;
+        }
+        bool process_raw(unsigned int idx) {
+            uint8_t *src = nullptr, *dst = nullptr;
+            raw_win_ptr_->get_yuv_buffer(idx, &src);
+            win_ptr_->get_yuv_buffer(idx, &dst);
+            if (nullptr == src || nullptr == dst) {
+                return false;
+            }
+            if (!raw_.process(src, cap_buf_->buffers[idx].planes[0].stride, dst, win_ptr_->get_win_buf().stride[0],
+                              raw_pool_.get())) {
+                return false;
+            }
+            const raw_timing &timing = raw_.get_timing();
+            LOG_D("raw unpack %.2f ms, demosaic %.2f ms", timing.unpack_ns / 1e6, timing.demosaic_ns / 1e6);
+            return true;
+        }
+        void notify_listeners(const camera_frame &frame) {
+            std::lock_guard<std::mutex> guard(listener_mutex_);
+            for (auto &listener : listeners_) {
+                listener.second(frame);
+            }
+        }
+        // under rate_mutex_
+        bool apply_frame_rate() {
+            float target = attr_.target_fps;
+            if (hidden_ && attr_.hidden_fps > 0 && (target <= 0 || attr_.hidden_fps < target)) {
+                target = attr_.hidden_fps;
+            }
+            bool decimate = target > 0 && (attr_.fps <= 0 || target < attr_.fps);
+            qcarcam_param_value_t param;
+            memset(&param, 0, sizeof(param));
+            param.frame_rate_config = make_frame_drop_pattern(attr_.fps, target);
+            bool isp = QCARCAM_FRAMEDROP_MANUAL == param.frame_rate_config.frame_drop_mode;
+            if (isp || DECIMATION_ISP == decimation_) {     // also puts a pattern back to keep all
+                qcarcam_ret_t ret = qcarcam_s_param(qcarcam_ctx_, QCARCAM_PARAM_FRAME_RATE, &param);
+                if (ret != QCARCAM_RET_OK) {
+                    LOG_W("set frame drop period:%d pattern:0x%x failed %d, decimating in software",
+                          param.frame_rate_config.frame_drop_period, param.frame_rate_config.frame_drop_pattern, ret);
+                    isp = false;
+                }
+            }
+            if (isp) {
+                LOG_I("%.1f fps of %.1f: ISP keeps pattern 0x%x of %d frames", target, attr_.fps,
+                      param.frame_rate_config.frame_drop_pattern, param.frame_rate_config.frame_drop_period);
+                sw_interval_ns_ = 0;
+                decimation_ = DECIMATION_ISP;
+            }
+            else if (decimate) {
+                sw_interval_ns_ = static_cast<uint64_t>(1e9 / target);
+                decimation_ = DECIMATION_SOFTWARE;
+            }
+            else {
+                sw_interval_ns_ = 0;
+                decimation_ = DECIMATION_NONE;
+            }
+            return true;
+        }
+        void update_frame_stats(const qcarcam_frame_info_t &frameInfo) {
+            uint64_t now = monotonic_ns();
+            uint64_t latency = now > frameInfo.timestamp ? now - frameInfo.timestamp : 0;
+            ++stat_frames_;
+            stat_last_seq_no_ = frameInfo.seq_no;
+            stat_last_timestamp_ = frameInfo.timestamp;
+            stat_last_latency_ns_ = latency;
+            if (latency > stat_max_latency_ns_) {
+                stat_max_latency_ns_ = latency;     // only the capture thread writes it
+            }
+            if (latency > stat_window_latency_ns_) {
+                stat_window_latency_ns_ = latency;  // a max lost to take_window_latency() is one frame
+            }
+            if (latency > deadline_ns()) {
+                ++stat_deadline_misses_;
+            }
+        }
+        // keeps one frame in qos_divisor_
+        inline bool qos_keep() {
+            int divisor = qos_divisor_;
+            return divisor <= 1 || 0 == qos_phase_++ % static_cast<unsigned int>(divisor);
+        }
     private:
         capture_attr attr_;
         std::shared_ptr<screen_window>win_ptr_;
+        std::shared_ptr<screen_window> raw_win_ptr_;   // < Hidden capture buffers of RAW inputs
+        raw_processor raw_;                             // < Capture thread only
+        std::unique_ptr<thread_pool> raw_pool_;
+        plane_layout layout_;                           // < Of the captured format in the capture buffers
         qcarcam_buffers_t *cap_buf_ = nullptr;
+        std::vector<capture_memory> headless_bufs_;     // < Capture buffers of a headless input
+        bool default_allocator_ = false;                // < attr_.allocator was not given but made by init
         qcarcam_hndl_t qcarcam_ctx_ = nullptr;
-        camera_state camera_state_ = CAM_STATE_INIT;
+        std::atomic<int> camera_state_{CAM_STATE_INIT};
         std::condition_variable frame_cv_;
         std::mutex frame_mutex_;
         std::mutex control_mutex_;
+        std::mutex rate_mutex_;                         // < attr_ frame rates, hidden_ and the decimation setup
+        bool hidden_ = false;
+        std::mutex post_mutex_;                         // < Posting to the window, pre_buffer_idx_, unposted_ and mirrors_
+        bool unposted_ = false;                         // < pre_buffer_idx_ was held back while hidden
+        std::vector<std::pair<int, std::shared_ptr<display_mirror>>> mirrors_;     // < By mirror id
+        int mirror_seq_ = 0;
+        std::mutex policy_mutex_;
+        thread_policy effective_policy_;
         std::thread* cap_thread_ = nullptr;
-        std::atomic<bool>keep_running_;
+        std::atomic<bool>keep_running_{false};         // < Written under frame_mutex_ so a waiter cannot miss it
+        unsigned int pending_frames_ = 0;               // < FRAME_READY events not fetched yet, under frame_mutex_
+        std::shared_ptr<frame_exporter> exporter_;
+        std::shared_ptr<viewport_animator> viewport_;
+        std::atomic<int> buf_refs_[QCARCAM_MAX_NUM_BUFFERS] = {};
+        std::mutex listener_mutex_;
+        std::vector<std::pair<int, frame_listener>> listeners_;
+        int listener_seq_ = 0;
+        std::mutex latest_mutex_;
+        camera_frame latest_frame_;     // < Newest posted buffer, valid while the display holds it
+        bool has_latest_ = false;
         int pre_buffer_idx_ = -1;
         unsigned int frame_num_ = 0;
+        std::atomic<uint64_t> stat_frames_{0};
+        std::atomic<uint64_t> stat_timeouts_{0};
+        std::atomic<uint64_t> stat_errors_{0};
+        std::atomic<uint64_t> stat_dropped_{0};
+        std::atomic<uint64_t> stat_posts_{0};
+        std::atomic<uint64_t> stat_hidden_skips_{0};
+        std::atomic<uint64_t> stat_deadline_misses_{0};
+        std::atomic<uint64_t> stat_window_latency_ns_{0};  // < Max latency since the last take_window_latency()
+        std::atomic<uint64_t> stat_open_ns_{0};
+        std::atomic<uint64_t> stat_park_ns_{0};
+        std::atomic<uint64_t> stat_warm_opens_{0};
+        std::atomic<int> qos_divisor_{1};
+        unsigned int qos_phase_ = 0;                    // < Capture thread only
+        std::atomic<uint64_t> stat_csi_errors_{0};     // < From the diagnostics poller thread
+        std::atomic<uint64_t> stat_ife_overflows_{0};
+        std::atomic<uint64_t> stat_driver_drops_{0};
+        std::atomic<uint64_t> stat_driver_errors_{0};
+        std::atomic<int> decimation_{DECIMATION_NONE};
+        std::atomic<uint64_t> sw_interval_ns_{0};
+        frame_decimator decimator_;             // < Capture thread only
+        std::atomic<uint64_t> stat_last_seq_no_{0};
+        std::atomic<uint64_t> stat_last_timestamp_{0};
+        std::atomic<uint64_t> stat_last_latency_ns_{0};
+        std::atomic<uint64_t> stat_max_latency_ns_{0};
     };
 }
\ No newline at end of file
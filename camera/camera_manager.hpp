@@ -1,14 +1,30 @@
 #pragma once
 #include <map>
+#include <set>
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include "single_instance.hpp"
 #include "camera_controller.hpp"
+#include "qos_governor.hpp"
+#include "sync_group.hpp"
+#include "snapshot.hpp"
+#include "guideline_overlay.hpp"
+#include "dewarp_stage.hpp"
+#include "top_view_stage.hpp"
+#include "tensor_batcher.hpp"
+#include "lens_monitor.hpp"
+#include "frame_recorder.hpp"
 namespace qnx_screen_camera {
     class camera_manager;
     #define G_CAMERA_MANAGER single_instance<camera_manager>::instance()
+    enum camera_manager_param : int {
+        CAM_CALLBACK_DRAIN_MS = 200,    // < Longest wait on in flight event callbacks of a closing input
+    };
     class camera_manager {
     public:
         bool init() {
+            TRACE_SCOPE("qcarcam_initialize");
             qcarcam_init_t qcarcam_init = { 0 };
             qcarcam_init.version = QCARCAM_VERSION;
             qcarcam_init.debug_tag = (char *) "camera_manager";
@@ -55,6 +71,7 @@ namespace qnx_screen_camera {
             return true;
         }
         qcarcam_hndl_t create_camera_connect(screen_attribute &sreenAttr, capture_attr &capAttr) {
+            TRACE_SCOPE("create_camera_connect", capAttr.input_id);
             auto inputSrc = input_src_map_.find(capAttr.input_id);
             if (input_src_map_.end() == inputSrc) {
                 LOG_E("cannot find input id!");
@@ -67,18 +84,117 @@ namespace qnx_screen_camera {
             if (QCARCAM_FMT_MAX == capAttr.format) {
                 capAttr.format = inputSrc->second.color_fmt[0];
             }
+            if (capAttr.fps <= 0) {
+                capAttr.fps = inputSrc->second.res[0].fps;
+            }
             sreenAttr.input_id = static_cast<int>(capAttr.input_id);
-            auto cameraPtr = std::make_shared<camera_controller>(capAttr);
+            {
+                // claimed until registered, so a second connect of the input cannot open it meanwhile
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                if (camera_handle_map_.count(capAttr.input_id) || connecting_.count(capAttr.input_id)) {
+                    LOG_E("input id:%d is already connected!", capAttr.input_id);
+                    return nullptr;
+                }
+                connecting_.insert(capAttr.input_id);
+            }
+            uint64_t begin = monotonic_ns();
+            auto cameraPtr = unpark(sreenAttr, capAttr);
+            if (cameraPtr != nullptr) {
+                cameraPtr->note_open(monotonic_ns() - begin, true);
+                register_camera(cameraPtr);
+                LOG_I("camera %d reopened from standby in %.2f ms", capAttr.input_id, (monotonic_ns() - begin) / 1e6);
+                return cameraPtr->get_handle();
+            }
+            cameraPtr = std::make_shared<camera_controller>(capAttr);
             qcarcam_hndl_t camHandle = cameraPtr->init(sreenAttr, reinterpret_cast<void *>(qcarcamEventCb));
             if (nullptr == camHandle) {
                 LOG_E("init camera handle failed!");
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                connecting_.erase(capAttr.input_id);
                 return nullptr;
             }
-            camera_connect_map_.emplace(std::make_pair(camHandle, cameraPtr));
-            camera_handle_map_.emplace(std::make_pair(capAttr.input_id, cameraPtr));
+            cameraPtr->note_open(monotonic_ns() - begin, false);
+            register_camera(cameraPtr);
+            LOG_I("camera %d opened in %.2f ms", capAttr.input_id, (monotonic_ns() - begin) / 1e6);
             return camHandle;
         }
+        // unregister input id, wait out its in flight event callbacks and close it in bounded time. Sync groups and
+        // the lens monitor, recording and mirrors of the input are dropped, other stages on it must be stopped first.
+        // park keeps the stopped handle, window and buffers so the next create_camera_connect of the same geometry
+        // only restarts them
+        bool destroy_camera_connect(int id, bool park = false) {
+            TRACE_SCOPE("destroy_camera_connect", id);
+            uint64_t begin = monotonic_ns();
+            std::shared_ptr<camera_controller> ptr;
+            {
+                std::unique_lock<std::mutex> lk(connect_mutex_);
+                auto it = camera_handle_map_.find(id);
+                if (camera_handle_map_.end() == it) {
+                    LOG_E("destroy id:%d is not exist.", id);
+                    return false;
+                }
+                ptr = it->second;
+                camera_handle_map_.erase(it);
+                connecting_.insert(id);     // claimed until closed or parked, a connect meanwhile would open it twice
+                qcarcam_hndl_t handle = ptr->get_handle();
+                camera_connect_map_.erase(handle);
+                if (!callback_cv_.wait_for(lk, std::chrono::milliseconds(CAM_CALLBACK_DRAIN_MS), [this, handle]() {
+                        return 0 == callbacks_in_flight_.count(handle); })) {
+                    LOG_W("camera %d closes with event callbacks still running", id);
+                }
+            }
+            stop_lens_monitor(id);
+            stop_recording(id);
+            ptr->remove_mirrors();
+            std::vector<std::shared_ptr<sync_group>> groups;
+            {
+                std::lock_guard<std::mutex> guard(sync_mutex_);
+                for (auto it = sync_groups_.begin();it != sync_groups_.end();) {
+                    if ((*it)->contains(ptr)) {
+                        groups.push_back(*it);
+                        it = sync_groups_.erase(it);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+            for (auto &group : groups) {
+                group->stop();
+            }
+            std::shared_ptr<camera_controller> replaced;
+            if (park) {
+                ptr->stop_capture();
+                ptr->note_park(monotonic_ns() - begin);
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                replaced = parked_map_[id];
+                parked_map_[id] = ptr;
+                connecting_.erase(id);
+            }
+            else {
+                ptr->close();
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                connecting_.erase(id);
+            }
+            LOG_I("camera %d %s in %.2f ms", id, park ? "parked" : "closed", (monotonic_ns() - begin) / 1e6);
+            if (replaced != nullptr && replaced != ptr) {
+                replaced->close();
+            }
+            return true;
+        }
+        // close every parked input, e.g. when the standby memory is needed
+        void drop_standby() {
+            std::map<int, std::shared_ptr<camera_controller>> parked;
+            {
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                parked.swap(parked_map_);
+            }
+            for (auto &it : parked) {
+                it.second->close();
+            }
+        }
         std::shared_ptr<camera_controller> find_camera_connect(const qcarcam_hndl_t handle) {
+            std::lock_guard<std::mutex> guard(connect_mutex_);
             auto controller = camera_connect_map_.find(handle);
             if (controller != camera_connect_map_.end()) {
                 return controller->second;
@@ -86,26 +202,402 @@ namespace qnx_screen_camera {
             return nullptr;
         }
         std::shared_ptr<camera_controller> find_camera_connect_by_id(int id) {
+            std::lock_guard<std::mutex> guard(connect_mutex_);
             auto ctr = camera_handle_map_.find(id);
             if (ctr != camera_handle_map_.end()) {
                 return ctr->second;
             }
             return nullptr;
         }
-        bool control_camera(int id, int command) {
+        bool control_camera(int id, int command, bool flush = true) {
             auto ptr = find_camera_connect_by_id(id);
             if (nullptr == ptr) {
                 LOG_E("controlCamera id:%d is not exist.", id);
                 return false;
             }
-            if (false == ptr->control_command(command)) {
+            if (false == ptr->control_command(command, flush)) {
                 LOG_E("call controlCommand error!");
                 return false;
             }
             return true;
         }
+        bool change_camera_window(int id, DVECT size, DVECT pos, bool flush = true) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("change window id:%d is not exist.", id);
+                return false;
+            }
+            return ptr->change_window(size, pos, flush);
+        }
+        bool set_camera_visible(int id, int visible, bool flush = true) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("set visible id:%d is not exist.", id);
+                return false;
+            }
+            return ptr->set_window_visible(visible, flush);
+        }
+        bool set_camera_viewport(int id, DVECT pos, DVECT size, int duration_ms = 0) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("set viewport id:%d is not exist.", id);
+                return false;
+            }
+            return ptr->set_viewport(pos, size, duration_ms);
+        }
+        // the stream of input id on one more display, sharing its capture buffers; returns the mirror id or -1
+        int add_camera_mirror(int id, const screen_attribute &attr) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("mirror id:%d is not exist.", id);
+                return -1;
+            }
+            return ptr->add_mirror(attr);
+        }
+        bool remove_camera_mirror(int id, int mirror) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("mirror id:%d is not exist.", id);
+                return false;
+            }
+            return ptr->remove_mirror(mirror);
+        }
+        // size and position (display ratios) plus viewport (buffer ratios) of one mirror
+        bool change_camera_mirror(int id, int mirror, DVECT size, DVECT pos, DVECT source_pos, DVECT source_size,
+                                  bool flush = true) {
+            auto ptr = find_camera_connect_by_id(id);
+            auto win = ptr ? ptr->get_mirror_window(mirror) : nullptr;
+            if (nullptr == win) {
+                LOG_E("mirror %d of id:%d is not exist.", mirror, id);
+                return false;
+            }
+            return win->change_win_attr(size, pos, false) && win->set_viewport(source_pos, source_size, flush);
+        }
+        bool set_camera_frame_rate(int id, float fps) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("set frame rate id:%d is not exist.", id);
+                return false;
+            }
+            return ptr->set_frame_rate(fps);
+        }
+        bool get_camera_stats(int id, camera_stats &stats) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                return false;
+            }
+            stats = ptr->get_stats();
+            return true;
+        }
+        // match frames of the given inputs by capture time, see sync_group
+        std::shared_ptr<sync_group> create_sync_group(const std::vector<int> &ids, uint64_t tolerance_ns,
+                                                      const sync_set_callback &callback, size_t max_pending = 2) {
+            std::vector<std::shared_ptr<camera_controller>> members;
+            for (int id : ids) {
+                auto ptr = find_camera_connect_by_id(id);
+                if (nullptr == ptr) {
+                    LOG_E("sync group member id:%d is not exist.", id);
+                    return nullptr;
+                }
+                members.push_back(ptr);
+            }
+            auto group = std::make_shared<sync_group>(members, tolerance_ns, callback, max_pending);
+            if (!group->start()) {
+                LOG_E("start sync group error!");
+                return nullptr;
+            }
+            std::lock_guard<std::mutex> guard(sync_mutex_);
+            sync_groups_.push_back(group);
+            return group;
+        }
+        void destroy_sync_group(const std::shared_ptr<sync_group> &group) {
+            {
+                std::lock_guard<std::mutex> guard(sync_mutex_);
+                auto it = std::find(sync_groups_.begin(), sync_groups_.end(), group);
+                if (sync_groups_.end() == it) {
+                    return;
+                }
+                sync_groups_.erase(it);
+            }
+            group->stop();
+        }
+        // parking guide lines in their own window above the camera window, owned by the caller;
+        // the overlay thread keeps the default policy so it never competes with capture
+        std::shared_ptr<guideline_overlay> create_guideline_overlay(int id, const guideline_config &config,
+                                                                    double scale = 0.5) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("guideline overlay id:%d is not exist.", id);
+                return nullptr;
+            }
+            auto overlay = std::make_shared<guideline_overlay>(config, thread_policy(), ptr->thread_name("guide"));
+            if (!overlay->start(ptr->get_window(), scale)) {
+                LOG_E("start guideline overlay error!");
+                return nullptr;
+            }
+            return overlay;
+        }
+        // corrected view of a fisheye input stacked on its camera window, owned by the caller
+        std::shared_ptr<dewarp_stage> create_dewarp_stage(int id, const dewarp_config &config) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("dewarp id:%d is not exist.", id);
+                return nullptr;
+            }
+            auto stage = std::make_shared<dewarp_stage>(ptr, config);
+            if (!stage->init_display() || !stage->start()) {
+                LOG_E("start dewarp stage error!");
+                return nullptr;
+            }
+            return stage;
+        }
+        // bird's-eye view of the given inputs in camera order, owned by the caller; cameras without
+        // a source size use the capture size of their input. The render threads keep the default policy
+        // unless given one, so they never compete with capture
+        std::shared_ptr<top_view_stage> create_top_view(const std::vector<int> &ids, const top_view_config &config,
+                                                        std::vector<top_view_camera> cameras,
+                                                        const screen_attribute &screenAttr, uint64_t tolerance_ns,
+                                                        const thread_policy &policy = thread_policy()) {
+            std::vector<std::shared_ptr<camera_controller>> members;
+            for (size_t i = 0;i < ids.size() && i < cameras.size();++i) {
+                auto ptr = find_camera_connect_by_id(ids[i]);
+                if (nullptr == ptr) {
+                    LOG_E("top view member id:%d is not exist.", ids[i]);
+                    return nullptr;
+                }
+                if (cameras[i].src_width <= 0 || cameras[i].src_height <= 0) {
+                    cameras[i].src_width = ptr->get_attr().width;
+                    cameras[i].src_height = ptr->get_attr().height;
+                }
+                members.push_back(ptr);
+            }
+            if (members.empty() || ids.size() != cameras.size()) {
+                LOG_E("top view needs one calibration per input!");
+                return nullptr;
+            }
+            auto stage = std::make_shared<top_view_stage>(members, config, cameras, 0, policy, "topview");
+            if (!stage->init_display(screenAttr) || !stage->start(tolerance_ns)) {
+                LOG_E("start top view error!");
+                return nullptr;
+            }
+            return stage;
+        }
+        // model input batches of the given inputs in batch order, owned by the caller, see tensor_batcher;
+        // the batcher threads keep the default policy unless given one, so they never compete with capture
+        std::shared_ptr<tensor_batcher> create_tensor_batcher(const std::vector<int> &ids, const tensor_config &config,
+                                                              uint64_t tolerance_ns, const tensor_batch_callback &callback,
+                                                              int threads = 0,
+                                                              const thread_policy &policy = thread_policy()) {
+            std::vector<std::shared_ptr<camera_controller>> members;
+            for (int id : ids) {
+                auto ptr = find_camera_connect_by_id(id);
+                if (nullptr == ptr) {
+                    LOG_E("tensor batch member id:%d is not exist.", id);
+                    return nullptr;
+                }
+                members.push_back(ptr);
+            }
+            if (members.empty()) {
+                return nullptr;
+            }
+            auto batcher = std::make_shared<tensor_batcher>(members, config, callback, threads, policy,
+                                                            members[0]->thread_name("tensor"));
+            if (!batcher->start(tolerance_ns)) {
+                LOG_E("start tensor batcher error!");
+                return nullptr;
+            }
+            return batcher;
+        }
+        // call before the first snapshot, threads <= 0 uses up to 4 cores; the encode threads keep the
+        // default policy unless given one, so they never compete with capture
+        void configure_snapshot(int threads, const jpeg_options &options,
+                                const thread_policy &policy = thread_policy()) {
+            std::lock_guard<std::mutex> guard(snapshot_mutex_);
+            snapshot_threads_ = threads;
+            snapshot_options_ = options;
+            snapshot_policy_ = policy;
+        }
+        // JPEG of the newest frame of input id, encoded off the capture thread, see snapshot_engine
+        std::future<snapshot_result> snapshot(int id, const snapshot_callback &callback = nullptr) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("snapshot id:%d is not exist.", id);
+                snapshot_result failed;
+                failed.input_id = id;
+                if (callback) {
+                    callback(failed);
+                }
+                std::promise<snapshot_result> promise;
+                promise.set_value(failed);
+                return promise.get_future();
+            }
+            std::shared_ptr<snapshot_engine> engine;
+            {
+                std::lock_guard<std::mutex> guard(snapshot_mutex_);
+                if (nullptr == snapshot_engine_) {
+                    int threads = snapshot_threads_;
+                    if (threads <= 0) {
+                        threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+                    }
+                    snapshot_engine_ = std::make_shared<snapshot_engine>(threads, snapshot_policy_, snapshot_options_);
+                }
+                engine = snapshot_engine_;
+            }
+            return engine->request(ptr, callback);
+        }
+        // driver counters merged into get_camera_stats every config.interval_ms; decoder knows the
+        // diagnostics layout of the driver release
+        bool start_diagnostics(const diag_config &config, const diag_decoder &decoder) {
+            std::lock_guard<std::mutex> guard(diag_mutex_);
+            if (diag_poller_ != nullptr) {
+                return false;
+            }
+            auto poller = std::make_shared<diagnostics_poller>(config, decoder, [this](const driver_counters &delta) {
+                auto ptr = find_camera_connect_by_id(delta.input_id);
+                if (ptr != nullptr) {
+                    ptr->add_driver_counters(delta);
+                }
+            });
+            if (!poller->start()) {
+                LOG_E("start diagnostics poller error!");
+                return false;
+            }
+            diag_poller_ = poller;
+            return true;
+        }
+        void stop_diagnostics() {
+            std::shared_ptr<diagnostics_poller> poller;
+            {
+                std::lock_guard<std::mutex> guard(diag_mutex_);
+                poller.swap(diag_poller_);
+            }
+            if (poller != nullptr) {
+                poller->stop();
+            }
+        }
+        // lens obstruction / blur watch of input id, condition changes go to callback on the monitor thread
+        bool start_lens_monitor(int id, const lens_config &config, const lens_callback &callback) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("lens monitor id:%d is not exist.", id);
+                return false;
+            }
+            std::lock_guard<std::mutex> guard(lens_mutex_);
+            if (lens_monitors_.count(id)) {
+                return false;
+            }
+            auto monitor = std::make_shared<lens_monitor>(ptr, config, callback);
+            if (!monitor->start()) {
+                LOG_E("start lens monitor error!");
+                return false;
+            }
+            lens_monitors_[id] = monitor;
+            return true;
+        }
+        void stop_lens_monitor(int id) {
+            std::shared_ptr<lens_monitor> monitor;
+            {
+                std::lock_guard<std::mutex> guard(lens_mutex_);
+                auto it = lens_monitors_.find(id);
+                if (lens_monitors_.end() == it) {
+                    return;
+                }
+                monitor = it->second;
+                lens_monitors_.erase(it);
+            }
+            monitor->stop();
+        }
+        // LENS_OK for inputs without a monitor
+        lens_condition get_lens_condition(int id) {
+            std::lock_guard<std::mutex> guard(lens_mutex_);
+            auto it = lens_monitors_.find(id);
+            return lens_monitors_.end() == it ? LENS_OK : it->second->get_condition();
+        }
+        // compressed recording of input id to path, see frame_recorder; recording_reader plays it back
+        bool start_recording(int id, const std::string &path, const recorder_config &config = recorder_config()) {
+            auto ptr = find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                LOG_E("recording id:%d is not exist.", id);
+                return false;
+            }
+            std::lock_guard<std::mutex> guard(record_mutex_);
+            if (recorders_.count(id)) {
+                return false;
+            }
+            auto recorder = std::make_shared<frame_recorder>(ptr, config, ptr->thread_name("record"));
+            if (!recorder->start(path)) {
+                LOG_E("start recording error!");
+                return false;
+            }
+            recorders_[id] = recorder;
+            return true;
+        }
+        // finishes the frames in flight and closes the file with its index
+        void stop_recording(int id) {
+            std::shared_ptr<frame_recorder> recorder;
+            {
+                std::lock_guard<std::mutex> guard(record_mutex_);
+                auto it = recorders_.find(id);
+                if (recorders_.end() == it) {
+                    return;
+                }
+                recorder = it->second;
+                recorders_.erase(it);
+            }
+            recorder->stop();
+        }
+        bool get_recording_stats(int id, recorder_stats &stats) {
+            std::lock_guard<std::mutex> guard(record_mutex_);
+            auto it = recorders_.find(id);
+            if (recorders_.end() == it) {
+                return false;
+            }
+            stats = it->second->get_stats();
+            return true;
+        }
+        // enforce the capture_attr::qos classes of all connected inputs, see qos_governor
+        bool start_qos(const qos_config &config) {
+            std::lock_guard<std::mutex> guard(qos_mutex_);
+            if (qos_governor_ != nullptr) {
+                return false;
+            }
+            auto governor = std::make_shared<qos_governor>(config, [this]() { return get_cameras(); });
+            if (!governor->start()) {
+                LOG_E("start qos governor error!");
+                return false;
+            }
+            qos_governor_ = governor;
+            return true;
+        }
+        void stop_qos() {
+            std::shared_ptr<qos_governor> governor;
+            {
+                std::lock_guard<std::mutex> guard(qos_mutex_);
+                governor.swap(qos_governor_);
+            }
+            if (governor != nullptr) {
+                governor->stop();
+            }
+        }
+        bool get_qos_stats(qos_stats &stats) {
+            std::lock_guard<std::mutex> guard(qos_mutex_);
+            if (nullptr == qos_governor_) {
+                return false;
+            }
+            stats = qos_governor_->get_stats();
+            return true;
+        }
+        std::vector<std::shared_ptr<camera_controller>> get_cameras() {
+            std::vector<std::shared_ptr<camera_controller>> cameras;
+            std::lock_guard<std::mutex> guard(connect_mutex_);
+            for (auto &it : camera_handle_map_) {
+                cameras.push_back(it.second);
+            }
+            return cameras;
+        }
         static void qcarcamEventCb(qcarcam_hndl_t hndl, qcarcam_event_t event_id, qcarcam_event_payload_t *p_payload) {
-            auto ptr = G_CAMERA_MANAGER.find_camera_connect(hndl);
+            TRACE_SCOPE("qcarcam_event", event_id);
+            auto ptr = G_CAMERA_MANAGER.enter_callback(hndl);
             if (nullptr == ptr) {
                 LOG_E("not find this hndl:%d", hndl);
                 return;
@@ -123,6 +615,7 @@ namespace qnx_screen_camera {
             default:
                 break;
             }
+            G_CAMERA_MANAGER.leave_callback(hndl);
         }
         void start_capture(qcarcam_hndl_t hndl) {
             auto ptr = find_camera_connect(hndl);
@@ -136,9 +629,77 @@ namespace qnx_screen_camera {
                 ptr->stop_capture();
             }
         }
+    private:
+        void register_camera(const std::shared_ptr<camera_controller> &ptr) {
+            std::lock_guard<std::mutex> guard(connect_mutex_);
+            camera_connect_map_[ptr->get_handle()] = ptr;
+            camera_handle_map_[ptr->get_attr().input_id] = ptr;
+            connecting_.erase(ptr->get_attr().input_id);
+        }
+        // the parked controller of the input if it takes the request, restyled to the new window
+        std::shared_ptr<camera_controller> unpark(const screen_attribute &screenAttr, const capture_attr &capAttr) {
+            std::shared_ptr<camera_controller> ptr;
+            {
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                auto it = parked_map_.find(capAttr.input_id);
+                if (parked_map_.end() == it) {
+                    return nullptr;
+                }
+                ptr = it->second;
+                parked_map_.erase(it);
+            }
+            auto win = ptr->get_window();
+            if (!ptr->reattach(capAttr) ||
+                (!capAttr.headless && (nullptr == win || win->get_display_id() != screenAttr.display_id ||
+                                       !ptr->change_window(screenAttr.window_size, screenAttr.window_pos)))) {
+                LOG_I("standby of camera %d does not match, reopened cold", capAttr.input_id);
+                ptr->close();
+                return nullptr;
+            }
+            return ptr;
+        }
+        std::shared_ptr<camera_controller> enter_callback(qcarcam_hndl_t handle) {
+            std::lock_guard<std::mutex> guard(connect_mutex_);
+            auto controller = camera_connect_map_.find(handle);
+            if (camera_connect_map_.end() == controller) {
+                return nullptr;
+            }
+            ++callbacks_in_flight_[handle];
+            return controller->second;
+        }
+        void leave_callback(qcarcam_hndl_t handle) {
+            {
+                std::lock_guard<std::mutex> guard(connect_mutex_);
+                auto it = callbacks_in_flight_.find(handle);
+                if (it != callbacks_in_flight_.end() && --it->second <= 0) {
+                    callbacks_in_flight_.erase(it);
+                }
+            }
+            callback_cv_.notify_all();
+        }
     private:
         std::map<qcarcam_input_desc_t, qcarcam_input_t>input_src_map_;
         std::map<qcarcam_hndl_t, std::shared_ptr<camera_controller>>camera_connect_map_;
         std::map<int, std::shared_ptr<camera_controller>>camera_handle_map_;
+        std::map<int, std::shared_ptr<camera_controller>>parked_map_;             // < Warm standby by input id
+        std::map<qcarcam_hndl_t, int>callbacks_in_flight_;
+        std::set<int>connecting_;                   // < Input ids being opened or closed outside the maps above
+        std::mutex connect_mutex_;                  // < The maps above, shared with the event callback
+        std::condition_variable callback_cv_;
+        std::mutex sync_mutex_;
+        std::vector<std::shared_ptr<sync_group>>sync_groups_;
+        std::mutex snapshot_mutex_;
+        std::shared_ptr<snapshot_engine> snapshot_engine_;
+        int snapshot_threads_ = 0;
+        jpeg_options snapshot_options_;
+        thread_policy snapshot_policy_;
+        std::mutex diag_mutex_;
+        std::shared_ptr<diagnostics_poller> diag_poller_;
+        std::mutex qos_mutex_;
+        std::shared_ptr<qos_governor> qos_governor_;
+        std::mutex lens_mutex_;
+        std::map<int, std::shared_ptr<lens_monitor>> lens_monitors_;
+        std::mutex record_mutex_;
+        std::map<int, std::shared_ptr<frame_recorder>> recorders_;
     };
 }
\ No newline at end of file
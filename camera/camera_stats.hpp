@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+namespace qnx_screen_camera {
+    struct camera_stats {               // plain snapshot, also sent as is over the control socket
+        uint64_t frames = 0;            // < Frames received from qcarcam_get_frame
+        uint64_t timeouts = 0;          // < qcarcam_get_frame timeouts
+        uint64_t errors = 0;            // < get/release frame failures
+        uint64_t last_seq_no = 0;
+        uint64_t last_timestamp = 0;    // < Monotonic capture timestamp of the last frame (ns)
+        uint64_t last_latency_ns = 0;   // < Capture timestamp to dequeue latency of the last frame
+        uint64_t max_latency_ns = 0;
+        uint64_t dropped = 0;           // < Frames dropped by software decimation
+        int32_t state = -1;             // < camera_state of the controller
+        int32_t decimation = 0;         // < frame_decimation_mode in effect
+        uint64_t deadline_misses = 0;   // < Frames over the capture_attr::deadline_ns latency budget
+        int32_t qos_class = 0;          // < camera_qos_class
+        int32_t qos_divisor = 1;        // < One frame kept in qos_divisor while the qos governor throttles
+        uint64_t csi_errors = 0;        // < Driver diagnostics, counted while the diagnostics poller runs
+        uint64_t ife_overflows = 0;
+        uint64_t driver_drops = 0;
+        uint64_t driver_errors = 0;
+        uint64_t posts = 0;             // < Buffers posted to the window
+        uint64_t hidden_skips = 0;      // < Frames not posted because the window was hidden
+        uint64_t open_ns = 0;           // < create_camera_connect of the current connection, cold or warm
+        uint64_t park_ns = 0;           // < destroy_camera_connect of the last park into warm standby, 0 if never
+        uint64_t warm_opens = 0;        // < Connections served from warm standby
+    };
+}
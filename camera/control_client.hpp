@@ -0,0 +1,90 @@
+#pragma once
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include "control_protocol.hpp"
+#include "socket_io.hpp"
+#include "color_log.hpp"
+namespace qnx_screen_camera {
+    // client side of control_server, header only and free of qcarcam / screen dependencies
+    class control_client {
+    public:
+        virtual ~control_client() {
+            disconnect();
+        }
+        bool connect(const std::string &path = CONTROL_SOCKET_PATH) {
+            disconnect();
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd_ < 0) {
+                LOG_E("create control socket error:%d", errno);
+                return false;
+            }
+            if (::connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                LOG_E("connect %s error:%d", path.c_str(), errno);
+                disconnect();
+                return false;
+            }
+            return true;
+        }
+        void disconnect() {
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        // send one batch and wait for its replies, replies must hold count entries
+        bool submit(const control_request *requests, uint16_t count, control_reply *replies) {
+            if (fd_ < 0 || count > CTL_MAX_BATCH) {
+                return false;
+            }
+            struct {
+                control_header header;
+                control_request requests[CTL_MAX_BATCH];
+            } batch;
+            batch.header.count = count;
+            batch.header.seq = ++seq_;
+            memcpy(batch.requests, requests, count * sizeof(control_request));
+            if (!send_all(fd_, &batch, sizeof(control_header) + count * sizeof(control_request))) {
+                LOG_E("send control batch error:%d", errno);
+                return false;
+            }
+            control_header header;
+            if (!recv_all(fd_, &header, sizeof(header)) || header.seq != seq_ || header.count != count) {
+                LOG_E("receive control reply error!");
+                return false;
+            }
+            return recv_all(fd_, replies, count * sizeof(control_reply));
+        }
+        bool command(uint8_t opcode, int input_id, int value = 0) {
+            control_request req = make_control_request(opcode, input_id, value);
+            control_reply rep;
+            return submit(&req, 1, &rep) && CTL_STATUS_OK == rep.status;
+        }
+        bool set_frame_rate(int input_id, float fps) {
+            control_request req = make_frame_rate_request(input_id, fps);
+            control_reply rep;
+            return submit(&req, 1, &rep) && CTL_STATUS_OK == rep.status;
+        }
+        // off writes the trace to TRACE_DUMP_PATH on the server side
+        bool set_tracing(bool on) {
+            return command(CTL_OP_TRACE, -1, on ? 1 : 0);
+        }
+        bool query_stats(int input_id, camera_stats &stats) {
+            control_request req = make_control_request(CTL_OP_STATS, input_id);
+            control_reply rep;
+            if (!submit(&req, 1, &rep) || rep.status != CTL_STATUS_OK) {
+                return false;
+            }
+            stats = rep.stats;
+            return true;
+        }
+    private:
+        int fd_ = -1;
+        uint32_t seq_ = 0;
+    };
+}
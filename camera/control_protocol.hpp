@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "camera_stats.hpp"
+namespace qnx_screen_camera {
+    #define CONTROL_SOCKET_PATH "/tmp/qnx_screen_camera.sock"
+    // one batch on the wire: control_header followed by count control_request,
+    // answered by a control_header followed by count control_reply in the same order
+    enum control_param : uint32_t {
+        CTL_MAGIC = 0x43435351,         // "QSCC"
+        CTL_VERSION = 6,
+        CTL_MAX_BATCH = 32,
+    };
+    enum control_opcode : uint8_t {
+        CTL_OP_START = 1,
+        CTL_OP_STOP,
+        CTL_OP_PAUSE,
+        CTL_OP_RESUME,
+        CTL_OP_RESIZE,                  // < rect = { size.x, size.y, pos.x, pos.y } display ratio
+        CTL_OP_VISIBLE,                 // < value = visibility
+        CTL_OP_STATS,
+        CTL_OP_FRAME_RATE,              // < rect[0] = target fps, 0 for the sensor rate
+        CTL_OP_VIEWPORT,                // < rect = { size.x, size.y, pos.x, pos.y } buffer ratio, value = ms
+        CTL_OP_TRACE,                   // < value = 1 starts tracing, 0 stops it and writes TRACE_DUMP_PATH; any input_id
+    };
+    enum control_status : int8_t {
+        CTL_STATUS_OK = 0,
+        CTL_STATUS_FAILED = -1,
+        CTL_STATUS_NO_CAMERA = -2,
+        CTL_STATUS_BAD_OPCODE = -3,
+    };
+    struct control_header {
+        uint32_t magic = CTL_MAGIC;
+        uint16_t version = CTL_VERSION;
+        uint16_t count = 0;             // < Number of records following the header
+        uint32_t seq = 0;               // < Echoed back in the reply
+        uint32_t reserved = 0;
+    };
+    struct control_request {
+        uint8_t opcode = 0;
+        uint8_t reserved[3] = { 0 };
+        int32_t input_id = -1;
+        int32_t value = 0;
+        float rect[4] = { 0 };
+    };
+    struct control_reply {
+        uint8_t opcode = 0;
+        int8_t status = CTL_STATUS_OK;
+        uint8_t reserved[2] = { 0 };
+        int32_t input_id = -1;
+        camera_stats stats;             // < Filled for CTL_OP_STATS
+    };
+    inline control_request make_control_request(uint8_t opcode, int input_id, int value = 0) {
+        control_request req;
+        req.opcode = opcode;
+        req.input_id = input_id;
+        req.value = value;
+        return req;
+    }
+    inline control_request make_resize_request(int input_id, double width, double height, double x, double y) {
+        control_request req = make_control_request(CTL_OP_RESIZE, input_id);
+        req.rect[0] = static_cast<float>(width);
+        req.rect[1] = static_cast<float>(height);
+        req.rect[2] = static_cast<float>(x);
+        req.rect[3] = static_cast<float>(y);
+        return req;
+    }
+    inline control_request make_viewport_request(int input_id, double width, double height, double x, double y,
+                                                 int duration_ms = 0) {
+        control_request req = make_resize_request(input_id, width, height, x, y);
+        req.opcode = CTL_OP_VIEWPORT;
+        req.value = duration_ms;
+        return req;
+    }
+    inline control_request make_frame_rate_request(int input_id, float fps) {
+        control_request req = make_control_request(CTL_OP_FRAME_RATE, input_id);
+        req.rect[0] = fps;
+        return req;
+    }
+}
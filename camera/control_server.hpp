@@ -0,0 +1,303 @@
+#pragma once
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include "control_protocol.hpp"
+#include "socket_io.hpp"
+#include "window_transaction.hpp"
+#include "camera_manager.hpp"
+namespace qnx_screen_camera {
+    // local control plane: HMI / gear services drive the cameras through a unix socket,
+    // every batch is applied with window changes pending and committed by a single flush
+    class control_server {
+    public:
+        virtual ~control_server() {
+            stop();
+        }
+        bool start(const std::string &path = CONTROL_SOCKET_PATH, const thread_policy &policy = thread_policy()) {
+            if (server_thread_ != nullptr) {
+                return true;
+            }
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path)) {
+                LOG_E("control socket path too long:%s", path.c_str());
+                return false;
+            }
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd_ < 0) {
+                LOG_E("create control socket error:%d", errno);
+                return false;
+            }
+            unlink(path.c_str());
+            if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                LOG_E("bind control socket %s error:%d", path.c_str(), errno);
+                close_fds();
+                return false;
+            }
+            if (listen(listen_fd_, CTL_MAX_CLIENTS) < 0) {
+                LOG_E("listen control socket error:%d", errno);
+                close_fds();
+                return false;
+            }
+            if (pipe(wake_pipe_) < 0) {
+                LOG_E("create wake pipe error:%d", errno);
+                close_fds();
+                return false;
+            }
+            path_ = path;
+            server_thread_ = new std::thread([this, policy]() {
+                apply_thread_policy(policy, "ctl_server");
+                this->run();
+            });
+            LOG_I("control server listen on %s", path_.c_str());
+            return true;
+        }
+        void stop() {
+            if (nullptr == server_thread_) {
+                return;
+            }
+            char c = 0;
+            if (write(wake_pipe_[1], &c, 1) < 0) {
+                LOG_E("wake control server error:%d", errno);
+            }
+            if (server_thread_->joinable()) {
+                server_thread_->join();
+            }
+            delete server_thread_;
+            server_thread_ = nullptr;
+            close_fds();
+            unlink(path_.c_str());
+        }
+    private:
+        enum {
+            CTL_MAX_CLIENTS = 8,
+            CTL_MAX_OUTBOX_BATCHES = 4,         // < Replies a client may leave unread before it is dropped
+        };
+        // bytes of a client's next batch received so far, requests run once the batch is complete;
+        // replies wait in the outbox until the socket takes them
+        struct control_peer {
+            std::vector<uint8_t> inbox;
+            std::vector<uint8_t> outbox;
+        };
+        void run() {
+            std::vector<struct pollfd> fds;
+            std::vector<control_peer> peers;        // < peers[i] belongs to fds[i + 2]
+            fds.push_back({ wake_pipe_[0], POLLIN, 0 });
+            fds.push_back({ listen_fd_, POLLIN, 0 });
+            while (true) {
+                // a full table leaves new connections in the listen backlog instead of waking poll for them
+                fds[1].events = fds.size() < CTL_MAX_CLIENTS + 2 ? POLLIN : 0;
+                for (size_t i = 2;i < fds.size();++i) {
+                    fds[i].events = POLLIN | (peers[i - 2].outbox.empty() ? 0 : POLLOUT);
+                }
+                int rc = poll(fds.data(), fds.size(), -1);
+                if (rc < 0) {
+                    if (EINTR == errno) {
+                        continue;
+                    }
+                    LOG_E("control server poll error:%d", errno);
+                    break;
+                }
+                if (fds[0].revents) {
+                    break;
+                }
+                if (fds[1].revents & POLLIN) {
+                    int client = accept(listen_fd_, nullptr, nullptr);
+                    if (client >= 0) {
+                        int flags = fcntl(client, F_GETFL, 0);
+                        if (flags < 0 || fcntl(client, F_SETFL, flags | O_NONBLOCK) < 0) {
+                            LOG_E("set control client non-blocking error:%d", errno);
+                            close(client);
+                        }
+                        else {
+                            fds.push_back({ client, POLLIN, 0 });
+                            peers.push_back(control_peer());
+                        }
+                    }
+                }
+                for (size_t i = 2;i < fds.size();) {
+                    if (fds[i].revents && !serve(fds[i].fd, fds[i].revents, peers[i - 2])) {
+                        close(fds[i].fd);
+                        fds.erase(fds.begin() + i);
+                        peers.erase(peers.begin() + (i - 2));
+                        continue;
+                    }
+                    ++i;
+                }
+            }
+            for (size_t i = 2;i < fds.size();++i) {
+                close(fds[i].fd);
+            }
+        }
+        // takes what the client sent and sends what its socket accepts without waiting for the rest,
+        // so a client stalled inside a batch or behind on its replies never holds up the others;
+        // false drops the client
+        bool serve(int fd, short revents, control_peer &peer) {
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!receive(fd, peer)) {
+                    return false;
+                }
+            }
+            while (!peer.outbox.empty()) {
+                ssize_t n = send(fd, peer.outbox.data(), peer.outbox.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n < 0 && EINTR == errno) {
+                    continue;
+                }
+                if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                    break;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                peer.outbox.erase(peer.outbox.begin(), peer.outbox.begin() + n);
+            }
+            const size_t max_outbox = CTL_MAX_OUTBOX_BATCHES * (sizeof(control_header) + CTL_MAX_BATCH * sizeof(control_reply));
+            if (peer.outbox.size() > max_outbox) {
+                LOG_E("control client fd:%d does not read its replies, %zu bytes queued", fd, peer.outbox.size());
+                return false;
+            }
+            return true;
+        }
+        bool receive(int fd, control_peer &peer) {
+            const size_t max_batch = sizeof(control_header) + CTL_MAX_BATCH * sizeof(control_request);
+            size_t used = peer.inbox.size();
+            peer.inbox.resize(max_batch);
+            ssize_t n = recv(fd, peer.inbox.data() + used, max_batch - used, MSG_DONTWAIT);
+            if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)) {
+                n = 0;
+            }
+            else if (n <= 0) {
+                return false;
+            }
+            used += static_cast<size_t>(n);
+            peer.inbox.resize(used);
+            size_t offset = 0;
+            while (used - offset >= sizeof(control_header)) {
+                control_header header;
+                memcpy(&header, peer.inbox.data() + offset, sizeof(header));
+                if (header.magic != CTL_MAGIC || header.version != CTL_VERSION || header.count > CTL_MAX_BATCH) {
+                    LOG_E("bad control header magic:0x%x version:%d count:%d", header.magic, header.version, header.count);
+                    return false;
+                }
+                size_t size = sizeof(header) + header.count * sizeof(control_request);
+                if (used - offset < size) {
+                    break;
+                }
+                control_request requests[CTL_MAX_BATCH];
+                memcpy(requests, peer.inbox.data() + offset + sizeof(header), header.count * sizeof(control_request));
+                offset += size;
+                control_reply replies[CTL_MAX_BATCH];
+                execute(requests, header.count, replies);
+                const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+                peer.outbox.insert(peer.outbox.end(), bytes, bytes + sizeof(header));
+                bytes = reinterpret_cast<const uint8_t *>(replies);
+                peer.outbox.insert(peer.outbox.end(), bytes, bytes + header.count * sizeof(control_reply));
+            }
+            peer.inbox.erase(peer.inbox.begin(), peer.inbox.begin() + offset);
+            return true;
+        }
+        void execute(const control_request *requests, int count, control_reply *replies) {
+            window_transaction txn;
+            std::vector<int> deferred;              // replies decided by the transaction commit
+            for (int i = 0;i < count;++i) {
+                const control_request &req = requests[i];
+                control_reply &rep = replies[i];
+                rep.opcode = req.opcode;
+                rep.input_id = req.input_id;
+                if (CTL_OP_TRACE == req.opcode) {       // process wide, no camera involved
+                    if (req.value) {
+                        G_TRACER.start();
+                    }
+                    else {
+                        G_TRACER.stop();
+                    }
+                    rep.status = req.value || G_TRACER.dump() ? CTL_STATUS_OK : CTL_STATUS_FAILED;
+                    continue;
+                }
+                auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(req.input_id);
+                if (nullptr == ptr) {
+                    rep.status = CTL_STATUS_NO_CAMERA;
+                    continue;
+                }
+                auto win = ptr->get_window();
+                bool ok = true;
+                switch (req.opcode) {
+                case CTL_OP_START:
+                    ok = ptr->control_command(CAM_CMD_START, false);
+                    txn.touch(win);
+                    break;
+                case CTL_OP_STOP:
+                    ok = ptr->control_command(CAM_CMD_STOP, false);
+                    txn.touch(win);
+                    break;
+                case CTL_OP_PAUSE:
+                    ok = ptr->control_command(CAM_CMD_PAUSE, false);
+                    break;
+                case CTL_OP_RESUME:
+                    ok = ptr->control_command(CAM_CMD_RESUME, false);
+                    break;
+                case CTL_OP_RESIZE:
+                    ok = win != nullptr;        // headless inputs have no window
+                    if (ok) {
+                        txn.set_size(win, { req.rect[0], req.rect[1] }).set_position(win, { req.rect[2], req.rect[3] });
+                        deferred.push_back(i);
+                    }
+                    break;
+                case CTL_OP_VISIBLE:
+                    ok = win != nullptr;
+                    if (ok) {
+                        txn.set_visible(win, req.value);
+                        deferred.push_back(i);
+                    }
+                    break;
+                case CTL_OP_STATS:
+                    rep.stats = ptr->get_stats();
+                    break;
+                case CTL_OP_VIEWPORT:
+                    ok = ptr->set_viewport({ req.rect[2], req.rect[3] }, { req.rect[0], req.rect[1] }, req.value, &txn);
+                    if (ok && req.value <= 0) {
+                        deferred.push_back(i);
+                    }
+                    break;
+                case CTL_OP_FRAME_RATE:
+                    ok = ptr->set_frame_rate(req.rect[0]);
+                    break;
+                default:
+                    rep.status = CTL_STATUS_BAD_OPCODE;
+                    continue;
+                }
+                rep.status = ok ? CTL_STATUS_OK : CTL_STATUS_FAILED;
+            }
+            if (!txn.commit()) {
+                for (int i : deferred) {
+                    replies[i].status = CTL_STATUS_FAILED;
+                }
+            }
+        }
+        void close_fds() {
+            if (listen_fd_ >= 0) {
+                close(listen_fd_);
+                listen_fd_ = -1;
+            }
+            for (int i = 0;i < 2;++i) {
+                if (wake_pipe_[i] >= 0) {
+                    close(wake_pipe_[i]);
+                    wake_pipe_[i] = -1;
+                }
+            }
+        }
+    private:
+        std::string path_;
+        int listen_fd_ = -1;
+        int wake_pipe_[2] = { -1, -1 };
+        std::thread *server_thread_ = nullptr;
+    };
+}
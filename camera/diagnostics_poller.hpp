@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "qcarcam.h"
+#include "clock.hpp"
+#include "color_log.hpp"
+#include "thread_policy.hpp"
+namespace qnx_screen_camera {
+    enum diag_param : int {
+        DIAG_RESERVED_INPUTS = 16,      // < Sample slots allocated up front, more grow on the first poll
+    };
+    struct driver_counters {            // cumulative driver side counters of one input
+        int input_id = -1;
+        uint64_t csi_errors = 0;        // < CSI PHY / CRC / ECC errors
+        uint64_t ife_overflows = 0;     // < IFE write master overflows
+        uint64_t frame_drops = 0;       // < Frames the driver dropped
+        uint64_t other_errors = 0;
+    };
+    // fills out from the qcarcam_query_diagnostics buffer; the layout belongs to the driver release,
+    // so the integration that knows it provides the decoder
+    using diag_decoder = std::function<bool(const void *info, size_t size, std::vector<driver_counters> &out)>;
+    // called with the increase since the previous sample, never from a capture thread
+    using diag_sink = std::function<void(const driver_counters &delta)>;
+    struct diag_config {
+        int interval_ms = 1000;
+        size_t buffer_size = 16384;     // < Handed to qcarcam_query_diagnostics, allocated once
+        thread_policy policy;           // < Default scheduling, below every capture thread
+    };
+    // low rate poller of the driver diagnostics: one preallocated buffer, no lock shared with capture,
+    // its own CPU time is measured per poll
+    class diagnostics_poller {
+    public:
+        diagnostics_poller(const diag_config &config, const diag_decoder &decoder, const diag_sink &sink)
+            : config_(config), decoder_(decoder), sink_(sink) {
+        }
+        virtual ~diagnostics_poller() {
+            stop();
+        }
+        bool start() {
+            if (worker_ != nullptr || !decoder_ || !sink_ || config_.interval_ms <= 0 || 0 == config_.buffer_size) {
+                return false;
+            }
+            buffer_.assign(config_.buffer_size, 0);
+            samples_.reserve(DIAG_RESERVED_INPUTS);
+            previous_.reserve(DIAG_RESERVED_INPUTS);
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(config_.policy, "diag");
+                this->run();
+            });
+            return true;
+        }
+        void stop() {
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            LOG_I("diagnostics: %llu polls, %.1f us cpu each", (unsigned long long)polls_.load(),
+                  polls_ ? cpu_ns_ / 1e3 / polls_ : 0.0);
+        }
+        inline uint64_t polls() const {
+            return polls_;
+        }
+        inline uint64_t failures() const {
+            return failures_;
+        }
+        inline double last_poll_cpu_us() const {
+            return last_cpu_ns_ / 1e3;
+        }
+        inline double average_poll_cpu_us() const {
+            uint64_t polls = polls_;
+            return polls ? cpu_ns_ / 1e3 / polls : 0.0;
+        }
+    private:
+        void run() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait_for(lk, std::chrono::milliseconds(config_.interval_ms), [this]() { return !keep_running_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                }
+                uint64_t begin = thread_cpu_ns();
+                poll();
+                last_cpu_ns_ = thread_cpu_ns() - begin;
+                cpu_ns_ += last_cpu_ns_;
+                ++polls_;
+            }
+        }
+        void poll() {
+            qcarcam_ret_t ret = qcarcam_query_diagnostics(buffer_.data(), static_cast<unsigned int>(buffer_.size()));
+            samples_.clear();
+            if (ret != QCARCAM_RET_OK || !decoder_(buffer_.data(), buffer_.size(), samples_)) {
+                if (0 == failures_++) {
+                    LOG_E("query diagnostics failed %d", ret);
+                }
+                return;
+            }
+            for (auto &sample : samples_) {
+                driver_counters *last = nullptr;
+                for (auto &prev : previous_) {
+                    if (prev.input_id == sample.input_id) {
+                        last = &prev;
+                        break;
+                    }
+                }
+                if (nullptr == last) {      // the first sample of an input is the baseline
+                    previous_.push_back(sample);
+                    continue;
+                }
+                driver_counters delta;
+                delta.input_id = sample.input_id;
+                delta.csi_errors = increase(last->csi_errors, sample.csi_errors);
+                delta.ife_overflows = increase(last->ife_overflows, sample.ife_overflows);
+                delta.frame_drops = increase(last->frame_drops, sample.frame_drops);
+                delta.other_errors = increase(last->other_errors, sample.other_errors);
+                *last = sample;
+                if (delta.csi_errors || delta.ife_overflows || delta.frame_drops || delta.other_errors) {
+                    sink_(delta);
+                }
+            }
+        }
+        // a counter below its last value was reset by the driver, all of it is new
+        static inline uint64_t increase(uint64_t last, uint64_t now) {
+            return now >= last ? now - last : now;
+        }
+        static inline uint64_t thread_cpu_ns() {
+            struct timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+        }
+    private:
+        diag_config config_;
+        diag_decoder decoder_;
+        diag_sink sink_;
+        std::vector<uint8_t> buffer_;
+        std::vector<driver_counters> samples_;
+        std::vector<driver_counters> previous_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        std::atomic<uint64_t> polls_{0};
+        std::atomic<uint64_t> failures_{0};
+        std::atomic<uint64_t> cpu_ns_{0};
+        std::atomic<uint64_t> last_cpu_ns_{0};
+    };
+}
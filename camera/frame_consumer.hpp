@@ -0,0 +1,126 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    // runs an analysis stage off the capture thread: the listener only holds the newest frame
+    // in a single slot (an unprocessed older one is released at once), the worker processes it
+    // and gives the buffer back, so a slow consumer costs frames of its own, never capture buffers
+    class frame_consumer {
+    public:
+        // min_interval_ns > 0 samples at most one frame per interval of capture time
+        frame_consumer(const std::shared_ptr<camera_controller> &camera, const std::string &role,
+                       uint64_t min_interval_ns = 0)
+            : camera_(camera), role_(role), min_interval_ns_(min_interval_ns) {
+        }
+        // derived classes must call stop() in their own destructor, process() is virtual
+        virtual ~frame_consumer() {
+            stop();
+        }
+        bool start() {
+            if (worker_ != nullptr || !camera_) {
+                return false;
+            }
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(camera_->get_attr().thread_attr, camera_->thread_name(role_.c_str()));
+                this->run();
+            });
+            listener_id_ = camera_->add_frame_listener([this](const camera_frame &frame) {
+                this->on_frame(frame);
+            });
+            return true;
+        }
+        void stop() {
+            if (nullptr == worker_) {
+                return;
+            }
+            camera_->remove_frame_listener(listener_id_);
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            if (has_pending_) {
+                camera_->release_frame(pending_.idx);
+                has_pending_ = false;
+            }
+        }
+        inline uint64_t processed() const {
+            return processed_;
+        }
+        inline uint64_t skipped() const {
+            return skipped_;
+        }
+    protected:
+        virtual void process(const camera_frame &frame) = 0;
+        inline const std::shared_ptr<camera_controller> &camera() const {
+            return camera_;
+        }
+    private:
+        void on_frame(const camera_frame &frame) {
+            if (min_interval_ns_ && last_sample_ns_ && frame.timestamp < last_sample_ns_ + min_interval_ns_) {
+                return;
+            }
+            if (!camera_->hold_frame(frame.idx)) {
+                return;
+            }
+            last_sample_ns_ = frame.timestamp;
+            unsigned int stale = 0;
+            bool has_stale = false;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (has_pending_) {
+                    stale = pending_.idx;
+                    has_stale = true;
+                    ++skipped_;
+                }
+                pending_ = frame;
+                has_pending_ = true;
+            }
+            if (has_stale) {
+                camera_->release_frame(stale);
+            }
+            cv_.notify_one();
+        }
+        void run() {
+            while (true) {
+                camera_frame frame;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || has_pending_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                    frame = pending_;
+                    has_pending_ = false;
+                }
+                process(frame);
+                ++processed_;
+                camera_->release_frame(frame.idx);
+            }
+        }
+    private:
+        std::shared_ptr<camera_controller> camera_;
+        std::string role_;
+        uint64_t min_interval_ns_ = 0;
+        uint64_t last_sample_ns_ = 0;           // only touched by the capture thread
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        camera_frame pending_;
+        bool has_pending_ = false;
+        bool keep_running_ = false;
+        int listener_id_ = -1;
+        std::thread *worker_ = nullptr;
+        std::atomic<uint64_t> processed_{0};
+        std::atomic<uint64_t> skipped_{0};
+    };
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include "qcarcam_types.h"
+namespace qnx_screen_camera {
+    enum frame_decimation_mode : int32_t {
+        DECIMATION_NONE = 0,            // < Every sensor frame is delivered
+        DECIMATION_ISP,                 // < Dropped in the ISP by a QCARCAM_FRAMEDROP_MANUAL pattern
+        DECIMATION_SOFTWARE,            // < Dequeued and handed back at once by the capture thread
+    };
+    enum frame_drop_param : int {
+        FRAME_DROP_MAX_PERIOD = 31,     // < Largest frame_drop_period qcarcam accepts
+    };
+    // ISP drop pattern closest to target_fps: keep k of every period frames, bit i of the pattern
+    // keeps frame i of a period, kept frames spread evenly so the output cadence stays regular
+    inline qcarcam_frame_rate_t make_frame_drop_pattern(float sensor_fps, float target_fps) {
+        qcarcam_frame_rate_t config;
+        config.frame_drop_mode = QCARCAM_KEEP_ALL_FRAMES;
+        config.frame_drop_period = 0;
+        config.frame_drop_pattern = 0;
+        if (sensor_fps <= 0 || target_fps <= 0 || target_fps >= sensor_fps) {
+            return config;
+        }
+        double ratio = target_fps / sensor_fps;
+        int best_period = 1, best_keep = 1;
+        double best_error = 2.0;
+        for (int period = 1;period <= FRAME_DROP_MAX_PERIOD;++period) {
+            int keep = static_cast<int>(ratio * period + 0.5);
+            if (keep < 1) {
+                keep = 1;
+            }
+            double error = fabs(static_cast<double>(keep) / period - ratio);
+            if (error < best_error - 1e-9) {        // shortest period wins a tie
+                best_error = error;
+                best_period = period;
+                best_keep = keep;
+            }
+        }
+        if (best_keep >= best_period) {
+            return config;
+        }
+        config.frame_drop_mode = QCARCAM_FRAMEDROP_MANUAL;
+        config.frame_drop_period = static_cast<unsigned char>(best_period);
+        for (int i = 0;i < best_period;++i) {
+            if ((i + 1) * best_keep / best_period > i * best_keep / best_period) {
+                config.frame_drop_pattern |= 1u << i;
+            }
+        }
+        return config;
+    }
+    // fallback when the ISP rejects the pattern: keeps a frame once the previous kept one is an
+    // interval old, with a quarter interval of slack for timestamp jitter; capture thread only
+    class frame_decimator {
+    public:
+        bool keep(uint64_t timestamp, uint64_t interval_ns) {
+            if (0 == interval_ns) {
+                next_due_ = 0;
+                return true;
+            }
+            if (next_due_ != 0 && timestamp + interval_ns / 4 < next_due_) {
+                return false;
+            }
+            // stay on the cadence unless we fell a whole interval behind (pause, lost signal)
+            next_due_ = (next_due_ != 0 && timestamp < next_due_ + interval_ns) ? next_due_ + interval_ns
+                                                                              : timestamp + interval_ns;
+            return true;
+        }
+    private:
+        uint64_t next_due_ = 0;
+    };
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_share.hpp"
+#include "socket_io.hpp"
+#include "thread_policy.hpp"
+namespace qnx_screen_camera {
+    // publishes captured buffers to other processes without copying:
+    // readers receive the ring and buffer descriptors once, then follow the ring lock free.
+    // Screen buffers with neither a descriptor nor a physical address (on a development host) are
+    // copied into a shared memory twin on publish instead, only while a reader is connected
+    class frame_exporter {
+    public:
+        virtual ~frame_exporter() {
+            stop();
+            for (int fd : readers_) {
+                close(fd);
+            }
+            readers_.clear();
+            for (auto &twin : twins_) {
+                if (twin.addr != nullptr) {
+                    munmap(twin.addr, twin.size);
+                }
+                if (twin.fd >= 0) {
+                    close(twin.fd);
+                }
+            }
+            twins_.clear();
+            if (header_ != nullptr) {
+                munmap(header_, sizeof(frame_share_header));
+                header_ = nullptr;
+            }
+            if (ring_fd_ >= 0) {
+                close(ring_fd_);
+                ring_fd_ = -1;
+            }
+        }
+        bool init(unsigned int n_buffers) {
+            if (n_buffers > FRAME_SHARE_MAX_BUFFERS) {
+                LOG_E("too many buffers to export:%u", n_buffers);
+                return false;
+            }
+            ring_fd_ = create_anon_shm("frame_ring", sizeof(frame_share_header));
+            if (ring_fd_ < 0) {
+                return false;
+            }
+            void *addr = mmap(nullptr, sizeof(frame_share_header), PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd_, 0);
+            if (MAP_FAILED == addr) {
+                LOG_E("map frame ring error:%d", errno);
+                return false;
+            }
+            memset(addr, 0, sizeof(frame_share_header));
+            header_ = static_cast<frame_share_header *>(addr);
+            header_->magic = FRAME_SHARE_MAGIC;
+            header_->version = FRAME_SHARE_VERSION;
+            header_->n_buffers = n_buffers;
+            header_->n_slots = FRAME_SHARE_SLOTS;
+            for (unsigned int i = 0;i < FRAME_SHARE_SLOTS;++i) {
+                header_->slots[i].seq.store(0, std::memory_order_relaxed);
+            }
+            header_->head.store(0, std::memory_order_release);
+            buffer_fds_.assign(n_buffers, -1);
+            twins_.assign(n_buffers, buffer_twin());
+            return true;
+        }
+        // describe buffer idx, fd may be -1 when only the physical address can be shared; with neither,
+        // screen_data (the CPU mapping of a Screen buffer) is copied to a twin readers can map
+        bool add_buffer(unsigned int idx, int fd, uint64_t phys_addr, uint32_t size, uint32_t stride,
+                        const uint8_t *screen_data = nullptr) {
+            if (nullptr == header_ || idx >= header_->n_buffers) {
+                return false;
+            }
+            frame_share_buffer &buf = header_->buffers[idx];
+            buf.phys_addr = phys_addr;
+            buf.size = size;
+            buf.stride = stride;
+            buffer_fds_[idx] = fd;
+            if (fd < 0 && 0 == phys_addr && screen_data != nullptr && size > 0) {
+                buffer_twin &twin = twins_[idx];
+                twin.fd = create_anon_shm("frame_twin", size);
+                if (twin.fd < 0) {
+                    return false;
+                }
+                void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, twin.fd, 0);
+                if (MAP_FAILED == addr) {
+                    LOG_E("map frame twin %u error:%d", idx, errno);
+                    close(twin.fd);
+                    twin.fd = -1;
+                    return false;
+                }
+                twin.addr = static_cast<uint8_t *>(addr);
+                twin.source = screen_data;
+                twin.size = size;
+                buffer_fds_[idx] = twin.fd;
+            }
+            return true;
+        }
+        bool start(const std::string &path, const thread_policy &policy = thread_policy()) {
+            if (nullptr == header_ || listen_thread_ != nullptr) {
+                return false;
+            }
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd_ < 0) {
+                LOG_E("create export socket error:%d", errno);
+                return false;
+            }
+            unlink(path.c_str());
+            if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd_, 4) < 0) {
+                LOG_E("listen on %s error:%d", path.c_str(), errno);
+                close(listen_fd_);
+                listen_fd_ = -1;
+                return false;
+            }
+            if (pipe(wake_pipe_) < 0) {
+                LOG_E("create wake pipe error:%d", errno);
+                close(listen_fd_);
+                listen_fd_ = -1;
+                return false;
+            }
+            path_ = path;
+            listen_thread_ = new std::thread([this, policy]() {
+                apply_thread_policy(policy, "frame_export");
+                this->run();
+            });
+            LOG_I("frame exporter listen on %s", path_.c_str());
+            return true;
+        }
+        void stop() {
+            if (nullptr == listen_thread_) {
+                return;
+            }
+            char c = 0;
+            if (write(wake_pipe_[1], &c, 1) < 0) {
+                LOG_E("wake frame exporter error:%d", errno);
+            }
+            if (listen_thread_->joinable()) {
+                listen_thread_->join();
+            }
+            delete listen_thread_;
+            listen_thread_ = nullptr;
+            close(listen_fd_);
+            listen_fd_ = -1;
+            close(wake_pipe_[0]);
+            close(wake_pipe_[1]);
+            wake_pipe_[0] = wake_pipe_[1] = -1;
+            unlink(path_.c_str());
+        }
+        // called on the capture thread, wait free: never blocks on readers
+        void publish(uint32_t idx, uint64_t seq_no, uint64_t timestamp,
+                     uint32_t width, uint32_t height, uint32_t stride, uint32_t format) {
+            if (nullptr == header_) {
+                return;
+            }
+            if (idx < twins_.size() && twins_[idx].addr != nullptr && readers_connected_.load(std::memory_order_relaxed) > 0) {
+                // the twin of idx was last published n_buffers frames ago, readers treat it as reused by now
+                memcpy(twins_[idx].addr, twins_[idx].source, twins_[idx].size);
+            }
+            uint64_t count = header_->head.load(std::memory_order_relaxed);
+            frame_share_slot &slot = header_->slots[count & (FRAME_SHARE_SLOTS - 1)];
+            uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+            slot.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.idx = idx;
+            slot.seq_no = seq_no;
+            slot.timestamp = timestamp;
+            slot.width = width;
+            slot.height = height;
+            slot.stride = stride;
+            slot.format = format;
+            slot.frame_count = count + 1;
+            slot.seq.store(seq + 2, std::memory_order_release);
+            header_->head.store(count + 1, std::memory_order_release);
+        }
+        // connected reader processes
+        inline int readers() const {
+            return readers_connected_.load(std::memory_order_relaxed);
+        }
+    private:
+        // readers keep their connection while they follow the ring, its hangup tells they are gone
+        void run() {
+            std::vector<struct pollfd> fds;
+            while (true) {
+                fds.clear();
+                fds.push_back({ wake_pipe_[0], POLLIN, 0 });
+                fds.push_back({ listen_fd_, POLLIN, 0 });
+                for (int fd : readers_) {
+                    fds.push_back({ fd, POLLIN, 0 });
+                }
+                int rc = poll(fds.data(), fds.size(), -1);
+                if (rc < 0) {
+                    if (EINTR == errno) {
+                        continue;
+                    }
+                    LOG_E("frame exporter poll error:%d", errno);
+                    break;
+                }
+                if (fds[0].revents) {
+                    break;
+                }
+                for (size_t i = fds.size();i-- > 2;) {
+                    if (0 == fds[i].revents) {
+                        continue;
+                    }
+                    char c = 0;
+                    ssize_t n = recv(fds[i].fd, &c, 1, MSG_DONTWAIT);
+                    if (0 == n || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        close(fds[i].fd);
+                        readers_.erase(readers_.begin() + (i - 2));
+                        readers_connected_.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+                if (fds[1].revents & POLLIN) {
+                    int client = accept(listen_fd_, nullptr, nullptr);
+                    if (client < 0) {
+                        continue;
+                    }
+                    // twins went stale while nobody read them: counted first so the capture thread copies from
+                    // now on, then refreshed once here for the frames already in the ring
+                    readers_connected_.fetch_add(1, std::memory_order_relaxed);
+                    for (auto &twin : twins_) {
+                        if (twin.addr != nullptr) {
+                            memcpy(twin.addr, twin.source, twin.size);
+                        }
+                    }
+                    if (send_descriptors(client)) {
+                        readers_.push_back(client);
+                    }
+                    else {
+                        close(client);
+                        readers_connected_.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+        // hand the ring and all buffer fds to a new reader
+        bool send_descriptors(int client) {
+            std::vector<int> fds;
+            fds.push_back(ring_fd_);
+            for (unsigned int i = 0;i < buffer_fds_.size();++i) {
+                header_->buffers[i].fd_index = buffer_fds_[i] >= 0 ? static_cast<int32_t>(fds.size()) : -1;
+                if (buffer_fds_[i] >= 0) {
+                    fds.push_back(buffer_fds_[i]);
+                }
+            }
+            frame_share_hello hello;
+            hello.n_fds = fds.size();
+            if (!send_with_fds(client, &hello, sizeof(hello), fds.data(), fds.size())) {
+                LOG_E("send frame descriptors error:%d", errno);
+                return false;
+            }
+            return true;
+        }
+    private:
+        struct buffer_twin {
+            int fd = -1;
+            uint8_t *addr = nullptr;
+            const uint8_t *source = nullptr;
+            uint32_t size = 0;
+        };
+    private:
+        frame_share_header *header_ = nullptr;
+        int ring_fd_ = -1;
+        std::vector<int> buffer_fds_;
+        std::vector<buffer_twin> twins_;            // < By buffer index, addr nullptr for buffers shared as is
+        std::vector<int> readers_;                  // < Connections of the readers, exporter thread only
+        std::atomic<int> readers_connected_{0};
+        std::string path_;
+        int listen_fd_ = -1;
+        int wake_pipe_[2] = { -1, -1 };
+        std::thread *listen_thread_ = nullptr;
+    };
+}
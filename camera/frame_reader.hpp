@@ -0,0 +1,198 @@
+#pragma once
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include "frame_share.hpp"
+#include "socket_io.hpp"
+namespace qnx_screen_camera {
+    struct frame_view {
+        const uint8_t *data = nullptr;      // < Mapped buffer, nullptr if the buffer could not be mapped
+        uint32_t idx = 0;
+        uint64_t seq_no = 0;
+        uint64_t timestamp = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        uint32_t format = 0;
+        uint64_t frame_count = 0;           // < Position in the stream, pass it back to next()
+    };
+    // consumer side of frame_exporter, never writes to the ring so it cannot stall the capture thread
+    class frame_reader {
+    public:
+        virtual ~frame_reader() {
+            disconnect();
+        }
+        bool connect(const std::string &path) {
+            disconnect();
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (sock < 0) {
+                LOG_E("create socket error:%d", errno);
+                return false;
+            }
+            if (::connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                LOG_E("connect %s error:%d", path.c_str(), errno);
+                close(sock);
+                return false;
+            }
+            frame_share_hello hello;
+            int fds[FRAME_SHARE_MAX_BUFFERS + 1];
+            int nfds = 0;
+            bool ok = recv_with_fds(sock, &hello, sizeof(hello), fds, FRAME_SHARE_MAX_BUFFERS + 1, nfds);
+            sock_ = sock;                   // held open while reading, the exporter copies twins only for connected readers
+            fds_.assign(fds, fds + nfds);
+            if (!ok || hello.magic != FRAME_SHARE_MAGIC || hello.version != FRAME_SHARE_VERSION || nfds < 1 ||
+                hello.ring_size != sizeof(frame_share_header) || hello.n_fds != static_cast<uint32_t>(nfds)) {
+                LOG_E("bad frame share hello from %s", path.c_str());
+                disconnect();
+                return false;
+            }
+            void *addr_ring = mmap(nullptr, sizeof(frame_share_header), PROT_READ, MAP_SHARED, fds_[0], 0);
+            if (MAP_FAILED == addr_ring) {
+                LOG_E("map frame ring error:%d", errno);
+                disconnect();
+                return false;
+            }
+            header_ = static_cast<const frame_share_header *>(addr_ring);
+            // every buffer fd the ring announces must have arrived, none more
+            int announced = 1;
+            for (unsigned int i = 0;i < header_->n_buffers && i < FRAME_SHARE_MAX_BUFFERS;++i) {
+                if (header_->buffers[i].fd_index >= 0) {
+                    ++announced;
+                }
+            }
+            if (header_->n_buffers > FRAME_SHARE_MAX_BUFFERS || announced != nfds) {
+                LOG_E("frame share of %u buffers sent %d descriptors for %d", header_->n_buffers, nfds, announced);
+                disconnect();
+                return false;
+            }
+            buffers_.assign(header_->n_buffers, mapping());
+            for (unsigned int i = 0;i < header_->n_buffers;++i) {
+                map_buffer(i);
+            }
+            return true;
+        }
+        void disconnect() {
+            for (auto &buf : buffers_) {
+                if (buf.addr != nullptr) {
+                    munmap(buf.addr, buf.size);
+                }
+            }
+            buffers_.clear();
+            if (header_ != nullptr) {
+                munmap(const_cast<frame_share_header *>(header_), sizeof(frame_share_header));
+                header_ = nullptr;
+            }
+            for (int fd : fds_) {
+                close(fd);
+            }
+            fds_.clear();
+            if (sock_ >= 0) {
+                close(sock_);
+                sock_ = -1;
+            }
+        }
+        // newest published frame
+        bool latest(frame_view &view) const {
+            if (nullptr == header_) {
+                return false;
+            }
+            uint64_t head = header_->head.load(std::memory_order_acquire);
+            return head > 0 && read_slot(head, view);
+        }
+        // frame following last_count, skips ahead to the newest one if the reader fell behind the ring
+        bool next(uint64_t last_count, frame_view &view) const {
+            if (nullptr == header_) {
+                return false;
+            }
+            uint64_t head = header_->head.load(std::memory_order_acquire);
+            if (head <= last_count) {
+                return false;
+            }
+            uint64_t want = last_count + 1;
+            if (head - want >= FRAME_SHARE_SLOTS - 1) {
+                want = head;
+            }
+            return read_slot(want, view) || read_slot(header_->head.load(std::memory_order_acquire), view);
+        }
+        bool wait_next(uint64_t last_count, frame_view &view, std::chrono::microseconds timeout,
+                       std::chrono::microseconds poll_interval = std::chrono::microseconds(500)) const {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!next(last_count, view)) {
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(poll_interval);
+            }
+            return true;
+        }
+        // true while the capture side cannot have refilled the buffer behind view yet,
+        // check after consuming view.data and drop the result if it turned false
+        bool still_valid(const frame_view &view) const {
+            uint64_t head = header_->head.load(std::memory_order_acquire);
+            return head + FRAME_SHARE_REUSE_MARGIN < view.frame_count + header_->n_buffers;
+        }
+    private:
+        enum { FRAME_SHARE_REUSE_MARGIN = 2, FRAME_SHARE_READ_RETRY = 8 };
+        struct mapping {
+            void *addr = nullptr;
+            size_t size = 0;
+        };
+        void map_buffer(unsigned int idx) {
+            const frame_share_buffer &buf = header_->buffers[idx];
+            void *addr = MAP_FAILED;
+            if (buf.fd_index > 0 && buf.fd_index < static_cast<int32_t>(fds_.size())) {
+                addr = mmap(nullptr, buf.size, PROT_READ, MAP_SHARED, fds_[buf.fd_index], 0);
+            }
+#ifdef __QNX__
+            else if (buf.phys_addr != 0) {
+                addr = mmap_device_memory(nullptr, buf.size, PROT_READ | PROT_NOCACHE, 0, buf.phys_addr);
+            }
+#endif
+            if (MAP_FAILED == addr) {
+                LOG_W("buffer %u not mapped, frames will carry no data", idx);
+                return;
+            }
+            buffers_[idx].addr = addr;
+            buffers_[idx].size = buf.size;
+        }
+        bool read_slot(uint64_t count, frame_view &view) const {
+            const frame_share_slot &slot = header_->slots[(count - 1) & (FRAME_SHARE_SLOTS - 1)];
+            for (int retry = 0;retry < FRAME_SHARE_READ_RETRY;++retry) {
+                uint32_t seq1 = slot.seq.load(std::memory_order_acquire);
+                if (seq1 & 1) {
+                    continue;
+                }
+                view.idx = slot.idx;
+                view.seq_no = slot.seq_no;
+                view.timestamp = slot.timestamp;
+                view.width = slot.width;
+                view.height = slot.height;
+                view.stride = slot.stride;
+                view.format = slot.format;
+                view.frame_count = slot.frame_count;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != seq1) {
+                    continue;
+                }
+                if (view.frame_count != count || view.idx >= buffers_.size()) {
+                    return false;       // slot already reused for a newer frame
+                }
+                view.data = static_cast<const uint8_t *>(buffers_[view.idx].addr);
+                return true;
+            }
+            return false;
+        }
+    private:
+        const frame_share_header *header_ = nullptr;
+        std::vector<int> fds_;
+        int sock_ = -1;
+        std::vector<mapping> buffers_;
+    };
+}
@@ -0,0 +1,371 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "clock.hpp"
+#include "thread_pool.hpp"
+#include "frame_codec.hpp"
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    enum recording_param : uint32_t {
+        RECORDING_MAGIC = 0x52435351,       // < "QSCR", file header
+        RECORDING_FRAME_MAGIC = 0x4d524651, // < "QFRM", in front of every frame
+        RECORDING_INDEX_MAGIC = 0x58444951, // < "QIDX", trailer at the very end
+        RECORDING_VERSION = 1,
+    };
+    // a recording is the file header, frame records (header + coded frame) in capture order and, once
+    // closed, the index of all frames and a trailer pointing at it. Every record names its size, so a
+    // file cut short by a power loss is still read by walking the records
+    struct recording_header {
+        uint32_t magic = RECORDING_MAGIC;
+        uint32_t version = RECORDING_VERSION;
+        uint32_t codec_version = CODEC_VERSION;
+        uint32_t reserved = 0;
+    };
+    struct recording_frame_header {
+        uint32_t magic = RECORDING_FRAME_MAGIC;
+        int32_t input_id = -1;
+        uint32_t seq_no = 0;
+        uint32_t size = 0;                  // < Bytes of the coded frame that follows
+        uint64_t timestamp = 0;
+    };
+    struct recording_index_entry {
+        uint64_t offset = 0;                // < File offset of the recording_frame_header
+        uint64_t timestamp = 0;
+        uint32_t seq_no = 0;
+        uint32_t size = 0;
+    };
+    struct recording_trailer {
+        uint32_t magic = RECORDING_INDEX_MAGIC;
+        uint32_t frames = 0;
+        uint64_t index_offset = 0;
+    };
+    static_assert(16 == sizeof(recording_header), "recording_header is stored as is");
+    static_assert(24 == sizeof(recording_frame_header), "recording_frame_header is stored as is");
+    static_assert(24 == sizeof(recording_index_entry), "recording_index_entry is stored as is");
+    static_assert(16 == sizeof(recording_trailer), "recording_trailer is stored as is");
+    struct recorder_config {
+        int threads = 0;                    // < Coding threads, 0 picks up to 4 by the cores
+        int slice_rows = CODEC_SLICE_ROWS;
+        int max_in_flight = 4;              // < Frames pinned or coded but not yet written, more are dropped
+        thread_policy policy;               // < Of the coding pool and the writer
+    };
+    struct recorder_stats {
+        uint64_t frames = 0;                // < Written
+        uint64_t dropped = 0;               // < Arrived while max_in_flight frames were pending
+        uint64_t raw_bytes = 0;
+        uint64_t coded_bytes = 0;           // < Codec payload, without the record headers
+        uint64_t encode_ns = 0;             // < Slice coding time summed over frames and threads
+        double ratio = 0;                   // < raw_bytes / coded_bytes
+        double mb_per_s_per_core = 0;       // < Raw megabytes coded per second of one coding thread
+    };
+    // records a camera to a file through frame_codec: the capture thread only pins a buffer and hands
+    // it to the pool, where frames code in parallel and each spreads its slices over the pool too; the
+    // buffer goes back as soon as it is coded and the writer thread puts the frames out in capture order
+    class frame_recorder {
+    public:
+        frame_recorder(const std::shared_ptr<camera_controller> &camera, const recorder_config &config,
+                       const std::string &name = "record")
+            : camera_(camera), config_(config), codec_(config.slice_rows), name_(name) {
+            int threads = config_.threads;
+            if (threads <= 0) {
+                threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+            }
+            // a pool without workers would run the coding on the capture thread
+            pool_.reset(new thread_pool(std::max(threads, 1), config_.policy, name_ + "_"));
+        }
+        virtual ~frame_recorder() {
+            stop();
+        }
+        bool start(const std::string &path) {
+            if (worker_ != nullptr || !camera_) {
+                return false;
+            }
+            file_ = fopen(path.c_str(), "wb");
+            if (nullptr == file_) {
+                LOG_E("open recording %s error!", path.c_str());
+                return false;
+            }
+            recording_header header;
+            if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+                LOG_E("write recording %s error!", path.c_str());
+                fclose(file_);
+                file_ = nullptr;
+                return false;
+            }
+            offset_ = sizeof(header);
+            index_.clear();
+            next_order_ = next_write_ = 0;
+            in_flight_ = 0;
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(config_.policy, name_);
+                this->run();
+            });
+            listener_id_ = camera_->add_frame_listener([this](const camera_frame &frame) {
+                this->on_frame(frame);
+            });
+            return true;
+        }
+        // lets the frames already taken finish, then writes the index and closes the file
+        void stop() {
+            if (listener_id_ >= 0) {
+                camera_->remove_frame_listener(listener_id_);
+                listener_id_ = -1;
+            }
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            recording_trailer trailer;
+            trailer.frames = static_cast<uint32_t>(index_.size());
+            trailer.index_offset = offset_;
+            if (fwrite(index_.data(), sizeof(recording_index_entry), index_.size(), file_) != index_.size()
+                || fwrite(&trailer, sizeof(trailer), 1, file_) != 1) {
+                LOG_E("write recording index error!");
+            }
+            fclose(file_);
+            file_ = nullptr;
+        }
+        recorder_stats get_stats() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            recorder_stats stats = stats_;
+            stats.ratio = stats.coded_bytes ? static_cast<double>(stats.raw_bytes) / stats.coded_bytes : 0;
+            stats.mb_per_s_per_core = stats.encode_ns ? stats.raw_bytes * 1e3 / stats.encode_ns : 0;
+            return stats;
+        }
+    private:
+        struct coded_frame {
+            recording_frame_header header;
+            uint32_t raw_bytes = 0;
+            uint64_t encode_ns = 0;
+            bool ok = false;
+            std::vector<uint8_t> data;
+        };
+        void on_frame(const camera_frame &frame) {
+            uint64_t order = 0;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (!keep_running_ || in_flight_ >= config_.max_in_flight) {
+                    ++stats_.dropped;
+                    return;
+                }
+                if (!camera_->hold_frame(frame.idx)) {
+                    return;
+                }
+                ++in_flight_;
+                order = next_order_++;
+            }
+            pool_->submit([this, frame, order]() {
+                this->encode(frame, order);
+            });
+        }
+        // pool thread, the frame is held
+        void encode(const camera_frame &frame, uint64_t order) {
+            std::unique_ptr<coded_frame> coded;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (!spare_.empty()) {
+                    coded = std::move(spare_.back());
+                    spare_.pop_back();
+                }
+            }
+            if (!coded) {
+                coded.reset(new coded_frame());
+            }
+            coded->header = recording_frame_header();
+            coded->header.input_id = frame.input_id;
+            coded->header.seq_no = frame.seq_no;
+            coded->header.timestamp = frame.timestamp;
+            {
+                TRACE_SCOPE("record_encode", static_cast<int64_t>(frame.seq_no));
+                coded->ok = codec_.encode(frame, coded->data, pool_.get(), &coded->encode_ns);
+            }
+            camera_->release_frame(frame.idx);
+            codec_frame_header header;
+            coded->raw_bytes = coded->ok && frame_codec::parse_header(coded->data.data(), coded->data.size(), header)
+                             ? header.size : 0;
+            coded->header.size = static_cast<uint32_t>(coded->data.size());
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                coded_[order] = std::move(coded);
+            }
+            cv_.notify_all();
+        }
+        void run() {
+            while (true) {
+                std::unique_ptr<coded_frame> coded;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() {
+                        return coded_.count(next_write_) || (!keep_running_ && 0 == in_flight_);
+                    });
+                    auto it = coded_.find(next_write_);
+                    if (coded_.end() == it) {
+                        break;
+                    }
+                    coded = std::move(it->second);
+                    coded_.erase(it);
+                    ++next_write_;
+                }
+                bool written = false;
+                if (coded->ok) {
+                    TRACE_SCOPE("record_write", static_cast<int64_t>(coded->header.size));
+                    written = fwrite(&coded->header, sizeof(coded->header), 1, file_) == 1
+                           && fwrite(coded->data.data(), 1, coded->data.size(), file_) == coded->data.size();
+                    if (!written) {
+                        LOG_E("write recording frame %u error!", coded->header.seq_no);
+                    }
+                }
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (written) {
+                    recording_index_entry entry;
+                    entry.offset = offset_;
+                    entry.timestamp = coded->header.timestamp;
+                    entry.seq_no = coded->header.seq_no;
+                    entry.size = coded->header.size;
+                    index_.push_back(entry);
+                    offset_ += sizeof(coded->header) + coded->data.size();
+                    ++stats_.frames;
+                    stats_.raw_bytes += coded->raw_bytes;
+                    stats_.coded_bytes += coded->data.size();
+                    stats_.encode_ns += coded->encode_ns;
+                }
+                spare_.push_back(std::move(coded));
+                --in_flight_;
+            }
+        }
+    private:
+        std::shared_ptr<camera_controller> camera_;
+        recorder_config config_;
+        frame_codec codec_;
+        std::string name_;
+        int listener_id_ = -1;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        int in_flight_ = 0;
+        uint64_t next_order_ = 0;
+        uint64_t next_write_ = 0;
+        std::map<uint64_t, std::unique_ptr<coded_frame>> coded_;    // < Coded, waiting for their turn
+        std::vector<std::unique_ptr<coded_frame>> spare_;          // < Written, their buffers are reused
+        recorder_stats stats_;
+        FILE *file_ = nullptr;                          // < Writer thread only while running
+        uint64_t offset_ = 0;
+        std::vector<recording_index_entry> index_;
+        std::unique_ptr<thread_pool> pool_;             // < Last, so its workers are joined before the rest goes
+    };
+    // random access to the frames of a recording by number or time; reads the index of a closed
+    // file, or rebuilds it by walking the frame records of one that was never closed
+    class recording_reader {
+    public:
+        recording_reader() = default;
+        recording_reader(const recording_reader &) = delete;
+        recording_reader &operator=(const recording_reader &) = delete;
+        virtual ~recording_reader() {
+            close();
+        }
+        bool open(const std::string &path) {
+            close();
+            file_ = fopen(path.c_str(), "rb");
+            recording_header header;
+            if (nullptr == file_ || fread(&header, sizeof(header), 1, file_) != 1
+                || header.magic != RECORDING_MAGIC || header.version != RECORDING_VERSION) {
+                LOG_E("%s is not a recording!", path.c_str());
+                close();
+                return false;
+            }
+            if (!read_index() && !scan_index()) {
+                close();
+                return false;
+            }
+            return true;
+        }
+        void close() {
+            if (file_ != nullptr) {
+                fclose(file_);
+                file_ = nullptr;
+            }
+            index_.clear();
+        }
+        inline size_t frames() const {
+            return index_.size();
+        }
+        inline const recording_index_entry &entry(size_t n) const {
+            return index_[n];
+        }
+        // first frame at or after timestamp, frames() if none
+        size_t find(uint64_t timestamp) const {
+            auto it = std::lower_bound(index_.begin(), index_.end(), timestamp,
+                                       [](const recording_index_entry &e, uint64_t t) { return e.timestamp < t; });
+            return it - index_.begin();
+        }
+        // the coded frame n, decode it with frame_codec::decode
+        bool read(size_t n, recording_frame_header &header, std::vector<uint8_t> &coded) {
+            if (n >= index_.size() || fseeko(file_, static_cast<off_t>(index_[n].offset), SEEK_SET) != 0
+                || fread(&header, sizeof(header), 1, file_) != 1 || header.magic != RECORDING_FRAME_MAGIC) {
+                return false;
+            }
+            coded.resize(header.size);
+            return fread(coded.data(), 1, coded.size(), file_) == coded.size();
+        }
+    private:
+        bool read_index() {
+            recording_trailer trailer;
+            if (fseeko(file_, -static_cast<off_t>(sizeof(trailer)), SEEK_END) != 0
+                || fread(&trailer, sizeof(trailer), 1, file_) != 1 || trailer.magic != RECORDING_INDEX_MAGIC
+                || fseeko(file_, static_cast<off_t>(trailer.index_offset), SEEK_SET) != 0) {
+                return false;
+            }
+            index_.resize(trailer.frames);
+            if (fread(index_.data(), sizeof(recording_index_entry), index_.size(), file_) != index_.size()) {
+                index_.clear();
+                return false;
+            }
+            return true;
+        }
+        bool scan_index() {
+            LOG_W("recording has no index, scanning its frames");
+            if (fseeko(file_, 0, SEEK_END) != 0) {
+                return false;
+            }
+            const uint64_t file_size = ftello(file_);
+            uint64_t offset = sizeof(recording_header);
+            recording_frame_header header;
+            while (fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file_) == 1
+                   && RECORDING_FRAME_MAGIC == header.magic && offset + sizeof(header) + header.size <= file_size) {
+                recording_index_entry entry;
+                entry.offset = offset;
+                entry.timestamp = header.timestamp;
+                entry.seq_no = header.seq_no;
+                entry.size = header.size;
+                index_.push_back(entry);
+                offset += sizeof(header) + header.size;
+            }
+            return true;
+        }
+    private:
+        FILE *file_ = nullptr;
+        std::vector<recording_index_entry> index_;
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include "color_log.hpp"
+#include "anon_shm.hpp"
+namespace qnx_screen_camera {
+    // shared memory layout between frame_exporter (capture process) and frame_reader (consumers)
+    // buffers are handed over once at connect time, afterwards only the descriptor ring moves
+    enum frame_share_param : uint32_t {
+        FRAME_SHARE_MAGIC = 0x52465351,     // "QSFR"
+        FRAME_SHARE_VERSION = 1,
+        FRAME_SHARE_MAX_BUFFERS = 12,       // < QCARCAM_MAX_NUM_BUFFERS
+        FRAME_SHARE_SLOTS = 16,             // < power of two
+    };
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "frame ring needs lock free 64 bit atomics");
+    struct frame_share_buffer {
+        uint64_t phys_addr = 0;             // < For readers mapping device memory when no fd is passed
+        uint32_t size = 0;
+        uint32_t stride = 0;
+        int32_t fd_index = -1;              // < Position in the SCM_RIGHTS array, -1 if no fd
+        uint32_t reserved = 0;
+    };
+    // one published frame, protected by a per slot sequence lock:
+    // odd seq while the writer is updating, readers retry when seq is odd or changed under them
+    struct frame_share_slot {
+        std::atomic<uint32_t> seq;
+        uint32_t idx;                       // < qcarcam buffer index
+        uint64_t seq_no;
+        uint64_t timestamp;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t format;                    // < qcarcam_color_fmt_t
+        uint64_t frame_count;               // < Value of head when published
+    };
+    struct frame_share_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t n_buffers;
+        uint32_t n_slots;
+        std::atomic<uint64_t> head;         // < Number of frames published so far
+        frame_share_buffer buffers[FRAME_SHARE_MAX_BUFFERS];
+        frame_share_slot slots[FRAME_SHARE_SLOTS];
+    };
+    // sent with the descriptors when a reader connects, fd[0] is the ring itself
+    struct frame_share_hello {
+        uint32_t magic = FRAME_SHARE_MAGIC;
+        uint32_t version = FRAME_SHARE_VERSION;
+        uint32_t ring_size = sizeof(frame_share_header);
+        uint32_t n_fds = 0;
+    };
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    enum qos_level : int {              // steps the governor walks one per tick
+        QOS_LEVEL_NONE = 0,
+        QOS_LEVEL_DECIMATE_BACKGROUND,  // < Background at half rate
+        QOS_LEVEL_PAUSE_BACKGROUND,     // < Background paused in the driver, interactive at half rate
+        QOS_LEVEL_DECIMATE_INTERACTIVE, // < Background paused, interactive at a quarter
+        QOS_LEVEL_NUM
+    };
+    struct qos_config {
+        int interval_ms = 100;
+        double escalate_ratio = 0.8;    // < Safety latency / deadline at which one more step is taken
+        double relax_ratio = 0.5;       // < Below it for relax_ticks in a row one step is given back
+        int relax_ticks = 10;
+        thread_policy policy;           // < Should sit above the non safety capture threads
+    };
+    struct qos_stats {
+        int level = QOS_LEVEL_NONE;
+        uint64_t escalations = 0;
+        double safety_pressure = 0;     // < Worst safety latency / deadline of the last tick
+        uint64_t deadline_misses[QOS_CLASS_NUM] = { 0 };    // < Summed over the cameras of each class
+    };
+    using camera_list_source = std::function<std::vector<std::shared_ptr<camera_controller>>()>;
+    // protects the safety cameras under overload: watches their worst capture to dequeue latency
+    // against the deadline and decimates, then pauses, the lower classes until it recovers
+    class qos_governor {
+    public:
+        qos_governor(const qos_config &config, const camera_list_source &cameras)
+            : config_(config), cameras_(cameras) {
+        }
+        virtual ~qos_governor() {
+            stop();
+        }
+        bool start() {
+            if (worker_ != nullptr || !cameras_ || config_.interval_ms <= 0) {
+                return false;
+            }
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(config_.policy, "qos");
+                this->run();
+            });
+            return true;
+        }
+        // gives every throttled camera its full rate back
+        void stop() {
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            auto cameras = cameras_();
+            cameras.insert(cameras.end(), paused_.begin(), paused_.end());
+            apply(cameras, QOS_LEVEL_NONE);
+            level_ = QOS_LEVEL_NONE;
+        }
+        qos_stats get_stats() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            return stats_;
+        }
+    private:
+        void run() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait_for(lk, std::chrono::milliseconds(config_.interval_ms), [this]() { return !keep_running_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                }
+                tick();
+            }
+        }
+        void tick() {
+            auto cameras = cameras_();
+            auto gone = [&cameras](const std::shared_ptr<camera_controller> &p) {     // closed meanwhile
+                return std::find(cameras.begin(), cameras.end(), p) == cameras.end();
+            };
+            paused_.erase(std::remove_if(paused_.begin(), paused_.end(), gone), paused_.end());
+            double pressure = 0;
+            qos_stats stats;
+            for (auto &camera : cameras) {
+                uint64_t latency = camera->take_window_latency();
+                camera_stats cs = camera->get_stats();
+                int cls = std::min(std::max(cs.qos_class, 0), QOS_CLASS_NUM - 1);
+                stats.deadline_misses[cls] += cs.deadline_misses;
+                if (QOS_SAFETY == cls) {
+                    pressure = std::max(pressure, static_cast<double>(latency) / camera->deadline_ns());
+                }
+            }
+            if (pressure >= config_.escalate_ratio) {
+                calm_ticks_ = 0;
+                if (level_ + 1 < QOS_LEVEL_NUM) {
+                    ++level_;
+                    ++escalations_;
+                    LOG_W("qos: safety latency at %.0f%% of deadline, level %d", pressure * 100, level_);
+                }
+            }
+            else if (pressure < config_.relax_ratio && level_ > QOS_LEVEL_NONE && ++calm_ticks_ >= config_.relax_ticks) {
+                calm_ticks_ = 0;
+                --level_;
+                LOG_I("qos: safety latency recovered, level %d", level_);
+            }
+            else if (pressure >= config_.relax_ratio) {
+                calm_ticks_ = 0;
+            }
+            apply(cameras, level_);
+            stats.level = level_;
+            stats.escalations = escalations_;
+            stats.safety_pressure = pressure;
+            std::lock_guard<std::mutex> guard(mutex_);
+            stats_ = stats;
+        }
+        void apply(const std::vector<std::shared_ptr<camera_controller>> &cameras, int level) {
+            // frame divisor per class and level, 0 pauses the camera in the driver
+            static const int divisors[QOS_CLASS_NUM][QOS_LEVEL_NUM] = {
+                { 1, 1, 1, 1 },             // safety
+                { 1, 1, 2, 4 },             // interactive
+                { 1, 2, 0, 0 },             // background
+            };
+            for (auto &camera : cameras) {
+                int cls = std::min(std::max(static_cast<int>(camera->get_attr().qos), 0), QOS_CLASS_NUM - 1);
+                int divisor = divisors[cls][level];
+                bool paused = std::find(paused_.begin(), paused_.end(), camera) != paused_.end();
+                if (0 == divisor && !paused) {
+                    if (camera->control_command(CAM_CMD_PAUSE)) {
+                        paused_.push_back(camera);
+                    }
+                }
+                else if (divisor != 0 && paused) {
+                    camera->control_command(CAM_CMD_RESUME);        // fails harmlessly if stopped meanwhile
+                    paused_.erase(std::find(paused_.begin(), paused_.end(), camera));
+                }
+                if (divisor != 0 && camera->get_qos_divisor() != divisor) {
+                    camera->set_qos_divisor(divisor);
+                }
+            }
+        }
+    private:
+        qos_config config_;
+        camera_list_source cameras_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        qos_stats stats_;
+        int level_ = QOS_LEVEL_NONE;                    // < Governor thread only, as the fields below
+        int calm_ticks_ = 0;
+        uint64_t escalations_ = 0;
+        std::vector<std::shared_ptr<camera_controller>> paused_;
+    };
+}
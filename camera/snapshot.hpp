@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "clock.hpp"
+#include "luma.hpp"
+#include "thread_pool.hpp"
+#include "jpeg_encoder.hpp"
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    struct snapshot_result {
+        bool ok = false;
+        int input_id = -1;
+        unsigned int seq_no = 0;
+        unsigned long long timestamp = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> jpeg;
+        double copy_ms = 0;             // < Capture buffer pinned until the copy is done
+        double encode_ms = 0;
+    };
+    using snapshot_callback = std::function<void(const snapshot_result &)>;
+    // still images of running cameras: request() only pins the newest buffer, the worker copies it
+    // out, gives it back to capture at once and encodes the copy on the pool, so the capture thread
+    // never waits and a capture buffer is held for a memcpy, not for the encode
+    class snapshot_engine {
+    public:
+        // threads counts the worker itself, the pool gets threads - 1 helpers
+        snapshot_engine(int threads, const thread_policy &policy, const jpeg_options &options = jpeg_options(),
+                        size_t max_pending = 2)
+            : pool_(std::max(threads, 1) - 1, policy, "snap"), encoder_(options), max_pending_(max_pending) {
+            keep_running_ = true;
+            worker_ = new std::thread([this, policy]() {
+                apply_thread_policy(policy, "snapshot");
+                this->run();
+            });
+        }
+        virtual ~snapshot_engine() {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_ != nullptr) {
+                if (worker_->joinable()) {
+                    worker_->join();
+                }
+                delete worker_;
+                worker_ = nullptr;
+            }
+        }
+        // the future and the callback both get the result; the callback runs on the snapshot thread,
+        // or right here with ok false when the camera has no frame yet or too many requests wait
+        std::future<snapshot_result> request(const std::shared_ptr<camera_controller> &camera,
+                                             const snapshot_callback &callback = nullptr) {
+            job next;
+            next.camera = camera;
+            next.callback = callback;
+            std::future<snapshot_result> result = next.promise.get_future();
+            bool pinned = camera && camera->hold_latest_frame(next.frame);
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (pinned && jobs_.size() < max_pending_) {
+                    jobs_.push_back(std::move(next));
+                    cv_.notify_one();
+                    return result;
+                }
+            }
+            if (pinned) {
+                LOG_E("too many pending snapshots!");
+                camera->release_frame(next.frame.idx);
+            }
+            finish(next);
+            return result;
+        }
+    private:
+        struct job {
+            std::shared_ptr<camera_controller> camera;
+            camera_frame frame;
+            snapshot_callback callback;
+            std::promise<snapshot_result> promise;
+            snapshot_result result;
+        };
+        void run() {
+            while (true) {
+                job current;
+                bool running = true;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || !jobs_.empty(); });
+                    if (jobs_.empty()) {
+                        break;
+                    }
+                    current = std::move(jobs_.front());
+                    jobs_.pop_front();
+                    running = keep_running_;        // shutting down: hand back queued frames unencoded
+                }
+                if (running) {
+                    capture(current);
+                }
+                else {
+                    current.camera->release_frame(current.frame.idx);
+                }
+                finish(current);
+            }
+        }
+        void capture(job &current) {
+            const camera_frame &frame = current.frame;
+            snapshot_result &result = current.result;
+            result.input_id = frame.input_id;
+            result.seq_no = frame.seq_no;
+            result.timestamp = frame.timestamp;
+            result.width = frame.width;
+            result.height = frame.height;
+            uint64_t start = monotonic_ns();
+            bool copied = false;
+            int offset = luma_packed_offset(frame.format);
+            if (frame.data != nullptr && offset >= -1) {
+                // NV12/NV21 chroma may sit at a padded plane offset, the encoder wants it right below the luma
+                plane_layout layout;
+                get_plane_layout(frame.format, frame.width, frame.height, frame.stride, 0, layout);
+                staging_.resize(layout.size);
+                memcpy(staging_.data(), frame.data, layout.offset[1] ? layout.offset[1] : layout.size);
+                if (layout.planes > 1) {
+                    uint32_t offset1 = frame.plane_offset ? frame.plane_offset : layout.offset[1];
+                    memcpy(staging_.data() + layout.offset[1], frame.data + offset1, layout.size - layout.offset[1]);
+                }
+                copied = true;
+            }
+            current.camera->release_frame(frame.idx);
+            uint64_t copied_at = monotonic_ns();
+            result.copy_ms = (copied_at - start) / 1e6;
+            if (!copied) {
+                LOG_E("snapshot of input %d: frame not mapped or format 0x%x not supported", frame.input_id, frame.format);
+                return;
+            }
+            result.ok = encoder_.encode(staging_.data(), frame.stride, frame.width, frame.height, frame.format,
+                                        &pool_, result.jpeg);
+            result.encode_ms = (monotonic_ns() - copied_at) / 1e6;
+            LOG_D("snapshot input %d seq %u: copy %.2f ms, encode %.2f ms, %zu bytes", frame.input_id, frame.seq_no,
+                  result.copy_ms, result.encode_ms, result.jpeg.size());
+        }
+        void finish(job &current) {
+            if (current.callback) {
+                current.callback(current.result);
+            }
+            current.promise.set_value(std::move(current.result));
+        }
+    private:
+        thread_pool pool_;
+        jpeg_encoder encoder_;
+        std::vector<uint8_t> staging_;
+        size_t max_pending_ = 2;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<job> jobs_;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+    };
+}
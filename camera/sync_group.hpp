@@ -0,0 +1,148 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    struct sync_group_stats {
+        uint64_t frames_in = 0;         // < Frames received from all members
+        uint64_t sets = 0;              // < Complete sets delivered
+        uint64_t dropped = 0;           // < Frames released without a match
+        uint64_t last_skew_ns = 0;      // < Max - min timestamp of the last set
+        uint64_t max_skew_ns = 0;
+        uint64_t total_skew_ns = 0;     // < Divide by sets for the mean skew
+        inline double match_rate(size_t members) const {
+            return frames_in ? static_cast<double>(sets * members) / frames_in : 0.0;
+        }
+    };
+    // a set of frames, one per member in member order, all within the group tolerance;
+    // runs on a member capture thread with the group locked, the frames are released when it returns
+    // unless the receiver holds them through their controller
+    using sync_set_callback = std::function<void(const std::vector<camera_frame> &)>;
+    // matches frames of several cameras by qcarcam capture timestamp:
+    // each member keeps at most max_pending held buffers, the oldest head that can no longer be
+    // matched is released immediately so no camera starves of buffers
+    class sync_group {
+    public:
+        sync_group(const std::vector<std::shared_ptr<camera_controller>> &members, uint64_t tolerance_ns,
+                   const sync_set_callback &callback, size_t max_pending = 2)
+            : members_(members), tolerance_ns_(tolerance_ns), max_pending_(max_pending ? max_pending : 1),
+              callback_(callback), pending_(members.size()) {
+            set_.resize(members_.size());
+        }
+        virtual ~sync_group() {
+            stop();
+        }
+        bool start() {
+            if (!listener_ids_.empty() || members_.size() < 2) {
+                return false;
+            }
+            for (size_t i = 0;i < members_.size();++i) {
+                listener_ids_.push_back(members_[i]->add_frame_listener([this, i](const camera_frame &frame) {
+                    this->on_frame(i, frame);
+                }));
+            }
+            return true;
+        }
+        void stop() {
+            for (size_t i = 0;i < listener_ids_.size();++i) {     // no group lock: listeners may be waiting on it
+                members_[i]->remove_frame_listener(listener_ids_[i]);
+            }
+            listener_ids_.clear();
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (size_t i = 0;i < pending_.size();++i) {
+                while (!pending_[i].empty()) {
+                    members_[i]->release_frame(pending_[i].front().idx);
+                    pending_[i].pop_front();
+                }
+            }
+        }
+        void set_tolerance(uint64_t tolerance_ns) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            tolerance_ns_ = tolerance_ns;
+        }
+        sync_group_stats get_stats() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            return stats_;
+        }
+        inline size_t size() const {
+            return members_.size();
+        }
+        inline bool contains(const std::shared_ptr<camera_controller> &camera) const {
+            return std::find(members_.begin(), members_.end(), camera) != members_.end();
+        }
+    private:
+        void on_frame(size_t member, const camera_frame &frame) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (!members_[member]->hold_frame(frame.idx)) {
+                return;
+            }
+            ++stats_.frames_in;
+            std::deque<camera_frame> &queue = pending_[member];
+            queue.push_back(frame);
+            if (queue.size() > max_pending_) {
+                drop_head(member);
+            }
+            match();
+        }
+        void match() {
+            while (true) {
+                size_t oldest = 0;
+                uint64_t min_ts = UINT64_MAX;
+                uint64_t max_ts = 0;
+                for (size_t i = 0;i < pending_.size();++i) {
+                    if (pending_[i].empty()) {
+                        return;
+                    }
+                    uint64_t ts = pending_[i].front().timestamp;
+                    if (ts < min_ts) {
+                        min_ts = ts;
+                        oldest = i;
+                    }
+                    if (ts > max_ts) {
+                        max_ts = ts;
+                    }
+                }
+                if (max_ts - min_ts > tolerance_ns_) {
+                    drop_head(oldest);      // every later frame of the others is even further away
+                    continue;
+                }
+                for (size_t i = 0;i < pending_.size();++i) {
+                    set_[i] = pending_[i].front();
+                    pending_[i].pop_front();
+                }
+                uint64_t skew = max_ts - min_ts;
+                ++stats_.sets;
+                stats_.last_skew_ns = skew;
+                stats_.total_skew_ns += skew;
+                if (skew > stats_.max_skew_ns) {
+                    stats_.max_skew_ns = skew;
+                }
+                if (callback_) {
+                    callback_(set_);
+                }
+                for (size_t i = 0;i < set_.size();++i) {
+                    members_[i]->release_frame(set_[i].idx);
+                }
+            }
+        }
+        void drop_head(size_t member) {
+            members_[member]->release_frame(pending_[member].front().idx);
+            pending_[member].pop_front();
+            ++stats_.dropped;
+        }
+    private:
+        std::vector<std::shared_ptr<camera_controller>> members_;
+        uint64_t tolerance_ns_;
+        size_t max_pending_;
+        sync_set_callback callback_;
+        std::mutex mutex_;
+        std::vector<std::deque<camera_frame>> pending_;
+        std::vector<camera_frame> set_;
+        std::vector<int> listener_ids_;
+        sync_group_stats stats_;
+    };
+}
@@ -0,0 +1,537 @@
+// soak test of the camera manager on the simulated backend: random create, start, stop, control, resize and
+// destroy across every input from several threads, with driver faults injected. Fails on a hang, on
+// buffers, handles, windows or threads left behind, on the process not returning to its baseline or on
+// threads, rss, fds or outstanding buffers growing during the run
+#include <dirent.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "camera_manager.hpp"
+#include "host_allocator.hpp"
+#include "sim_backend.hpp"
+using namespace qnx_screen_camera;
+namespace {
+    enum soak_param : int {
+        SOAK_HANG_MS = 5000,            // < Longest manager call before the run counts as hung
+        SOAK_TEARDOWN_MS = 20000,       // < Closing every input at the end
+        SOAK_HEAP_SLACK_KB = 1024,      // < Heap in use over the baseline that still counts as the same
+        SOAK_LATENCY_BUCKET_US = 50,
+        SOAK_LATENCY_BUCKETS = 40000,   // < Two seconds, later frames land in the last bucket
+        SOAK_GROWTH_SAMPLES = 3,        // < Samples in a row over the first one that count as growth
+        SOAK_GROWTH_THREADS = 32,       // < Slack over the first sample, the open inputs change at random
+        SOAK_GROWTH_FDS = 32,
+        SOAK_GROWTH_RSS_KB = 65536,
+        SOAK_GROWTH_BUFFERS = 16,
+    };
+    enum soak_op {
+        OP_CREATE = 0,
+        OP_DESTROY,
+        OP_START,
+        OP_STOP,
+        OP_PAUSE,
+        OP_RESUME,
+        OP_RESIZE,
+        OP_VISIBLE,
+        OP_VIEWPORT,
+        OP_FRAME_RATE,
+        OP_MIRROR,
+        OP_HOLD,
+        OP_STATS,
+        OP_NUM
+    };
+    const char *const op_names[OP_NUM] = {
+        "create", "destroy", "start", "stop", "pause", "resume", "resize", "visible", "viewport", "frame_rate",
+        "mirror", "hold", "stats"
+    };
+    const int op_weights[OP_NUM] = { 10, 6, 8, 5, 3, 3, 8, 6, 8, 4, 3, 4, 6 };
+    struct soak_options {
+        int seconds = 60;
+        int workers = 3;
+        int gap_ms = 20;                // < Longest pause of a worker between two operations
+        int interval_s = 2;             // < Usage sample period of the measured round
+        uint32_t seed = 1;
+        double faults = 1.0;            // < Scale of the default fault rates, 0 runs without faults
+        bool verbose = false;
+    };
+    struct process_usage {
+        int threads = 0;
+        long rss_kb = 0;                // < Informational, the allocator keeps freed arenas resident
+        long heap_kb = 0;               // < Allocated and not freed
+        int fds = 0;
+    };
+    process_usage read_usage() {
+        process_usage usage;
+        malloc_trim(0);
+        struct mallinfo2 heap = mallinfo2();
+        usage.heap_kb = static_cast<long>((heap.uordblks + heap.hblkhd) / 1024);
+        FILE *status = fopen("/proc/self/status", "r");
+        if (status != nullptr) {
+            char line[256];
+            while (fgets(line, sizeof(line), status)) {
+                sscanf(line, "Threads: %d", &usage.threads);
+                sscanf(line, "VmRSS: %ld", &usage.rss_kb);
+            }
+            fclose(status);
+        }
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir != nullptr) {
+            while (readdir(dir) != nullptr) {
+                ++usage.fds;
+            }
+            closedir(dir);
+            usage.fds -= 3;             // . .. and the directory itself
+        }
+        return usage;
+    }
+    // usage sampled during the measured round; a metric grows when SOAK_GROWTH_SAMPLES samples in a row are
+    // over the first sample by more than its slack, a swing of the random load comes back under it
+    class growth_monitor {
+    public:
+        // false once a metric has grown, what names it
+        bool add(const process_usage &usage, int buffers, const char *&what) {
+            const long values[METRIC_NUM] = { usage.threads, usage.rss_kb, usage.fds, buffers };
+            static const long slacks[METRIC_NUM] = {
+                SOAK_GROWTH_THREADS, SOAK_GROWTH_RSS_KB, SOAK_GROWTH_FDS, SOAK_GROWTH_BUFFERS
+            };
+            static const char *const names[METRIC_NUM] = { "threads", "rss", "file descriptors", "buffers" };
+            bool ok = true;
+            for (int i = 0;i < METRIC_NUM;++i) {
+                if (0 == samples_) {
+                    first_[i] = values[i];
+                }
+                over_[i] = values[i] > first_[i] + slacks[i] ? over_[i] + 1 : 0;
+                if (over_[i] >= SOAK_GROWTH_SAMPLES && ok) {
+                    what = names[i];
+                    ok = false;
+                }
+            }
+            ++samples_;
+            return ok;
+        }
+    private:
+        enum { METRIC_NUM = 4 };
+        long first_[METRIC_NUM] = {};
+        int over_[METRIC_NUM] = {};
+        int samples_ = 0;
+    };
+    // capture to listener latency of every delivered frame
+    class latency_histogram {
+    public:
+        void add(uint64_t ns) {
+            uint64_t bucket = ns / 1000 / SOAK_LATENCY_BUCKET_US;
+            ++buckets_[bucket < SOAK_LATENCY_BUCKETS ? bucket : SOAK_LATENCY_BUCKETS - 1];
+            ++count_;
+            uint64_t max = max_;
+            while (ns > max && !max_.compare_exchange_weak(max, ns)) {
+            }
+        }
+        // upper edge of the bucket holding quantile q, in ms
+        double percentile(double q) const {
+            uint64_t total = count_;
+            uint64_t rank = static_cast<uint64_t>(q * total);
+            uint64_t seen = 0;
+            for (int i = 0;i < SOAK_LATENCY_BUCKETS;++i) {
+                seen += buckets_[i];
+                if (seen > rank) {
+                    return (i + 1) * SOAK_LATENCY_BUCKET_US / 1000.0;
+                }
+            }
+            return max_ / 1e6;
+        }
+        inline uint64_t count() const {
+            return count_;
+        }
+        inline double max_ms() const {
+            return max_ / 1e6;
+        }
+    private:
+        std::atomic<uint64_t> buckets_[SOAK_LATENCY_BUCKETS] = {};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+    struct worker_state {
+        std::atomic<int> op{-1};
+        std::atomic<int> id{-1};
+        std::atomic<uint64_t> since{0};
+    };
+    struct op_totals {
+        std::atomic<uint64_t> calls[OP_NUM] = {};
+        std::atomic<uint64_t> failed[OP_NUM] = {};
+    };
+    class soak_run {
+    public:
+        explicit soak_run(const soak_options &options) : options_(options), workers_(options.workers) {
+            allocator_ = std::make_shared<host_allocator>();
+        }
+        // sample usage every interval of the round when asked
+        void run(int seconds, bool sampled = false) {
+            std::atomic<bool> done{false};
+            std::vector<std::thread> threads;
+            uint64_t end = monotonic_ns() + static_cast<uint64_t>(seconds) * 1000000000ULL;
+            for (int i = 0;i < options_.workers;++i) {
+                threads.emplace_back([this, i, end]() { this->work(i, end); });
+            }
+            std::thread watchdog([this, &done, sampled]() { this->watch(done, sampled); });
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            done = true;
+            watchdog.join();
+        }
+        // closes whatever is left, each in bounded time
+        bool teardown() {
+            uint64_t begin = monotonic_ns();
+            for (int id = 0;id < CAM_INPUTS;++id) {
+                G_CAMERA_MANAGER.destroy_camera_connect(id);
+            }
+            G_CAMERA_MANAGER.drop_standby();
+            double ms = (monotonic_ns() - begin) / 1e6;
+            fprintf(stderr, "teardown %.1f ms\n", ms);
+            return ms < SOAK_TEARDOWN_MS;
+        }
+        // the metric that grew during a sampled round, nullptr if none did
+        inline const char *growth() const {
+            return growth_;
+        }
+        void report(double seconds) const {
+            fprintf(stderr, "operations:");
+            for (int op = 0;op < OP_NUM;++op) {
+                fprintf(stderr, " %s %llu/%llu", op_names[op], static_cast<unsigned long long>(totals_.failed[op]),
+                        static_cast<unsigned long long>(totals_.calls[op]));
+            }
+            fprintf(stderr, " (failed/called)\n");
+            fprintf(stderr, "frames %llu in %.1f s, %.1f fps over all inputs\n",
+                    static_cast<unsigned long long>(latency_.count()), seconds, latency_.count() / seconds);
+            fprintf(stderr, "latency ms p50 %.2f p90 %.2f p99 %.2f p99.9 %.2f max %.2f\n", latency_.percentile(0.5),
+                    latency_.percentile(0.9), latency_.percentile(0.99), latency_.percentile(0.999), latency_.max_ms());
+            fprintf(stderr, "worst operation %s %.1f ms\n", worst_op_ >= 0 ? op_names[worst_op_] : "-",
+                    worst_op_ns_ / 1e6);
+        }
+    private:
+        enum { CAM_INPUTS = 8 };
+        void work(int index, uint64_t end) {
+            std::mt19937 rng(options_.seed * 31u + static_cast<uint32_t>(index));
+            int weight_sum = 0;
+            for (int op = 0;op < OP_NUM;++op) {
+                weight_sum += op_weights[op];
+            }
+            while (monotonic_ns() < end) {
+                int pick = std::uniform_int_distribution<int>(0, weight_sum - 1)(rng);
+                int op = 0;
+                while (pick >= op_weights[op]) {
+                    pick -= op_weights[op++];
+                }
+                int id = std::uniform_int_distribution<int>(0, CAM_INPUTS - 1)(rng);
+                worker_state &state = workers_[index];
+                state.id = id;
+                state.since = monotonic_ns();
+                state.op = op;
+                bool ok = execute(static_cast<soak_op>(op), id, rng);
+                uint64_t took = monotonic_ns() - state.since;
+                state.op = -1;
+                ++totals_.calls[op];
+                if (!ok) {
+                    ++totals_.failed[op];
+                }
+                {
+                    std::lock_guard<std::mutex> guard(worst_mutex_);
+                    if (took > worst_op_ns_) {
+                        worst_op_ns_ = took;
+                        worst_op_ = op;
+                    }
+                }
+                if (options_.gap_ms > 0) {
+                    int gap = std::uniform_int_distribution<int>(0, options_.gap_ms)(rng);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(gap));
+                }
+            }
+        }
+        bool execute(soak_op op, int id, std::mt19937 &rng) {
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            switch (op) {
+            case OP_CREATE: {
+                int display = std::uniform_int_distribution<int>(0, 1)(rng);
+                if (!create(id, unit(rng) < 0.25, display)) {
+                    return false;
+                }
+                return unit(rng) < 0.2 || G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+            }
+            case OP_DESTROY: {
+                std::lock_guard<std::mutex> guard(hold_mutex_[id]);
+                return G_CAMERA_MANAGER.destroy_camera_connect(id, unit(rng) < 0.5);
+            }
+            case OP_START:
+                return G_CAMERA_MANAGER.control_camera(id, CAM_CMD_START);
+            case OP_STOP:
+                return G_CAMERA_MANAGER.control_camera(id, CAM_CMD_STOP);
+            case OP_PAUSE:
+                return G_CAMERA_MANAGER.control_camera(id, CAM_CMD_PAUSE);
+            case OP_RESUME:
+                return G_CAMERA_MANAGER.control_camera(id, CAM_CMD_RESUME);
+            case OP_RESIZE: {
+                DVECT size = { 0.2 + 0.8 * unit(rng), 0.2 + 0.8 * unit(rng) };
+                DVECT pos = { (1.0 - size.x) * unit(rng), (1.0 - size.y) * unit(rng) };
+                return G_CAMERA_MANAGER.change_camera_window(id, size, pos);
+            }
+            case OP_VISIBLE:
+                return G_CAMERA_MANAGER.set_camera_visible(id, unit(rng) < 0.7 ? 1 : 0);
+            case OP_VIEWPORT: {
+                DVECT size = { 0.25 + 0.75 * unit(rng), 0.25 + 0.75 * unit(rng) };
+                DVECT pos = { (1.0 - size.x) * unit(rng), (1.0 - size.y) * unit(rng) };
+                int duration = unit(rng) < 0.5 ? 0 : std::uniform_int_distribution<int>(50, 300)(rng);
+                return G_CAMERA_MANAGER.set_camera_viewport(id, pos, size, duration);
+            }
+            case OP_FRAME_RATE: {
+                static const float rates[] = { 0, 5, 10, 15, 20, 30 };
+                return G_CAMERA_MANAGER.set_camera_frame_rate(id, rates[std::uniform_int_distribution<int>(0, 5)(rng)]);
+            }
+            case OP_MIRROR:
+                return mirror(id, rng);
+            case OP_HOLD:
+                return hold(id, rng);
+            case OP_STATS: {
+                camera_stats stats;
+                return G_CAMERA_MANAGER.get_camera_stats(id, stats);
+            }
+            default:
+                return false;
+            }
+        }
+        bool create(int id, bool headless, int display) {
+            screen_attribute screenAttr;
+            screenAttr.display_id = display;
+            screenAttr.window_size = { 0.5, 0.5 };
+            screenAttr.window_pos = { 0.5 * (id % 2), 0.5 * (id / 2 % 2) };
+            capture_attr capAttr;
+            capAttr.input_id = static_cast<qcarcam_input_desc_t>(id);
+            capAttr.headless = headless;
+            capAttr.allocator = headless ? allocator_ : nullptr;
+            capAttr.qos = static_cast<camera_qos_class>(id % QOS_CLASS_NUM);
+            if (nullptr == G_CAMERA_MANAGER.create_camera_connect(screenAttr, capAttr)) {
+                return false;
+            }
+            listen(id);
+            return true;
+        }
+        // one latency listener per controller; a warm reopen brings the controller back with it
+        void listen(int id) {
+            auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+            if (nullptr == ptr) {
+                return;
+            }
+            std::lock_guard<std::mutex> guard(listen_mutex_);
+            auto &known = listened_[ptr.get()];
+            if (known.lock() == ptr) {
+                return;
+            }
+            known = ptr;
+            ptr->add_frame_listener([this](const camera_frame &frame) {
+                uint64_t now = monotonic_ns();
+                latency_.add(now > frame.timestamp ? now - frame.timestamp : 0);
+            });
+        }
+        bool mirror(int id, std::mt19937 &rng) {
+            int existing = -1;
+            {
+                std::lock_guard<std::mutex> guard(listen_mutex_);
+                existing = mirrors_[id];
+                mirrors_[id] = -1;
+            }
+            if (existing > 0 && G_CAMERA_MANAGER.remove_camera_mirror(id, existing)) {
+                return true;
+            }
+            screen_attribute attr;
+            attr.display_id = std::uniform_int_distribution<int>(0, 1)(rng);
+            attr.window_size = { 0.3, 0.3 };
+            int mirror = G_CAMERA_MANAGER.add_camera_mirror(id, attr);
+            std::lock_guard<std::mutex> guard(listen_mutex_);
+            mirrors_[id] = mirror;
+            return mirror > 0;
+        }
+        // a stage pinning the newest frame for a while, released before the input may go away
+        bool hold(int id, std::mt19937 &rng) {
+            std::lock_guard<std::mutex> guard(hold_mutex_[id]);
+            auto ptr = G_CAMERA_MANAGER.find_camera_connect_by_id(id);
+            camera_frame frame;
+            if (nullptr == ptr || !ptr->hold_latest_frame(frame)) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::uniform_int_distribution<int>(1, 40)(rng)));
+            return ptr->release_frame(frame.idx);
+        }
+        void watch(std::atomic<bool> &done, bool sampled) {
+            const uint64_t begin = monotonic_ns();
+            const uint64_t interval = static_cast<uint64_t>(options_.interval_s) * 1000000000ULL;
+            uint64_t next = begin + interval;
+            while (!done) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                uint64_t now = monotonic_ns();
+                if (sampled && now >= next) {
+                    sample(now - begin);
+                    next += interval;
+                }
+                for (int i = 0;i < options_.workers;++i) {
+                    int op = workers_[i].op;
+                    uint64_t since = workers_[i].since;
+                    if (op >= 0 && now > since && now - since > SOAK_HANG_MS * 1000000ULL) {
+                        fprintf(stderr, "HANG: worker %d in %s of input %d for %llu ms\n", i, op_names[op],
+                                workers_[i].id.load(), static_cast<unsigned long long>((now - since) / 1000000));
+                        _exit(3);
+                    }
+                }
+            }
+        }
+        void sample(uint64_t elapsed) {
+            process_usage usage = read_usage();
+            int buffers = sim_get_counters().held_buffers;
+            const char *what = nullptr;
+            bool ok = monitor_.add(usage, buffers, what);
+            fprintf(stderr, "%4.0f s: %d threads, heap %ld kB, rss %ld kB, %d fds, %d buffers out\n", elapsed / 1e9,
+                    usage.threads, usage.heap_kb, usage.rss_kb, usage.fds, buffers);
+            if (!ok && nullptr == growth_) {
+                fprintf(stderr, "GROWTH: %s over the first sample for %d samples\n", what, SOAK_GROWTH_SAMPLES);
+                growth_ = what;
+            }
+        }
+    private:
+        soak_options options_;
+        std::vector<worker_state> workers_;
+        std::shared_ptr<buffer_allocator> allocator_;
+        op_totals totals_;
+        latency_histogram latency_;
+        std::mutex hold_mutex_[CAM_INPUTS];                 // < A hold of the input against its destroy
+        std::mutex listen_mutex_;
+        std::map<camera_controller *, std::weak_ptr<camera_controller>> listened_;
+        std::map<int, int> mirrors_;                        // < Last mirror id by input
+        std::mutex worst_mutex_;
+        uint64_t worst_op_ns_ = 0;
+        int worst_op_ = -1;
+        growth_monitor monitor_;
+        const char *growth_ = nullptr;
+    };
+    bool parse(int argc, char **argv, soak_options &options) {
+        int opt = 0;
+        while ((opt = getopt(argc, argv, "t:w:g:i:s:f:v")) != -1) {
+            switch (opt) {
+            case 't':
+                options.seconds = atoi(optarg);
+                break;
+            case 'w':
+                options.workers = atoi(optarg);
+                break;
+            case 'g':
+                options.gap_ms = atoi(optarg);
+                break;
+            case 'i':
+                options.interval_s = atoi(optarg);
+                break;
+            case 's':
+                options.seed = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+                break;
+            case 'f':
+                options.faults = atof(optarg);
+                break;
+            case 'v':
+                options.verbose = true;
+                break;
+            default:
+                return false;
+            }
+        }
+        return options.seconds > 0 && options.workers > 0 && options.gap_ms >= 0 && options.interval_s > 0 &&
+               options.faults >= 0;
+    }
+    bool check(bool ok, const char *what) {
+        if (!ok) {
+            fprintf(stderr, "LEAK: %s\n", what);
+        }
+        return ok;
+    }
+}
+int main(int argc, char **argv) {
+    soak_options options;
+    if (!parse(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [-t seconds] [-w workers] [-g max ms between operations] "
+                "[-i seconds between usage samples] [-s seed] [-f fault scale] [-v]\n", argv[0]);
+        return 2;
+    }
+    if (!options.verbose && nullptr == freopen("/dev/null", "w", stdout)) {
+        return 2;
+    }
+    sim_config config;
+    config.seed = options.seed;
+    config.get_frame_timeout_rate = 0.002 * options.faults;
+    config.release_fail_rate = 0.0005 * options.faults;
+    config.error_event_rate = 0.002 * options.faults;
+    config.signal_loss_rate = 0.0005 * options.faults;
+    sim_configure(config);
+    if (!G_CAMERA_MANAGER.init()) {
+        fprintf(stderr, "camera manager init failed\n");
+        return 2;
+    }
+    // a first round and its teardown leave the lazily made singletons, the thread stack cache and the
+    // arenas of the allocator at their steady size, the measured round has to come back to it
+    std::unique_ptr<soak_run> run(new soak_run(options));
+    uint64_t begin = monotonic_ns();
+    run->run(std::max(options.seconds / 5, 1));
+    if (!run->teardown()) {
+        fprintf(stderr, "HANG: teardown over %d ms\n", SOAK_TEARDOWN_MS);
+        return 3;
+    }
+    process_usage baseline = read_usage();
+    fprintf(stderr, "soak %d s, %d workers, seed %u, faults x%.2f; baseline %d threads, heap %ld kB, rss %ld kB, "
+            "%d fds\n", options.seconds, options.workers, options.seed, options.faults, baseline.threads,
+            baseline.heap_kb, baseline.rss_kb, baseline.fds);
+    run->run(options.seconds, true);
+    if (!run->teardown()) {
+        fprintf(stderr, "HANG: teardown over %d ms\n", SOAK_TEARDOWN_MS);
+        return 3;
+    }
+    double seconds = (monotonic_ns() - begin) / 1e9;
+    bool ok = true;
+    run->report(seconds);
+    sim_counters counters = sim_get_counters();
+    fprintf(stderr, "sim produced %llu delivered %llu released %llu starved %llu dropped %llu, posts %llu flushes %llu\n",
+            static_cast<unsigned long long>(counters.frames_produced),
+            static_cast<unsigned long long>(counters.frames_delivered),
+            static_cast<unsigned long long>(counters.frames_released),
+            static_cast<unsigned long long>(counters.frames_starved),
+            static_cast<unsigned long long>(counters.frames_dropped),
+            static_cast<unsigned long long>(counters.posts), static_cast<unsigned long long>(counters.flushes));
+    fprintf(stderr, "faults: %llu get_frame timeouts, %llu release failures, %llu error events, %llu signal losses\n",
+            static_cast<unsigned long long>(counters.injected_timeouts),
+            static_cast<unsigned long long>(counters.injected_release_failures),
+            static_cast<unsigned long long>(counters.injected_errors),
+            static_cast<unsigned long long>(counters.injected_signal_losses));
+    fprintf(stderr, "closes %llu, buffers held at close %llu, bad calls %llu\n",
+            static_cast<unsigned long long>(counters.closes), static_cast<unsigned long long>(counters.held_at_close),
+            static_cast<unsigned long long>(counters.bad_calls));
+    // the one buffer the display keeps per connection is given back by the close itself
+    ok = check(0 == counters.open_handles && 0 == counters.started_handles, "qcarcam handles left open") && ok;
+    ok = check(0 == counters.windows && 0 == counters.window_buffers && 0 == counters.contexts,
+               "screen windows, buffers or contexts left") && ok;
+    ok = check(counters.held_at_close <= counters.closes, "capture buffers held past the display reference") && ok;
+    ok = check(0 == counters.bad_calls, "calls on closed handles or foreign buffers") && ok;
+    ok = check(nullptr == run->growth(), "growth during the run") && ok;
+    run.reset();
+    process_usage after = read_usage();
+    fprintf(stderr, "after teardown %d threads, heap %ld kB, rss %ld kB, %d fds\n", after.threads, after.heap_kb,
+            after.rss_kb, after.fds);
+    ok = check(after.threads <= baseline.threads, "threads") && ok;
+    ok = check(after.fds <= baseline.fds, "file descriptors") && ok;
+    ok = check(after.heap_kb <= baseline.heap_kb + SOAK_HEAP_SLACK_KB, "heap memory") && ok;
+    fprintf(stderr, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
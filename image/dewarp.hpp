@@ -0,0 +1,244 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "qcarcam_types.h"
+#include "simd.hpp"
+#include "luma.hpp"
+#include "thread_pool.hpp"
+namespace qnx_screen_camera {
+    struct fisheye_intrinsics {         // equidistant fisheye with the Kannala-Brandt polynomial (OpenCV fisheye)
+        double fx = 0;
+        double fy = 0;
+        double cx = 0;
+        double cy = 0;
+        double k[4] = { 0 };            // < theta_d = theta * (1 + k0 theta^2 + k1 theta^4 + k2 theta^6 + k3 theta^8)
+        int width = 0;                  // < Calibrated image size, the intrinsics are scaled to the frame
+        int height = 0;
+    };
+    enum dewarp_projection_type {
+        DEWARP_PERSPECTIVE = 0,         // < Straight lines stay straight, hfov well below 180
+        DEWARP_CYLINDRICAL,             // < Wide panorama, vertical lines stay straight
+    };
+    struct dewarp_projection {          // the virtual camera the output shows
+        dewarp_projection_type type = DEWARP_PERSPECTIVE;
+        int width = 1280;
+        int height = 720;
+        double hfov_deg = 100.0;
+        double yaw_deg = 0;             // < Rotation of the virtual camera against the fisheye, right positive
+        double pitch_deg = 0;           // < Down positive
+        double roll_deg = 0;
+    };
+    enum remap_param : uint32_t {
+        REMAP_FRACTION_BITS = 4,        // < Source coordinates are 12.4 fixed point
+        REMAP_ONE = 1u << REMAP_FRACTION_BITS,
+        REMAP_INVALID = 0xFFFFFFFFu,    // < Output pixel sees nothing of the source, drawn black
+        REMAP_MAX_SIZE = 4096,
+    };
+    // output pixel to source position table, one uint32 per pixel with x in the low and y in the
+    // high 16 bits, both 12.4 fixed point and at most size - 2 so the 2x2 neighbourhood is inside
+    struct remap_lut {
+        int width = 0;
+        int height = 0;
+        int src_width = 0;
+        int src_height = 0;
+        std::vector<uint32_t> map;
+    };
+    // camera space ray (x right, y down, z along the axis) to a packed lut entry of a src_width x
+    // src_height frame, sx/sy scale the calibrated size to the frame; returns the ray angle to the
+    // axis in radians, out is left untouched when the ray misses the image
+    inline double fisheye_project(const fisheye_intrinsics &lens, double x, double y, double z, double sx, double sy,
+                                  int src_width, int src_height, uint32_t &out) {
+        double r = sqrt(x * x + y * y);
+        double theta = atan2(r, z);
+        double t2 = theta * theta;
+        double theta_d = theta * (1 + t2 * (lens.k[0] + t2 * (lens.k[1] + t2 * (lens.k[2] + t2 * lens.k[3]))));
+        double scale = r > 1e-12 ? theta_d / r : 0.0;
+        double px = (lens.fx * x * scale + lens.cx) * sx;
+        double py = (lens.fy * y * scale + lens.cy) * sy;
+        if (px < 0 || py < 0 || px > src_width - 2 || py > src_height - 2) {
+            return theta;
+        }
+        uint32_t fx = static_cast<uint32_t>(px * REMAP_ONE + 0.5);
+        uint32_t fy = static_cast<uint32_t>(py * REMAP_ONE + 0.5);
+        out = (fy << 16) | fx;
+        return theta;
+    }
+    // built once per camera and view; pool may be nullptr
+    inline bool build_fisheye_lut(const fisheye_intrinsics &lens, const dewarp_projection &proj,
+                                  int src_width, int src_height, thread_pool *pool, remap_lut &lut) {
+        if (proj.width <= 0 || proj.height <= 0 || src_width < 2 || src_height < 2 ||
+            src_width > static_cast<int>(REMAP_MAX_SIZE) || src_height > static_cast<int>(REMAP_MAX_SIZE) ||
+            lens.fx <= 0 || lens.fy <= 0) {
+            LOG_E("dewarp: bad lut size %dx%d from %dx%d", proj.width, proj.height, src_width, src_height);
+            return false;
+        }
+        lut.width = proj.width;
+        lut.height = proj.height;
+        lut.src_width = src_width;
+        lut.src_height = src_height;
+        lut.map.assign(static_cast<size_t>(proj.width) * proj.height, REMAP_INVALID);
+        const double deg = M_PI / 180.0;
+        double sx = lens.width > 0 ? static_cast<double>(src_width) / lens.width : 1.0;
+        double sy = lens.height > 0 ? static_cast<double>(src_height) / lens.height : 1.0;
+        double hfov = std::min(std::max(proj.hfov_deg, 1.0), DEWARP_PERSPECTIVE == proj.type ? 170.0 : 360.0) * deg;
+        double f = DEWARP_PERSPECTIVE == proj.type ? proj.width / 2.0 / tan(hfov / 2) : proj.width / hfov;
+        // rotation of the virtual camera: yaw around y, then pitch around x, then roll around z
+        double cy_ = cos(proj.yaw_deg * deg), sy_ = sin(proj.yaw_deg * deg);
+        double cp = cos(proj.pitch_deg * deg), sp = sin(proj.pitch_deg * deg);
+        double cr = cos(proj.roll_deg * deg), sr = sin(proj.roll_deg * deg);
+        const double rot[9] = {
+            cy_ * cr + sy_ * sp * sr, -cy_ * sr + sy_ * sp * cr, sy_ * cp,
+            cp * sr,                  cp * cr,                   -sp,
+            -sy_ * cr + cy_ * sp * sr, sy_ * sr + cy_ * sp * cr, cy_ * cp
+        };
+        auto build_row = [&](int v) {
+            uint32_t *out = lut.map.data() + static_cast<size_t>(v) * proj.width;
+            double ry = (v + 0.5 - proj.height / 2.0) / f;
+            for (int u = 0;u < proj.width;++u) {
+                double a = (u + 0.5 - proj.width / 2.0) / f;
+                double ray[3] = { a, ry, 1.0 };
+                if (DEWARP_CYLINDRICAL == proj.type) {
+                    ray[0] = sin(a);
+                    ray[2] = cos(a);
+                }
+                double x = rot[0] * ray[0] + rot[1] * ray[1] + rot[2] * ray[2];
+                double y = rot[3] * ray[0] + rot[4] * ray[1] + rot[5] * ray[2];
+                double z = rot[6] * ray[0] + rot[7] * ray[1] + rot[8] * ray[2];
+                fisheye_project(lens, x, y, z, sx, sy, src_width, src_height, out[u]);
+            }
+        };
+        if (pool) {
+            pool->parallel_for(proj.height, build_row);
+        }
+        else {
+            for (int v = 0;v < proj.height;++v) {
+                build_row(v);
+            }
+        }
+        return true;
+    }
+    // (p00 (1-fx) + p01 fx) (1-fy) + (p10 (1-fx) + p11 fx) fy with 4 bit weights, fits 16 bits
+    inline simd::u16x8 bilinear_4bit(const simd::u16x8 &p00, const simd::u16x8 &p01, const simd::u16x8 &p10,
+                                     const simd::u16x8 &p11, const simd::u16x8 &fx, const simd::u16x8 &fy) {
+        const simd::u16x8 one = simd::splat<simd::u16x8>(REMAP_ONE);
+        simd::u16x8 top = p00 * (one - fx) + p01 * fx;
+        simd::u16x8 bottom = p10 * (one - fx) + p11 * fx;
+        return (top * (one - fy) + bottom * fy + simd::splat<simd::u16x8>(128)) >> 8;
+    }
+    // applies a remap_lut to packed 4:2:2 frames: luma and the chroma pairs are sampled bilinearly,
+    // 8 lanes at a time, over output tiles small enough that their source footprint stays in cache
+    class remap_engine {
+    public:
+        enum : int {
+            TILE_W = 64,                // < Output pixels, even so chroma pairs never straddle tiles
+            TILE_H = 16,
+            LANES = 8,
+        };
+        // output has the lut size and the source format; pool may be nullptr
+        bool remap(const remap_lut &lut, const uint8_t *src, uint32_t src_stride, qcarcam_color_fmt_t format,
+                   uint8_t *dst, uint32_t dst_stride, thread_pool *pool) {
+            int luma = luma_packed_offset(format);
+            if (nullptr == src || nullptr == dst || luma < 0 || lut.map.empty() ||
+                QCARCAM_COLOR_GET_BITDEPTH(format) != QCARCAM_BITDEPTH_8) {
+                LOG_E("dewarp: format 0x%x not supported", format);
+                return false;
+            }
+            job work = { &lut, src, src_stride, dst, dst_stride, luma, 1 - luma };     // chroma at 0/2 or 1/3
+            int tiles_x = (lut.width + TILE_W - 1) / TILE_W;
+            int tiles_y = (lut.height + TILE_H - 1) / TILE_H;
+            auto run_tile = [&work, tiles_x](int t) {
+                remap_tile(work, (t % tiles_x) * TILE_W, (t / tiles_x) * TILE_H);
+            };
+            if (pool) {
+                pool->parallel_for(tiles_x * tiles_y, run_tile);
+            }
+            else {
+                for (int t = 0;t < tiles_x * tiles_y;++t) {
+                    run_tile(t);
+                }
+            }
+            return true;
+        }
+    private:
+        struct job {
+            const remap_lut *lut;
+            const uint8_t *src;
+            uint32_t src_stride;
+            uint8_t *dst;
+            uint32_t dst_stride;
+            int luma;                   // < Byte of the first Y in a pixel pair
+            int chroma;                 // < Byte of the first chroma sample, the second is 2 further
+        };
+        static void remap_tile(const job &j, int x0, int y0) {
+            using simd::u16x8;
+            using simd::load;
+            const remap_lut &lut = *j.lut;
+            const int x1 = std::min(x0 + static_cast<int>(TILE_W), lut.width);
+            const int y1 = std::min(y0 + static_cast<int>(TILE_H), lut.height);
+            const int chroma_last = lut.src_width / 2 - 1;
+            for (int y = y0;y < y1;++y) {
+                const uint32_t *map = lut.map.data() + static_cast<size_t>(y) * lut.width;
+                uint8_t *out = j.dst + static_cast<size_t>(y) * j.dst_stride;
+                for (int x = x0;x < x1;x += LANES) {
+                    int n = std::min(static_cast<int>(LANES), x1 - x);
+                    // gathered into arrays first, lane inserts into vector registers are slow
+                    uint16_t p[4][LANES], w[2][LANES], c[4][LANES], cw[2][LANES];
+                    for (int lane = 0;lane < LANES;++lane) {
+                        uint32_t m = lane < n ? map[x + lane] : REMAP_INVALID;
+                        if (REMAP_INVALID == m) {
+                            p[0][lane] = p[1][lane] = p[2][lane] = p[3][lane] = 16;     // black
+                            w[0][lane] = w[1][lane] = 0;
+                            if (0 == (lane & 1)) {
+                                c[0][lane] = c[1][lane] = c[2][lane] = c[3][lane] = 128;
+                                c[0][lane + 1] = c[1][lane + 1] = c[2][lane + 1] = c[3][lane + 1] = 128;
+                                cw[0][lane] = cw[1][lane] = cw[0][lane + 1] = cw[1][lane + 1] = 0;
+                            }
+                            continue;
+                        }
+                        uint32_t sx = m & 0xFFFF, sy = m >> 16;
+                        const uint8_t *row = j.src + static_cast<size_t>(sy >> REMAP_FRACTION_BITS) * j.src_stride;
+                        const uint8_t *a = row + (sx >> REMAP_FRACTION_BITS) * 2 + j.luma;
+                        p[0][lane] = a[0];
+                        p[1][lane] = a[2];
+                        p[2][lane] = a[j.src_stride];
+                        p[3][lane] = a[j.src_stride + 2];
+                        w[0][lane] = sx & (REMAP_ONE - 1);
+                        w[1][lane] = sy & (REMAP_ONE - 1);
+                        if (lane & 1) {
+                            continue;
+                        }
+                        // one chroma pair per two pixels, sampled where the even pixel maps; its two
+                        // bytes take lanes 2k and 2k + 1 with the same weights
+                        uint32_t cx = sx >> 1;                                  // chroma units, 12.4
+                        int g0 = cx >> REMAP_FRACTION_BITS;
+                        int g1 = std::min(g0 + 1, chroma_last);
+                        const uint8_t *b = row + j.chroma;
+                        for (int k = 0;k < 2;++k) {
+                            c[0][lane + k] = b[g0 * 4 + 2 * k];
+                            c[1][lane + k] = b[g1 * 4 + 2 * k];
+                            c[2][lane + k] = b[g0 * 4 + 2 * k + j.src_stride];
+                            c[3][lane + k] = b[g1 * 4 + 2 * k + j.src_stride];
+                            cw[0][lane + k] = cx & (REMAP_ONE - 1);
+                            cw[1][lane + k] = w[1][lane];
+                        }
+                    }
+                    u16x8 luma = bilinear_4bit(load<u16x8>(p[0]), load<u16x8>(p[1]), load<u16x8>(p[2]),
+                                               load<u16x8>(p[3]), load<u16x8>(w[0]), load<u16x8>(w[1]));
+                    u16x8 chroma = bilinear_4bit(load<u16x8>(c[0]), load<u16x8>(c[1]), load<u16x8>(c[2]),
+                                                 load<u16x8>(c[3]), load<u16x8>(cw[0]), load<u16x8>(cw[1]));
+                    // pixel l is bytes 2l, 2l + 1 holding chroma lane l and its luma, little endian
+                    u16x8 packed = j.luma ? (chroma | (luma << 8)) : (luma | (chroma << 8));
+                    if (LANES == n) {
+                        simd::store(out + x * 2, packed);
+                    }
+                    else {
+                        memcpy(out + x * 2, &packed, n * 2);
+                    }
+                }
+            }
+        }
+    };
+}
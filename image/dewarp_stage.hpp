@@ -0,0 +1,159 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "clock.hpp"
+#include "dewarp.hpp"
+#include "frame_consumer.hpp"
+namespace qnx_screen_camera {
+    struct dewarp_config {
+        fisheye_intrinsics lens;
+        dewarp_projection view;         // < Its size is the output buffer size
+        int threads = 0;                // < Remap threads including the stage thread, <= 0 uses up to 4 cores
+        int num_buffers = 3;            // < Display pool, 3 or more keeps the buffer written off screen
+        uint64_t min_interval_ns = 0;   // < Dewarp at most one frame per interval, 0 for every frame
+    };
+    // shows a corrected view of a fisheye camera in its own window stacked on the camera window;
+    // the remap table is rebuilt only when the view or the frame size changes
+    class dewarp_stage : public frame_consumer {
+    public:
+        dewarp_stage(const std::shared_ptr<camera_controller> &camera, const dewarp_config &config)
+            : frame_consumer(camera, "dewarp", config.min_interval_ns), config_(config) {
+            int threads = config_.threads;
+            if (threads <= 0) {
+                threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+            }
+            pool_.reset(new thread_pool(threads - 1, camera->get_attr().thread_attr, camera->thread_name("warp")));
+        }
+        virtual ~dewarp_stage() {
+            stop();
+        }
+        // the output window covers the camera window one zorder higher, call before start()
+        bool init_display() {
+            auto below = camera()->get_window();
+            int size[2] = { 0 }, pos[2] = { 0 }, zorder = 0;
+            if (!below || !below->get_property(WIN_PROP_SIZE, size) || !below->get_property(WIN_PROP_POSITION, pos)) {
+                LOG_E("dewarp needs the camera window!");
+                return false;
+            }
+            if (!below->get_property(WIN_PROP_ZORDER, &zorder)) {
+                zorder = 0;
+            }
+            const display_property *display_pro = below->get_display_property();
+            if (nullptr == display_pro || display_pro->size[0] <= 0 || display_pro->size[1] <= 0) {
+                LOG_E("dewarp display %d error!", below->get_display_id());
+                return false;
+            }
+            screen_attribute attr;
+            attr.display_id = below->get_display_id();
+            attr.window_size = { static_cast<double>(size[0]) / display_pro->size[0],
+                                 static_cast<double>(size[1]) / display_pro->size[1] };
+            attr.window_pos = { static_cast<double>(pos[0]) / display_pro->size[0],
+                                static_cast<double>(pos[1]) / display_pro->size[1] };
+            attr.buffer_size = { config_.view.width, config_.view.height };
+            attr.zorder = zorder + 1;
+            attr.format = screen_format(camera()->get_attr().format);
+            attr.usage = SCREEN_USAGE_WRITE | SCREEN_USAGE_NATIVE;
+            if (attr.format < 0) {
+                LOG_E("dewarp format 0x%x not supported", camera()->get_attr().format);
+                return false;
+            }
+            win_ = std::make_shared<screen_window>(std::make_shared<screen_context>());
+            if (!win_->init(attr)) {
+                return false;
+            }
+            window_buffer_attr bufferAttr;
+            bufferAttr.num = std::max(config_.num_buffers, 2);
+            bufferAttr.size[0] = attr.buffer_size.x;
+            bufferAttr.size[1] = attr.buffer_size.y;
+            if (!win_->init_buffer(bufferAttr)) {
+                LOG_E("dewarp init buffer error!");
+                return false;
+            }
+            for (auto &handle : win_->get_win_buf().handles) {
+                if (nullptr == handle.ptr[0]) {
+                    LOG_E("dewarp buffer not mapped!");
+                    return false;
+                }
+            }
+            return true;
+        }
+        // takes effect from the next frame
+        void set_view(const dewarp_projection &view) {
+            std::lock_guard<std::mutex> guard(view_mutex_);
+            if (view.width != config_.view.width || view.height != config_.view.height) {
+                LOG_W("dewarp view size is fixed at %dx%d", config_.view.width, config_.view.height);
+            }
+            config_.view.type = view.type;
+            config_.view.hfov_deg = view.hfov_deg;
+            config_.view.yaw_deg = view.yaw_deg;
+            config_.view.pitch_deg = view.pitch_deg;
+            config_.view.roll_deg = view.roll_deg;
+            view_changed_ = true;
+        }
+        inline double last_remap_ms() const {
+            return last_remap_ns_ / 1e6;
+        }
+        inline const std::shared_ptr<screen_window> &get_window() const {
+            return win_;
+        }
+    protected:
+        void process(const camera_frame &frame) override {
+            if (!win_ || nullptr == frame.data) {
+                return;
+            }
+            if (!prepare_lut(frame)) {
+                return;
+            }
+            auto &buffer = win_->get_win_buf();
+            next_ = (next_ + 1) % static_cast<int>(buffer.handles.size());
+            uint64_t start = monotonic_ns();
+            if (!engine_.remap(lut_, frame.data, frame.stride, frame.format,
+                               static_cast<uint8_t *>(buffer.handles[next_].ptr[0]), buffer.stride[0], pool_.get())) {
+                return;
+            }
+            last_remap_ns_ = monotonic_ns() - start;
+            int rect[4] = { 0, 0, lut_.width, lut_.height };
+            win_->post_buffer(next_, rect, 1, 0);
+        }
+    private:
+        bool prepare_lut(const camera_frame &frame) {
+            dewarp_projection view;
+            {
+                std::lock_guard<std::mutex> guard(view_mutex_);
+                if (!view_changed_ && lut_.src_width == static_cast<int>(frame.width) &&
+                    lut_.src_height == static_cast<int>(frame.height)) {
+                    return true;
+                }
+                view = config_.view;
+                view_changed_ = false;
+            }
+            uint64_t start = monotonic_ns();
+            if (!build_fisheye_lut(config_.lens, view, frame.width, frame.height, pool_.get(), lut_)) {
+                lut_.map.clear();
+                return false;
+            }
+            LOG_I("dewarp lut %dx%d from %ux%u built in %.1f ms", lut_.width, lut_.height,
+                  frame.width, frame.height, (monotonic_ns() - start) / 1e6);
+            return true;
+        }
+        // the remap handles packed 4:2:2 only, so the planar formats have no window format here
+        static int screen_format(qcarcam_color_fmt_t format) {
+            const format_traits traits = format_traits_of(format);
+            return traits.luma_offset >= 0 ? traits.screen_format : -1;
+        }
+    private:
+        dewarp_config config_;
+        std::mutex view_mutex_;
+        bool view_changed_ = true;
+        std::unique_ptr<thread_pool> pool_;
+        std::shared_ptr<screen_window> win_;
+        remap_lut lut_;
+        remap_engine engine_;
+        int next_ = -1;
+        std::atomic<uint64_t> last_remap_ns_{0};
+    };
+}
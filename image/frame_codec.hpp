@@ -0,0 +1,485 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "simd.hpp"
+#include "clock.hpp"
+#include "thread_pool.hpp"
+#include "format_traits.hpp"
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    enum frame_codec_param : uint32_t {
+        CODEC_FRAME_MAGIC = 0x31434651,     // < "QFC1"
+        CODEC_VERSION = 1,
+        CODEC_SLICE_ROWS = 32,              // < Default rows per slice, each slice is coded on its own
+        CODEC_MAX_CODE_BITS = 12,           // < Longest Huffman code, also the decode table index width
+        CODEC_TABLE_BYTES = 128,            // < 256 code lengths as nibbles in front of a Huffman slice
+    };
+    enum codec_slice_mode : uint8_t {
+        CODEC_SLICE_RAW = 0,                // < Rows as they are, the prediction did not pay off
+        CODEC_SLICE_HUFFMAN = 1,            // < Code lengths, then the MSB first codes of the residuals
+    };
+    struct codec_frame_header {             // in front of every coded frame, followed by the slice table
+        uint32_t magic = CODEC_FRAME_MAGIC;
+        uint16_t version = CODEC_VERSION;
+        uint16_t slices = 0;
+        uint32_t format = 0;                // < qcarcam_color_fmt_t of the source
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t size = 0;                  // < Bytes of the decoded frame, planes tightly packed
+    };
+    struct codec_slice {
+        uint32_t first_row = 0;
+        uint16_t rows = 0;
+        uint8_t plane = 0;
+        uint8_t mode = CODEC_SLICE_RAW;
+        uint32_t size = 0;                  // < Coded bytes, slices follow the table back to back
+    };
+    static_assert(24 == sizeof(codec_frame_header), "codec_frame_header is stored as is");
+    static_assert(12 == sizeof(codec_slice), "codec_slice is stored as is");
+    // where a byte finds the previous sample of its own component: lanes set in near_mask (repeating
+    // every 16 bytes) look near bytes back, the others far, e.g. Y and chroma of UYVY at 2 and 4
+    struct codec_predictor {
+        uint8_t near_distance = 1;
+        uint8_t far_distance = 1;
+        uint16_t near_mask = 0xffff;
+        inline int distance(uint32_t x) const {
+            return (near_mask >> (x & 15)) & 1 ? near_distance : far_distance;
+        }
+    };
+    inline codec_predictor codec_predictor_of(qcarcam_color_fmt_t format, int plane) {
+        const format_traits traits = format_traits_of(format);
+        const qcarcam_color_pattern_t pattern = QCARCAM_COLOR_GET_PATTERN(format);
+        codec_predictor pred;
+        if (traits.luma_offset >= 0) {
+            pred.near_distance = 2;
+            pred.far_distance = 4;
+            pred.near_mask = traits.luma_offset ? 0xaaaa : 0x5555;
+        }
+        else if (-1 == traits.luma_offset) {
+            pred.near_distance = pred.far_distance = plane ? 2 : 1;
+        }
+        else {
+            // a Bayer site repeats every second pixel; MIPI packing is predicted byte wise
+            int bytes = std::max(traits.row_bits[plane] / 8, 1);
+            bool bayer = pattern >= QCARCAM_BAYER_GBRG && pattern <= QCARCAM_BAYER_BGGR;
+            pred.near_distance = pred.far_distance = static_cast<uint8_t>(std::min(bayer ? 2 * bytes : bytes, 16));
+        }
+        return pred;
+    }
+    // LOCO-I median edge detector of left a, up b and up left c; it is median(a, b, a + b - c), so in
+    // the unclamped case a + b - c lies between a and b and the 8 bit wrap is exact
+    inline uint8_t codec_med(uint8_t a, uint8_t b, uint8_t c) {
+        uint8_t mn = std::min(a, b);
+        uint8_t mx = std::max(a, b);
+        return c >= mx ? mn : c <= mn ? mx : static_cast<uint8_t>(a + b - c);
+    }
+    // residuals fold to 0, -1, 1, -2 ... -> 0, 1, 2, 3 ... so small errors get the short codes
+    inline uint8_t codec_zigzag(uint8_t r) {
+        return static_cast<uint8_t>((r << 1) ^ static_cast<uint8_t>(static_cast<int8_t>(r) >> 7));
+    }
+    inline uint8_t codec_unzigzag(uint8_t z) {
+        return static_cast<uint8_t>((z >> 1) ^ static_cast<uint8_t>(-(z & 1)));
+    }
+    // code lengths of a Huffman code over the counts, at most CODEC_MAX_CODE_BITS long: the counts are
+    // flattened and the tree rebuilt until it fits, which costs little on residual histograms
+    inline void codec_code_lengths(const uint32_t *count, uint8_t *lengths) {
+        uint32_t freq[256];
+        memcpy(freq, count, sizeof(freq));
+        while (true) {
+            typedef std::pair<uint64_t, int> weighted;
+            std::priority_queue<weighted, std::vector<weighted>, std::greater<weighted>> queue;
+            int parent[511];
+            uint8_t depth[511];
+            memset(lengths, 0, 256);
+            for (int s = 0;s < 256;++s) {
+                if (freq[s]) {
+                    queue.push(weighted(freq[s], s));
+                }
+            }
+            if (queue.size() <= 1) {        // a single symbol still needs one bit
+                if (!queue.empty()) {
+                    lengths[queue.top().second] = 1;
+                }
+                return;
+            }
+            int next = 256;
+            while (queue.size() > 1) {
+                weighted a = queue.top();
+                queue.pop();
+                weighted b = queue.top();
+                queue.pop();
+                parent[a.second] = parent[b.second] = next;
+                queue.push(weighted(a.first + b.first, next++));
+            }
+            const int root = next - 1;
+            depth[root] = 0;
+            for (int n = root - 1;n >= 256;--n) {       // parents are created after their children
+                depth[n] = depth[parent[n]] + 1;
+            }
+            int longest = 0;
+            for (int s = 0;s < 256;++s) {
+                if (freq[s]) {
+                    lengths[s] = depth[parent[s]] + 1;
+                    longest = std::max(longest, static_cast<int>(lengths[s]));
+                }
+            }
+            if (longest <= static_cast<int>(CODEC_MAX_CODE_BITS)) {
+                return;
+            }
+            for (int s = 0;s < 256;++s) {
+                if (freq[s]) {
+                    freq[s] = (freq[s] >> 1) | 1;
+                }
+            }
+        }
+    }
+    // canonical codes of the lengths, as deflate assigns them
+    inline void codec_canonical_codes(const uint8_t *lengths, uint16_t *codes) {
+        int count[CODEC_MAX_CODE_BITS + 1] = { 0 };
+        uint16_t next[CODEC_MAX_CODE_BITS + 1] = { 0 };
+        for (int s = 0;s < 256;++s) {
+            ++count[lengths[s]];
+        }
+        count[0] = 0;
+        uint16_t code = 0;
+        for (int bits = 1;bits <= static_cast<int>(CODEC_MAX_CODE_BITS);++bits) {
+            code = static_cast<uint16_t>((code + count[bits - 1]) << 1);
+            next[bits] = code;
+        }
+        for (int s = 0;s < 256;++s) {
+            codes[s] = lengths[s] ? next[lengths[s]]++ : 0;
+        }
+    }
+    // lossless predictive codec of captured frames: every plane is cut into slices of rows, each slice
+    // predicts its bytes with the median edge detector from the same component left and above (the
+    // first row of a slice only from the left, so slices decode on their own), folds the residuals and
+    // Huffman codes them with a code built from their histogram. Slices run in parallel on a pool, and
+    // one codec may serve several frames at once, all state of a slice lives on the coding thread
+    class frame_codec {
+    public:
+        explicit frame_codec(int slice_rows = CODEC_SLICE_ROWS)
+            : slice_rows_(std::min(std::max(slice_rows, 1), 0xffff)) {
+        }
+        // out is resized to exactly the coded frame; pool may be nullptr. busy_ns, if given, gets the
+        // time the slices took summed over the threads that coded them, what the frame cost in cores
+        bool encode(const camera_frame &frame, std::vector<uint8_t> &out, thread_pool *pool,
+                    uint64_t *busy_ns = nullptr) const {
+            plane_layout layout;
+            if (nullptr == frame.data || !get_plane_layout(frame.format, frame.width, frame.height, frame.stride,
+                                                           frame.plane_offset, layout)) {
+                LOG_E("codec: frame of input %d not mapped or format 0x%x not supported", frame.input_id, frame.format);
+                return false;
+            }
+            codec_frame_header header;
+            header.format = frame.format;
+            header.width = frame.width;
+            header.height = frame.height;
+            std::vector<codec_slice> slices;
+            std::vector<size_t> regions;            // < Where each slice is coded before the compaction
+            size_t region = 0;
+            for (int p = 0;p < layout.planes;++p) {
+                uint32_t row_bytes = min_stride(frame.format, frame.width, p);
+                header.size += row_bytes * layout.height[p];
+                for (uint32_t y = 0;y < layout.height[p];y += slice_rows_) {
+                    codec_slice slice;
+                    slice.first_row = y;
+                    slice.rows = static_cast<uint16_t>(std::min<uint32_t>(slice_rows_, layout.height[p] - y));
+                    slice.plane = static_cast<uint8_t>(p);
+                    slices.push_back(slice);
+                    regions.push_back(region);
+                    region += CODEC_TABLE_BYTES + row_bytes * slice.rows;
+                }
+            }
+            header.slices = static_cast<uint16_t>(slices.size());
+            if (slices.size() > 0xffff) {
+                return false;
+            }
+            const size_t head = sizeof(header) + slices.size() * sizeof(codec_slice);
+            out.resize(head + region);
+            uint8_t *body = out.data() + head;
+            std::atomic<uint64_t> busy{0};
+            auto code = [&](int i) {
+                uint64_t begin = monotonic_ns();
+                codec_slice &slice = slices[i];
+                int p = slice.plane;
+                const uint32_t offset = p ? (frame.plane_offset ? frame.plane_offset : layout.offset[1]) : 0;
+                const uint8_t *src = frame.data + offset + slice.first_row * layout.stride[p];
+                slice.size = static_cast<uint32_t>(encode_slice(src, layout.stride[p], min_stride(frame.format, frame.width, p),
+                                                                slice.rows, codec_predictor_of(frame.format, p),
+                                                                body + regions[i], slice.mode));
+                busy += monotonic_ns() - begin;
+            };
+            if (pool != nullptr) {
+                pool->parallel_for(static_cast<int>(slices.size()), code);
+            }
+            else {
+                for (int i = 0;i < static_cast<int>(slices.size());++i) {
+                    code(i);
+                }
+            }
+            size_t end = 0;
+            for (size_t i = 0;i < slices.size();++i) {
+                memmove(body + end, body + regions[i], slices[i].size);
+                end += slices[i].size;
+            }
+            memcpy(out.data(), &header, sizeof(header));
+            memcpy(out.data() + sizeof(header), slices.data(), slices.size() * sizeof(codec_slice));
+            out.resize(head + end);
+            if (busy_ns != nullptr) {
+                *busy_ns = busy;
+            }
+            return true;
+        }
+        // header of a coded frame, false if data does not hold one this codec understands
+        static bool parse_header(const uint8_t *data, size_t size, codec_frame_header &header) {
+            if (size < sizeof(header)) {
+                return false;
+            }
+            memcpy(&header, data, sizeof(header));
+            return CODEC_FRAME_MAGIC == header.magic && CODEC_VERSION == header.version
+                && size >= sizeof(header) + header.slices * sizeof(codec_slice);
+        }
+        // rebuilds the frame into dst (header.size bytes, planes tightly packed one after the other)
+        bool decode(const uint8_t *data, size_t size, uint8_t *dst, size_t dst_size, thread_pool *pool) const {
+            codec_frame_header header;
+            plane_layout layout;
+            if (!parse_header(data, size, header) || dst_size < header.size
+                || !get_plane_layout(static_cast<qcarcam_color_fmt_t>(header.format), header.width, header.height,
+                                     0, 0, layout)) {
+                LOG_E("codec: not a coded frame or destination too small");
+                return false;
+            }
+            const qcarcam_color_fmt_t format = static_cast<qcarcam_color_fmt_t>(header.format);
+            std::vector<codec_slice> slices(header.slices);
+            memcpy(slices.data(), data + sizeof(header), slices.size() * sizeof(codec_slice));
+            std::vector<size_t> offsets(slices.size());
+            size_t offset = sizeof(header) + slices.size() * sizeof(codec_slice);
+            for (size_t i = 0;i < slices.size();++i) {
+                offsets[i] = offset;
+                offset += slices[i].size;
+                if (slices[i].plane >= layout.planes
+                    || slices[i].first_row + slices[i].rows > layout.height[slices[i].plane]) {
+                    offset = size + 1;
+                    break;
+                }
+            }
+            if (offset > size) {
+                LOG_E("codec: slice table does not match the frame");
+                return false;
+            }
+            std::atomic<bool> ok{true};
+            auto code = [&](int i) {
+                const codec_slice &slice = slices[i];
+                int p = slice.plane;
+                uint32_t row_bytes = layout.stride[p];
+                uint8_t *rows = dst + layout.offset[p] + slice.first_row * row_bytes;
+                if (!decode_slice(data + offsets[i], slice.size, slice.mode, rows, row_bytes, slice.rows,
+                                  codec_predictor_of(format, p))) {
+                    ok = false;
+                }
+            };
+            if (pool != nullptr) {
+                pool->parallel_for(static_cast<int>(slices.size()), code);
+            }
+            else {
+                for (int i = 0;i < static_cast<int>(slices.size());++i) {
+                    code(i);
+                }
+            }
+            return ok;
+        }
+    private:
+        // folded residuals of the rows into res, row after row without padding
+        static void predict(const uint8_t *src, uint32_t stride, uint32_t row_bytes, int rows,
+                            const codec_predictor &pred, uint8_t *res) {
+            using namespace simd;
+            s8x16 near;
+            for (int i = 0;i < VEC_BYTES;++i) {
+                near[i] = (pred.near_mask >> i) & 1 ? -1 : 0;
+            }
+            const int dn = pred.near_distance;
+            const int df = pred.far_distance;
+            static const uint8_t zero_row[1] = { 0 };
+            for (int y = 0;y < rows;++y) {
+                const uint8_t *cur = src + y * stride;
+                const uint8_t *up = y ? cur - stride : zero_row;
+                const uint32_t up_step = y ? 1 : 0;
+                uint8_t *out = res + y * row_bytes;
+                uint32_t x = 0;
+                for (uint32_t head = std::min<uint32_t>(VEC_BYTES, row_bytes);x < head;++x) {
+                    int d = pred.distance(x);
+                    uint8_t a = x >= static_cast<uint32_t>(d) ? cur[x - d] : 0;
+                    uint8_t b = up[x * up_step];
+                    uint8_t c = x >= static_cast<uint32_t>(d) ? up[(x - d) * up_step] : 0;
+                    out[x] = codec_zigzag(static_cast<uint8_t>(cur[x] - codec_med(a, b, c)));
+                }
+                if (y) {
+                    for (;x + VEC_BYTES <= row_bytes;x += VEC_BYTES) {
+                        u8x16 v = load<u8x16>(cur + x);
+                        u8x16 a = select(near, load<u8x16>(cur + x - dn), load<u8x16>(cur + x - df));
+                        u8x16 b = load<u8x16>(up + x);
+                        u8x16 c = select(near, load<u8x16>(up + x - dn), load<u8x16>(up + x - df));
+                        u8x16 mn = vmin(a, b);
+                        u8x16 mx = vmax(a, b);
+                        u8x16 p = select(c >= mx, mn, select(c <= mn, mx, (u8x16)(a + b - c)));
+                        s8x16 r = (s8x16)(v - p);
+                        store(out + x, (u8x16)((r << 1) ^ (r >> 7)));
+                    }
+                }
+                else {
+                    // no row above: the median of a, 0, 0 is a
+                    for (;x + VEC_BYTES <= row_bytes;x += VEC_BYTES) {
+                        u8x16 v = load<u8x16>(cur + x);
+                        u8x16 a = select(near, load<u8x16>(cur + x - dn), load<u8x16>(cur + x - df));
+                        s8x16 r = (s8x16)(v - a);
+                        store(out + x, (u8x16)((r << 1) ^ (r >> 7)));
+                    }
+                }
+                for (;x < row_bytes;++x) {
+                    int d = pred.distance(x);
+                    out[x] = codec_zigzag(static_cast<uint8_t>(cur[x] - codec_med(cur[x - d], up[x * up_step],
+                                                                                   up[(x - d) * up_step])));
+                }
+            }
+        }
+        // codes rows into dst (room for CODEC_TABLE_BYTES + raw bytes), returns the bytes written
+        static size_t encode_slice(const uint8_t *src, uint32_t stride, uint32_t row_bytes, int rows,
+                                   const codec_predictor &pred, uint8_t *dst, uint8_t &mode) {
+            static thread_local std::vector<uint8_t> residuals;
+            const size_t n = static_cast<size_t>(row_bytes) * rows;
+            residuals.resize(n);
+            predict(src, stride, row_bytes, rows, pred, residuals.data());
+            const uint8_t *res = residuals.data();
+            uint32_t hist[4][256] = { { 0 } };      // four tables break the store to load chain on runs
+            size_t i = 0;
+            for (;i + 4 <= n;i += 4) {
+                ++hist[0][res[i]];
+                ++hist[1][res[i + 1]];
+                ++hist[2][res[i + 2]];
+                ++hist[3][res[i + 3]];
+            }
+            for (;i < n;++i) {
+                ++hist[0][res[i]];
+            }
+            uint32_t count[256];
+            for (int s = 0;s < 256;++s) {
+                count[s] = hist[0][s] + hist[1][s] + hist[2][s] + hist[3][s];
+            }
+            uint8_t lengths[256];
+            uint16_t codes[256];
+            codec_code_lengths(count, lengths);
+            uint64_t bits = 0;
+            for (int s = 0;s < 256;++s) {
+                bits += static_cast<uint64_t>(count[s]) * lengths[s];
+            }
+            if (CODEC_TABLE_BYTES + (bits + 7) / 8 >= n) {
+                for (int y = 0;y < rows;++y) {
+                    memcpy(dst + y * row_bytes, src + y * stride, row_bytes);
+                }
+                mode = CODEC_SLICE_RAW;
+                return n;
+            }
+            codec_canonical_codes(lengths, codes);
+            for (int s = 0;s < 256;s += 2) {
+                dst[s / 2] = static_cast<uint8_t>(lengths[s] | (lengths[s + 1] << 4));
+            }
+            uint8_t *out = dst + CODEC_TABLE_BYTES;
+            uint64_t acc = 0;
+            int pending = 0;
+            for (i = 0;i < n;++i) {
+                uint8_t s = res[i];
+                acc = (acc << lengths[s]) | codes[s];
+                pending += lengths[s];
+                if (pending >= 32) {
+                    pending -= 32;
+                    uint32_t word = static_cast<uint32_t>(acc >> pending);
+                    out[0] = static_cast<uint8_t>(word >> 24);
+                    out[1] = static_cast<uint8_t>(word >> 16);
+                    out[2] = static_cast<uint8_t>(word >> 8);
+                    out[3] = static_cast<uint8_t>(word);
+                    out += 4;
+                }
+            }
+            for (;pending > 0;pending -= 8) {
+                *out++ = static_cast<uint8_t>(pending >= 8 ? acc >> (pending - 8) : acc << (8 - pending));
+            }
+            mode = CODEC_SLICE_HUFFMAN;
+            return out - dst;
+        }
+        static bool decode_slice(const uint8_t *data, uint32_t size, uint8_t mode, uint8_t *dst, uint32_t row_bytes,
+                                 int rows, const codec_predictor &pred) {
+            const size_t n = static_cast<size_t>(row_bytes) * rows;
+            if (CODEC_SLICE_RAW == mode) {
+                if (size != n) {
+                    return false;
+                }
+                memcpy(dst, data, n);
+                return true;
+            }
+            if (mode != CODEC_SLICE_HUFFMAN || size < CODEC_TABLE_BYTES) {
+                return false;
+            }
+            uint8_t lengths[256];
+            uint16_t codes[256];
+            for (int s = 0;s < 256;s += 2) {
+                lengths[s] = data[s / 2] & 15;
+                lengths[s + 1] = data[s / 2] >> 4;
+            }
+            codec_canonical_codes(lengths, codes);
+            // entry of every 12 bit window: symbol << 4 | code length, 0 marks a window no code starts
+            static thread_local std::vector<uint16_t> table;
+            table.assign(1u << CODEC_MAX_CODE_BITS, 0);
+            for (int s = 0;s < 256;++s) {
+                int len = lengths[s];
+                if (len > static_cast<int>(CODEC_MAX_CODE_BITS)) {
+                    return false;
+                }
+                if (len) {
+                    uint32_t first = static_cast<uint32_t>(codes[s]) << (CODEC_MAX_CODE_BITS - len);
+                    uint32_t last = first + (1u << (CODEC_MAX_CODE_BITS - len));
+                    if (last > table.size()) {
+                        return false;
+                    }
+                    std::fill(table.begin() + first, table.begin() + last, static_cast<uint16_t>(s << 4 | len));
+                }
+            }
+            const uint8_t *in = data + CODEC_TABLE_BYTES;
+            const uint8_t *end = data + size;
+            uint64_t acc = 0;
+            int avail = 0;
+            for (int y = 0;y < rows;++y) {
+                uint8_t *cur = dst + y * row_bytes;
+                const uint8_t *up = cur - row_bytes;
+                for (uint32_t x = 0;x < row_bytes;++x) {
+                    if (avail < static_cast<int>(CODEC_MAX_CODE_BITS)) {
+                        while (avail <= 56) {
+                            acc |= static_cast<uint64_t>(in < end ? *in++ : 0) << (56 - avail);
+                            avail += 8;
+                        }
+                    }
+                    uint16_t entry = table[acc >> (64 - CODEC_MAX_CODE_BITS)];
+                    int len = entry & 15;
+                    if (0 == len) {
+                        return false;
+                    }
+                    acc <<= len;
+                    avail -= len;
+                    int d = pred.distance(x);
+                    uint8_t a = x >= static_cast<uint32_t>(d) ? cur[x - d] : 0;
+                    uint8_t b = y ? up[x] : 0;
+                    uint8_t c = y && x >= static_cast<uint32_t>(d) ? up[x - d] : 0;
+                    cur[x] = static_cast<uint8_t>(codec_med(a, b, c) + codec_unzigzag(static_cast<uint8_t>(entry >> 4)));
+                }
+            }
+            return true;
+        }
+    private:
+        uint32_t slice_rows_;
+    };
+}
@@ -0,0 +1,459 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "qcarcam_types.h"
+#include "color_log.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+namespace qnx_screen_camera {
+    namespace jpeg_tables {             // internal linkage, header only
+        // ITU-T T.81 Annex K tables, natural order
+        const uint8_t LUMA_QUANT[64] = {
+            16, 11, 10, 16, 24, 40, 51, 61,     12, 12, 14, 19, 26, 58, 60, 55,
+            14, 13, 16, 24, 40, 57, 69, 56,     14, 17, 22, 29, 51, 87, 80, 62,
+            18, 22, 37, 56, 68, 109, 103, 77,   24, 35, 55, 64, 81, 104, 113, 92,
+            49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+        const uint8_t CHROMA_QUANT[64] = {
+            17, 18, 24, 47, 99, 99, 99, 99,     18, 21, 26, 66, 99, 99, 99, 99,
+            24, 26, 56, 99, 99, 99, 99, 99,     47, 66, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,     99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,     99, 99, 99, 99, 99, 99, 99, 99 };
+        // zigzag position to natural index
+        const uint8_t ZIGZAG[64] = {
+            0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48,
+            41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+            30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+        // zigzag position to index in the transposed DCT output
+        const uint8_t ZIGZAG_TRANSPOSED[64] = {
+            0, 8, 1, 2, 9, 16, 24, 17, 10, 3, 4, 11, 18, 25, 32, 40, 33, 26, 19, 12, 5, 6,
+            13, 20, 27, 34, 41, 48, 56, 49, 42, 35, 28, 21, 14, 7, 15, 22, 29, 36, 43, 50, 57, 58,
+            51, 44, 37, 30, 23, 31, 38, 45, 52, 59, 60, 53, 46, 39, 47, 54, 61, 62, 55, 63 };
+        const uint8_t DC_LUMA_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+        const uint8_t DC_LUMA_VALS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+        const uint8_t DC_CHROMA_BITS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+        const uint8_t DC_CHROMA_VALS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+        const uint8_t AC_LUMA_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+        const uint8_t AC_LUMA_VALS[162] = {
+            0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+            0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+            0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+            0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+            0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+            0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+            0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+            0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+            0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+            0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa };
+        const uint8_t AC_CHROMA_BITS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+        const uint8_t AC_CHROMA_VALS[162] = {
+            0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+            0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+            0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+            0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+            0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+            0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+            0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+            0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+            0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+            0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa };
+    }
+    struct jpeg_options {
+        int quality = 85;               // < 1..100, IJG scaling of the Annex K tables
+        bool full_range = false;        // < Source is full range YUV, otherwise video range is expanded
+        int segments_per_thread = 4;    // < Restart intervals per encoding thread, more balances better
+    };
+    // baseline JPEG from the 8 bit YUV capture formats without going through RGB: packed 4:2:2 is
+    // written as 4:2:2, NV12/NV21 as 4:2:0; the image is cut into restart intervals of whole MCU rows
+    // which are entropy coded in parallel and joined with RSTn markers
+    // one encode() at a time per instance, the segment buffers are kept for the next frame
+    class jpeg_encoder {
+    public:
+        explicit jpeg_encoder(const jpeg_options &options = jpeg_options()) {
+            build_huffman(jpeg_tables::DC_LUMA_BITS, jpeg_tables::DC_LUMA_VALS, huff_[0]);
+            build_huffman(jpeg_tables::AC_LUMA_BITS, jpeg_tables::AC_LUMA_VALS, huff_[1]);
+            build_huffman(jpeg_tables::DC_CHROMA_BITS, jpeg_tables::DC_CHROMA_VALS, huff_[2]);
+            build_huffman(jpeg_tables::AC_CHROMA_BITS, jpeg_tables::AC_CHROMA_VALS, huff_[3]);
+            set_options(options);
+        }
+        void set_options(const jpeg_options &options) {
+            options_ = options;
+            options_.quality = std::min(std::max(options_.quality, 1), 100);
+            options_.segments_per_thread = std::max(options_.segments_per_thread, 1);
+            build_quant(jpeg_tables::LUMA_QUANT, quant_[0], recip_[0]);
+            build_quant(jpeg_tables::CHROMA_QUANT, quant_[1], recip_[1]);
+        }
+        inline const jpeg_options &get_options() const {
+            return options_;
+        }
+        // pool may be nullptr to encode on the calling thread only
+        bool encode(const uint8_t *src, uint32_t stride, uint32_t width, uint32_t height,
+                    qcarcam_color_fmt_t format, thread_pool *pool, std::vector<uint8_t> &out) {
+            if (nullptr == src || 0 == width || 0 == height || width > 65535 || height > 65535 ||
+                QCARCAM_COLOR_GET_BITDEPTH(format) != QCARCAM_BITDEPTH_8 || !prepare(stride, width, height, format)) {
+                LOG_E("jpeg: unsupported frame %ux%u format 0x%x", width, height, format);
+                return false;
+            }
+            src_ = src;
+            int threads = pool ? pool->size() + 1 : 1;
+            int rows_per_segment = std::max(1, mcus_y_ / (threads * options_.segments_per_thread));
+            int segments = (mcus_y_ + rows_per_segment - 1) / rows_per_segment;
+            if (mcus_x_ * rows_per_segment > 65535) {
+                rows_per_segment = mcus_y_;     // restart interval does not fit DRI, encode serially
+                segments = 1;
+            }
+            if (segments_.size() < static_cast<size_t>(segments)) {
+                segments_.resize(segments);
+            }
+            auto encode_segment = [this, rows_per_segment](int i) {
+                int first = i * rows_per_segment;
+                this->encode_rows(first, std::min(first + rows_per_segment, mcus_y_), segments_[i]);
+            };
+            if (pool && segments > 1) {
+                pool->parallel_for(segments, encode_segment);
+            }
+            else {
+                for (int i = 0;i < segments;++i) {
+                    encode_segment(i);
+                }
+            }
+            out.clear();
+            size_t total = 1024;
+            for (int i = 0;i < segments;++i) {
+                total += segments_[i].size() + 2;
+            }
+            out.reserve(total);
+            write_headers(out, width, height, segments > 1 ? mcus_x_ * rows_per_segment : 0);
+            for (int i = 0;i < segments;++i) {
+                out.insert(out.end(), segments_[i].begin(), segments_[i].end());
+                if (i + 1 < segments) {
+                    out.push_back(0xFF);
+                    out.push_back(0xD0 + (i & 7));
+                }
+            }
+            out.push_back(0xFF);
+            out.push_back(0xD9);                // EOI
+            return true;
+        }
+    private:
+        struct huffman_table {
+            uint16_t code[256];
+            uint8_t size[256];
+        };
+        // per padded coordinate byte offsets with the edge replicated, so blocks need no bounds checks
+        struct plane_sampler {
+            size_t offset = 0;              // < Plane start in the frame
+            uint32_t stride = 0;
+            std::vector<int> col;
+            std::vector<int> row;
+            float scale = 1.0f;
+            float bias = 0.0f;
+        };
+        class bit_writer {
+        public:
+            explicit bit_writer(std::vector<uint8_t> &out) : out_(out) {}
+            inline void put(uint32_t bits, int count) {
+                acc_ = (acc_ << count) | (bits & ((1u << count) - 1));
+                count_ += count;
+                while (count_ >= 8) {
+                    count_ -= 8;
+                    uint8_t byte = static_cast<uint8_t>(acc_ >> count_);
+                    out_.push_back(byte);
+                    if (0xFF == byte) {
+                        out_.push_back(0);      // byte stuffing
+                    }
+                }
+            }
+            inline void flush() {           // pad the last byte with ones
+                if (count_ > 0) {
+                    put(0x7F, 8 - count_);
+                }
+            }
+        private:
+            std::vector<uint8_t> &out_;
+            uint64_t acc_ = 0;
+            int count_ = 0;
+        };
+        bool prepare(uint32_t stride, uint32_t width, uint32_t height, qcarcam_color_fmt_t format) {
+            int y_offset = 0, u_offset = 0, v_offset = 0;
+            switch (QCARCAM_COLOR_GET_PATTERN(format)) {
+            case QCARCAM_YUV_UYVY:
+                y_offset = 1, u_offset = 0, v_offset = 2;
+                break;
+            case QCARCAM_YUV_VYUY:
+                y_offset = 1, u_offset = 2, v_offset = 0;
+                break;
+            case QCARCAM_YUV_YUYV:
+                y_offset = 0, u_offset = 1, v_offset = 3;
+                break;
+            case QCARCAM_YUV_YVYU:
+                y_offset = 0, u_offset = 3, v_offset = 1;
+                break;
+            case QCARCAM_YUV_NV12:
+                y_offset = -1, u_offset = 0, v_offset = 1;
+                break;
+            case QCARCAM_YUV_NV21:
+                y_offset = -1, u_offset = 1, v_offset = 0;
+                break;
+            default:
+                return false;
+            }
+            planar_ = y_offset < 0;
+            mcu_h_ = planar_ ? 16 : 8;
+            mcus_x_ = (width + 15) / 16;
+            mcus_y_ = (height + mcu_h_ - 1) / mcu_h_;
+            int chroma_w = (width + 1) / 2;
+            int chroma_h = planar_ ? (height + 1) / 2 : height;
+            int luma_step = planar_ ? 1 : 2;
+            int chroma_step = planar_ ? 2 : 4;
+            size_t chroma_base = planar_ ? static_cast<size_t>(stride) * height : 0;
+            float luma_scale = options_.full_range ? 1.0f : 255.0f / 219.0f;
+            float chroma_scale = options_.full_range ? 1.0f : 255.0f / 224.0f;
+            // level shift and video to full range expansion folded into one multiply-add
+            init_sampler(samplers_[0], stride, 0, mcus_x_ * 16, mcus_y_ * mcu_h_, height,
+                         luma_scale, options_.full_range ? -128.0f : -16.0f * luma_scale - 128.0f);
+            for (int i = 1;i < 3;++i) {
+                init_sampler(samplers_[i], stride, chroma_base, mcus_x_ * 8, mcus_y_ * 8, chroma_h,
+                             chroma_scale, -128.0f * chroma_scale);
+            }
+            for (int x = 0;x < mcus_x_ * 16;++x) {
+                int sx = std::min<int>(x, width - 1);
+                samplers_[0].col[x] = planar_ ? sx : sx * luma_step + y_offset;
+            }
+            for (int x = 0;x < mcus_x_ * 8;++x) {
+                int sx = std::min(x, chroma_w - 1) * chroma_step;
+                samplers_[1].col[x] = sx + u_offset;
+                samplers_[2].col[x] = sx + v_offset;
+            }
+            return true;
+        }
+        void init_sampler(plane_sampler &sampler, uint32_t stride, size_t offset, int padded_w, int padded_h,
+                          int h, float scale, float bias) {
+            sampler.offset = offset;
+            sampler.stride = stride;
+            sampler.col.resize(padded_w);
+            sampler.row.resize(padded_h);
+            for (int y = 0;y < padded_h;++y) {
+                sampler.row[y] = std::min(y, h - 1);
+            }
+            sampler.scale = scale;
+            sampler.bias = bias;
+        }
+        void encode_rows(int first, int last, std::vector<uint8_t> &out) {
+            out.clear();
+            out.reserve(static_cast<size_t>(mcus_x_) * (last - first) * 16 * mcu_h_ / 2);
+            bit_writer writer(out);
+            int pred[3] = { 0, 0, 0 };
+            for (int my = first;my < last;++my) {
+                for (int mx = 0;mx < mcus_x_;++mx) {
+                    int x0 = mx * 16;
+                    int y0 = my * mcu_h_;
+                    encode_block(samplers_[0], x0, y0, 0, pred[0], writer);
+                    encode_block(samplers_[0], x0 + 8, y0, 0, pred[0], writer);
+                    if (planar_) {
+                        encode_block(samplers_[0], x0, y0 + 8, 0, pred[0], writer);
+                        encode_block(samplers_[0], x0 + 8, y0 + 8, 0, pred[0], writer);
+                    }
+                    int cy = planar_ ? y0 / 2 : y0;
+                    encode_block(samplers_[1], x0 / 2, cy, 1, pred[1], writer);
+                    encode_block(samplers_[2], x0 / 2, cy, 1, pred[2], writer);
+                }
+            }
+            writer.flush();
+        }
+        void encode_block(const plane_sampler &sampler, int x0, int y0, int table, int &pred, bit_writer &writer) {
+            using simd::f32x4;
+            f32x4 block[16];                    // row r, columns 0-3 in block[2r], 4-7 in block[2r+1]
+            const f32x4 scale = simd::splat<f32x4>(sampler.scale);
+            const f32x4 bias = simd::splat<f32x4>(sampler.bias);
+            const int *col = sampler.col.data() + x0;
+            for (int r = 0;r < 8;++r) {
+                const uint8_t *row = src_ + sampler.offset + static_cast<size_t>(sampler.row[y0 + r]) * sampler.stride;
+                f32x4 lo = { static_cast<float>(row[col[0]]), static_cast<float>(row[col[1]]),
+                             static_cast<float>(row[col[2]]), static_cast<float>(row[col[3]]) };
+                f32x4 hi = { static_cast<float>(row[col[4]]), static_cast<float>(row[col[5]]),
+                             static_cast<float>(row[col[6]]), static_cast<float>(row[col[7]]) };
+                block[2 * r] = lo * scale + bias;
+                block[2 * r + 1] = hi * scale + bias;
+            }
+            fdct_columns(block);
+            fdct_columns(block + 1);
+            transpose(block);
+            fdct_columns(block);
+            fdct_columns(block + 1);
+            const f32x4 *recip = recip_[table];
+            for (int i = 0;i < 16;++i) {
+                block[i] *= recip[i];
+            }
+            const float *coef = reinterpret_cast<const float *>(block);
+            int zz[64];
+            for (int k = 0;k < 64;++k) {
+                zz[k] = static_cast<int>(coef[jpeg_tables::ZIGZAG_TRANSPOSED[k]] + 16384.5f) - 16384;
+            }
+            const huffman_table &dc = huff_[2 * table];
+            const huffman_table &ac = huff_[2 * table + 1];
+            int diff = zz[0] - pred;
+            pred = zz[0];
+            int bits = magnitude_bits(diff);
+            writer.put(dc.code[bits], dc.size[bits]);
+            if (bits) {
+                writer.put(diff < 0 ? diff - 1 : diff, bits);
+            }
+            int run = 0;
+            for (int k = 1;k < 64;++k) {
+                if (0 == zz[k]) {
+                    ++run;
+                    continue;
+                }
+                while (run > 15) {
+                    writer.put(ac.code[0xF0], ac.size[0xF0]);
+                    run -= 16;
+                }
+                bits = magnitude_bits(zz[k]);
+                int symbol = (run << 4) | bits;
+                writer.put(ac.code[symbol], ac.size[symbol]);
+                writer.put(zz[k] < 0 ? zz[k] - 1 : zz[k], bits);
+                run = 0;
+            }
+            if (run > 0) {
+                writer.put(ac.code[0], ac.size[0]);     // EOB
+            }
+        }
+        static inline int magnitude_bits(int value) {
+            unsigned int v = value < 0 ? -value : value;
+            return v ? 32 - __builtin_clz(v) : 0;
+        }
+        // AAN float forward DCT down the 4 columns held in every other vector, outputs are scaled by
+        // the AAN factors which the quantizer divides out
+        static void fdct_columns(simd::f32x4 *b) {
+            using simd::f32x4;
+            const f32x4 c0_707 = simd::splat<f32x4>(0.707106781f);
+            const f32x4 c0_382 = simd::splat<f32x4>(0.382683433f);
+            const f32x4 c0_541 = simd::splat<f32x4>(0.541196100f);
+            const f32x4 c1_306 = simd::splat<f32x4>(1.306562965f);
+            f32x4 tmp0 = b[0] + b[14], tmp7 = b[0] - b[14];
+            f32x4 tmp1 = b[2] + b[12], tmp6 = b[2] - b[12];
+            f32x4 tmp2 = b[4] + b[10], tmp5 = b[4] - b[10];
+            f32x4 tmp3 = b[6] + b[8], tmp4 = b[6] - b[8];
+            f32x4 tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+            f32x4 tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+            b[0] = tmp10 + tmp11;
+            b[8] = tmp10 - tmp11;
+            f32x4 z1 = (tmp12 + tmp13) * c0_707;
+            b[4] = tmp13 + z1;
+            b[12] = tmp13 - z1;
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            f32x4 z5 = (tmp10 - tmp12) * c0_382;
+            f32x4 z2 = c0_541 * tmp10 + z5;
+            f32x4 z4 = c1_306 * tmp12 + z5;
+            f32x4 z3 = tmp11 * c0_707;
+            f32x4 z11 = tmp7 + z3, z13 = tmp7 - z3;
+            b[10] = z13 + z2;
+            b[6] = z13 - z2;
+            b[2] = z11 + z4;
+            b[14] = z11 - z4;
+        }
+        static void transpose(simd::f32x4 *b) {
+            float *m = reinterpret_cast<float *>(b);
+            for (int r = 0;r < 8;++r) {
+                for (int c = r + 1;c < 8;++c) {
+                    std::swap(m[r * 8 + c], m[c * 8 + r]);
+                }
+            }
+        }
+        // after two column passes and a transpose the block holds coefficient (u, v) at v * 8 + u,
+        // the divisors are laid out the same way
+        void build_quant(const uint8_t *base, uint8_t *quant, simd::f32x4 *recip) {
+            static const float AAN[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+                                          1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+            int quality = options_.quality;
+            int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+            float *out = reinterpret_cast<float *>(recip);
+            for (int n = 0;n < 64;++n) {
+                int q = std::min(std::max((base[n] * scale + 50) / 100, 1), 255);
+                quant[n] = static_cast<uint8_t>(q);
+                int u = n / 8, v = n % 8;
+                out[v * 8 + u] = 1.0f / (q * AAN[u] * AAN[v] * 8.0f);
+            }
+        }
+        static void build_huffman(const uint8_t *bits, const uint8_t *vals, huffman_table &table) {
+            memset(&table, 0, sizeof(table));
+            int code = 0, k = 0;
+            for (int len = 1;len <= 16;++len) {
+                for (int i = 0;i < bits[len - 1];++i, ++k) {
+                    table.code[vals[k]] = static_cast<uint16_t>(code++);
+                    table.size[vals[k]] = static_cast<uint8_t>(len);
+                }
+                code <<= 1;
+            }
+        }
+        static inline void put16(std::vector<uint8_t> &out, int value) {
+            out.push_back(static_cast<uint8_t>(value >> 8));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+        static void put_dht(std::vector<uint8_t> &out, int id, const uint8_t *bits, const uint8_t *vals) {
+            int count = 0;
+            for (int i = 0;i < 16;++i) {
+                count += bits[i];
+            }
+            out.push_back(0xFF);
+            out.push_back(0xC4);
+            put16(out, 2 + 1 + 16 + count);
+            out.push_back(static_cast<uint8_t>(id));
+            out.insert(out.end(), bits, bits + 16);
+            out.insert(out.end(), vals, vals + count);
+        }
+        void write_headers(std::vector<uint8_t> &out, uint32_t width, uint32_t height, int restart_interval) {
+            static const uint8_t JFIF[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                                            0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00 };
+            out.insert(out.end(), JFIF, JFIF + sizeof(JFIF));
+            out.push_back(0xFF);
+            out.push_back(0xDB);
+            put16(out, 2 + 2 * 65);
+            for (int t = 0;t < 2;++t) {
+                out.push_back(static_cast<uint8_t>(t));
+                for (int k = 0;k < 64;++k) {
+                    out.push_back(quant_[t][jpeg_tables::ZIGZAG[k]]);
+                }
+            }
+            out.push_back(0xFF);
+            out.push_back(0xC0);                // SOF0
+            put16(out, 8 + 3 * 3);
+            out.push_back(8);
+            put16(out, height);
+            put16(out, width);
+            out.push_back(3);
+            const uint8_t components[9] = { 1, static_cast<uint8_t>(planar_ ? 0x22 : 0x21), 0, 2, 0x11, 1, 3, 0x11, 1 };
+            out.insert(out.end(), components, components + 9);
+            put_dht(out, 0x00, jpeg_tables::DC_LUMA_BITS, jpeg_tables::DC_LUMA_VALS);
+            put_dht(out, 0x10, jpeg_tables::AC_LUMA_BITS, jpeg_tables::AC_LUMA_VALS);
+            put_dht(out, 0x01, jpeg_tables::DC_CHROMA_BITS, jpeg_tables::DC_CHROMA_VALS);
+            put_dht(out, 0x11, jpeg_tables::AC_CHROMA_BITS, jpeg_tables::AC_CHROMA_VALS);
+            if (restart_interval > 0) {
+                out.push_back(0xFF);
+                out.push_back(0xDD);
+                put16(out, 4);
+                put16(out, restart_interval);
+            }
+            static const uint8_t SOS[] = { 0xFF, 0xDA, 0x00, 0x0C, 0x03, 1, 0x00, 2, 0x11, 3, 0x11, 0x00, 0x3F, 0x00 };
+            out.insert(out.end(), SOS, SOS + sizeof(SOS));
+        }
+    private:
+        jpeg_options options_;
+        huffman_table huff_[4];             // < DC/AC luma, DC/AC chroma
+        uint8_t quant_[2][64];              // < Natural order, for DQT
+        simd::f32x4 recip_[2][16];          // < Quantizer reciprocals with the AAN scale, DCT output layout
+        plane_sampler samplers_[3];
+        const uint8_t *src_ = nullptr;
+        bool planar_ = false;
+        int mcu_h_ = 8;
+        int mcus_x_ = 0;
+        int mcus_y_ = 0;
+        std::vector<std::vector<uint8_t>> segments_;
+    };
+}
@@ -0,0 +1,288 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "simd.hpp"
+#include "luma.hpp"
+#include "clock.hpp"
+#include "frame_consumer.hpp"
+namespace qnx_screen_camera {
+    enum lens_condition : int {
+        LENS_OK = 0,
+        LENS_BLURRED,                   // < Sharpness fell well below what this camera usually sees
+        LENS_OBSTRUCTED,                // < Most blocks lost their contrast (mud, snow, a cover)
+    };
+    enum lens_param : int {
+        LENS_HIST_BINS = 64,            // < Luma histogram, 4 levels per bin
+    };
+    struct lens_config {
+        int decimation = 4;             // < Luma is sampled every decimation pixels in both directions
+        int block_size = 16;            // < Contrast map block edge in decimated pixels
+        uint64_t min_interval_ns = 200000000;   // < At most 5 samples per second
+        int block_contrast = 10;        // < Max - min luma below which a block counts as flat
+        double obstruction_ratio = 0.6; // < Share of flat blocks in the trend that means obstructed
+        double blur_ratio = 0.3;        // < Sharpness trend below this share of the reference means blurred
+        double trend_alpha = 0.2;       // < Weight of a new sample in the trends
+        double reference_alpha = 0.01;  // < Weight of a new sample in the reference, learned while OK only
+        int warmup_samples = 25;        // < Samples that build the reference before any event
+        int confirm_samples = 10;       // < Consecutive samples a new condition needs before it is raised
+    };
+    struct lens_metrics {               // one sampled frame
+        double sharpness = 0;           // < Variance of the Laplacian of the decimated luma
+        double mean_luma = 0;
+        double flat_ratio = 0;          // < Share of blocks under lens_config::block_contrast
+        uint32_t histogram[LENS_HIST_BINS] = { 0 };
+        uint64_t process_ns = 0;        // < Cost of the sample on the monitor thread
+    };
+    struct lens_event {
+        int input_id = -1;
+        unsigned int seq_no = 0;
+        unsigned long long timestamp = 0;
+        lens_condition condition = LENS_OK;
+        lens_condition previous = LENS_OK;
+        double sharpness_trend = 0;
+        double sharpness_reference = 0;
+        double flat_trend = 0;
+        lens_metrics metrics;           // < Of the sample that confirmed the change
+    };
+    using lens_callback = std::function<void(const lens_event &)>;
+    // image quality of a camera from a few frames per second: Laplacian variance sharpness, a luma
+    // histogram and a block contrast map on the decimated luma plane. Short trends are compared with a
+    // reference the camera learns while healthy, a condition is raised after confirm_samples in a row
+    class lens_monitor : public frame_consumer {
+    public:
+        lens_monitor(const std::shared_ptr<camera_controller> &camera, const lens_config &config,
+                     const lens_callback &callback)
+            : frame_consumer(camera, "lens", config.min_interval_ns), config_(config), callback_(callback) {
+            if (config_.decimation <= 0) {
+                config_.decimation = 1;
+            }
+            if (config_.block_size < LANES) {
+                config_.block_size = LANES;
+            }
+            config_.block_size = config_.block_size / LANES * LANES;
+        }
+        virtual ~lens_monitor() {
+            stop();
+        }
+        inline lens_condition get_condition() const {
+            return static_cast<lens_condition>(condition_.load());
+        }
+        inline double last_process_ms() const {
+            return last_process_ns_ / 1e6;
+        }
+        // block contrast (max - min luma) of the last sample, row major
+        inline const std::vector<uint8_t> &get_contrast_map(int &blocks_w, int &blocks_h) const {
+            blocks_w = blocks_w_;
+            blocks_h = blocks_h_;
+            return contrast_;
+        }
+    protected:
+        void process(const camera_frame &frame) override {
+            uint64_t begin = monotonic_ns();
+            if (!prepare(frame) || !extract_luma(frame.data, frame.stride, frame.format, config_.decimation,
+                                                 row(0), padded_w_, plane_w_, plane_h_)) {
+                return;
+            }
+            pad_columns();
+            metrics_.sharpness = laplacian_variance();
+            metrics_.flat_ratio = block_contrast();
+            metrics_.mean_luma = histogram();
+            metrics_.process_ns = monotonic_ns() - begin;
+            last_process_ns_ = metrics_.process_ns;
+            update_trends(frame);
+        }
+    private:
+        enum { LANES = 8 };
+        bool prepare(const camera_frame &frame) {
+            if (nullptr == frame.data) {
+                return false;
+            }
+            int w = frame.width / config_.decimation;
+            int h = frame.height / config_.decimation;
+            if (w == plane_w_ && h == plane_h_) {
+                return true;
+            }
+            if (w < 3 || h < 3) {
+                return false;
+            }
+            plane_w_ = w;
+            plane_h_ = h;
+            // one spare vector on both sides so the Laplacian reads x - 1 and x + 1 without a tail loop
+            padded_w_ = (w + LANES - 1) / LANES * LANES + 2 * LANES;
+            luma_.assign(static_cast<size_t>(padded_w_) * h + LANES, 0);
+            blocks_w_ = w / config_.block_size;
+            blocks_h_ = h / config_.block_size;
+            contrast_.assign(std::max(blocks_w_ * blocks_h_, 0), 0);
+            block_max_.assign(config_.block_size / LANES, simd::splat<simd::s16x8>(0));
+            block_min_.assign(config_.block_size / LANES, simd::splat<simd::s16x8>(0));
+            samples_ = 0;
+            return true;
+        }
+        inline int16_t *row(int y) {
+            return luma_.data() + static_cast<size_t>(y) * padded_w_ + LANES;
+        }
+        // replicate the edge columns into the spare vectors
+        void pad_columns() {
+            for (int y = 0;y < plane_h_;++y) {
+                int16_t *dst = row(y);
+                for (int x = plane_w_;x < padded_w_ - LANES;++x) {
+                    dst[x] = dst[plane_w_ - 1];
+                }
+                dst[-1] = dst[0];
+            }
+        }
+        // 4c - up - down - left - right over the interior; squares in 32 bits through the even/odd halves
+        double laplacian_variance() {
+            using namespace simd;
+            const int vecs = (plane_w_ - 2 + LANES - 1) / LANES;
+            const int last = plane_w_ - 1;
+            int64_t sum = 0, sum_sq = 0;
+            for (int y = 1;y + 1 < plane_h_;++y) {
+                const int16_t *up = row(y - 1), *mid = row(y), *down = row(y + 1);
+                s32x4 acc = splat<s32x4>(0);
+                s32x4 acc_sq = splat<s32x4>(0);
+                for (int v = 0;v < vecs;++v) {
+                    int x = 1 + v * LANES;
+                    s16x8 c = load<s16x8>(mid + x);
+                    s16x8 lap = (c << 2) - load<s16x8>(up + x) - load<s16x8>(down + x) - load<s16x8>(mid + x - 1) -
+                                load<s16x8>(mid + x + 1);
+                    if (x + LANES > last) {     // lanes at and past the last column are not interior
+                        s16x8 lane = { 0, 1, 2, 3, 4, 5, 6, 7 };
+                        lap = select(lane < splat<s16x8>(static_cast<int16_t>(last - x)), lap, splat<s16x8>(0));
+                    }
+                    s32x4 even = ((s32x4)lap << 16) >> 16, odd = (s32x4)lap >> 16;
+                    acc += even + odd;
+                    acc_sq += even * even + odd * odd;
+                }
+                sum += hsum<int64_t>(acc);
+                sum_sq += hsum<int64_t>(acc_sq);    // a lane of one row stays below 2 * 1020^2 * vecs
+            }
+            int64_t count = static_cast<int64_t>(plane_w_ - 2) * (plane_h_ - 2);
+            double mean = static_cast<double>(sum) / count;
+            return static_cast<double>(sum_sq) / count - mean * mean;
+        }
+        // max - min per block with vector running extremes over the block rows, share of flat blocks
+        double block_contrast() {
+            using namespace simd;
+            const int vecs = config_.block_size / LANES;
+            int flat = 0;
+            for (int by = 0;by < blocks_h_;++by) {
+                for (int bx = 0;bx < blocks_w_;++bx) {
+                    for (int v = 0;v < vecs;++v) {
+                        block_max_[v] = splat<s16x8>(0);
+                        block_min_[v] = splat<s16x8>(255);
+                    }
+                    for (int y = by * config_.block_size;y < (by + 1) * config_.block_size;++y) {
+                        const int16_t *src = row(y) + bx * config_.block_size;
+                        for (int v = 0;v < vecs;++v) {
+                            s16x8 p = load<s16x8>(src + v * LANES);
+                            block_max_[v] = vmax(block_max_[v], p);
+                            block_min_[v] = vmin(block_min_[v], p);
+                        }
+                    }
+                    int hi = 0, lo = 255;
+                    for (int v = 0;v < vecs;++v) {
+                        for (int lane = 0;lane < LANES;++lane) {
+                            hi = std::max<int>(hi, block_max_[v][lane]);
+                            lo = std::min<int>(lo, block_min_[v][lane]);
+                        }
+                    }
+                    contrast_[by * blocks_w_ + bx] = static_cast<uint8_t>(hi - lo);
+                    flat += hi - lo < config_.block_contrast;
+                }
+            }
+            return contrast_.empty() ? 0.0 : static_cast<double>(flat) / contrast_.size();
+        }
+        // histogram of every other decimated row, the mean luma comes with it
+        double histogram() {
+            uint32_t *bins = metrics_.histogram;
+            memset(bins, 0, sizeof(metrics_.histogram));
+            uint64_t total = 0, count = 0;
+            for (int y = 0;y < plane_h_;y += 2) {
+                const int16_t *src = row(y);
+                for (int x = 0;x < plane_w_;++x) {
+                    ++bins[(src[x] >> 2) & (LENS_HIST_BINS - 1)];
+                    total += src[x];
+                }
+                count += plane_w_;
+            }
+            return count ? static_cast<double>(total) / count : 0.0;
+        }
+        void update_trends(const camera_frame &frame) {
+            double a = config_.trend_alpha;
+            if (0 == samples_) {
+                sharpness_trend_ = reference_ = metrics_.sharpness;
+                flat_trend_ = metrics_.flat_ratio;
+            }
+            else {
+                sharpness_trend_ += a * (metrics_.sharpness - sharpness_trend_);
+                flat_trend_ += a * (metrics_.flat_ratio - flat_trend_);
+            }
+            ++samples_;
+            if (samples_ <= static_cast<uint64_t>(config_.warmup_samples)) {
+                reference_ += (metrics_.sharpness - reference_) / samples_;     // plain mean while warming up
+                return;
+            }
+            lens_condition seen = flat_trend_ >= config_.obstruction_ratio ? LENS_OBSTRUCTED
+                                : sharpness_trend_ < config_.blur_ratio * reference_ ? LENS_BLURRED : LENS_OK;
+            lens_condition current = get_condition();
+            if (LENS_OK == current && LENS_OK == seen) {
+                reference_ += config_.reference_alpha * (metrics_.sharpness - reference_);
+            }
+            if (seen == current) {
+                streak_ = 0;
+                return;
+            }
+            if (seen != candidate_) {
+                candidate_ = seen;
+                streak_ = 0;
+            }
+            if (++streak_ < config_.confirm_samples) {
+                return;
+            }
+            streak_ = 0;
+            condition_ = seen;
+            event_.input_id = frame.input_id;
+            event_.seq_no = frame.seq_no;
+            event_.timestamp = frame.timestamp;
+            event_.condition = seen;
+            event_.previous = current;
+            event_.sharpness_trend = sharpness_trend_;
+            event_.sharpness_reference = reference_;
+            event_.flat_trend = flat_trend_;
+            event_.metrics = metrics_;
+            LOG_W("camera %d lens %s, sharpness %.1f of %.1f, flat blocks %.0f%%", frame.input_id,
+                  LENS_OBSTRUCTED == seen ? "obstructed" : LENS_BLURRED == seen ? "blurred" : "ok",
+                  sharpness_trend_, reference_, flat_trend_ * 100);
+            if (callback_) {
+                callback_(event_);
+            }
+        }
+    private:
+        lens_config config_;
+        lens_callback callback_;
+        int plane_w_ = 0;
+        int plane_h_ = 0;
+        int padded_w_ = 0;
+        int blocks_w_ = 0;
+        int blocks_h_ = 0;
+        std::vector<int16_t> luma_;
+        std::vector<uint8_t> contrast_;
+        std::vector<simd::s16x8> block_max_;
+        std::vector<simd::s16x8> block_min_;
+        lens_metrics metrics_;
+        uint64_t samples_ = 0;
+        double sharpness_trend_ = 0;
+        double flat_trend_ = 0;
+        double reference_ = 0;
+        lens_condition candidate_ = LENS_OK;
+        int streak_ = 0;
+        lens_event event_;
+        std::atomic<int> condition_{LENS_OK};
+        std::atomic<uint64_t> last_process_ns_{0};
+    };
+}
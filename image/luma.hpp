@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "qcarcam_types.h"
+#include "format_traits.hpp"
+namespace qnx_screen_camera {
+    // byte offset of Y inside a packed 4:2:2 pixel pair, -1 for planar luma, -2 if unsupported
+    inline int luma_packed_offset(qcarcam_color_fmt_t format) {
+        return format_traits_of(format).luma_offset;
+    }
+    // the sampling step is a constant of the format, so each layout gets its own unrolled loop
+    template <qcarcam_color_fmt_t FORMAT>
+    inline void extract_luma_kernel(const uint8_t *src, uint32_t stride, int factor,
+                                    int16_t *dst, int dst_stride, int dst_w, int dst_h) {
+        constexpr int offset = format_traits_of(FORMAT).luma_offset;
+        constexpr int bytes = offset >= 0 ? 2 : 1;
+        static_assert(offset >= -1, "format has no 8 bit luma");
+        const int step = bytes * factor;
+        for (int y = 0;y < dst_h;++y) {
+            const uint8_t *row = src + static_cast<size_t>(y) * factor * stride + (offset >= 0 ? offset : 0);
+            int16_t *out = dst + static_cast<size_t>(y) * dst_stride;
+            for (int x = 0;x < dst_w;++x) {
+                out[x] = row[x * step];
+            }
+        }
+    }
+    // point sample every factor-th pixel of every factor-th row into a dst_w x dst_h int16 plane
+    // (dst_w <= width / factor, dst_h <= height / factor); only the 8 bit YUV formats are handled
+    inline bool extract_luma(const uint8_t *src, uint32_t stride, qcarcam_color_fmt_t format, int factor,
+                             int16_t *dst, int dst_stride, int dst_w, int dst_h) {
+        if (nullptr == src || factor <= 0) {
+            return false;
+        }
+        switch (luma_packed_offset(format)) {
+        case 1:
+            extract_luma_kernel<QCARCAM_FMT_UYVY_8>(src, stride, factor, dst, dst_stride, dst_w, dst_h);
+            return true;
+        case 0:
+            extract_luma_kernel<QCARCAM_FMT_YUYV_8>(src, stride, factor, dst, dst_stride, dst_w, dst_h);
+            return true;
+        case -1:
+            extract_luma_kernel<QCARCAM_FMT_NV12>(src, stride, factor, dst, dst_stride, dst_w, dst_h);
+            return true;
+        default:
+            return false;
+        }
+    }
+}
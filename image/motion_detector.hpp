@@ -0,0 +1,260 @@
+#pragma once
+#include <stdint.h>
+#include <limits.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "simd.hpp"
+#include "luma.hpp"
+#include "screen_attribute.hpp"
+#include "frame_consumer.hpp"
+namespace qnx_screen_camera {
+    struct motion_box {                 // full resolution pixels
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        int blocks = 0;                 // < Active blocks in this component
+    };
+    struct motion_event {
+        int input_id = -1;
+        unsigned int seq_no = 0;
+        unsigned long long timestamp = 0;
+        bool scene_change = false;      // < Most of the image changed (lights, occlusion), background was reset
+        int active_blocks = 0;
+        std::vector<motion_box> boxes;
+    };
+    struct motion_zone {                // ratio of the image, later zones override earlier ones
+        DVECT pos = { 0, 0 };
+        DVECT size = { 1.0, 1.0 };
+        double sensitivity = 1.0;       // < 0 masks the zone out, > 1 needs fewer changed pixels
+    };
+    struct motion_config {
+        int decimation = 4;             // < Luma is sampled every decimation pixels in both directions
+        int block_size = 8;             // < Block edge in decimated pixels
+        int pixel_threshold = 20;       // < Luma difference against the background that counts as change
+        double block_ratio = 0.25;      // < Share of changed pixels that makes a block active at sensitivity 1
+        int background_shift = 4;       // < Background follows the image by 1/2^shift per frame
+        int min_blocks = 2;             // < Smallest component reported
+        double scene_change_ratio = 0.6;
+        int warmup_frames = 10;         // < Frames to learn the background before reporting
+        uint64_t min_interval_ns = 0;   // < Analyse at most one frame per interval, 0 for every frame
+        std::vector<motion_zone> zones; // < Empty means the whole image at sensitivity 1
+    };
+    using motion_callback = std::function<void(const motion_event &)>;
+    // running background subtraction on a decimated luma plane with block activity maps
+    class motion_detector : public frame_consumer {
+    public:
+        motion_detector(const std::shared_ptr<camera_controller> &camera, const motion_config &config,
+                        const motion_callback &callback)
+            : frame_consumer(camera, "motion", config.min_interval_ns), config_(config), callback_(callback) {
+            if (config_.decimation <= 0) {
+                config_.decimation = 1;
+            }
+            if (config_.block_size <= 0) {
+                config_.block_size = 8;
+            }
+        }
+        virtual ~motion_detector() {
+            stop();
+        }
+        // activity of the last analysed frame, changed pixels per block, row major
+        inline const std::vector<uint16_t> &get_activity_map(int &blocks_w, int &blocks_h) const {
+            blocks_w = blocks_w_;
+            blocks_h = blocks_h_;
+            return block_count_;
+        }
+    protected:
+        void process(const camera_frame &frame) override {
+            if (!prepare(frame)) {
+                return;
+            }
+            if (!extract_luma(frame.data, frame.stride, frame.format, config_.decimation,
+                              luma_.data(), padded_w_, plane_w_, plane_h_)) {
+                return;
+            }
+            if (frames_ == 0) {
+                reset_background();
+                ++frames_;
+                return;
+            }
+            int active = update_blocks();
+            ++frames_;
+            if (config_.warmup_frames > 0 && frames_ <= static_cast<uint64_t>(config_.warmup_frames)) {
+                return;
+            }
+            event_.input_id = frame.input_id;
+            event_.seq_no = frame.seq_no;
+            event_.timestamp = frame.timestamp;
+            event_.active_blocks = active;
+            event_.boxes.clear();
+            event_.scene_change = active >= config_.scene_change_ratio * blocks_w_ * blocks_h_;
+            if (event_.scene_change) {
+                reset_background();
+            }
+            else {
+                find_components();
+                if (event_.boxes.empty()) {
+                    return;
+                }
+            }
+            if (callback_) {
+                callback_(event_);
+            }
+        }
+    private:
+        enum { LANES = 8 };
+        bool prepare(const camera_frame &frame) {
+            if (nullptr == frame.data) {
+                return false;
+            }
+            int w = frame.width / config_.decimation;
+            int h = frame.height / config_.decimation;
+            if (w == plane_w_ && h == plane_h_) {
+                return true;
+            }
+            plane_w_ = w;
+            plane_h_ = h;
+            padded_w_ = (w + LANES - 1) / LANES * LANES;
+            luma_.assign(static_cast<size_t>(padded_w_) * h, 0);
+            background_.assign(luma_.size(), 0);
+            acc_.assign(padded_w_ / LANES, simd::splat<simd::s16x8>(0));
+            blocks_w_ = (w + config_.block_size - 1) / config_.block_size;
+            blocks_h_ = (h + config_.block_size - 1) / config_.block_size;
+            block_count_.assign(blocks_w_ * blocks_h_, 0);
+            active_.assign(blocks_w_ * blocks_h_, 0);
+            stack_.reserve(blocks_w_ * blocks_h_);
+            build_block_thresholds();
+            frames_ = 0;
+            return true;
+        }
+        // per block changed pixel count needed, from the zone sensitivities
+        void build_block_thresholds() {
+            block_min_.assign(blocks_w_ * blocks_h_, 0);
+            int pixels = config_.block_size * config_.block_size;
+            std::vector<double> sensitivity(block_min_.size(), config_.zones.empty() ? 1.0 : 0.0);
+            for (auto &zone : config_.zones) {
+                int x0 = zone.pos.x * blocks_w_;
+                int y0 = zone.pos.y * blocks_h_;
+                int x1 = (zone.pos.x + zone.size.x) * blocks_w_ + 0.5;
+                int y1 = (zone.pos.y + zone.size.y) * blocks_h_ + 0.5;
+                for (int by = std::max(y0, 0);by < std::min(y1, blocks_h_);++by) {
+                    for (int bx = std::max(x0, 0);bx < std::min(x1, blocks_w_);++bx) {
+                        sensitivity[by * blocks_w_ + bx] = zone.sensitivity;
+                    }
+                }
+            }
+            for (size_t i = 0;i < block_min_.size();++i) {
+                block_min_[i] = sensitivity[i] <= 0 ? INT_MAX
+                              : std::max(1, static_cast<int>(pixels * config_.block_ratio / sensitivity[i]));
+            }
+        }
+        void reset_background() {
+            for (size_t i = 0;i < luma_.size();++i) {
+                background_[i] = luma_[i] << BG_FRACTION;
+            }
+        }
+        // background difference, changed pixel count per block and background update in one pass
+        int update_blocks() {
+            using simd::s16x8;
+            const s16x8 threshold = simd::splat<s16x8>(config_.pixel_threshold << BG_FRACTION);
+            const int shift = config_.background_shift;
+            const int vecs = padded_w_ / LANES;
+            int active = 0;
+            for (int by = 0;by < blocks_h_;++by) {
+                for (int v = 0;v < vecs;++v) {
+                    acc_[v] = simd::splat<s16x8>(0);
+                }
+                int y_end = std::min((by + 1) * config_.block_size, plane_h_);
+                for (int y = by * config_.block_size;y < y_end;++y) {
+                    const int16_t *cur_row = luma_.data() + static_cast<size_t>(y) * padded_w_;
+                    int16_t *bg_row = background_.data() + static_cast<size_t>(y) * padded_w_;
+                    for (int v = 0;v < vecs;++v) {
+                        s16x8 cur = simd::load<s16x8>(cur_row + v * LANES) << static_cast<int>(BG_FRACTION);
+                        s16x8 bg = simd::load<s16x8>(bg_row + v * LANES);
+                        acc_[v] -= (s16x8)(simd::absdiff(cur, bg) > threshold);     // true lanes are -1
+                        bg += (cur - bg) >> shift;
+                        simd::store(bg_row + v * LANES, bg);
+                    }
+                }
+                uint16_t *counts = block_count_.data() + by * blocks_w_;
+                for (int bx = 0;bx < blocks_w_;++bx) {
+                    counts[bx] = 0;
+                }
+                for (int v = 0;v < vecs;++v) {
+                    for (int lane = 0;lane < LANES;++lane) {
+                        int x = v * LANES + lane;
+                        if (x < plane_w_) {
+                            counts[x / config_.block_size] += acc_[v][lane];
+                        }
+                    }
+                }
+                for (int bx = 0;bx < blocks_w_;++bx) {
+                    int b = by * blocks_w_ + bx;
+                    active_[b] = counts[bx] >= block_min_[b];
+                    active += active_[b];
+                }
+            }
+            return active;
+        }
+        // 4-connected components of active blocks, reported as full resolution boxes
+        void find_components() {
+            int scale = config_.block_size * config_.decimation;
+            for (int start = 0;start < blocks_w_ * blocks_h_;++start) {
+                if (active_[start] != 1) {
+                    continue;
+                }
+                motion_box box;
+                int x0 = INT_MAX, y0 = INT_MAX, x1 = -1, y1 = -1;
+                stack_.clear();
+                stack_.push_back(start);
+                active_[start] = 2;                    // visited
+                while (!stack_.empty()) {
+                    int b = stack_.back();
+                    stack_.pop_back();
+                    int bx = b % blocks_w_;
+                    int by = b / blocks_w_;
+                    x0 = std::min(x0, bx);
+                    x1 = std::max(x1, bx);
+                    y0 = std::min(y0, by);
+                    y1 = std::max(y1, by);
+                    ++box.blocks;
+                    const int neighbours[4] = { bx > 0 ? b - 1 : -1, bx + 1 < blocks_w_ ? b + 1 : -1,
+                                                by > 0 ? b - blocks_w_ : -1, by + 1 < blocks_h_ ? b + blocks_w_ : -1 };
+                    for (int n : neighbours) {
+                        if (n >= 0 && 1 == active_[n]) {
+                            active_[n] = 2;
+                            stack_.push_back(n);
+                        }
+                    }
+                }
+                if (box.blocks < config_.min_blocks) {
+                    continue;
+                }
+                box.x = x0 * scale;
+                box.y = y0 * scale;
+                box.width = (x1 - x0 + 1) * scale;
+                box.height = (y1 - y0 + 1) * scale;
+                event_.boxes.push_back(box);
+            }
+        }
+    private:
+        enum { BG_FRACTION = 7 };           // background kept in 8.7 fixed point
+        motion_config config_;
+        motion_callback callback_;
+        int plane_w_ = 0;
+        int plane_h_ = 0;
+        int padded_w_ = 0;
+        int blocks_w_ = 0;
+        int blocks_h_ = 0;
+        uint64_t frames_ = 0;
+        std::vector<int16_t> luma_;
+        std::vector<int16_t> background_;
+        std::vector<simd::s16x8> acc_;
+        std::vector<uint16_t> block_count_;
+        std::vector<int> block_min_;
+        std::vector<uint8_t> active_;
+        std::vector<int> stack_;
+        motion_event event_;
+    };
+}
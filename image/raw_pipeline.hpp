@@ -0,0 +1,318 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "qcarcam_types.h"
+#include "clock.hpp"
+#include "format_traits.hpp"
+#include "color_log.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+namespace qnx_screen_camera {
+    struct raw_config {
+        qcarcam_color_pattern_t bayer = QCARCAM_BAYER_RGGB;    // < CFA order when the format pattern is QCARCAM_RAW
+        int black_level = -1;           // < In sensor counts, -1 is 64 at 10 bit scaled to the bit depth
+        int white_level = -1;           // < In sensor counts, -1 is full scale
+        float wb_gain[3] = { 1.0f, 1.0f, 1.0f };               // < R, G, B
+        int threads = 0;                // < Including the capture thread, <= 0 uses up to 4 cores
+    };
+    inline bool same_raw_config(const raw_config &a, const raw_config &b) {
+        return a.bayer == b.bayer && a.black_level == b.black_level && a.white_level == b.white_level &&
+               a.wb_gain[0] == b.wb_gain[0] && a.wb_gain[1] == b.wb_gain[1] && a.wb_gain[2] == b.wb_gain[2] &&
+               a.threads == b.threads;
+    }
+    struct raw_timing {                 // of the last frame
+        uint64_t unpack_ns = 0;         // < Unpack with black level and white balance
+        uint64_t demosaic_ns = 0;       // < Demosaic with the conversion to UYVY
+    };
+    inline bool is_raw_format(qcarcam_color_fmt_t format) {
+        qcarcam_color_pattern_t pattern = QCARCAM_COLOR_GET_PATTERN(format);
+        return QCARCAM_RAW == pattern || (pattern >= QCARCAM_BAYER_GBRG && pattern <= QCARCAM_BAYER_BGGR);
+    }
+    // bytes per line as the capture hardware writes it: MIPI packs 4 pixels of 10 bits into 5 bytes,
+    // 2 of 12 into 3 and 4 of 14 into 7; lines are padded to 16 bytes. 0 for layouts not handled
+    inline uint32_t raw_stride(qcarcam_color_fmt_t format, int width) {
+        uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+        switch (QCARCAM_COLOR_GET_PACK(format)) {
+        case QCARCAM_PACK_MIPI:
+            if (bits > 14) {
+                return 0;
+            }
+            break;
+        case QCARCAM_PACK_PLAIN8:
+            if (bits != 8) {
+                return 0;
+            }
+            break;
+        case QCARCAM_PACK_PLAIN16:
+            if (bits > 16) {
+                return 0;
+            }
+            break;
+        default:
+            return 0;
+        }
+        return (min_stride(format, width) + 15) & ~15u;
+    }
+    namespace raw_detail {
+        // 8 pixels of MIPI RAW10 from 10 bytes: 4 high bytes, then one byte with their 2 low bits
+        inline simd::u16x8 unpack_mipi10(const uint8_t *src) {
+            using namespace simd;
+            const u8x16 zero = splat<u8x16>(0);
+            const u8x16 high = { 0, 16, 1, 16, 2, 16, 3, 16, 5, 16, 6, 16, 7, 16, 8, 16 };
+            const u8x16 low = { 4, 16, 4, 16, 4, 16, 4, 16, 9, 16, 9, 16, 9, 16, 9, 16 };
+            const u16x8 shift = { 0, 2, 4, 6, 0, 2, 4, 6 };
+            u8x16 v = load<u8x16>(src);
+            u16x8 h = (u16x8)shuffle(v, zero, high), l = (u16x8)shuffle(v, zero, low);
+            return (h << 2) | ((l >> shift) & splat<u16x8>(3));
+        }
+        // 8 pixels of MIPI RAW12 from 12 bytes: 2 high bytes, then one byte with both low nibbles
+        inline simd::u16x8 unpack_mipi12(const uint8_t *src) {
+            using namespace simd;
+            const u8x16 zero = splat<u8x16>(0);
+            const u8x16 high = { 0, 16, 1, 16, 3, 16, 4, 16, 6, 16, 7, 16, 9, 16, 10, 16 };
+            const u8x16 low = { 2, 16, 2, 16, 5, 16, 5, 16, 8, 16, 8, 16, 11, 16, 11, 16 };
+            const u16x8 shift = { 0, 4, 0, 4, 0, 4, 0, 4 };
+            u8x16 v = load<u8x16>(src);
+            u16x8 h = (u16x8)shuffle(v, zero, high), l = (u16x8)shuffle(v, zero, low);
+            return (h << 4) | ((l >> shift) & splat<u16x8>(15));
+        }
+        inline uint16_t mipi_pixel(const uint8_t *src, int x, uint32_t bits) {
+            switch (bits) {
+            case 10: {
+                const uint8_t *g = src + (x >> 2) * 5;
+                return static_cast<uint16_t>((g[x & 3] << 2) | ((g[4] >> (2 * (x & 3))) & 3));
+            }
+            case 12: {
+                const uint8_t *g = src + (x >> 1) * 3;
+                return static_cast<uint16_t>((g[x & 1] << 4) | ((g[2] >> (4 * (x & 1))) & 15));
+            }
+            case 14: {
+                // 4 high bytes, then 3 bytes holding the 6 low bits of each pixel LSB first
+                const uint8_t *g = src + (x >> 2) * 7;
+                uint32_t low = g[4] | (g[5] << 8) | (g[6] << 16);
+                return static_cast<uint16_t>((g[x & 3] << 6) | ((low >> (6 * (x & 3))) & 63));
+            }
+            default:
+                return src[x];
+            }
+        }
+    }
+    // one row of any handled RAW layout to sensor counts; row_bytes bounds the vector loads
+    inline bool unpack_raw_row(const uint8_t *src, uint32_t row_bytes, qcarcam_color_fmt_t format, int width,
+                               uint16_t *dst) {
+        uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+        int x = 0;
+        switch (QCARCAM_COLOR_GET_PACK(format)) {
+        case QCARCAM_PACK_MIPI:
+            if (10 == bits) {
+                for (;x + 8 <= width && (x / 4) * 5 + 16 <= static_cast<int>(row_bytes);x += 8) {
+                    simd::store(dst + x, raw_detail::unpack_mipi10(src + (x / 4) * 5));
+                }
+            }
+            else if (12 == bits) {
+                for (;x + 8 <= width && (x / 2) * 3 + 16 <= static_cast<int>(row_bytes);x += 8) {
+                    simd::store(dst + x, raw_detail::unpack_mipi12(src + (x / 2) * 3));
+                }
+            }
+            for (;x < width;++x) {
+                dst[x] = raw_detail::mipi_pixel(src, x, bits);
+            }
+            return true;
+        case QCARCAM_PACK_PLAIN8:
+            for (;x < width;++x) {
+                dst[x] = src[x];
+            }
+            return true;
+        case QCARCAM_PACK_PLAIN16:
+            memcpy(dst, src, width * sizeof(uint16_t));
+            return true;
+        default:
+            return false;
+        }
+    }
+    // RAW to UYVY in two row parallel passes: unpack + black level + white balance into a 12 bit
+    // linear plane with a mirrored border, then bilinear demosaic + BT.601 conversion; every row
+    // of the second pass reads three plane rows, so the plane stays in cache for small bands
+    class raw_processor {
+    public:
+        enum : int {
+            PLANE_BITS = 12,
+            GAIN_BITS = 12,             // < Fraction bits of the per channel gains
+            BAND_ROWS = 16,             // < Rows per parallel job
+            BORDER = 8,                 // < Plane columns left of pixel 0, keeps vector loads aligned to 16 bytes
+        };
+        bool configure(const raw_config &config, qcarcam_color_fmt_t format, int width, int height) {
+            uint32_t bits = QCARCAM_COLOR_GET_BITDEPTH(format);
+            if (!is_raw_format(format) || width < 4 || height < 4 || (width & 1) || (height & 1) ||
+                0 == raw_stride(format, width) || bits < 8 || bits > 16) {
+                LOG_E("raw: format 0x%x %dx%d not supported", format, width, height);
+                return false;
+            }
+            format_ = format;
+            width_ = width;
+            height_ = height;
+            qcarcam_color_pattern_t pattern = QCARCAM_COLOR_GET_PATTERN(format);
+            set_cfa(QCARCAM_RAW == pattern ? config.bayer : pattern);
+            int full = (1 << bits) - 1;
+            int black = config.black_level >= 0 ? config.black_level : (bits >= 10 ? 64 << (bits - 10) : 16);
+            int white = config.white_level > black ? std::min(config.white_level, full) : full;
+            black_ = static_cast<uint32_t>(black);
+            for (int c = 0;c < 3;++c) {
+                double gain = std::max(config.wb_gain[c], 0.0f) * ((1 << PLANE_BITS) - 1) / (white - black);
+                gain_[c] = static_cast<uint32_t>(gain * (1 << GAIN_BITS) + 0.5);
+            }
+            plane_stride_ = (BORDER + width_ + 16 + 15) & ~15;     // the last vector reads 8 past it
+            plane_.assign(static_cast<size_t>(plane_stride_) * (height_ + 2), 0);
+            return true;
+        }
+        // dst is width x height UYVY; pool may be nullptr
+        bool process(const uint8_t *src, uint32_t src_stride, uint8_t *dst, uint32_t dst_stride, thread_pool *pool) {
+            if (nullptr == src || nullptr == dst || plane_.empty()) {
+                return false;
+            }
+            int bands = (height_ + BAND_ROWS - 1) / BAND_ROWS;
+            uint64_t start = monotonic_ns();
+            run(pool, bands, [&](int band) {
+                int y1 = std::min(height_, (band + 1) * BAND_ROWS);
+                for (int y = band * BAND_ROWS;y < y1;++y) {
+                    unpack_raw_row(src + static_cast<size_t>(y) * src_stride, src_stride, format_, width_, plane_row(y));
+                    levels_row(y);
+                }
+            });
+            // rows -1 and height mirror rows 1 and height - 2 so the CFA phase continues
+            memcpy(plane_row(-1) - BORDER, plane_row(1) - BORDER, plane_stride_ * sizeof(uint16_t));
+            memcpy(plane_row(height_) - BORDER, plane_row(height_ - 2) - BORDER, plane_stride_ * sizeof(uint16_t));
+            uint64_t middle = monotonic_ns();
+            run(pool, bands, [&](int band) {
+                int y1 = std::min(height_, (band + 1) * BAND_ROWS);
+                for (int y = band * BAND_ROWS;y < y1;++y) {
+                    demosaic_row(y, dst + static_cast<size_t>(y) * dst_stride);
+                }
+            });
+            timing_.unpack_ns = middle - start;
+            timing_.demosaic_ns = monotonic_ns() - middle;
+            return true;
+        }
+        inline const raw_timing &get_timing() const {
+            return timing_;
+        }
+    private:
+        enum cfa_color : int {
+            CFA_R = 0,
+            CFA_G,
+            CFA_B,
+        };
+        void set_cfa(qcarcam_color_pattern_t pattern) {
+            static const int layouts[4][4] = {
+                { CFA_G, CFA_B, CFA_R, CFA_G },     // < GBRG
+                { CFA_G, CFA_R, CFA_B, CFA_G },     // < GRBG
+                { CFA_R, CFA_G, CFA_G, CFA_B },     // < RGGB
+                { CFA_B, CFA_G, CFA_G, CFA_R },     // < BGGR
+            };
+            int idx = pattern - QCARCAM_BAYER_GBRG;
+            if (idx < 0 || idx > 3) {
+                idx = QCARCAM_BAYER_RGGB - QCARCAM_BAYER_GBRG;
+            }
+            for (int i = 0;i < 4;++i) {
+                cfa_[i >> 1][i & 1] = layouts[idx][i];
+            }
+        }
+        inline uint16_t *plane_row(int y) {
+            return plane_.data() + static_cast<size_t>(y + 1) * plane_stride_ + BORDER;
+        }
+        // (max(v, black) - black) * gain in place on an unpacked plane row, clamped to the plane range;
+        // even and odd columns are one CFA colour each, exactly the low and high halves of the 32 bit lanes
+        void levels_row(int y) {
+            using namespace simd;
+            uint16_t *out = plane_row(y);
+            const uint16_t *src = out;
+            const int *colors = cfa_[y & 1];
+            const u32x4 black = splat<u32x4>(black_);
+            const u32x4 gain_even = splat<u32x4>(gain_[colors[0]]), gain_odd = splat<u32x4>(gain_[colors[1]]);
+            const u32x4 round = splat<u32x4>(1u << (GAIN_BITS - 1)), top = splat<u32x4>((1u << PLANE_BITS) - 1);
+            const u32x4 mask = splat<u32x4>(0xFFFF);
+            const int gain_bits = GAIN_BITS;
+            int x = 0;
+            for (;x + 8 <= width_;x += 8) {
+                u32x4 v = load<u32x4>(src + x);
+                u32x4 even = vmax(v & mask, black) - black, odd = vmax(v >> 16, black) - black;
+                even = vmin((even * gain_even + round) >> gain_bits, top);
+                odd = vmin((odd * gain_odd + round) >> gain_bits, top);
+                store(out + x, even | (odd << 16));
+            }
+            for (;x < width_;++x) {
+                uint32_t v = std::max<uint32_t>(src[x], black_) - black_;
+                out[x] = static_cast<uint16_t>(std::min<uint32_t>((v * gain_[colors[x & 1]] + (1u << (GAIN_BITS - 1))) >> GAIN_BITS,
+                                                                  (1u << PLANE_BITS) - 1));
+            }
+            out[-1] = out[1];
+            out[width_] = out[width_ - 2];
+        }
+        // bilinear: at a chroma site the other chroma is the diagonal mean and green the cross mean;
+        // at a green site the row's chroma is the horizontal and the other one the vertical mean
+        void demosaic_row(int y, uint8_t *dst) {
+            using namespace simd;
+            const uint16_t *up = plane_row(y - 1), *mid = plane_row(y), *down = plane_row(y + 1);
+            const int *colors = cfa_[y & 1];
+            bool green_even = CFA_G == colors[0];
+            int row_chroma = green_even ? colors[1] : colors[0];
+            u16x8 chroma_site = green_even ? (u16x8){ 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF }
+                                           : (u16x8){ 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0 };
+            const u16x8 two = splat<u16x8>(2);
+            const s32x4 c128 = splat<s32x4>(128);
+            const u32x4 mask = splat<u32x4>(0xFFFF), one = splat<u32x4>(1);
+            for (int x = 0;x < width_;x += 8) {
+                u16x8 c = load<u16x8>(mid + x), l = load<u16x8>(mid + x - 1), r = load<u16x8>(mid + x + 1);
+                u16x8 n = load<u16x8>(up + x), s = load<u16x8>(down + x);
+                u16x8 nw = load<u16x8>(up + x - 1), ne = load<u16x8>(up + x + 1);
+                u16x8 sw = load<u16x8>(down + x - 1), se = load<u16x8>(down + x + 1);
+                u16x8 cross = (n + s + l + r + two) >> 2, diag = (nw + ne + sw + se + two) >> 2;
+                u16x8 horiz = (l + r + splat<u16x8>(1)) >> 1, vert = (n + s + splat<u16x8>(1)) >> 1;
+                u16x8 own = select(chroma_site, c, horiz) >> 4;             // the row's chroma, 8 bit
+                u16x8 other = select(chroma_site, diag, vert) >> 4;
+                u16x8 g = select(chroma_site, cross, c) >> 4;
+                u16x8 red = CFA_R == row_chroma ? own : other, blue = CFA_R == row_chroma ? other : own;
+                u16x8 luma = ((red * splat<u16x8>(66) + g * splat<u16x8>(129) + blue * splat<u16x8>(25) +
+                               splat<u16x8>(128)) >> 8) + splat<u16x8>(16);
+                // chroma of a pixel pair from its mean colour, pairs are the 32 bit lanes
+                s32x4 rp = (s32x4)((((u32x4)red & mask) + ((u32x4)red >> 16) + one) >> 1);
+                s32x4 gp = (s32x4)((((u32x4)g & mask) + ((u32x4)g >> 16) + one) >> 1);
+                s32x4 bp = (s32x4)((((u32x4)blue & mask) + ((u32x4)blue >> 16) + one) >> 1);
+                s32x4 u = ((splat<s32x4>(-38) * rp - splat<s32x4>(74) * gp + splat<s32x4>(112) * bp + c128) >> 8) + c128;
+                s32x4 v = ((splat<s32x4>(112) * rp - splat<s32x4>(94) * gp - splat<s32x4>(18) * bp + c128) >> 8) + c128;
+                u = clamp(u, splat<s32x4>(0), splat<s32x4>(255));
+                v = clamp(v, splat<s32x4>(0), splat<s32x4>(255));
+                u16x8 packed = (u16x8)((u32x4)u | ((u32x4)v << 16)) | (luma << 8);
+                if (x + 8 <= width_) {
+                    store(dst + x * 2, packed);
+                }
+                else {
+                    memcpy(dst + x * 2, &packed, (width_ - x) * 2);
+                }
+            }
+        }
+        template <typename Fn>
+        static void run(thread_pool *pool, int count, Fn fn) {
+            if (pool) {
+                pool->parallel_for(count, fn);
+            }
+            else {
+                for (int i = 0;i < count;++i) {
+                    fn(i);
+                }
+            }
+        }
+    private:
+        qcarcam_color_fmt_t format_ = QCARCAM_FMT_MAX;
+        int width_ = 0;
+        int height_ = 0;
+        int cfa_[2][2] = { { CFA_R, CFA_G }, { CFA_G, CFA_B } };
+        uint32_t black_ = 0;
+        uint32_t gain_[3] = { 0 };
+        int plane_stride_ = 0;
+        std::vector<uint16_t> plane_;
+        raw_timing timing_;
+    };
+}
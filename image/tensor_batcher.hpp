@@ -0,0 +1,227 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "clock.hpp"
+#include "thread_pool.hpp"
+#include "tensor_convert.hpp"
+#include "sync_group.hpp"
+namespace qnx_screen_camera {
+    enum tensor_batch_param : int {
+        TENSOR_BAND_ROWS = 16,          // < Output rows per parallel job
+    };
+    struct tensor_frame_info {          // where batch entry n came from
+        int input_id = -1;
+        unsigned int seq_no = 0;
+        unsigned long long timestamp = 0;
+        uint32_t width = 0;             // < Source size before the resize
+        uint32_t height = 0;
+    };
+    struct tensor_batch {
+        const void *data = nullptr;     // < batch x tensor_frame_bytes(config), float or int8 as configured
+        size_t bytes = 0;
+        int batch = 0;                  // < N, one entry per member in member order
+        tensor_config config;
+        std::vector<tensor_frame_info> frames;
+        uint64_t sequence = 0;          // < Counts delivered batches
+        uint64_t convert_ns = 0;        // < Wall time of the conversion of this batch
+    };
+    // runs on the batcher thread; data belongs to the arena and is overwritten by the next batch,
+    // so an inference running past the return must copy it
+    using tensor_batch_callback = std::function<void(const tensor_batch &)>;
+    // model input of several cameras at once: time matched sets from a sync_group (one member takes
+    // its frames directly) are held in a single slot, the batcher thread converts every frame into its
+    // place of a preallocated arena in row bands over the pool and hands the batch over with metadata
+    class tensor_batcher {
+    public:
+        tensor_batcher(const std::vector<std::shared_ptr<camera_controller>> &members, const tensor_config &config,
+                       const tensor_batch_callback &callback, int threads = 0,
+                       const thread_policy &policy = thread_policy(), const std::string &name = "tensor")
+            : members_(members), config_(config), callback_(callback), policy_(policy), name_(name) {
+            if (threads <= 0) {
+                threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+            }
+            pool_.reset(new thread_pool(threads - 1, policy_, name_ + "_"));
+        }
+        virtual ~tensor_batcher() {
+            stop();
+        }
+        bool start(uint64_t tolerance_ns) {
+            if (worker_ != nullptr || members_.empty() || !callback_) {
+                return false;
+            }
+            converters_.assign(members_.size(), tensor_converter());
+            for (auto &converter : converters_) {
+                if (!converter.configure(config_)) {
+                    return false;
+                }
+            }
+            frame_bytes_ = tensor_frame_bytes(config_);
+            arena_.assign(frame_bytes_ * members_.size(), 0);      // new[] storage is aligned for float
+            batch_.data = arena_.data();
+            batch_.bytes = frame_bytes_ * members_.size();
+            batch_.batch = static_cast<int>(members_.size());
+            batch_.config = config_;
+            batch_.frames.assign(members_.size(), tensor_frame_info());
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(policy_, name_);
+                this->run();
+            });
+            if (1 == members_.size()) {
+                listener_id_ = members_[0]->add_frame_listener([this](const camera_frame &frame) {
+                    this->on_set(std::vector<camera_frame>(1, frame));
+                });
+                return true;
+            }
+            group_ = std::make_shared<sync_group>(members_, tolerance_ns, [this](const std::vector<camera_frame> &set) {
+                this->on_set(set);
+            });
+            if (!group_->start()) {
+                stop();
+                return false;
+            }
+            return true;
+        }
+        void stop() {
+            if (group_) {
+                group_->stop();
+                group_ = nullptr;
+            }
+            if (listener_id_ >= 0) {
+                members_[0]->remove_frame_listener(listener_id_);
+                listener_id_ = -1;
+            }
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            if (has_pending_) {
+                release(pending_);
+                has_pending_ = false;
+            }
+        }
+        inline double last_convert_ms() const {
+            return last_convert_ns_ / 1e6;
+        }
+        inline uint64_t batches() const {
+            return batches_;
+        }
+        inline uint64_t skipped() const {
+            return skipped_;
+        }
+    private:
+        void on_set(const std::vector<camera_frame> &set) {
+            for (size_t i = 0;i < set.size();++i) {
+                if (!members_[i]->hold_frame(set[i].idx)) {
+                    for (size_t j = 0;j < i;++j) {
+                        members_[j]->release_frame(set[j].idx);
+                    }
+                    return;
+                }
+            }
+            std::vector<camera_frame> stale;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (has_pending_) {
+                    stale.swap(pending_);
+                    ++skipped_;
+                }
+                pending_ = set;
+                has_pending_ = true;
+            }
+            release(stale);
+            cv_.notify_one();
+        }
+        void run() {
+            const int bands = (config_.height + TENSOR_BAND_ROWS - 1) / TENSOR_BAND_ROWS;
+            while (true) {
+                std::vector<camera_frame> set;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || has_pending_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                    set.swap(pending_);
+                    has_pending_ = false;
+                }
+                bool ok = true;
+                for (size_t i = 0;i < set.size();++i) {
+                    ok = ok && nullptr != set[i].data && converters_[i].prepare(set[i]);
+                }
+                if (!ok) {
+                    release(set);
+                    continue;
+                }
+                uint64_t begin = monotonic_ns();
+                {
+                    TRACE_SCOPE("tensor_batch", static_cast<int64_t>(set.size()));
+                    uint8_t *arena = arena_.data();
+                    const int jobs = bands * static_cast<int>(set.size());
+                    pool_->parallel_for(jobs, [&](int job) {
+                        int n = job / bands;
+                        int y0 = (job % bands) * TENSOR_BAND_ROWS;
+                        converters_[n].convert(set[n], arena + n * frame_bytes_, y0,
+                                               std::min(config_.height, y0 + TENSOR_BAND_ROWS));
+                    });
+                }
+                for (size_t i = 0;i < set.size();++i) {
+                    tensor_frame_info &info = batch_.frames[i];
+                    info.input_id = set[i].input_id;
+                    info.seq_no = set[i].seq_no;
+                    info.timestamp = set[i].timestamp;
+                    info.width = set[i].width;
+                    info.height = set[i].height;
+                }
+                release(set);
+                batch_.convert_ns = monotonic_ns() - begin;
+                batch_.sequence = ++batches_;
+                last_convert_ns_ = batch_.convert_ns;
+                callback_(batch_);
+            }
+        }
+        void release(const std::vector<camera_frame> &set) {
+            for (size_t i = 0;i < set.size();++i) {
+                members_[i]->release_frame(set[i].idx);
+            }
+        }
+    private:
+        std::vector<std::shared_ptr<camera_controller>> members_;
+        tensor_config config_;
+        tensor_batch_callback callback_;
+        thread_policy policy_;
+        std::string name_;
+        std::unique_ptr<thread_pool> pool_;
+        std::vector<tensor_converter> converters_;     // < One per member, its tables follow the member geometry
+        std::vector<uint8_t> arena_;
+        size_t frame_bytes_ = 0;
+        tensor_batch batch_;                            // < Batcher thread only
+        std::shared_ptr<sync_group> group_;
+        int listener_id_ = -1;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<camera_frame> pending_;
+        bool has_pending_ = false;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        std::atomic<uint64_t> last_convert_ns_{0};
+        std::atomic<uint64_t> batches_{0};
+        std::atomic<uint64_t> skipped_{0};
+    };
+}
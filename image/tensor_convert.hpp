@@ -0,0 +1,275 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "simd.hpp"
+#include "format_traits.hpp"
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    enum tensor_layout : int {
+        TENSOR_NCHW = 0,
+        TENSOR_NHWC,
+    };
+    enum tensor_type : int {
+        TENSOR_FLOAT32 = 0,
+        TENSOR_INT8,                    // < Symmetric or affine per tensor quantization
+    };
+    enum tensor_color : int {           // channel order of the model input
+        TENSOR_RGB = 0,
+        TENSOR_BGR,
+        TENSOR_GRAY,                    // < One channel, the luma
+    };
+    struct tensor_config {
+        int width = 224;                // < Model input, every frame is resized to it
+        int height = 224;
+        tensor_layout layout = TENSOR_NCHW;
+        tensor_type type = TENSOR_FLOAT32;
+        tensor_color color = TENSOR_RGB;
+        float mean[3] = { 0, 0, 0 };    // < Per output channel in 0-255 units: (c - mean) / std
+        float std[3] = { 1, 1, 1 };
+        float quant_scale = 1.0f;       // < INT8: q = round(normalized / quant_scale) + quant_zero_point
+        int quant_zero_point = 0;
+    };
+    inline int tensor_channels(const tensor_config &config) {
+        return TENSOR_GRAY == config.color ? 1 : 3;
+    }
+    inline size_t tensor_frame_bytes(const tensor_config &config) {
+        return static_cast<size_t>(config.width) * config.height * tensor_channels(config) *
+               (TENSOR_INT8 == config.type ? sizeof(int8_t) : sizeof(float));
+    }
+    enum tensor_tap : int {             // sample tables of one output column
+        TAP_LUMA = 0,
+        TAP_CB,
+        TAP_CR,
+        TAP_NUM
+    };
+    struct tensor_column {
+        int32_t tap[TAP_NUM][2];        // < Byte offsets of the two bilinear taps inside a source row
+        float weight[2];                // < Of the second luma and the second chroma tap
+    };
+    struct tensor_row {                 // source rows of one output row, chroma rows in the chroma plane
+        int32_t luma[2];
+        int32_t chroma[2];
+        float luma_w;
+        float chroma_w;
+    };
+    // resize + BT.601 limited range YUV to RGB + (c - mean) / std + quantization fused into a single pass
+    // over the output pixels, four at a time: the bilinear taps are gathered into vectors through tables
+    // built once per source geometry, everything after the gather is vector arithmetic
+    class tensor_converter {
+    public:
+        enum : int {
+            LANES = 4,
+        };
+        bool configure(const tensor_config &config) {
+            if (config.width <= 0 || config.height <= 0 || config.quant_scale <= 0) {
+                LOG_E("tensor: bad config %dx%d", config.width, config.height);
+                return false;
+            }
+            for (int c = 0;c < tensor_channels(config);++c) {
+                if (config.std[c] <= 0) {
+                    LOG_E("tensor: std of channel %d must be positive", c);
+                    return false;
+                }
+            }
+            config_ = config;
+            // output channel c is the model's; source_[c] picks R, G or B of the conversion
+            static const int orders[3][3] = { { 0, 1, 2 }, { 2, 1, 0 }, { 0, 0, 0 } };
+            float quant = TENSOR_INT8 == config_.type ? config_.quant_scale : 1.0f;
+            float zero = TENSOR_INT8 == config_.type ? static_cast<float>(config_.quant_zero_point) : 0.0f;
+            for (int c = 0;c < 3;++c) {
+                source_[c] = orders[config_.color][c];
+                scale_[c] = 1.0f / (config_.std[c] * quant);
+                bias_[c] = zero - config_.mean[c] * scale_[c];
+            }
+            src_format_ = QCARCAM_FMT_MAX;
+            src_width_ = src_height_ = 0;
+            return true;
+        }
+        // frame to tensor at dst (one frame of tensor_frame_bytes), rows [y0, y1) of the output only
+        // so a batch can be split into bands; prepare() must have accepted the frame geometry
+        void convert(const camera_frame &frame, void *dst, int y0, int y1) const {
+            int channels = tensor_channels(config_);
+            bool nhwc = TENSOR_NHWC == config_.layout;
+            bool int8 = TENSOR_INT8 == config_.type;
+            if (1 == channels) {
+                nhwc ? (int8 ? run<1, TENSOR_NHWC, TENSOR_INT8>(frame, dst, y0, y1)
+                             : run<1, TENSOR_NHWC, TENSOR_FLOAT32>(frame, dst, y0, y1))
+                     : (int8 ? run<1, TENSOR_NCHW, TENSOR_INT8>(frame, dst, y0, y1)
+                             : run<1, TENSOR_NCHW, TENSOR_FLOAT32>(frame, dst, y0, y1));
+            }
+            else {
+                nhwc ? (int8 ? run<3, TENSOR_NHWC, TENSOR_INT8>(frame, dst, y0, y1)
+                             : run<3, TENSOR_NHWC, TENSOR_FLOAT32>(frame, dst, y0, y1))
+                     : (int8 ? run<3, TENSOR_NCHW, TENSOR_INT8>(frame, dst, y0, y1)
+                             : run<3, TENSOR_NCHW, TENSOR_FLOAT32>(frame, dst, y0, y1));
+            }
+        }
+        // (re)builds the tables when the source format or size changed, false for unsupported formats
+        bool prepare(const camera_frame &frame) {
+            if (frame.format == src_format_ && static_cast<int>(frame.width) == src_width_ &&
+                static_cast<int>(frame.height) == src_height_) {
+                return true;
+            }
+            const format_traits traits = format_traits_of(frame.format);
+            int cb = 0, cr = 0;
+            if (traits.luma_offset < -1 || !chroma_offsets(frame.format, cb, cr) || frame.width < 2 || frame.height < 2) {
+                LOG_E("tensor: format 0x%x %ux%u not supported", frame.format, frame.width, frame.height);
+                return false;
+            }
+            bool packed = traits.luma_offset >= 0;
+            int w = static_cast<int>(frame.width), h = static_cast<int>(frame.height);
+            int cw = w >> traits.chroma_h_shift, ch = h >> traits.chroma_v_shift;
+            int padded = (config_.width + LANES - 1) / LANES * LANES;       // the last group repeats the last column
+            columns_.resize(padded);
+            for (int x = 0;x < padded;++x) {
+                int ox = std::min(x, config_.width - 1);
+                int l0 = 0, l1 = 0, c0 = 0, c1 = 0;
+                float lw = taps(ox, config_.width, w, l0, l1);
+                float cwt = taps(ox, config_.width, cw, c0, c1);
+                tensor_column &col = columns_[x];
+                col.tap[TAP_LUMA][0] = packed ? 2 * l0 + traits.luma_offset : l0;
+                col.tap[TAP_LUMA][1] = packed ? 2 * l1 + traits.luma_offset : l1;
+                col.tap[TAP_CB][0] = (packed ? 4 : 2) * c0 + cb;
+                col.tap[TAP_CB][1] = (packed ? 4 : 2) * c1 + cb;
+                col.tap[TAP_CR][0] = (packed ? 4 : 2) * c0 + cr;
+                col.tap[TAP_CR][1] = (packed ? 4 : 2) * c1 + cr;
+                col.weight[0] = lw;
+                col.weight[1] = cwt;
+            }
+            rows_.resize(config_.height);
+            for (int y = 0;y < config_.height;++y) {
+                tensor_row &row = rows_[y];
+                row.luma_w = taps(y, config_.height, h, row.luma[0], row.luma[1]);
+                if (packed) {
+                    row.chroma[0] = row.luma[0];
+                    row.chroma[1] = row.luma[1];
+                    row.chroma_w = row.luma_w;
+                }
+                else {
+                    row.chroma_w = taps(y, config_.height, ch, row.chroma[0], row.chroma[1]);
+                }
+            }
+            src_format_ = frame.format;
+            src_width_ = w;
+            src_height_ = h;
+            planar_ = !packed;
+            return true;
+        }
+        inline const tensor_config &get_config() const {
+            return config_;
+        }
+    private:
+        // centre aligned source position of output i: the two taps and the weight of the second one
+        static inline float taps(int i, int out, int in, int32_t &t0, int32_t &t1) {
+            float pos = (i + 0.5f) * in / out - 0.5f;
+            pos = std::min(std::max(pos, 0.0f), static_cast<float>(in - 1));
+            t0 = static_cast<int32_t>(pos);
+            t1 = std::min(t0 + 1, in - 1);
+            return pos - t0;
+        }
+        static inline bool chroma_offsets(qcarcam_color_fmt_t format, int &cb, int &cr) {
+            switch (QCARCAM_COLOR_GET_PATTERN(format)) {
+            case QCARCAM_YUV_UYVY: cb = 0; cr = 2; return true;
+            case QCARCAM_YUV_VYUY: cb = 2; cr = 0; return true;
+            case QCARCAM_YUV_YUYV: cb = 1; cr = 3; return true;
+            case QCARCAM_YUV_YVYU: cb = 3; cr = 1; return true;
+            case QCARCAM_YUV_NV12: cb = 0; cr = 1; return true;
+            case QCARCAM_YUV_NV21: cb = 1; cr = 0; return true;
+            default: return false;
+            }
+        }
+        static inline simd::f32x4 gather(const uint8_t *r0, const uint8_t *r1, const tensor_column *col, int tap,
+                                         const simd::f32x4 &fy) {
+            using simd::f32x4;
+            const int w = TAP_LUMA == tap ? 0 : 1;
+            f32x4 a = { static_cast<float>(r0[col[0].tap[tap][0]]), static_cast<float>(r0[col[1].tap[tap][0]]),
+                        static_cast<float>(r0[col[2].tap[tap][0]]), static_cast<float>(r0[col[3].tap[tap][0]]) };
+            f32x4 b = { static_cast<float>(r0[col[0].tap[tap][1]]), static_cast<float>(r0[col[1].tap[tap][1]]),
+                        static_cast<float>(r0[col[2].tap[tap][1]]), static_cast<float>(r0[col[3].tap[tap][1]]) };
+            f32x4 c = { static_cast<float>(r1[col[0].tap[tap][0]]), static_cast<float>(r1[col[1].tap[tap][0]]),
+                        static_cast<float>(r1[col[2].tap[tap][0]]), static_cast<float>(r1[col[3].tap[tap][0]]) };
+            f32x4 d = { static_cast<float>(r1[col[0].tap[tap][1]]), static_cast<float>(r1[col[1].tap[tap][1]]),
+                        static_cast<float>(r1[col[2].tap[tap][1]]), static_cast<float>(r1[col[3].tap[tap][1]]) };
+            f32x4 fx = { col[0].weight[w], col[1].weight[w], col[2].weight[w], col[3].weight[w] };
+            f32x4 top = a + (b - a) * fx;
+            f32x4 bottom = c + (d - c) * fx;
+            return top + (bottom - top) * fy;
+        }
+        template <tensor_layout LAYOUT, tensor_type TYPE>
+        static inline void store(void *dst, size_t plane, size_t pixel, int channels, int c, int lanes,
+                                 const simd::f32x4 &v) {
+            if (TENSOR_FLOAT32 == TYPE && TENSOR_NCHW == LAYOUT && LANES == lanes) {
+                simd::store(static_cast<float *>(dst) + c * plane + pixel, v);
+                return;
+            }
+            for (int i = 0;i < lanes;++i) {
+                size_t at = TENSOR_NCHW == LAYOUT ? c * plane + pixel + i : (pixel + i) * channels + c;
+                if (TENSOR_FLOAT32 == TYPE) {
+                    static_cast<float *>(dst)[at] = v[i];
+                }
+                else {
+                    int q = static_cast<int>(v[i] + 16384.5f) - 16384;     // round half up without a libm call
+                    static_cast<int8_t *>(dst)[at] = static_cast<int8_t>(std::min(std::max(q, -128), 127));
+                }
+            }
+        }
+        template <int CHANNELS, tensor_layout LAYOUT, tensor_type TYPE>
+        void run(const camera_frame &frame, void *dst, int y0, int y1) const {
+            using simd::f32x4;
+            using simd::splat;
+            const f32x4 zero = splat<f32x4>(0.0f), full = splat<f32x4>(255.0f);
+            const f32x4 luma_bias = splat<f32x4>(16.0f), chroma_bias = splat<f32x4>(128.0f);
+            const f32x4 ky = splat<f32x4>(1.164f);
+            const f32x4 k_rv = splat<f32x4>(1.596f), k_gu = splat<f32x4>(-0.392f);
+            const f32x4 k_gv = splat<f32x4>(-0.813f), k_bu = splat<f32x4>(2.017f);
+            f32x4 scale[3], bias[3];
+            for (int c = 0;c < 3;++c) {
+                scale[c] = splat<f32x4>(scale_[c]);
+                bias[c] = splat<f32x4>(bias_[c]);
+            }
+            const size_t plane = static_cast<size_t>(config_.width) * config_.height;
+            const uint8_t *chroma_base = planar_ ? frame.data + frame.plane_offset : frame.data;
+            for (int y = y0;y < y1;++y) {
+                const tensor_row &row = rows_[y];
+                const uint8_t *l0 = frame.data + static_cast<size_t>(row.luma[0]) * frame.stride;
+                const uint8_t *l1 = frame.data + static_cast<size_t>(row.luma[1]) * frame.stride;
+                const uint8_t *c0 = chroma_base + static_cast<size_t>(row.chroma[0]) * frame.stride;
+                const uint8_t *c1 = chroma_base + static_cast<size_t>(row.chroma[1]) * frame.stride;
+                const f32x4 fy = splat<f32x4>(row.luma_w), cfy = splat<f32x4>(row.chroma_w);
+                for (int x = 0;x < config_.width;x += LANES) {
+                    const tensor_column *col = &columns_[x];
+                    int lanes = std::min(static_cast<int>(LANES), config_.width - x);
+                    size_t pixel = static_cast<size_t>(y) * config_.width + x;
+                    f32x4 luma = (gather(l0, l1, col, TAP_LUMA, fy) - luma_bias) * ky;
+                    if (1 == CHANNELS) {
+                        f32x4 gray = simd::clamp(luma, zero, full);
+                        store<LAYOUT, TYPE>(dst, plane, pixel, 1, 0, lanes, gray * scale[0] + bias[0]);
+                        continue;
+                    }
+                    f32x4 u = gather(c0, c1, col, TAP_CB, cfy) - chroma_bias;
+                    f32x4 v = gather(c0, c1, col, TAP_CR, cfy) - chroma_bias;
+                    f32x4 rgb[3] = { simd::clamp(luma + k_rv * v, zero, full),
+                                     simd::clamp(luma + k_gu * u + k_gv * v, zero, full),
+                                     simd::clamp(luma + k_bu * u, zero, full) };
+                    for (int c = 0;c < CHANNELS;++c) {
+                        store<LAYOUT, TYPE>(dst, plane, pixel, CHANNELS, c, lanes, rgb[source_[c]] * scale[c] + bias[c]);
+                    }
+                }
+            }
+        }
+    private:
+        tensor_config config_;
+        int source_[3] = { 0, 1, 2 };
+        float scale_[3] = { 1, 1, 1 };          // < 1 / (std * quant_scale)
+        float bias_[3] = { 0, 0, 0 };           // < zero_point - mean / (std * quant_scale)
+        std::vector<tensor_column> columns_;
+        std::vector<tensor_row> rows_;
+        qcarcam_color_fmt_t src_format_ = QCARCAM_FMT_MAX;
+        int src_width_ = 0;
+        int src_height_ = 0;
+        bool planar_ = false;
+    };
+}
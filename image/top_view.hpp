@@ -0,0 +1,429 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "dewarp.hpp"
+#include "camera_controller.hpp"
+namespace qnx_screen_camera {
+    struct camera_pose {                // mount in the vehicle frame: x forward, y left, z up, meters
+        double x = 0;
+        double y = 0;
+        double z = 1.0;
+        double yaw_deg = 0;             // < Heading of the optical axis, 0 forward, 90 left
+        double pitch_deg = 30;          // < Tilt of the optical axis below the horizon
+        double roll_deg = 0;
+    };
+    struct top_view_camera {
+        fisheye_intrinsics lens;
+        camera_pose pose;
+        double max_theta_deg = 95;      // < Rays further off axis are not used
+        int src_width = 0;              // < Frame size the table is built for
+        int src_height = 0;
+    };
+    struct top_view_config {
+        int width = 640;                // < Output buffer, UYVY
+        int height = 640;
+        double meters_per_pixel = 0.02;
+        double origin_x = 0;            // < Vehicle point shown at the output center
+        double origin_y = 0;
+        double vehicle_length = 4.8;    // < Footprint around the origin left black
+        double vehicle_width = 1.9;
+        double blend_band = 0.15;       // < Score difference over which two cameras cross fade at a seam
+    };
+    enum top_view_param : int {
+        TOP_VIEW_MAX_CAMERAS = 8,
+        TOP_VIEW_NONE = 0xFF,           // < No camera sees the pixel
+        TOP_VIEW_WEIGHT_ONE = 128,      // < Blend weights are 1/128
+        TOP_VIEW_TILE_W = 64,
+        TOP_VIEW_TILE_H = 16,
+    };
+    // everything the render pass needs for one output pixel: up to two source cameras with their
+    // 12.4 fixed point positions (as in remap_lut) and the share of the first one
+    struct top_view_entry {
+        uint32_t pos[2];
+        uint8_t cam[2];
+        uint8_t weight;                 // < Of cam[0] in 1/128, cam[1] only read below TOP_VIEW_WEIGHT_ONE
+        uint8_t reserved;
+    };
+    // ground plane view fused from several fisheye cameras through one table, rendered in a single
+    // pass straight from the captured buffers. The table keeps a projection layer per camera, so a
+    // calibration change recomputes one layer and re-fuses only the tiles it touches
+    class top_view_engine {
+    public:
+        bool configure(const top_view_config &config, const std::vector<top_view_camera> &cameras, thread_pool *pool) {
+            if (config.width <= 0 || config.height <= 0 || config.meters_per_pixel <= 0 ||
+                cameras.empty() || cameras.size() > TOP_VIEW_MAX_CAMERAS) {
+                LOG_E("top view: bad config %dx%d with %zu cameras", config.width, config.height, cameras.size());
+                return false;
+            }
+            config_ = config;
+            cameras_ = cameras;
+            tiles_x_ = (config_.width + TOP_VIEW_TILE_W - 1) / TOP_VIEW_TILE_W;
+            tiles_y_ = (config_.height + TOP_VIEW_TILE_H - 1) / TOP_VIEW_TILE_H;
+            size_t pixels = static_cast<size_t>(config_.width) * config_.height;
+            top_view_entry none;
+            memset(&none, 0, sizeof(none));
+            none.cam[0] = none.cam[1] = TOP_VIEW_NONE;
+            entries_.assign(pixels, none);
+            layers_.assign(cameras_.size(), layer());
+            tile_cams_.assign(static_cast<size_t>(tiles_x_) * tiles_y_, 0);
+            for (size_t i = 0;i < cameras_.size();++i) {
+                if (!build_layer(i, pool)) {
+                    return false;
+                }
+            }
+            std::vector<uint8_t> dirty(tile_cams_.size(), 1);
+            fuse(dirty, pool);
+            {
+                std::lock_guard<std::mutex> guard(pending_mutex_);
+                pending_.clear();
+            }
+            return true;
+        }
+        // new calibration for camera idx, applied by the next update()
+        bool set_camera(size_t idx, const top_view_camera &camera) {
+            std::lock_guard<std::mutex> guard(pending_mutex_);
+            if (idx >= cameras_.size()) {
+                return false;
+            }
+            pending_.push_back(std::make_pair(idx, camera));
+            return true;
+        }
+        // applies queued calibrations, returns the number of tiles re-fused
+        int update(thread_pool *pool) {
+            std::vector<std::pair<size_t, top_view_camera>> pending;
+            {
+                std::lock_guard<std::mutex> guard(pending_mutex_);
+                pending.swap(pending_);
+            }
+            if (pending.empty()) {
+                return 0;
+            }
+            std::vector<uint8_t> dirty(tile_cams_.size(), 0);
+            for (auto &item : pending) {
+                uint8_t bit = static_cast<uint8_t>(1u << item.first);
+                for (size_t t = 0;t < tile_cams_.size();++t) {      // tiles the camera covered before
+                    dirty[t] |= (tile_cams_[t] & bit) ? 1 : 0;
+                }
+                cameras_[item.first] = item.second;
+                if (!build_layer(item.first, pool)) {
+                    layers_[item.first].score.assign(layers_[item.first].score.size(), 0);
+                }
+                const layer &l = layers_[item.first];
+                for (int t = 0;t < tiles_x_ * tiles_y_;++t) {       // and the ones it covers now
+                    if (dirty[t]) {
+                        continue;
+                    }
+                    for_tile(t, [&](size_t i) {
+                        dirty[t] |= l.score[i] ? 1 : 0;
+                    });
+                }
+            }
+            return fuse(dirty, pool);
+        }
+        // frames in camera order, all packed 4:2:2 at the calibrated size; dst is UYVY
+        bool render(const std::vector<camera_frame> &frames, uint8_t *dst, uint32_t dst_stride, thread_pool *pool) {
+            if (frames.size() != cameras_.size() || nullptr == dst) {
+                return false;
+            }
+            job work;
+            for (size_t i = 0;i < frames.size();++i) {
+                const camera_frame &f = frames[i];
+                int luma = luma_packed_offset(f.format);
+                if (nullptr == f.data || luma < 0 || QCARCAM_COLOR_GET_BITDEPTH(f.format) != QCARCAM_BITDEPTH_8 ||
+                    static_cast<int>(f.width) != cameras_[i].src_width ||
+                    static_cast<int>(f.height) != cameras_[i].src_height) {
+                    LOG_E("top view: camera %zu frame %ux%u format 0x%x does not match", i, f.width, f.height, f.format);
+                    return false;
+                }
+                work.src[i] = f.data;
+                work.stride[i] = f.stride;
+                work.luma[i] = luma;
+                work.chroma[i] = 1 - luma;
+                work.chroma_last[i] = static_cast<int>(f.width) / 2 - 1;
+            }
+            work.dst = dst;
+            work.dst_stride = dst_stride;
+            auto run_tile = [this, &work](int t) {
+                render_tile(work, t);
+            };
+            if (pool) {
+                pool->parallel_for(tiles_x_ * tiles_y_, run_tile);
+            }
+            else {
+                for (int t = 0;t < tiles_x_ * tiles_y_;++t) {
+                    run_tile(t);
+                }
+            }
+            return true;
+        }
+        inline const top_view_config &get_config() const {
+            return config_;
+        }
+        inline size_t camera_count() const {
+            return cameras_.size();
+        }
+    private:
+        struct layer {                  // one camera's view of every output pixel
+            std::vector<uint32_t> pos;
+            std::vector<uint8_t> score; // < 0 unseen, else 1 + 254 * (1 - theta / max_theta)
+        };
+        struct job {
+            const uint8_t *src[TOP_VIEW_MAX_CAMERAS];
+            uint32_t stride[TOP_VIEW_MAX_CAMERAS];
+            int luma[TOP_VIEW_MAX_CAMERAS];
+            int chroma[TOP_VIEW_MAX_CAMERAS];
+            int chroma_last[TOP_VIEW_MAX_CAMERAS];
+            uint8_t *dst;
+            uint32_t dst_stride;
+        };
+        struct samples {                // one candidate for 8 pixels, see bilinear_4bit
+            uint16_t p[4][remap_engine::LANES];
+            uint16_t w[2][remap_engine::LANES];
+            uint16_t c[4][remap_engine::LANES];
+            uint16_t cw[2][remap_engine::LANES];
+        };
+        template <typename Fn>
+        void for_tile(int t, Fn fn) const {
+            int x0 = (t % tiles_x_) * TOP_VIEW_TILE_W, y0 = (t / tiles_x_) * TOP_VIEW_TILE_H;
+            int x1 = std::min(x0 + static_cast<int>(TOP_VIEW_TILE_W), config_.width);
+            int y1 = std::min(y0 + static_cast<int>(TOP_VIEW_TILE_H), config_.height);
+            for (int y = y0;y < y1;++y) {
+                for (int x = x0;x < x1;++x) {
+                    fn(static_cast<size_t>(y) * config_.width + x);
+                }
+            }
+        }
+        bool build_layer(size_t idx, thread_pool *pool) {
+            const top_view_camera &cam = cameras_[idx];
+            const fisheye_intrinsics &lens = cam.lens;
+            if (cam.src_width < 2 || cam.src_height < 2 || cam.src_width > static_cast<int>(REMAP_MAX_SIZE) ||
+                cam.src_height > static_cast<int>(REMAP_MAX_SIZE) || lens.fx <= 0 || lens.fy <= 0) {
+                LOG_E("top view: camera %zu bad calibration for %dx%d", idx, cam.src_width, cam.src_height);
+                return false;
+            }
+            layer &l = layers_[idx];
+            size_t pixels = static_cast<size_t>(config_.width) * config_.height;
+            l.pos.assign(pixels, REMAP_INVALID);
+            l.score.assign(pixels, 0);
+            const double deg = M_PI / 180.0;
+            double sx = lens.width > 0 ? static_cast<double>(cam.src_width) / lens.width : 1.0;
+            double sy = lens.height > 0 ? static_cast<double>(cam.src_height) / lens.height : 1.0;
+            double cyaw = cos(cam.pose.yaw_deg * deg), syaw = sin(cam.pose.yaw_deg * deg);
+            double cp = cos(cam.pose.pitch_deg * deg), sp = sin(cam.pose.pitch_deg * deg);
+            double cr = cos(cam.pose.roll_deg * deg), sr = sin(cam.pose.roll_deg * deg);
+            double max_theta = std::max(cam.max_theta_deg, 1.0) * deg;
+            double half_length = config_.vehicle_length / 2, half_width = config_.vehicle_width / 2;
+            auto build_row = [&](int v) {
+                double gx = config_.origin_x + (config_.height / 2.0 - v - 0.5) * config_.meters_per_pixel;
+                size_t base = static_cast<size_t>(v) * config_.width;
+                for (int u = 0;u < config_.width;++u) {
+                    double gy = config_.origin_y + (config_.width / 2.0 - u - 0.5) * config_.meters_per_pixel;
+                    if (fabs(gx) < half_length && fabs(gy) < half_width) {
+                        continue;
+                    }
+                    // vehicle to camera: undo the heading, swap to x right / y down / z ahead,
+                    // then undo the tilt and the roll
+                    double dx = gx - cam.pose.x, dy = gy - cam.pose.y, dz = -cam.pose.z;
+                    double fwd = cyaw * dx + syaw * dy, left = -syaw * dx + cyaw * dy;
+                    double x0 = -left, y0 = -dz, z0 = fwd;
+                    double y1 = cp * y0 - sp * z0, z1 = sp * y0 + cp * z0;
+                    double x = cr * x0 + sr * y1, y = -sr * x0 + cr * y1;
+                    uint32_t pos = REMAP_INVALID;
+                    double theta = fisheye_project(lens, x, y, z1, sx, sy, cam.src_width, cam.src_height, pos);
+                    if (REMAP_INVALID == pos || theta >= max_theta) {
+                        continue;
+                    }
+                    l.pos[base + u] = pos;
+                    l.score[base + u] = static_cast<uint8_t>(1 + 254 * (1 - theta / max_theta));
+                }
+            };
+            if (pool) {
+                pool->parallel_for(config_.height, build_row);
+            }
+            else {
+                for (int v = 0;v < config_.height;++v) {
+                    build_row(v);
+                }
+            }
+            return true;
+        }
+        // picks the two best scoring cameras per pixel of the dirty tiles, returns the tile count
+        int fuse(const std::vector<uint8_t> &dirty, thread_pool *pool) {
+            std::vector<int> tiles;
+            for (size_t t = 0;t < dirty.size();++t) {
+                if (dirty[t]) {
+                    tiles.push_back(static_cast<int>(t));
+                }
+            }
+            double band = std::max(config_.blend_band, 1e-3) * 254;
+            auto fuse_tile = [&](int n) {
+                int t = tiles[n];
+                uint8_t mask = 0;
+                for_tile(t, [&](size_t i) {
+                    int best = -1, second = -1;
+                    for (size_t c = 0;c < layers_.size();++c) {
+                        uint8_t s = layers_[c].score[i];
+                        if (0 == s) {
+                            continue;
+                        }
+                        mask |= static_cast<uint8_t>(1u << c);
+                        if (best < 0 || s > layers_[best].score[i]) {
+                            second = best;
+                            best = static_cast<int>(c);
+                        }
+                        else if (second < 0 || s > layers_[second].score[i]) {
+                            second = static_cast<int>(c);
+                        }
+                    }
+                    top_view_entry &e = entries_[i];
+                    e.cam[0] = e.cam[1] = TOP_VIEW_NONE;
+                    e.weight = TOP_VIEW_WEIGHT_ONE;
+                    if (best < 0) {
+                        return;
+                    }
+                    e.cam[0] = static_cast<uint8_t>(best);
+                    e.pos[0] = layers_[best].pos[i];
+                    if (second < 0) {
+                        return;
+                    }
+                    double share = 0.5 + (layers_[best].score[i] - layers_[second].score[i]) / (2 * band);
+                    int weight = static_cast<int>(std::min(share, 1.0) * TOP_VIEW_WEIGHT_ONE + 0.5);
+                    if (weight < TOP_VIEW_WEIGHT_ONE) {
+                        e.cam[1] = static_cast<uint8_t>(second);
+                        e.pos[1] = layers_[second].pos[i];
+                        e.weight = static_cast<uint8_t>(weight);
+                    }
+                });
+                tile_cams_[t] = mask;
+            };
+            if (pool) {
+                pool->parallel_for(static_cast<int>(tiles.size()), fuse_tile);
+            }
+            else {
+                for (size_t n = 0;n < tiles.size();++n) {
+                    fuse_tile(static_cast<int>(n));
+                }
+            }
+            return static_cast<int>(tiles.size());
+        }
+        // lane of s from camera cam at pos; chroma is taken for even lanes and fills lane, lane + 1
+        static inline void gather(const job &j, int cam, uint32_t pos, int lane, samples &s) {
+            uint32_t sx = pos & 0xFFFF, sy = pos >> 16;
+            const uint8_t *row = j.src[cam] + static_cast<size_t>(sy >> REMAP_FRACTION_BITS) * j.stride[cam];
+            const uint8_t *a = row + (sx >> REMAP_FRACTION_BITS) * 2 + j.luma[cam];
+            uint32_t stride = j.stride[cam];
+            s.p[0][lane] = a[0];
+            s.p[1][lane] = a[2];
+            s.p[2][lane] = a[stride];
+            s.p[3][lane] = a[stride + 2];
+            s.w[0][lane] = sx & (REMAP_ONE - 1);
+            s.w[1][lane] = sy & (REMAP_ONE - 1);
+            if (lane & 1) {
+                return;
+            }
+            uint32_t cx = sx >> 1;
+            int g0 = cx >> REMAP_FRACTION_BITS;
+            int g1 = std::min(g0 + 1, j.chroma_last[cam]);
+            const uint8_t *b = row + j.chroma[cam];
+            for (int k = 0;k < 2;++k) {
+                s.c[0][lane + k] = b[g0 * 4 + 2 * k];
+                s.c[1][lane + k] = b[g1 * 4 + 2 * k];
+                s.c[2][lane + k] = b[g0 * 4 + 2 * k + stride];
+                s.c[3][lane + k] = b[g1 * 4 + 2 * k + stride];
+                s.cw[0][lane + k] = cx & (REMAP_ONE - 1);
+                s.cw[1][lane + k] = sy & (REMAP_ONE - 1);
+            }
+        }
+        static inline void fill(int lane, uint16_t luma, uint16_t chroma, samples &s) {
+            s.p[0][lane] = s.p[1][lane] = s.p[2][lane] = s.p[3][lane] = luma;
+            s.w[0][lane] = s.w[1][lane] = 0;
+            if (lane & 1) {
+                return;
+            }
+            for (int k = 0;k < 2;++k) {
+                s.c[0][lane + k] = s.c[1][lane + k] = s.c[2][lane + k] = s.c[3][lane + k] = chroma;
+                s.cw[0][lane + k] = s.cw[1][lane + k] = 0;
+            }
+        }
+        static inline void sample(const samples &s, simd::u16x8 &luma, simd::u16x8 &chroma) {
+            using simd::load;
+            using simd::u16x8;
+            luma = bilinear_4bit(load<u16x8>(s.p[0]), load<u16x8>(s.p[1]), load<u16x8>(s.p[2]),
+                                 load<u16x8>(s.p[3]), load<u16x8>(s.w[0]), load<u16x8>(s.w[1]));
+            chroma = bilinear_4bit(load<u16x8>(s.c[0]), load<u16x8>(s.c[1]), load<u16x8>(s.c[2]),
+                                   load<u16x8>(s.c[3]), load<u16x8>(s.cw[0]), load<u16x8>(s.cw[1]));
+        }
+        void render_tile(const job &j, int t) const {
+            using simd::u16x8;
+            const int lanes = remap_engine::LANES;
+            int x0 = (t % tiles_x_) * TOP_VIEW_TILE_W, y0 = (t / tiles_x_) * TOP_VIEW_TILE_H;
+            int x1 = std::min(x0 + static_cast<int>(TOP_VIEW_TILE_W), config_.width);
+            int y1 = std::min(y0 + static_cast<int>(TOP_VIEW_TILE_H), config_.height);
+            samples first, second;
+            uint16_t weight[remap_engine::LANES];
+            for (int y = y0;y < y1;++y) {
+                const top_view_entry *row = entries_.data() + static_cast<size_t>(y) * config_.width;
+                uint8_t *out = j.dst + static_cast<size_t>(y) * j.dst_stride;
+                for (int x = x0;x < x1;x += lanes) {
+                    int n = std::min(lanes, x1 - x);
+                    bool blend = false;
+                    for (int lane = 0;lane < lanes;++lane) {
+                        const top_view_entry &e = row[x + std::min(lane, n - 1)];
+                        if (TOP_VIEW_NONE == e.cam[0]) {
+                            fill(lane, 16, 128, first);
+                        }
+                        else {
+                            gather(j, e.cam[0], e.pos[0], lane, first);
+                        }
+                        weight[lane] = e.weight;
+                        blend |= e.weight < TOP_VIEW_WEIGHT_ONE;
+                    }
+                    u16x8 luma, chroma;
+                    sample(first, luma, chroma);
+                    if (blend) {
+                        uint16_t chroma_weight[remap_engine::LANES];
+                        for (int lane = 0;lane < lanes;++lane) {
+                            const top_view_entry &e = row[x + std::min(lane, n - 1)];
+                            if (e.weight < TOP_VIEW_WEIGHT_ONE) {
+                                gather(j, e.cam[1], e.pos[1], lane, second);
+                            }
+                            else {
+                                fill(lane, 0, 0, second);
+                            }
+                            chroma_weight[lane] = weight[lane & ~1];      // chroma follows the even pixel
+                        }
+                        u16x8 luma2, chroma2;
+                        sample(second, luma2, chroma2);
+                        const u16x8 one = simd::splat<u16x8>(TOP_VIEW_WEIGHT_ONE);
+                        const u16x8 half = simd::splat<u16x8>(TOP_VIEW_WEIGHT_ONE / 2);
+                        u16x8 w = simd::load<u16x8>(weight), cw = simd::load<u16x8>(chroma_weight);
+                        luma = (luma * w + luma2 * (one - w) + half) >> 7;
+                        chroma = (chroma * cw + chroma2 * (one - cw) + half) >> 7;
+                    }
+                    // UYVY: chroma in the low byte of each pixel's 16 bits, luma in the high one
+                    u16x8 packed = chroma | (luma << 8);
+                    if (lanes == n) {
+                        simd::store(out + x * 2, packed);
+                    }
+                    else {
+                        memcpy(out + x * 2, &packed, n * 2);
+                    }
+                }
+            }
+        }
+    private:
+        top_view_config config_;
+        std::vector<top_view_camera> cameras_;
+        std::vector<layer> layers_;
+        std::vector<top_view_entry> entries_;
+        std::vector<uint8_t> tile_cams_;        // < Bit per camera seen somewhere in the tile
+        int tiles_x_ = 0;
+        int tiles_y_ = 0;
+        std::mutex pending_mutex_;
+        std::vector<std::pair<size_t, top_view_camera>> pending_;
+    };
+}
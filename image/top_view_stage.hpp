@@ -0,0 +1,199 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "clock.hpp"
+#include "top_view.hpp"
+#include "sync_group.hpp"
+namespace qnx_screen_camera {
+    // renders the top view from time matched sets of the member cameras into its own window:
+    // the sync callback only holds the set in a single slot (an older unrendered set is released),
+    // the stage thread applies calibration changes between frames, renders and gives the buffers back
+    class top_view_stage {
+    public:
+        top_view_stage(const std::vector<std::shared_ptr<camera_controller>> &members, const top_view_config &config,
+                       const std::vector<top_view_camera> &cameras, int threads = 0,
+                       const thread_policy &policy = thread_policy(), const std::string &name = "topview")
+            : members_(members), config_(config), cameras_(cameras), policy_(policy), name_(name) {
+            if (threads <= 0) {
+                threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 4);
+            }
+            pool_.reset(new thread_pool(threads - 1, policy_, name_ + "_"));
+        }
+        virtual ~top_view_stage() {
+            stop();
+        }
+        bool init_display(const screen_attribute &screenAttr, int num_buffers = 3) {
+            screen_attribute attr = screenAttr;
+            attr.buffer_size = { config_.width, config_.height };
+            attr.format = SCREEN_FORMAT_UYVY;
+            attr.usage = SCREEN_USAGE_WRITE | SCREEN_USAGE_NATIVE;
+            win_ = std::make_shared<screen_window>(std::make_shared<screen_context>());
+            if (!win_->init(attr)) {
+                return false;
+            }
+            window_buffer_attr bufferAttr;
+            bufferAttr.num = std::max(num_buffers, 2);
+            bufferAttr.size[0] = config_.width;
+            bufferAttr.size[1] = config_.height;
+            if (!win_->init_buffer(bufferAttr)) {
+                LOG_E("top view init buffer error!");
+                return false;
+            }
+            for (auto &handle : win_->get_win_buf().handles) {
+                if (nullptr == handle.ptr[0]) {
+                    LOG_E("top view buffer not mapped!");
+                    return false;
+                }
+            }
+            return true;
+        }
+        bool start(uint64_t tolerance_ns) {
+            if (worker_ != nullptr || !win_ || members_.size() != cameras_.size()) {
+                return false;
+            }
+            uint64_t begin = monotonic_ns();
+            if (!engine_.configure(config_, cameras_, pool_.get())) {
+                return false;
+            }
+            LOG_I("top view table %dx%d from %zu cameras built in %.1f ms", config_.width, config_.height,
+                  cameras_.size(), (monotonic_ns() - begin) / 1e6);
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(policy_, name_);
+                this->run();
+            });
+            group_ = std::make_shared<sync_group>(members_, tolerance_ns, [this](const std::vector<camera_frame> &set) {
+                this->on_set(set);
+            });
+            if (!group_->start()) {
+                stop();
+                return false;
+            }
+            return true;
+        }
+        void stop() {
+            if (group_) {
+                group_->stop();
+                group_ = nullptr;
+            }
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+            if (has_pending_) {
+                release(pending_);
+                has_pending_ = false;
+            }
+        }
+        // new calibration of member idx, the table is patched before the next frame
+        inline bool set_camera(size_t idx, const top_view_camera &camera) {
+            return engine_.set_camera(idx, camera);
+        }
+        inline double last_render_ms() const {
+            return last_render_ns_ / 1e6;
+        }
+        inline uint64_t rendered() const {
+            return rendered_;
+        }
+        inline uint64_t skipped() const {
+            return skipped_;
+        }
+        inline const std::shared_ptr<screen_window> &get_window() const {
+            return win_;
+        }
+    private:
+        void on_set(const std::vector<camera_frame> &set) {
+            for (size_t i = 0;i < set.size();++i) {
+                if (!members_[i]->hold_frame(set[i].idx)) {
+                    for (size_t j = 0;j < i;++j) {
+                        members_[j]->release_frame(set[j].idx);
+                    }
+                    return;
+                }
+            }
+            std::vector<camera_frame> stale;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (has_pending_) {
+                    stale.swap(pending_);
+                    ++skipped_;
+                }
+                pending_ = set;
+                has_pending_ = true;
+            }
+            release(stale);
+            cv_.notify_one();
+        }
+        void run() {
+            auto &buffer = win_->get_win_buf();
+            int next = -1;
+            while (true) {
+                std::vector<camera_frame> set;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || has_pending_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                    set.swap(pending_);
+                    has_pending_ = false;
+                }
+                int tiles = engine_.update(pool_.get());
+                if (tiles > 0) {
+                    LOG_D("top view calibration patched %d tiles", tiles);
+                }
+                next = (next + 1) % static_cast<int>(buffer.handles.size());
+                uint64_t begin = monotonic_ns();
+                bool ok = engine_.render(set, static_cast<uint8_t *>(buffer.handles[next].ptr[0]), buffer.stride[0],
+                                         pool_.get());
+                release(set);
+                if (!ok) {
+                    continue;
+                }
+                last_render_ns_ = monotonic_ns() - begin;
+                ++rendered_;
+                int rect[4] = { 0, 0, config_.width, config_.height };
+                win_->post_buffer(next, rect, 1, 0);
+            }
+        }
+        void release(const std::vector<camera_frame> &set) {
+            for (size_t i = 0;i < set.size();++i) {
+                members_[i]->release_frame(set[i].idx);
+            }
+        }
+    private:
+        std::vector<std::shared_ptr<camera_controller>> members_;
+        top_view_config config_;
+        std::vector<top_view_camera> cameras_;
+        thread_policy policy_;
+        std::string name_;
+        std::unique_ptr<thread_pool> pool_;
+        top_view_engine engine_;
+        std::shared_ptr<sync_group> group_;
+        std::shared_ptr<screen_window> win_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<camera_frame> pending_;
+        bool has_pending_ = false;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        std::atomic<uint64_t> last_render_ns_{0};
+        std::atomic<uint64_t> rendered_{0};
+        std::atomic<uint64_t> skipped_{0};
+    };
+}
@@ -1,4 +1,5 @@
 #include "camera_manager.hpp"
+#include "control_server.hpp"
 using namespace qnx_screen_camera;
 int main() {
    if (false == G_CAMERA_MANAGER.init()) {
@@ -11,11 +12,12 @@ int main() {
 
    capture_attr cAttr;
    cAttr.input_id = QCARCAM_INPUT_TYPE_TOF_DEPTH;
-   if (false == G_CAMERA_MANAGER.init()) {
-      return -1;
-   }
    qcarcam_hndl_t handle = G_CAMERA_MANAGER.create_camera_connect(sAttr, cAttr);
    G_CAMERA_MANAGER.start_capture(handle);
+   control_server server;
+   if (false == server.start()) {
+      return -1;
+   }
    while (true) {
       std::this_thread::sleep_for(std::chrono::seconds(10));
    }
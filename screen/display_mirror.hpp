@@ -0,0 +1,173 @@
+#pragma once
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "thread_policy.hpp"
+#include "screen_window.hpp"
+namespace qnx_screen_camera {
+    enum display_mirror_param : int {
+        MIRROR_LATCH_VSYNCS = 2,        // < Vsyncs of the mirror display after a post until it surely scans the new buffer
+    };
+    // gives a buffer reference back, called on the mirror thread or in stop()
+    using buffer_release = std::function<void(int idx)>;
+    // one more window of a stream on another display: it shares the buffers of the source window, so
+    // every post to the source shows here too, at the mirror's own size, position and viewport. That
+    // display flips on its own vsync, so each post made while the mirror is visible hands it a buffer
+    // reference; the mirror thread gives the previous buffer back once its display latched a newer one
+    class display_mirror {
+    public:
+        display_mirror(const std::shared_ptr<screen_window> &source, const buffer_release &release,
+                       const thread_policy &policy = thread_policy(), const std::string &name = "mirror")
+            : source_(source), release_(release), policy_(policy), name_(name) {
+        }
+        virtual ~display_mirror() {
+            stop();
+        }
+        // listener is told about visibility changes of the mirror window, after the mirror handled them
+        bool start(const screen_attribute &attr, const visibility_listener &listener = nullptr) {
+            if (worker_ != nullptr || !source_ || !release_) {
+                return false;
+            }
+            auto win = std::make_shared<screen_window>(std::make_shared<screen_context>());
+            if (!win->init_mirror(attr, *source_)) {
+                LOG_E("mirror on display %d error!", attr.display_id);
+                return false;
+            }
+            win_ = win;
+            listener_ = listener;
+            win_->set_visibility_listener([this](bool visible) {
+                this->on_visibility(visible);
+            });
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(policy_, name_);
+                this->run();
+            });
+            return true;
+        }
+        // destroys the window, then gives back every reference it still holds
+        void stop() {
+            if (win_) {
+                win_->set_visibility_listener(nullptr);
+            }
+            if (worker_ != nullptr) {
+                {
+                    std::lock_guard<std::mutex> guard(mutex_);
+                    keep_running_ = false;
+                }
+                cv_.notify_all();
+                if (worker_->joinable()) {
+                    worker_->join();
+                }
+                delete worker_;
+                worker_ = nullptr;
+            }
+            if (win_) {
+                win_->destroy();
+                win_->flush(SCREEN_WAIT_IDLE);     // the compositor let go of the window
+                win_ = nullptr;
+            }
+            release_all();
+        }
+        // right after the source posted idx; the caller took the reference that now belongs to the mirror
+        void post(int idx) {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                pending_.push_back(latch{ idx, vsyncs_ });
+            }
+            cv_.notify_one();
+        }
+        // every reference at once, when nothing reads the buffers any more (capture stopped, window gone)
+        void release_all() {
+            std::vector<int> held;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                for (auto &entry : pending_) {
+                    if (entry.idx >= 0) {
+                        held.push_back(entry.idx);
+                    }
+                }
+                pending_.clear();
+                if (shown_ >= 0) {
+                    held.push_back(shown_);
+                    shown_ = -1;
+                }
+            }
+            for (int idx : held) {
+                release_(idx);
+            }
+        }
+        inline bool is_visible() const {
+            return win_ && win_->is_visible();
+        }
+        // for size, position and viewport changes of the mirror alone
+        inline const std::shared_ptr<screen_window> &get_window() const {
+            return win_;
+        }
+    private:
+        struct latch {
+            int idx;                    // < -1: the window was hidden, nothing is scanned out after it
+            uint64_t vsync;             // < vsyncs_ when it was posted
+        };
+        void on_visibility(bool visible) {
+            if (!visible) {
+                post(-1);
+            }
+            if (listener_) {
+                listener_(visible);
+            }
+        }
+        void run() {
+            screen_display_t display = win_->get_display();
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || !pending_.empty(); });
+                    if (!keep_running_) {
+                        break;
+                    }
+                }
+                if (nullptr == display || screen_wait_vsync(display)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(16));
+                }
+                std::vector<int> done;
+                {
+                    // the newest latched post is on screen now, what was shown or posted before it is free
+                    std::lock_guard<std::mutex> guard(mutex_);
+                    ++vsyncs_;
+                    while (!pending_.empty() && pending_.front().vsync + MIRROR_LATCH_VSYNCS <= vsyncs_) {
+                        if (shown_ >= 0) {
+                            done.push_back(shown_);
+                        }
+                        shown_ = pending_.front().idx;
+                        pending_.pop_front();
+                    }
+                }
+                for (int idx : done) {
+                    release_(idx);
+                }
+            }
+        }
+    private:
+        std::shared_ptr<screen_window> source_;
+        std::shared_ptr<screen_window> win_;
+        buffer_release release_;
+        visibility_listener listener_;
+        thread_policy policy_;
+        std::string name_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        std::deque<latch> pending_;         // < Posted, not yet latched by the display, oldest first
+        int shown_ = -1;                    // < Buffer the display scans out
+        uint64_t vsyncs_ = 0;               // < Vsyncs seen by the mirror thread
+    };
+}
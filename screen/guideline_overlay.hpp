@@ -0,0 +1,367 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "thread_policy.hpp"
+#include "overlay_window.hpp"
+namespace qnx_screen_camera {
+    struct guideline_config {
+        double wheelbase_m = 2.8;
+        double steering_ratio = 15.0;       // < Steering wheel angle per road wheel angle
+        double rear_overhang_m = 1.0;       // < Rear axle to bumper
+        double track_width_m = 1.8;         // < Distance between the two guide lines
+        double max_distance_m = 4.0;        // < Length of the lines behind the bumper
+        std::vector<double> marks_m = { 0.5, 1.5, 3.0 };    // < Cross marks, also where the color changes
+        uint32_t colors[3] = { 0xFFFF3030, 0xFFFFD020, 0xFF30E040 };   // < 0xAARRGGBB before/between/after marks
+        double camera_height_m = 1.0;
+        double camera_pitch_deg = 35.0;     // < Down from horizontal
+        double camera_hfov_deg = 110.0;     // < Of the undistorted view the lines are drawn over
+        double camera_offset_m = 0.0;       // < Camera lateral offset from the vehicle center line
+        bool mirror = true;                 // < Rear view shown mirrored like an inside mirror
+        double bucket_deg = 4.0;            // < Steering wheel degrees per cached rendering
+        double line_width_px = 5.0;         // < In overlay buffer pixels
+        size_t cache_entries = 48;
+    };
+    enum guideline_param : int {
+        GUIDE_CELLS_X = 2,                  // < Dirty rect grid, one column per guide line
+        GUIDE_CELLS_Y = 8,
+        GUIDE_CELLS = GUIDE_CELLS_X * GUIDE_CELLS_Y,
+    };
+    // rendered lines of one steering bucket as horizontal runs of non transparent pixels, so a
+    // buffer is cleared and redrawn only where lines are; the bounds per grid cell follow the
+    // slanted lines much closer than one box around both
+    struct guideline_sprite {
+        struct span {
+            int y;
+            int x;
+            int len;
+            size_t offset;                  // < Into pixels
+        };
+        int cells[GUIDE_CELLS][4];          // < x0, y0, x1, y1 inclusive, x1 < x0 if empty
+        std::vector<span> spans;
+        std::vector<uint32_t> pixels;
+    };
+    // parking guide lines over a camera window from the steering wheel angle: positions are bucketed,
+    // each bucket is rasterized once and cached, and a change only redraws and posts the rectangles
+    // the old and new lines cover; everything runs on the overlay thread, apart from the capture path
+    class guideline_overlay {
+    public:
+        guideline_overlay(const guideline_config &config, const thread_policy &policy = thread_policy(),
+                          const std::string &name = "guide")
+            : config_(config), policy_(policy), name_(name) {
+            if (config_.bucket_deg <= 0) {
+                config_.bucket_deg = 1.0;
+            }
+            config_.cache_entries = std::max<size_t>(config_.cache_entries, 1);
+        }
+        virtual ~guideline_overlay() {
+            stop();
+        }
+        bool start(const std::shared_ptr<screen_window> &camera_window, double scale = 0.5) {
+            if (worker_ != nullptr || !overlay_.init_above(camera_window, scale)) {
+                return false;
+            }
+            if (overlay_.buffer_count() < 2) {
+                LOG_E("guideline overlay needs at least 2 buffers!");
+                return false;
+            }
+            canvas_.assign(static_cast<size_t>(overlay_.width()) * overlay_.height(), 0);
+            content_.assign(overlay_.buffer_count(), nullptr);
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(policy_, name_);
+                this->run();
+            });
+            return true;
+        }
+        void stop() {
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+        }
+        // steering wheel angle in degrees, positive turns left; cheap, call it on every CAN update
+        void set_steering_angle(double degrees) {
+            int bucket = static_cast<int>(lround(degrees / config_.bucket_deg));
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (bucket == wanted_bucket_) {
+                    return;
+                }
+                wanted_bucket_ = bucket;
+            }
+            cv_.notify_one();
+        }
+        // e.g. only while reverse is engaged
+        bool set_visible(bool visible) {
+            auto win = overlay_.get_window();
+            if (!win || !win->set_visible(visible ? 1 : 0, false)) {
+                return false;
+            }
+            win->flush();
+            return true;
+        }
+        inline uint64_t rendered() const {
+            return rendered_;
+        }
+        inline uint64_t cache_hits() const {
+            return cache_hits_;
+        }
+    private:
+        typedef std::shared_ptr<const guideline_sprite> sprite_ptr;
+        void run() {
+            while (true) {
+                int bucket = 0;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || (wanted_bucket_ != shown_bucket_); });
+                    if (!keep_running_) {
+                        break;
+                    }
+                    bucket = wanted_bucket_;
+                }
+                sprite_ptr sprite = get_sprite(bucket);
+                int idx = overlay_.next_buffer();
+                uint32_t *dst = overlay_.pixels(idx);
+                int stride = overlay_.stride();
+                if (content_[idx]) {
+                    for (auto &span : content_[idx]->spans) {
+                        std::fill_n(dst + static_cast<size_t>(span.y) * stride + span.x, span.len, 0u);
+                    }
+                }
+                for (auto &span : sprite->spans) {
+                    std::copy_n(sprite->pixels.data() + span.offset, span.len, dst + static_cast<size_t>(span.y) * stride + span.x);
+                }
+                content_[idx] = sprite;
+                // on screen only the lines shown last and the new ones change
+                int rects[4 * GUIDE_CELLS] = { 0 };
+                int count = 0;
+                for (int c = 0;c < GUIDE_CELLS;++c) {
+                    int box[4] = { INT_MAX, INT_MAX, -1, -1 };
+                    for (const sprite_ptr &s : { shown_, sprite }) {
+                        if (s && s->cells[c][2] >= s->cells[c][0]) {
+                            box[0] = std::min(box[0], s->cells[c][0]);
+                            box[1] = std::min(box[1], s->cells[c][1]);
+                            box[2] = std::max(box[2], s->cells[c][2]);
+                            box[3] = std::max(box[3], s->cells[c][3]);
+                        }
+                    }
+                    if (box[2] >= box[0]) {
+                        int *rect = rects + 4 * count++;
+                        rect[0] = box[0];
+                        rect[1] = box[1];
+                        rect[2] = box[2] - box[0] + 1;
+                        rect[3] = box[3] - box[1] + 1;
+                    }
+                }
+                if (0 == count) {
+                    rects[2] = 1, rects[3] = 1, count = 1;
+                }
+                overlay_.post(idx, rects, count);
+                shown_ = sprite;
+                std::lock_guard<std::mutex> guard(mutex_);
+                shown_bucket_ = bucket;
+            }
+        }
+        sprite_ptr get_sprite(int bucket) {
+            auto it = cache_index_.find(bucket);
+            if (it != cache_index_.end()) {
+                cache_.splice(cache_.begin(), cache_, it->second);    // most recently used first
+                ++cache_hits_;
+                return it->second->second;
+            }
+            sprite_ptr sprite = render(bucket * config_.bucket_deg);
+            ++rendered_;
+            cache_.emplace_front(bucket, sprite);
+            cache_index_[bucket] = cache_.begin();
+            if (cache_.size() > config_.cache_entries) {
+                cache_index_.erase(cache_.back().first);
+                cache_.pop_back();
+            }
+            return sprite;
+        }
+        // ground point (x to the right of the vehicle, y behind the bumper, meters) to buffer pixels
+        bool project(double x, double y, double &u, double &v) const {
+            const double deg = M_PI / 180.0;
+            double pitch = config_.camera_pitch_deg * deg;
+            double h = config_.camera_height_m;
+            double zc = y * cos(pitch) + h * sin(pitch);                // along the optical axis
+            double yc = h * cos(pitch) - y * sin(pitch);                // image down
+            double xc = (x - config_.camera_offset_m) * (config_.mirror ? 1.0 : -1.0);
+            if (zc < 0.05) {
+                return false;
+            }
+            double f = 0.5 * overlay_.width() / tan(config_.camera_hfov_deg * deg / 2);
+            u = 0.5 * overlay_.width() + f * xc / zc;
+            v = 0.5 * overlay_.height() + f * yc / zc;
+            return true;
+        }
+        // point of a wheel track offset d from the center line after reversing s meters, bicycle model
+        // around the rear axle; radius is signed, positive turns the path to the left
+        void track_point(double radius, double d, double s, double &x, double &y) const {
+            if (0 == radius) {
+                x = d;
+                y = s - config_.rear_overhang_m;
+                return;
+            }
+            double phi = s / radius;
+            x = -radius + (radius + d) * cos(phi);
+            y = -config_.rear_overhang_m + (radius + d) * sin(phi);
+        }
+        uint32_t color_at(double distance) const {
+            size_t band = 0;
+            while (band < config_.marks_m.size() && band < 2 && distance >= config_.marks_m[band]) {
+                ++band;
+            }
+            return config_.colors[band];
+        }
+        sprite_ptr render(double steering_deg) {
+            const double deg = M_PI / 180.0;
+            double wheel = steering_deg / config_.steering_ratio * deg;
+            double radius = fabs(wheel) < 1e-4 ? 0.0 : config_.wheelbase_m / tan(wheel);
+            double half = config_.track_width_m / 2;
+            dirty_[0] = overlay_.width(), dirty_[1] = overlay_.height(), dirty_[2] = -1, dirty_[3] = -1;
+            // the lines start at the bumper, that is after the rear overhang of travel
+            double s0 = config_.rear_overhang_m;
+            double s1 = s0 + config_.max_distance_m;
+            const int steps = 48;
+            for (double side : { -half, half }) {
+                double px = 0, py = 0, pu = 0, pv = 0;
+                bool prev = false;
+                for (int i = 0;i <= steps;++i) {
+                    double s = s0 + (s1 - s0) * i / steps;
+                    track_point(radius, side, s, px, py);
+                    double u = 0, v = 0;
+                    bool ok = project(px, py, u, v);
+                    if (ok && prev) {
+                        draw_segment(pu, pv, u, v, config_.line_width_px, color_at(s - s0 - (s1 - s0) / steps / 2));
+                    }
+                    pu = u, pv = v, prev = ok;
+                }
+            }
+            for (double mark : config_.marks_m) {       // short inward ticks on both lines
+                if (mark > config_.max_distance_m) {
+                    continue;
+                }
+                for (double side : { -half, half }) {
+                    double x0 = 0, y0 = 0, x1 = 0, y1 = 0, u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+                    track_point(radius, side, s0 + mark, x0, y0);
+                    track_point(radius, side * 0.7, s0 + mark, x1, y1);
+                    if (project(x0, y0, u0, v0) && project(x1, y1, u1, v1)) {
+                        draw_segment(u0, v0, u1, v1, config_.line_width_px, color_at(mark));
+                    }
+                }
+            }
+            return extract();
+        }
+        // anti-aliased thick segment into the canvas, the strongest alpha of overlapping lines wins
+        void draw_segment(double u0, double v0, double u1, double v1, double width, uint32_t color) {
+            double r = width / 2;
+            int x_min = std::max(0, static_cast<int>(floor(std::min(u0, u1) - r - 1)));
+            int x_max = std::min(overlay_.width() - 1, static_cast<int>(ceil(std::max(u0, u1) + r + 1)));
+            int y_min = std::max(0, static_cast<int>(floor(std::min(v0, v1) - r - 1)));
+            int y_max = std::min(overlay_.height() - 1, static_cast<int>(ceil(std::max(v0, v1) + r + 1)));
+            double du = u1 - u0, dv = v1 - v0;
+            double len2 = du * du + dv * dv;
+            uint32_t alpha = color >> 24;
+            for (int y = y_min;y <= y_max;++y) {
+                uint32_t *row = canvas_.data() + static_cast<size_t>(y) * overlay_.width();
+                for (int x = x_min;x <= x_max;++x) {
+                    double t = len2 > 0 ? ((x - u0) * du + (y - v0) * dv) / len2 : 0;
+                    t = std::min(std::max(t, 0.0), 1.0);
+                    double ex = x - (u0 + t * du), ey = y - (v0 + t * dv);
+                    double coverage = r + 0.5 - sqrt(ex * ex + ey * ey);
+                    if (coverage <= 0) {
+                        continue;
+                    }
+                    uint32_t a = static_cast<uint32_t>(std::min(coverage, 1.0) * alpha);
+                    if (a > (row[x] >> 24)) {
+                        row[x] = (a << 24) | (color & 0xFFFFFF);
+                    }
+                }
+            }
+            dirty_[0] = std::min(dirty_[0], x_min);
+            dirty_[1] = std::min(dirty_[1], y_min);
+            dirty_[2] = std::max(dirty_[2], x_max);
+            dirty_[3] = std::max(dirty_[3], y_max);
+        }
+        // move the drawn pixels out of the canvas into runs, leaving the canvas clear
+        sprite_ptr extract() {
+            auto sprite = std::make_shared<guideline_sprite>();
+            for (auto &cell : sprite->cells) {
+                cell[0] = cell[1] = INT_MAX;
+                cell[2] = cell[3] = -1;
+            }
+            if (dirty_[2] < dirty_[0] || dirty_[3] < dirty_[1]) {
+                return sprite;
+            }
+            for (int y = dirty_[1];y <= dirty_[3];++y) {
+                int (*row_cells)[4] = sprite->cells + y * GUIDE_CELLS_Y / overlay_.height() * GUIDE_CELLS_X;
+                uint32_t *row = canvas_.data() + static_cast<size_t>(y) * overlay_.width();
+                int x = dirty_[0];
+                while (x <= dirty_[2]) {
+                    if (0 == row[x]) {
+                        ++x;
+                        continue;
+                    }
+                    guideline_sprite::span span = { y, x, 0, sprite->pixels.size() };
+                    while (x <= dirty_[2] && row[x] != 0) {
+                        sprite->pixels.push_back(row[x]);
+                        row[x++] = 0;
+                    }
+                    span.len = x - span.x;
+                    sprite->spans.push_back(span);
+                    // a run crossing the column border counts for both cells
+                    int first = span.x * GUIDE_CELLS_X / overlay_.width();
+                    int last = (x - 1) * GUIDE_CELLS_X / overlay_.width();
+                    for (int c = first;c <= last;++c) {
+                        int *cell = row_cells[c];
+                        cell[0] = std::min(cell[0], std::max(span.x, c * overlay_.width() / GUIDE_CELLS_X));
+                        cell[1] = std::min(cell[1], y);
+                        cell[2] = std::max(cell[2], std::min(x - 1, (c + 1) * overlay_.width() / GUIDE_CELLS_X - 1));
+                        cell[3] = y;
+                    }
+                }
+            }
+            return sprite;
+        }
+    private:
+        guideline_config config_;
+        thread_policy policy_;
+        std::string name_;
+        overlay_window overlay_;
+        std::vector<uint32_t> canvas_;          // < Scratch for rasterizing, all zero between renders
+        int dirty_[4] = { 0 };                  // < x0, y0, x1, y1 drawn into the canvas
+        std::vector<sprite_ptr> content_;       // < What each overlay buffer holds
+        sprite_ptr shown_;
+        std::list<std::pair<int, sprite_ptr>> cache_;
+        std::map<int, std::list<std::pair<int, sprite_ptr>>::iterator> cache_index_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        int wanted_bucket_ = 0;
+        int shown_bucket_ = INT_MIN;
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+        std::atomic<uint64_t> rendered_{0};
+        std::atomic<uint64_t> cache_hits_{0};
+    };
+}
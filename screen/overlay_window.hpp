@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include "screen_window.hpp"
+namespace qnx_screen_camera {
+    // RGBA window stacked above another one with its own small buffer pool; it has its own screen
+    // context, so drawing and posting it never waits on the window below or its capture path
+    class overlay_window {
+    public:
+        // cover below at scale times its pixel size (the compositor scales back up), one zorder higher
+        bool init_above(const std::shared_ptr<screen_window> &below, double scale = 0.5, int num_buffers = 3) {
+            int size[2] = { 0 }, pos[2] = { 0 }, zorder = 0;
+            if (!below || !below->get_property(WIN_PROP_SIZE, size) || !below->get_property(WIN_PROP_POSITION, pos)) {
+                LOG_E("overlay needs an initialized window below!");
+                return false;
+            }
+            if (!below->get_property(WIN_PROP_ZORDER, &zorder)) {
+                zorder = 0;
+            }
+            const display_property *display_pro = below->get_display_property();
+            if (nullptr == display_pro || display_pro->size[0] <= 0 || display_pro->size[1] <= 0) {
+                LOG_E("overlay display %d error!", below->get_display_id());
+                return false;
+            }
+            screen_attribute attr;
+            attr.display_id = below->get_display_id();
+            attr.window_size = { static_cast<double>(size[0]) / display_pro->size[0],
+                                 static_cast<double>(size[1]) / display_pro->size[1] };
+            attr.window_pos = { static_cast<double>(pos[0]) / display_pro->size[0],
+                                static_cast<double>(pos[1]) / display_pro->size[1] };
+            attr.buffer_size = { std::max(static_cast<int>(size[0] * scale), 1), std::max(static_cast<int>(size[1] * scale), 1) };
+            attr.zorder = zorder + 1;
+            attr.format = SCREEN_FORMAT_RGBA8888;
+            attr.usage = SCREEN_USAGE_WRITE | SCREEN_USAGE_NATIVE;
+            attr.transparency = SCREEN_TRANSPARENCY_SOURCE_OVER;
+            return init(std::make_shared<screen_context>(), attr, num_buffers);
+        }
+        bool init(const std::shared_ptr<screen_context> &ctx, const screen_attribute &attr, int num_buffers) {
+            win_ = std::make_shared<screen_window>(ctx);
+            if (!win_->init(attr)) {
+                return false;
+            }
+            window_buffer_attr bufferAttr;
+            bufferAttr.num = num_buffers;
+            bufferAttr.size[0] = attr.buffer_size.x;
+            bufferAttr.size[1] = attr.buffer_size.y;
+            if (!win_->init_buffer(bufferAttr)) {
+                LOG_E("overlay init buffer error!");
+                return false;
+            }
+            width_ = attr.buffer_size.x;
+            height_ = attr.buffer_size.y;
+            auto &buffer = win_->get_win_buf();
+            stride_ = buffer.stride[0] / sizeof(uint32_t);
+            for (size_t i = 0;i < buffer.handles.size();++i) {
+                if (nullptr == buffer.handles[i].ptr[0]) {
+                    LOG_E("overlay buffer %zu not mapped!", i);
+                    return false;
+                }
+                memset(buffer.handles[i].ptr[0], 0, static_cast<size_t>(buffer.stride[0]) * height_);
+            }
+            return true;
+        }
+        // buffers are handed out round robin, so with 3 or more the one returned is not on screen
+        inline int next_buffer() {
+            int count = static_cast<int>(win_->get_win_buf().handles.size());
+            next_ = (next_ + 1) % count;
+            return next_;
+        }
+        inline uint32_t *pixels(int idx) const {           // 0xAARRGGBB, stride() pixels per row
+            return static_cast<uint32_t *>(win_->get_win_buf().handles[idx].ptr[0]);
+        }
+        inline bool post(int idx, const int *rects, int count) {
+            return win_->post_buffer(idx, rects, count);
+        }
+        inline int buffer_count() const {
+            return static_cast<int>(win_->get_win_buf().handles.size());
+        }
+        inline int width() const {
+            return width_;
+        }
+        inline int height() const {
+            return height_;
+        }
+        inline int stride() const {
+            return stride_;
+        }
+        inline const std::shared_ptr<screen_window> &get_window() const {
+            return win_;
+        }
+    private:
+        std::shared_ptr<screen_window> win_;
+        int width_ = 0;
+        int height_ = 0;
+        int stride_ = 0;
+        int next_ = -1;
+    };
+}
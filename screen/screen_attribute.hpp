@@ -12,7 +12,7 @@ namespace qnx_screen_camera {
         DVECT       window_size = { 1.0, 1.0 };                 // < Output window size [width, height] ratio
         DVECT       window_pos = { 0, 0 };                      // < Output window position [x, y] ratio
         DVECT       window_source_size = { 1.0, 1.0 };          // < Source window size [width, height] ratio
-        DVECT       window_source_pos = { 0, 0 };               // < Source window position [x, y]
+        DVECT       window_source_pos = { 0, 0 };               // < Source window position [x, y] ratio
         IVECT       buffer_size = { 0, 0 };                     // < buffer  size
         int         display_id = -1;                            // < Specific display output ID
         int         zorder = -1;                                // < Window position in Z plane
@@ -20,5 +20,7 @@ namespace qnx_screen_camera {
         int         format = SCREEN_FORMAT_UYVY;                // < Displayable format if need to convert
         int         num_buffers_display = 5;                    // < Number of buffers if we need to convert to
         int         input_id = -1;                              // < QCamera input id
+        int         usage = SCREEN_USAGE_WRITE | SCREEN_USAGE_VIDEO | SCREEN_USAGE_CAPTURE;  // < SCREEN_PROPERTY_USAGE
+        int         transparency = -1;                          // < SCREEN_TRANSPARENCY_*, -1 keeps the default
     };
 }
\ No newline at end of file
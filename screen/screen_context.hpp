@@ -1,6 +1,7 @@
 #pragma once
 #include <stdlib.h>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <screen/screen.h>
 #include "color_log.hpp"
@@ -52,6 +53,11 @@ namespace qnx_screen_camera {
             }
             return true;
         }
+        // init() unless already created, for a context shared by several windows
+        bool ensure_init() {
+            std::lock_guard<std::mutex> guard(init_mutex_);
+            return screen_ctx_ != nullptr || init();
+        }
         void free_context() {
             if (screen_ctx_ != nullptr) {
                 screen_destroy_context(screen_ctx_);
@@ -81,9 +87,29 @@ namespace qnx_screen_camera {
         std::shared_ptr<screen_context> get_context_ptr() {
             return shared_from_this();
         }
+        // a post or flush applies every pending change of the context, so a window_transaction holds this
+        // from its first property change to its flush and posts and flushes of the windows take it as well
+        inline std::recursive_mutex &batch_mutex() {
+            return batch_mutex_;
+        }
     private:
         screen_context_t screen_ctx_ = nullptr;
         screen_display_t *displays_ = nullptr;
         std::vector<display_property>display_pro_vec;
+        std::mutex init_mutex_;
+        std::recursive_mutex batch_mutex_;
     }; 
+    // the context of the camera windows: one flush applies a layout change across all of them at once.
+    // It lives as long as a window holds it and is created again for the next one
+    inline std::shared_ptr<screen_context> shared_screen_context() {
+        static std::mutex mutex;
+        static std::weak_ptr<screen_context> shared;
+        std::lock_guard<std::mutex> guard(mutex);
+        std::shared_ptr<screen_context> ctx = shared.lock();
+        if (nullptr == ctx) {
+            ctx = std::make_shared<screen_context>();
+            shared = ctx;
+        }
+        return ctx;
+    }
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 #include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "screen_attribute.hpp"
 #include "screen_context.hpp"
+#include "format_traits.hpp"
+#include "trace.hpp"
 namespace qnx_screen_camera {
     struct window_buffer_attr {     // all buffers size is the same 
         int size[2] = { 0 };
@@ -24,6 +30,9 @@ namespace qnx_screen_camera {
             source_size[0] = attr.window_source_size.x * attr.buffer_size.x;
             source_size[1] = attr.window_source_size.y * attr.buffer_size.y;
 
+            source_pos[0] = attr.window_source_pos.x * attr.buffer_size.x;
+            source_pos[1] = attr.window_source_pos.y * attr.buffer_size.y;
+
             LOG_D("win size:(%d,%d)w/h,pos:(%d,%d)x/y,attr size:(%f,%f)w/h,pos:(%f,%f)x/y",
                     size[0], size[1], pos[0], pos[1],
                     attr.window_size.x, attr.window_size.y, attr.window_pos.x, attr.window_pos.y);
@@ -35,6 +44,11 @@ namespace qnx_screen_camera {
             LOG_D("buffer size:(%d,%d)x/y", attr.buffer_size.x, attr.buffer_size.y);
         }
         inline void check(const screen_attribute &attr) {
+            if ((source_pos[0] < 0) || (source_pos[1] < 0) ||
+                (source_pos[0] >= attr.buffer_size.x) || (source_pos[1] >= attr.buffer_size.y)) {
+                source_pos[0] = 0;
+                source_pos[1] = 0;
+            }
             if ((source_size[0] <= 0) || (source_size[1] <= 0) ||
                 (source_size[0] + source_pos[0] > attr.buffer_size.x) ||
                 (source_size[1] + source_pos[1] > attr.buffer_size.y)) {
@@ -54,6 +68,20 @@ namespace qnx_screen_camera {
         void *ptr[2] = { 0 };       // buffer address
         uint32_t size = 0;          // buffer size
         long long phys_addr = 0;
+        int fd = -1;                // shareable descriptor of the buffer memory if the allocator has one
+    };
+    enum window_property_slot {         // properties a window_transaction can batch
+        WIN_PROP_SIZE = 0,
+        WIN_PROP_POSITION,
+        WIN_PROP_SOURCE_SIZE,
+        WIN_PROP_SOURCE_POSITION,
+        WIN_PROP_ZORDER,
+        WIN_PROP_VISIBLE,
+        WIN_PROP_NUM
+    };
+    struct window_property_cache {      // last values handed to screen, to skip redundant sets
+        int value[WIN_PROP_NUM][2] = { { 0 } };
+        bool known[WIN_PROP_NUM] = { false };
     };
     struct window_buffer {
         screen_buffer_t *screen_buffers = nullptr;
@@ -62,12 +90,14 @@ namespace qnx_screen_camera {
         std::vector<window_buffer_handle>handles;
         int buffer_size[2] = { 0 };
     };
+    // called after the window visibility changed and before the change is flushed
+    using visibility_listener = std::function<void(bool visible)>;
     class screen_window : public std::enable_shared_from_this<screen_window> {
     public:
         screen_window(std::shared_ptr<screen_context> ptr) : screen_ctx_(ptr) {
         }
         bool init(const screen_attribute &attr) {
-            if (false == screen_ctx_->init()) {
+            if (false == screen_ctx_->ensure_init()) {
                 return false;
             }
             int rc = screen_create_window(&win_ctx_, screen_ctx_->get_screen_ctx());
@@ -75,7 +105,7 @@ namespace qnx_screen_camera {
                 LOG_E("screen_create_window error:%d", errno);
                 return false;
             }
-            int val = SCREEN_USAGE_WRITE | SCREEN_USAGE_VIDEO | SCREEN_USAGE_CAPTURE;
+            int val = attr.usage;
             rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_USAGE, &val);
             if (rc) {
                 LOG_E("set SCREEN_PROPERTY_USAGE error!");
@@ -134,6 +164,13 @@ namespace qnx_screen_camera {
                     return false;
                 }
             }
+            if (attr.transparency != -1) {
+                rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_TRANSPARENCY, &attr.transparency);
+                if (rc) {
+                    LOG_E("set SCREEN_PROPERTY_TRANSPARENCY error:%d", errno);
+                    return false;
+                }
+            }
             int visible = attr.visibility;
             rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_VISIBLE, &visible);
             if (rc) {
@@ -153,11 +190,46 @@ namespace qnx_screen_camera {
                     return false;
                 }
             }
+            cache_property(WIN_PROP_SIZE, windowSizeAttr.size);
+            cache_property(WIN_PROP_POSITION, windowSizeAttr.pos);
+            cache_property(WIN_PROP_SOURCE_SIZE, windowSizeAttr.source_size);
+            cache_property(WIN_PROP_SOURCE_POSITION, windowSizeAttr.source_pos);
+            if (zorder != -1) {
+                cache_property(WIN_PROP_ZORDER, &zorder);
+            }
+            cache_property(WIN_PROP_VISIBLE, &visible);
             windowSizeAttr.get(rect_);
             LOG_I("init window done. win rect:(%d,%d),(%d*%d)", rect_[0], rect_[1], rect_[2], rect_[3]);
             return true;
         }
+        // a window on attr.display_id that shows the buffers of source, which must have them already:
+        // posts to source update both. The buffer size and format come from source, attr gives the rest
+        bool init_mirror(const screen_attribute &attr, const screen_window &source) {
+            screen_attribute mirror_attr = attr;
+            mirror_attr.buffer_size.x = source.win_buf_.buffer_size[0];
+            mirror_attr.buffer_size.y = source.win_buf_.buffer_size[1];
+            mirror_attr.format = source.format_;
+            if (nullptr == source.win_ctx_ || nullptr == source.win_buf_.screen_buffers) {
+                LOG_E("mirror source has no buffers!");
+                return false;
+            }
+            if (!init(mirror_attr)) {
+                return false;
+            }
+            int rc = screen_share_window_buffers(win_ctx_, source.win_ctx_);
+            if (rc) {
+                LOG_E("screen_share_window_buffers error:%d", errno);
+                return false;
+            }
+            // geometry only, the buffers stay with source and this window is never posted to
+            win_buf_.buffer_size[0] = source.win_buf_.buffer_size[0];
+            win_buf_.buffer_size[1] = source.win_buf_.buffer_size[1];
+            win_buf_.stride[0] = source.win_buf_.stride[0];
+            win_buf_.stride[1] = source.win_buf_.stride[1];
+            return true;
+        }
         bool init_buffer(const window_buffer_attr &attr) {
+            TRACE_SCOPE("init_buffer", attr.num);
             LOG_D("num buffer:%d,size(%d*%d)", attr.num, attr.size[0], attr.size[1]);
             int rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_FORMAT, &format_);
             if (rc) {
@@ -206,6 +278,14 @@ namespace qnx_screen_camera {
                 return false;
             }
             LOG_I("offset[0]:%d,offset[1]:%d,offset[2]:%d", win_buf_.offset[0], win_buf_.offset[1], win_buf_.offset[2]);
+            // sizes and the second plane come from the format traits, a format without traits keeps one plane
+            plane_layout layout;
+            if (!get_plane_layout(format_of_screen(format_), attr.size[0], attr.size[1], win_buf_.stride[0],
+                                  win_buf_.offset[1], layout)) {
+                layout.planes = 1;
+                layout.size = win_buf_.stride[0] * attr.size[1];
+            }
+            win_buf_.stride[1] = layout.stride[1];
             for (int i = 0;i < nPointers;i++) {
                 rc = screen_get_buffer_property_pv(win_buf_.screen_buffers[i], SCREEN_PROPERTY_EGL_HANDLE, &win_buf_.handles[i].mem_handle);
                 if (rc) {
@@ -223,32 +303,50 @@ namespace qnx_screen_camera {
                     LOG_E("get SCREEN_PROPERTY_PHYSICAL_ADDRESS error:%d", errno);
                     return false;
                 }
-                win_buf_.handles[i].size = win_buf_.stride[0] * attr.size[1];
+                win_buf_.handles[i].size = layout.size;
+                if (layout.planes > 1 && win_buf_.handles[i].ptr[0] != nullptr) {
+                    win_buf_.handles[i].ptr[1] = static_cast<uint8_t *>(win_buf_.handles[i].ptr[0]) + layout.offset[1];
+                }
                 LOG_I("buffer %d egl handle:0x%p, point:0x%p pyhaddr:0x%p size:%d", i, win_buf_.handles[i].mem_handle,
                         win_buf_.handles[i].ptr[0], win_buf_.handles[i].phys_addr, win_buf_.handles[i].size);
             }
             return true;
         }
         void handle_new_buffer(int idx) {
-            if (idx >= win_buf_.handles.size()) {
+            if (idx < 0 || idx >= static_cast<int>(win_buf_.handles.size())) {
                 return;
             }
+            TRACE_SCOPE("post_window", idx);
+            std::lock_guard<std::recursive_mutex> batch(screen_ctx_->batch_mutex());
             int rc = screen_post_window(win_ctx_, win_buf_.screen_buffers[idx], 1, rect_, SCREEN_WAIT_IDLE);
             if (rc) {
                 LOG_E("screen_post_window error:%d", errno);
             }
         }
+        // post with explicit dirty rects { x, y, w, h }, for partial updates of small windows
+        bool post_buffer(int idx, const int *rects, int count, int flags = SCREEN_WAIT_IDLE) {
+            if (idx < 0 || idx >= static_cast<int>(win_buf_.handles.size())) {
+                return false;
+            }
+            std::lock_guard<std::recursive_mutex> batch(screen_ctx_->batch_mutex());
+            int rc = screen_post_window(win_ctx_, win_buf_.screen_buffers[idx], count, rects, flags);
+            if (rc) {
+                LOG_E("screen_post_window error:%d", errno);
+                return false;
+            }
+            return true;
+        }
         inline void get_yuv_buffer(int idx, uint8_t **data) {
-            if (idx < win_buf_.handles.size()) {
+            *data = nullptr;
+            if (idx >= 0 && idx < static_cast<int>(win_buf_.handles.size())) {
                 *data = (uint8_t *)win_buf_.handles[idx].ptr[0];
             }
-            *data = nullptr;
         }
         inline void get_buffer_size(uint32_t& width, uint32_t& height) {
             width = win_buf_.buffer_size[0];
             height = win_buf_.buffer_size[1];
         }
-        bool change_win_attr(DVECT &size, DVECT &pos) {
+        bool change_win_attr(DVECT &size, DVECT &pos, bool flush = true) {
             const display_property *display_pro = screen_ctx_->get_display_property(display_id_);
             if (nullptr == display_pro) {
                 LOG_E("can not get display property!");
@@ -259,27 +357,163 @@ namespace qnx_screen_camera {
             windowProperty.size[1] = size.y * display_pro->size[1];
             windowProperty.pos[0] = pos.x * display_pro->size[0];
             windowProperty.pos[1] = pos.y * display_pro->size[1];
-            int rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_SIZE, windowProperty.size);
-            if (rc) {
-                LOG_E("set SCREEN_PROPERTY_SIZE error:%d", errno);
+            if (set_property(WIN_PROP_SIZE, windowProperty.size) < 0 ||
+                set_property(WIN_PROP_POSITION, windowProperty.pos) < 0) {
                 return false;
             }
-            rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_POSITION, windowProperty.pos);
-            if (rc) {
-                LOG_E("set SCREEN_PROPERTY_POSITION error:%d", errno);
+            if (flush) {
+                this->flush(SCREEN_WAIT_IDLE);
+            }
+            return true;
+        }
+        bool set_visible(int visible, bool flush = true) {
+            int rc = set_property(WIN_PROP_VISIBLE, &visible);
+            if (rc < 0) {
+                return false;
+            }
+            if (flush) {
+                this->flush(SCREEN_WAIT_IDLE);
+            }
+            return true;
+        }
+        // visible part of the buffer as ratios of the buffer size, the compositor scales it to the window
+        bool set_viewport(const DVECT &pos, const DVECT &size, bool flush = true) {
+            int rect[4] = { 0 };
+            if (!viewport_to_source(pos, size, rect) || !set_source_rect(rect)) {
+                return false;
+            }
+            if (flush) {
+                this->flush(SCREEN_WAIT_IDLE);
+            }
+            return true;
+        }
+        bool get_viewport(DVECT &pos, DVECT &size) {
+            std::lock_guard<std::mutex> guard(property_mutex_);
+            if (win_buf_.buffer_size[0] <= 0 || win_buf_.buffer_size[1] <= 0 ||
+                !prop_cache_.known[WIN_PROP_SOURCE_SIZE] || !prop_cache_.known[WIN_PROP_SOURCE_POSITION]) {
                 return false;
             }
-            screen_flush_context(screen_ctx_->get_screen_ctx(), SCREEN_WAIT_IDLE);
+            pos.x = static_cast<double>(prop_cache_.value[WIN_PROP_SOURCE_POSITION][0]) / win_buf_.buffer_size[0];
+            pos.y = static_cast<double>(prop_cache_.value[WIN_PROP_SOURCE_POSITION][1]) / win_buf_.buffer_size[1];
+            size.x = static_cast<double>(prop_cache_.value[WIN_PROP_SOURCE_SIZE][0]) / win_buf_.buffer_size[0];
+            size.y = static_cast<double>(prop_cache_.value[WIN_PROP_SOURCE_SIZE][1]) / win_buf_.buffer_size[1];
             return true;
         }
-        bool set_visible(int visible) {
-            int rc = screen_set_window_property_iv(win_ctx_, SCREEN_PROPERTY_VISIBLE, &visible);
-            if (rc)
+        // buffer ratio viewport to a source rect { x, y, w, h } in buffer pixels, kept inside the buffer
+        bool viewport_to_source(const DVECT &pos, const DVECT &size, int *rect) const {
+            const int *limit = win_buf_.buffer_size;
+            if (limit[0] <= 0 || limit[1] <= 0) {
+                LOG_E("window buffers are not created!");
+                return false;
+            }
+            for (int i = 0;i < 2;++i) {
+                double p = 0 == i ? pos.x : pos.y;
+                double s = 0 == i ? size.x : size.y;
+                rect[2 + i] = std::min(std::max(static_cast<int>(s * limit[i] + 0.5), 1), limit[i]);
+                rect[i] = std::min(std::max(static_cast<int>(p * limit[i] + 0.5), 0), limit[i] - rect[2 + i]);
+            }
+            return true;
+        }
+        // source size and position without flushing, in the order that keeps the rect inside the buffer
+        bool set_source_rect(const int *rect) {
+            bool size_first = true;
             {
-                LOG_E("set SCREEN_PROPERTY_VISIBLE error:%d", errno);
+                std::lock_guard<std::mutex> guard(property_mutex_);
+                const int *cur_size = prop_cache_.value[WIN_PROP_SOURCE_SIZE];
+                size_first = !prop_cache_.known[WIN_PROP_SOURCE_SIZE] ||
+                             rect[0] + cur_size[0] > win_buf_.buffer_size[0] ||
+                             rect[1] + cur_size[1] > win_buf_.buffer_size[1];
+            }
+            if (size_first) {
+                return set_property(WIN_PROP_SOURCE_SIZE, rect + 2) >= 0 &&
+                       set_property(WIN_PROP_SOURCE_POSITION, rect) >= 0;
+            }
+            return set_property(WIN_PROP_SOURCE_POSITION, rect) >= 0 &&
+                   set_property(WIN_PROP_SOURCE_SIZE, rect + 2) >= 0;
+        }
+        // last value set through this window, asked from screen if it was never set
+        bool get_property(window_property_slot slot, int *value) {
+            std::lock_guard<std::mutex> guard(property_mutex_);
+            if (!prop_cache_.known[slot]) {
+                if (screen_get_window_property_iv(win_ctx_, property_id(slot), prop_cache_.value[slot])) {
+                    LOG_E("get window property %d error:%d", property_id(slot), errno);
+                    return false;
+                }
+                prop_cache_.known[slot] = true;
+            }
+            value[0] = prop_cache_.value[slot][0];
+            if (property_count(slot) > 1) {
+                value[1] = prop_cache_.value[slot][1];
+            }
+            return true;
+        }
+        inline const display_property *get_display_property() const {
+            return screen_ctx_->get_display_property(display_id_);
+        }
+        inline int get_display_id() const {
+            return display_id_;
+        }
+        inline screen_display_t get_display() const {
+            const screen_display_t *displays = screen_ctx_->get_displays();
+            return (displays && display_id_ >= 0) ? displays[display_id_] : nullptr;
+        }
+        // commit pending property changes, flags 0 returns without waiting for the compositor
+        void flush(int flags = 0) {
+            std::lock_guard<std::recursive_mutex> batch(screen_ctx_->batch_mutex());
+            screen_flush_context(screen_ctx_->get_screen_ctx(), flags);
+        }
+        inline screen_context_t get_screen_ctx() const {
+            return screen_ctx_->get_screen_ctx();
+        }
+        inline const std::shared_ptr<screen_context> &get_context() const {
+            return screen_ctx_;
+        }
+        // set one batched property without flushing, -1 on error, 0 if unchanged, 1 if sent to screen;
+        // notify false leaves a visibility change to a later notify_visibility()
+        int set_property(window_property_slot slot, const int *value, bool notify = true) {
+            {
+                std::lock_guard<std::mutex> guard(property_mutex_);
+                int count = property_count(slot);
+                if (prop_cache_.known[slot] && prop_cache_.value[slot][0] == value[0] &&
+                    (count < 2 || prop_cache_.value[slot][1] == value[1])) {
+                    return 0;
+                }
+                int rc = screen_set_window_property_iv(win_ctx_, property_id(slot), value);
+                if (rc) {
+                    LOG_E("set window property %d error:%d", property_id(slot), errno);
+                    prop_cache_.known[slot] = false;
+                    return -1;
+                }
+                store_property(slot, value);
+            }
+            if (WIN_PROP_VISIBLE == slot && notify) {
+                notify_visibility();
+            }
+            return 1;
+        }
+        void notify_visibility() {
+            std::lock_guard<std::mutex> guard(visibility_mutex_);
+            if (visibility_listener_) {
+                visibility_listener_(visible_);
+            }
+        }
+        // one listener, nullptr removes it; after it returns the old listener is not running
+        void set_visibility_listener(const visibility_listener &listener) {
+            std::lock_guard<std::mutex> guard(visibility_mutex_);
+            visibility_listener_ = listener;
+        }
+        inline bool is_visible() const {
+            return visible_;
+        }
+        // display ratio to display pixels for this window's display
+        bool ratio_to_display(const DVECT &ratio, int *px) const {
+            const display_property *display_pro = screen_ctx_->get_display_property(display_id_);
+            if (nullptr == display_pro) {
+                LOG_E("can not get display property!");
                 return false;
             }
-            screen_flush_context(screen_ctx_->get_screen_ctx(), SCREEN_WAIT_IDLE);
+            px[0] = ratio.x * display_pro->size[0];
+            px[1] = ratio.y * display_pro->size[1];
             return true;
         }
         const window_buffer &get_win_buf() const {
@@ -301,6 +535,29 @@ namespace qnx_screen_camera {
         std::shared_ptr<screen_window> get_window_ptr() {
             return shared_from_this();
         }
+    private:
+        static inline int property_id(window_property_slot slot) {
+            static const int ids[WIN_PROP_NUM] = {
+                SCREEN_PROPERTY_SIZE, SCREEN_PROPERTY_POSITION, SCREEN_PROPERTY_SOURCE_SIZE,
+                SCREEN_PROPERTY_SOURCE_POSITION, SCREEN_PROPERTY_ZORDER, SCREEN_PROPERTY_VISIBLE
+            };
+            return ids[slot];
+        }
+        static inline int property_count(window_property_slot slot) {
+            return (WIN_PROP_ZORDER == slot || WIN_PROP_VISIBLE == slot) ? 1 : 2;
+        }
+        void store_property(window_property_slot slot, const int *value) {
+            prop_cache_.value[slot][0] = value[0];
+            prop_cache_.value[slot][1] = property_count(slot) > 1 ? value[1] : 0;
+            prop_cache_.known[slot] = true;
+            if (WIN_PROP_VISIBLE == slot) {
+                visible_ = 0 != value[0];
+            }
+        }
+        void cache_property(window_property_slot slot, const int *value) {
+            std::lock_guard<std::mutex> guard(property_mutex_);
+            store_property(slot, value);
+        }
     private:
         int format_ = -1;
         window_buffer win_buf_;
@@ -308,5 +565,10 @@ namespace qnx_screen_camera {
         std::shared_ptr<screen_context>screen_ctx_;
         int rect_[4] = { 0 };
         int display_id_ = -1;
+        std::mutex property_mutex_;
+        window_property_cache prop_cache_;
+        std::atomic<bool> visible_{true};
+        std::mutex visibility_mutex_;
+        visibility_listener visibility_listener_;
     };
 }
\ No newline at end of file
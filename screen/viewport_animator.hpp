@@ -0,0 +1,157 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include "clock.hpp"
+#include "thread_policy.hpp"
+#include "window_transaction.hpp"
+namespace qnx_screen_camera {
+    struct window_viewport {            // ratios of the window buffer
+        DVECT pos = { 0, 0 };
+        DVECT size = { 1.0, 1.0 };
+    };
+    // digital pan/zoom without touching pixels: moves the window source rectangle once per vsync
+    // of the window's display and lets the compositor scale it; the thread sleeps while idle
+    class viewport_animator {
+    public:
+        viewport_animator(const std::shared_ptr<screen_window> &win, const thread_policy &policy = thread_policy(),
+                          const std::string &name = "viewport")
+            : win_(win), policy_(policy), name_(name) {
+            if (win_) {
+                win_->get_viewport(current_.pos, current_.size);
+            }
+        }
+        virtual ~viewport_animator() {
+            stop();
+        }
+        bool start() {
+            if (worker_ != nullptr || !win_) {
+                return false;
+            }
+            keep_running_ = true;
+            worker_ = new std::thread([this]() {
+                apply_thread_policy(policy_, name_);
+                this->run();
+            });
+            return true;
+        }
+        void stop() {
+            if (nullptr == worker_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            if (worker_->joinable()) {
+                worker_->join();
+            }
+            delete worker_;
+            worker_ = nullptr;
+        }
+        // move to target over duration_ms (0 lands on the next vsync), starting from wherever the
+        // viewport is now, so a new target smoothly replaces one still in flight
+        void animate_to(const window_viewport &target, int duration_ms) {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                from_ = current_;
+                to_ = clamp(target);
+                start_ns_ = monotonic_ns();
+                duration_ns_ = duration_ms > 0 ? static_cast<uint64_t>(duration_ms) * 1000000ULL : 0;
+                animating_ = true;
+            }
+            cv_.notify_one();
+        }
+        // zoom >= 1 magnifies around center, a buffer ratio point
+        void zoom_to(const DVECT &center, double zoom, int duration_ms) {
+            window_viewport target;
+            zoom = zoom < 1.0 ? 1.0 : zoom;
+            target.size = { 1.0 / zoom, 1.0 / zoom };
+            target.pos = { center.x - target.size.x / 2, center.y - target.size.y / 2 };
+            animate_to(target, duration_ms);
+        }
+        window_viewport get_viewport() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            return current_;
+        }
+        inline bool busy() const {
+            return animating_;
+        }
+    private:
+        void run() {
+            screen_display_t display = win_->get_display();
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || animating_; });
+                    if (!keep_running_) {
+                        break;
+                    }
+                }
+                // a step set right after vsync is composed into the next frame
+                if (nullptr == display || screen_wait_vsync(display)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(16));
+                }
+                window_viewport step;
+                {
+                    std::lock_guard<std::mutex> guard(mutex_);
+                    uint64_t elapsed = monotonic_ns() - start_ns_;
+                    double t = elapsed >= duration_ns_ ? 1.0 : static_cast<double>(elapsed) / duration_ns_;
+                    step = clamp(interpolate(from_, to_, t * t * (3 - 2 * t)));
+                    if (t >= 1.0) {
+                        animating_ = false;
+                    }
+                }
+                int rect[4] = { 0 };
+                if (!win_->viewport_to_source(step.pos, step.size, rect) || !win_->set_source_rect(rect)) {
+                    std::lock_guard<std::mutex> guard(mutex_);
+                    animating_ = false;
+                    continue;
+                }
+                window_transaction().touch(win_).commit();
+                std::lock_guard<std::mutex> guard(mutex_);
+                current_ = step;
+            }
+        }
+        static window_viewport clamp(const window_viewport &v) {
+            const double min_size = 1.0 / 64;           // deepest zoom
+            window_viewport r;
+            r.size.x = std::min(std::max(v.size.x, min_size), 1.0);
+            r.size.y = std::min(std::max(v.size.y, min_size), 1.0);
+            r.pos.x = std::min(std::max(v.pos.x, 0.0), 1.0 - r.size.x);
+            r.pos.y = std::min(std::max(v.pos.y, 0.0), 1.0 - r.size.y);
+            return r;
+        }
+        // centers move linearly, sizes geometrically so a zoom feels uniform in speed
+        static window_viewport interpolate(const window_viewport &a, const window_viewport &b, double t) {
+            window_viewport v;
+            v.size.x = a.size.x * pow(b.size.x / a.size.x, t);
+            v.size.y = a.size.y * pow(b.size.y / a.size.y, t);
+            double cx = a.pos.x + a.size.x / 2 + (b.pos.x + b.size.x / 2 - a.pos.x - a.size.x / 2) * t;
+            double cy = a.pos.y + a.size.y / 2 + (b.pos.y + b.size.y / 2 - a.pos.y - a.size.y / 2) * t;
+            v.pos = { cx - v.size.x / 2, cy - v.size.y / 2 };
+            return v;
+        }
+    private:
+        std::shared_ptr<screen_window> win_;
+        thread_policy policy_;
+        std::string name_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        window_viewport current_;
+        window_viewport from_;
+        window_viewport to_;
+        uint64_t start_ns_ = 0;
+        uint64_t duration_ns_ = 0;
+        std::atomic<bool> animating_{false};
+        bool keep_running_ = false;
+        std::thread *worker_ = nullptr;
+    };
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "screen_window.hpp"
+namespace qnx_screen_camera {
+    // collects window property changes across any number of windows and commits them together:
+    // unchanged values are skipped and each screen context is flushed once without waiting for idle.
+    // The camera windows share one context (shared_screen_context), so a layout over any number of
+    // cameras is a single flush; the contexts stay locked during the commit so a post from a capture
+    // thread cannot flush half of it
+    class window_transaction {
+    public:
+        // a ratio that cannot be converted to pixels fails the commit
+        window_transaction &set_size(const std::shared_ptr<screen_window> &win, const DVECT &ratio) {
+            int px[2] = { 0 };
+            if (win && win->ratio_to_display(ratio, px)) {
+                add(win, WIN_PROP_SIZE, px[0], px[1]);
+            }
+            else {
+                failed_ = true;
+            }
+            return *this;
+        }
+        window_transaction &set_position(const std::shared_ptr<screen_window> &win, const DVECT &ratio) {
+            int px[2] = { 0 };
+            if (win && win->ratio_to_display(ratio, px)) {
+                add(win, WIN_PROP_POSITION, px[0], px[1]);
+            }
+            else {
+                failed_ = true;
+            }
+            return *this;
+        }
+        // source rectangle in buffer pixels
+        window_transaction &set_source(const std::shared_ptr<screen_window> &win, int x, int y, int width, int height) {
+            add(win, WIN_PROP_SOURCE_SIZE, width, height);
+            add(win, WIN_PROP_SOURCE_POSITION, x, y);
+            return *this;
+        }
+        // source rectangle from a viewport in buffer ratios, see screen_window::set_viewport
+        window_transaction &set_viewport(const std::shared_ptr<screen_window> &win, const DVECT &pos, const DVECT &size) {
+            int rect[4] = { 0 };
+            if (win && win->viewport_to_source(pos, size, rect)) {
+                return set_source(win, rect[0], rect[1], rect[2], rect[3]);
+            }
+            failed_ = true;
+            return *this;
+        }
+        window_transaction &set_zorder(const std::shared_ptr<screen_window> &win, int zorder) {
+            add(win, WIN_PROP_ZORDER, zorder, 0);
+            return *this;
+        }
+        window_transaction &set_visible(const std::shared_ptr<screen_window> &win, int visible) {
+            add(win, WIN_PROP_VISIBLE, visible, 0);
+            return *this;
+        }
+        // include a window changed outside the transaction in the final flush
+        window_transaction &touch(const std::shared_ptr<screen_window> &win) {
+            if (win) {
+                add_context(contexts_, win->get_context());
+            }
+            return *this;
+        }
+        inline bool empty() const {
+            return changes_.empty() && contexts_.empty();
+        }
+        // apply all changes, false if any property failed or could not be queued (the rest are still
+        // applied and flushed)
+        bool commit() {
+            bool ok = !failed_;
+            std::vector<std::shared_ptr<screen_context>> locked;
+            for (auto &change : changes_) {
+                add_context(locked, change.win->get_context());
+            }
+            for (auto &ctx : contexts_) {
+                add_context(locked, ctx);
+            }
+            std::sort(locked.begin(), locked.end());     // one order for every commit
+            for (auto &ctx : locked) {
+                ctx->batch_mutex().lock();
+            }
+            std::vector<std::shared_ptr<screen_window>> toggled;
+            for (size_t i = 0;i < changes_.size();++i) {
+                property_change &change = changes_[i];
+                int rc = 0;
+                int other = source_partner(i);
+                if (other >= 0) {
+                    // both halves of a source rect at once, in the order that keeps it inside the buffer
+                    if (static_cast<size_t>(other) < i) {
+                        continue;
+                    }
+                    const property_change &size = WIN_PROP_SOURCE_SIZE == change.slot ? change : changes_[other];
+                    const property_change &pos = WIN_PROP_SOURCE_SIZE == change.slot ? changes_[other] : change;
+                    int rect[4] = { pos.value[0], pos.value[1], size.value[0], size.value[1] };
+                    rc = change.win->set_source_rect(rect) ? 1 : -1;
+                }
+                else {
+                    rc = change.win->set_property(change.slot, change.value, false);
+                }
+                if (rc < 0) {
+                    ok = false;
+                }
+                else if (rc > 0) {
+                    add_context(contexts_, change.win->get_context());
+                    if (WIN_PROP_VISIBLE == change.slot) {
+                        toggled.push_back(change.win);
+                    }
+                }
+            }
+            for (auto &ctx : contexts_) {
+                screen_flush_context(ctx->get_screen_ctx(), 0);
+            }
+            for (auto it = locked.rbegin();it != locked.rend();++it) {
+                (*it)->batch_mutex().unlock();
+            }
+            // after the unlock: a window shown again posts its held frame under its camera's post lock, which
+            // capture threads take before the context lock
+            for (auto &win : toggled) {
+                win->notify_visibility();
+            }
+            changes_.clear();
+            contexts_.clear();
+            failed_ = false;
+            return ok;
+        }
+    private:
+        struct property_change {
+            std::shared_ptr<screen_window> win;
+            window_property_slot slot;
+            int value[2];
+        };
+        void add(const std::shared_ptr<screen_window> &win, window_property_slot slot, int v0, int v1) {
+            if (!win) {
+                failed_ = true;
+                return;
+            }
+            for (auto &change : changes_) {         // last write to the same property wins
+                if (change.win == win && change.slot == slot) {
+                    change.value[0] = v0;
+                    change.value[1] = v1;
+                    return;
+                }
+            }
+            property_change change;
+            change.win = win;
+            change.slot = slot;
+            change.value[0] = v0;
+            change.value[1] = v1;
+            changes_.push_back(change);
+        }
+        // index of the other source rect half queued for the window of change i, -1 if none
+        int source_partner(size_t i) const {
+            window_property_slot slot = changes_[i].slot;
+            if (slot != WIN_PROP_SOURCE_SIZE && slot != WIN_PROP_SOURCE_POSITION) {
+                return -1;
+            }
+            window_property_slot wanted = WIN_PROP_SOURCE_SIZE == slot ? WIN_PROP_SOURCE_POSITION : WIN_PROP_SOURCE_SIZE;
+            for (size_t j = 0;j < changes_.size();++j) {
+                if (changes_[j].win == changes_[i].win && changes_[j].slot == wanted) {
+                    return static_cast<int>(j);
+                }
+            }
+            return -1;
+        }
+        static void add_context(std::vector<std::shared_ptr<screen_context>> &contexts,
+                                const std::shared_ptr<screen_context> &ctx) {
+            if (std::find(contexts.begin(), contexts.end(), ctx) == contexts.end()) {
+                contexts.push_back(ctx);
+            }
+        }
+    private:
+        std::vector<property_change> changes_;
+        std::vector<std::shared_ptr<screen_context>> contexts_;
+        bool failed_ = false;                   // < A change was dropped before commit
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "buffer_allocator.hpp"
+namespace qnx_screen_camera {
+    // shared memory buffers for headless inputs of host builds: the anon allocator without its memory
+    // lock, the host limits locked memory far below what a few inputs need
+    class host_allocator : public anon_allocator {
+    public:
+        host_allocator() : anon_allocator(false) {
+        }
+    };
+}
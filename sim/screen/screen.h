@@ -0,0 +1,83 @@
+#pragma once
+// host stand-in of the QNX Screen subset the library uses, implemented by sim_backend.cpp;
+// the values only have to be distinct, they do not match the target headers
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef struct _screen_context *screen_context_t;
+typedef struct _screen_window *screen_window_t;
+typedef struct _screen_display *screen_display_t;
+typedef struct _screen_buffer *screen_buffer_t;
+enum {
+    SCREEN_APPLICATION_CONTEXT = 0,
+    SCREEN_POWER_MANAGER_CONTEXT = 1 << 5,
+};
+enum {
+    SCREEN_WAIT_IDLE = 1 << 0,
+};
+enum {
+    SCREEN_PROPERTY_BUFFER_SIZE = 5,
+    SCREEN_PROPERTY_DISPLAY,
+    SCREEN_PROPERTY_DISPLAYS,
+    SCREEN_PROPERTY_DISPLAY_COUNT,
+    SCREEN_PROPERTY_EGL_HANDLE,
+    SCREEN_PROPERTY_FORMAT,
+    SCREEN_PROPERTY_ID,
+    SCREEN_PROPERTY_PHYSICAL_ADDRESS,
+    SCREEN_PROPERTY_PLANAR_OFFSETS,
+    SCREEN_PROPERTY_POINTER,
+    SCREEN_PROPERTY_POSITION,
+    SCREEN_PROPERTY_RENDER_BUFFERS,
+    SCREEN_PROPERTY_RENDER_BUFFER_COUNT,
+    SCREEN_PROPERTY_SIZE,
+    SCREEN_PROPERTY_SOURCE_POSITION,
+    SCREEN_PROPERTY_SOURCE_SIZE,
+    SCREEN_PROPERTY_STRIDE,
+    SCREEN_PROPERTY_TRANSPARENCY,
+    SCREEN_PROPERTY_USAGE,
+    SCREEN_PROPERTY_VISIBLE,
+    SCREEN_PROPERTY_ZORDER,
+};
+enum {
+    SCREEN_USAGE_READ = 1 << 1,
+    SCREEN_USAGE_WRITE = 1 << 2,
+    SCREEN_USAGE_NATIVE = 1 << 3,
+    SCREEN_USAGE_VIDEO = 1 << 9,
+    SCREEN_USAGE_CAPTURE = 1 << 10,
+};
+enum {
+    SCREEN_FORMAT_BYTE = 1,
+    SCREEN_FORMAT_RGB888 = 7,
+    SCREEN_FORMAT_RGBA8888 = 8,
+    SCREEN_FORMAT_UYVY = 12,
+    SCREEN_FORMAT_YUY2 = 13,
+    SCREEN_FORMAT_YVYU = 14,
+    SCREEN_FORMAT_NV12 = 16,
+};
+enum {
+    SCREEN_TRANSPARENCY_SOURCE_OVER = 2,
+    SCREEN_TRANSPARENCY_NONE = 4,
+};
+int screen_create_context(screen_context_t *pctx, int flags);
+int screen_destroy_context(screen_context_t ctx);
+int screen_get_context_property_iv(screen_context_t ctx, int pname, int *param);
+int screen_get_context_property_pv(screen_context_t ctx, int pname, void **param);
+int screen_get_display_property_iv(screen_display_t disp, int pname, int *param);
+int screen_create_window(screen_window_t *pwin, screen_context_t ctx);
+int screen_destroy_window(screen_window_t win);
+int screen_set_window_property_iv(screen_window_t win, int pname, const int *param);
+int screen_get_window_property_iv(screen_window_t win, int pname, int *param);
+int screen_set_window_property_pv(screen_window_t win, int pname, void **param);
+int screen_get_window_property_pv(screen_window_t win, int pname, void **param);
+int screen_create_window_buffers(screen_window_t win, int count);
+int screen_destroy_window_buffers(screen_window_t win);
+int screen_share_window_buffers(screen_window_t win, screen_window_t share);
+int screen_get_buffer_property_iv(screen_buffer_t buf, int pname, int *param);
+int screen_get_buffer_property_pv(screen_buffer_t buf, int pname, void **param);
+int screen_get_buffer_property_llv(screen_buffer_t buf, int pname, long long *param);
+int screen_post_window(screen_window_t win, screen_buffer_t buf, int count, const int *dirty_rects, int flags);
+int screen_flush_context(screen_context_t ctx, int flags);
+int screen_wait_vsync(screen_display_t display);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,966 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include <screen/screen.h>
+#include "qcarcam.h"
+#include "clock.hpp"
+#include "color_log.hpp"
+#include "sim_backend.hpp"
+namespace qnx_screen_camera {
+    namespace {
+        enum sim_param : int {
+            SIM_STRIDE_ALIGN = 64,
+            SIM_BUFFER_ALIGN = 64,
+        };
+        struct sim_window;
+        struct sim_display {
+            int id = 0;
+            int size[2] = { 0 };
+        };
+        struct sim_context {
+            int windows = 0;
+        };
+        struct sim_buffer {
+            sim_window *owner = nullptr;
+            uint8_t *data = nullptr;
+            uint32_t size = 0;
+            int stride = 0;
+            int offsets[3] = { 0 };
+        };
+        struct sim_window {
+            sim_context *ctx = nullptr;
+            sim_display *display = nullptr;
+            std::map<int, std::vector<int>> props;      // < Integer properties as last set
+            int format = SCREEN_FORMAT_RGBA8888;
+            int buffer_size[2] = { 0 };
+            std::vector<sim_buffer *> buffers;
+            sim_window *share = nullptr;                // < Window whose buffers this one shows
+        };
+        enum slot_state {
+            SLOT_FREE = 0,              // < The sensor may fill it
+            SLOT_READY,                 // < Filled, waiting for qcarcam_get_frame
+            SLOT_HELD,                  // < With the client until qcarcam_release_frame
+        };
+        struct sim_slot {
+            uint8_t *data = nullptr;    // < nullptr once the memory behind it is gone
+            uint32_t size = 0;
+            uint32_t line = 0;
+            sim_buffer *buffer = nullptr;
+            slot_state state = SLOT_FREE;
+            bool stranded = false;      // < Held after a failed release
+            qcarcam_frame_info_t info;
+        };
+        struct sim_input {
+            qcarcam_input_desc_t desc = QCARCAM_INPUT_MAX;
+            std::vector<sim_slot> slots;
+            std::deque<unsigned int> ready;
+            qcarcam_event_cb_t callback = nullptr;
+            unsigned int event_mask = 0;
+            qcarcam_frame_rate_t rate;
+            bool started = false;
+            bool paused = false;
+            bool closing = false;
+            bool dark = false;
+            uint64_t dark_until = 0;
+            unsigned int seq = 0;
+            uint64_t sensor_frames = 0;
+            sim_diag_input diag;        // < Driver counters of this open
+            int callbacks = 0;          // < Event callbacks running
+            int waiters = 0;            // < qcarcam_get_frame calls waiting
+            std::mt19937 rng;
+            std::thread *sensor = nullptr;
+            std::condition_variable sensor_cv;
+            std::condition_variable frame_cv;
+            std::condition_variable idle_cv;
+        };
+        struct sim_event {
+            qcarcam_event_t id;
+            unsigned int payload;
+        };
+        struct sim_state {
+            std::mutex mutex;
+            sim_config config;
+            sim_counters counters;
+            std::vector<sim_display> displays;
+            std::set<sim_context *> contexts;
+            std::set<sim_window *> windows;
+            std::set<sim_buffer *> buffers;
+            std::map<qcarcam_input_desc_t, sim_input *> inputs;     // < Open handles by input
+            bool initialized = false;
+        };
+        // never destroyed, sensor threads may outlive static destruction at exit
+        sim_state &sim() {
+            static sim_state *state = new sim_state();
+            return *state;
+        }
+        inline bool chance(std::mt19937 &rng, double rate) {
+            return rate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+        }
+        inline int fail(int err) {
+            errno = err;
+            return -1;
+        }
+        // a call the real stack would reject or crash on, logged where it came from
+        inline void bad_call(const char *what) {
+            ++sim().counters.bad_calls;
+            LOG_E("sim: bad call, %s", what);
+        }
+        // the state lock is held by the callers of the helpers below
+        sim_input *find_input(qcarcam_hndl_t hndl, const char *caller) {
+            for (auto &it : sim().inputs) {
+                if (it.second == hndl) {
+                    return it.second;
+                }
+            }
+            bad_call(caller);
+            return nullptr;
+        }
+        template <typename T>
+        bool known(const std::set<T *> &set, const void *ptr, const char *caller) {
+            if (set.count(static_cast<T *>(const_cast<void *>(ptr)))) {
+                return true;
+            }
+            bad_call(caller);
+            return false;
+        }
+        void free_buffers(sim_window *win) {
+            sim_state &state = sim();
+            for (auto *buf : win->buffers) {
+                // capture still writing into memory that is gone is an ordering bug of the client
+                for (auto &it : state.inputs) {
+                    for (auto &slot : it.second->slots) {
+                        if (slot.buffer == buf) {
+                            bad_call("window buffers destroyed under capture");
+                            slot.data = nullptr;
+                            slot.buffer = nullptr;
+                        }
+                    }
+                }
+                state.buffers.erase(buf);
+                free(buf->data);
+                delete buf;
+                --state.counters.window_buffers;
+            }
+            win->buffers.clear();
+        }
+        void destroy_window(sim_window *win) {
+            sim_state &state = sim();
+            free_buffers(win);
+            for (auto *other : state.windows) {
+                if (other->share == win) {
+                    other->share = nullptr;
+                }
+            }
+            --win->ctx->windows;
+            state.windows.erase(win);
+            delete win;
+            --state.counters.windows;
+        }
+        void init_displays() {
+            sim_state &state = sim();
+            state.displays.assign(std::max(state.config.displays, 1), sim_display());
+            for (int i = 0;i < static_cast<int>(state.displays.size());++i) {
+                state.displays[i].id = i;
+                state.displays[i].size[0] = state.config.display_size[0];
+                state.displays[i].size[1] = state.config.display_size[1];
+            }
+        }
+        // the display a Screen handle points at, nullptr if it is none of ours
+        sim_display *find_display(const void *ptr, const char *caller) {
+            sim_state &state = sim();
+            for (auto &display : state.displays) {
+                if (&display == ptr) {
+                    return &display;
+                }
+            }
+            bad_call(caller);
+            return nullptr;
+        }
+        int property_count(int pname) {
+            switch (pname) {
+            case SCREEN_PROPERTY_SIZE:
+            case SCREEN_PROPERTY_POSITION:
+            case SCREEN_PROPERTY_SOURCE_SIZE:
+            case SCREEN_PROPERTY_SOURCE_POSITION:
+            case SCREEN_PROPERTY_BUFFER_SIZE:
+                return 2;
+            default:
+                return 1;
+            }
+        }
+        // bytes per pixel of the first plane and the size of all planes
+        bool buffer_layout(int format, int width, int height, sim_buffer &buf) {
+            int bpp = 0;
+            switch (format) {
+            case SCREEN_FORMAT_BYTE:
+            case SCREEN_FORMAT_NV12:
+                bpp = 1;
+                break;
+            case SCREEN_FORMAT_UYVY:
+            case SCREEN_FORMAT_YUY2:
+            case SCREEN_FORMAT_YVYU:
+                bpp = 2;
+                break;
+            case SCREEN_FORMAT_RGB888:
+                bpp = 3;
+                break;
+            case SCREEN_FORMAT_RGBA8888:
+                bpp = 4;
+                break;
+            default:
+                return false;
+            }
+            buf.stride = (width * bpp + SIM_STRIDE_ALIGN - 1) & ~(SIM_STRIDE_ALIGN - 1);
+            buf.offsets[1] = buf.stride * height;
+            buf.size = buf.offsets[1];
+            if (SCREEN_FORMAT_NV12 == format) {
+                buf.size += buf.stride * ((height + 1) / 2);
+            }
+            return true;
+        }
+        // one input: frames at fps into the free buffers, events delivered without the state lock
+        void run_sensor(sim_input *in) {
+            sim_state &state = sim();
+            std::unique_lock<std::mutex> lk(state.mutex);
+            const uint64_t period = static_cast<uint64_t>(1e9 / (state.config.fps > 0 ? state.config.fps : 30.0f));
+            uint64_t next = monotonic_ns() + period;
+            std::vector<sim_event> events;
+            while (!in->closing) {
+                in->sensor_cv.wait_for(lk, std::chrono::nanoseconds(next - std::min(next, monotonic_ns())),
+                                       [in, next]() { return in->closing || monotonic_ns() >= next; });
+                if (in->closing) {
+                    break;
+                }
+                uint64_t now = monotonic_ns();
+                next = next + period > now ? next + period : now + period;     // a late wakeup skips frames
+                if (!in->started || in->paused) {
+                    continue;
+                }
+                const sim_config &config = state.config;
+                events.clear();
+                if (in->dark) {
+                    if (now < in->dark_until) {
+                        continue;
+                    }
+                    in->dark = false;
+                    events.push_back(sim_event{ QCARCAM_EVENT_INPUT_SIGNAL, QCARCAM_INPUT_SIGNAL_VALID });
+                }
+                else if (chance(in->rng, config.signal_loss_rate)) {
+                    in->dark = true;
+                    in->dark_until = now + static_cast<uint64_t>(config.signal_loss_ms) * 1000000ULL;
+                    ++state.counters.injected_signal_losses;
+                    ++in->diag.csi_errors;
+                    events.push_back(sim_event{ QCARCAM_EVENT_INPUT_SIGNAL, QCARCAM_INPUT_SIGNAL_LOST });
+                }
+                else {
+                    ++in->seq;
+                    uint64_t phase = in->sensor_frames++;
+                    bool keep = QCARCAM_FRAMEDROP_MANUAL != in->rate.frame_drop_mode || 0 == in->rate.frame_drop_period ||
+                                (in->rate.frame_drop_pattern >> (phase % in->rate.frame_drop_period) & 1u);
+                    auto slot = std::find_if(in->slots.begin(), in->slots.end(), [](const sim_slot &s) {
+                        return SLOT_FREE == s.state && s.data != nullptr; });
+                    if (!keep) {
+                        ++state.counters.frames_dropped;
+                    }
+                    else if (in->slots.end() == slot) {
+                        ++state.counters.frames_starved;
+                        ++in->diag.frame_drops;
+                    }
+                    else {
+                        memset(slot->data, in->seq & 0xff, config.fill ? slot->size : std::min(slot->line, slot->size));
+                        memset(&slot->info, 0, sizeof(slot->info));
+                        slot->info.idx = static_cast<unsigned int>(slot - in->slots.begin());
+                        slot->info.seq_no = in->seq;
+                        slot->info.timestamp = now;
+                        ++state.counters.frames_produced;
+                        if (chance(in->rng, config.get_frame_timeout_rate)) {
+                            ++state.counters.injected_timeouts;     // lost after the event went out
+                        }
+                        else {
+                            slot->state = SLOT_READY;
+                            in->ready.push_back(slot->info.idx);
+                            in->frame_cv.notify_all();
+                        }
+                        events.push_back(sim_event{ QCARCAM_EVENT_FRAME_READY, 0 });
+                    }
+                    if (chance(in->rng, config.error_event_rate)) {
+                        ++state.counters.injected_errors;
+                        ++in->diag.ife_overflows;
+                        events.push_back(sim_event{ QCARCAM_EVENT_ERROR, QCARCAM_IFE_OVERFLOW_ERROR });
+                    }
+                }
+                qcarcam_event_cb_t callback = in->callback;
+                unsigned int mask = in->event_mask;
+                if (nullptr == callback || events.empty()) {
+                    continue;
+                }
+                ++in->callbacks;
+                lk.unlock();
+                for (auto &event : events) {
+                    if (mask & event.id) {
+                        qcarcam_event_payload_t payload;
+                        memset(&payload, 0, sizeof(payload));
+                        payload.uint_payload = event.payload;
+                        callback(in, event.id, &payload);
+                    }
+                }
+                lk.lock();
+                --in->callbacks;
+                in->idle_cv.notify_all();
+            }
+        }
+    }
+    void sim_configure(const sim_config &config) {
+        sim_state &state = sim();
+        std::lock_guard<std::mutex> guard(state.mutex);
+        if (!state.inputs.empty() || !state.contexts.empty()) {
+            LOG_E("sim configured with %zu open inputs and %zu contexts", state.inputs.size(), state.contexts.size());
+        }
+        state.config = config;
+        state.counters = sim_counters();
+        init_displays();
+    }
+    sim_counters sim_get_counters() {
+        std::lock_guard<std::mutex> guard(sim().mutex);
+        return sim().counters;
+    }
+}
+using namespace qnx_screen_camera;
+extern "C" {
+qcarcam_ret_t qcarcam_initialize(qcarcam_init_t *p_init_params) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (nullptr == p_init_params) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (state.displays.empty()) {
+        init_displays();
+    }
+    state.initialized = true;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_uninitialize(void) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!state.inputs.empty()) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    state.initialized = false;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_query_inputs(qcarcam_input_t *p_inputs, unsigned int size, unsigned int *ret_size) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!state.initialized || nullptr == ret_size) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    unsigned int count = static_cast<unsigned int>(std::max(state.config.inputs, 0));
+    if (nullptr == p_inputs) {
+        *ret_size = count;
+        return QCARCAM_RET_OK;
+    }
+    *ret_size = std::min(size, count);
+    for (unsigned int i = 0;i < *ret_size;++i) {
+        qcarcam_input_t &input = p_inputs[i];
+        memset(&input, 0, sizeof(input));
+        input.desc = static_cast<qcarcam_input_desc_t>(i);
+        snprintf(input.name, sizeof(input.name), "sim%u", i);
+        input.res[0].width = state.config.width;
+        input.res[0].height = state.config.height;
+        input.res[0].fps = state.config.fps;
+        input.num_res = 1;
+        input.color_fmt[0] = QCARCAM_FMT_UYVY_8;
+        input.num_color_fmt = 1;
+    }
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_query_diagnostics(void *p_diag_info, unsigned int diag_size) {
+    if (nullptr == p_diag_info) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    sim_diag_info info;
+    if (diag_size < sizeof(info)) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    memset(p_diag_info, 0, diag_size);
+    memset(&info, 0, sizeof(info));
+    uint8_t *out = static_cast<uint8_t *>(p_diag_info) + sizeof(info);
+    for (auto &open : state.inputs) {
+        if (sizeof(info) + (info.count + 1) * sizeof(sim_diag_input) > diag_size) {
+            break;
+        }
+        memcpy(out + info.count++ * sizeof(sim_diag_input), &open.second->diag, sizeof(sim_diag_input));
+    }
+    memcpy(p_diag_info, &info, sizeof(info));
+    return QCARCAM_RET_OK;
+}
+qcarcam_hndl_t qcarcam_open(qcarcam_input_desc_t desc) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!state.initialized || desc < 0 || desc >= state.config.inputs || state.inputs.count(desc)) {
+        bad_call("qcarcam_open of an open or unknown input");
+        return nullptr;
+    }
+    sim_input *in = new sim_input();
+    in->desc = desc;
+    memset(&in->rate, 0, sizeof(in->rate));
+    memset(&in->diag, 0, sizeof(in->diag));
+    in->diag.input_id = desc;
+    in->rate.frame_drop_mode = QCARCAM_KEEP_ALL_FRAMES;
+    in->rng.seed(state.config.seed * 7919u + static_cast<uint32_t>(desc));
+    state.inputs[desc] = in;
+    ++state.counters.open_handles;
+    in->sensor = new std::thread([in]() { run_sensor(in); });
+    return in;
+}
+qcarcam_ret_t qcarcam_close(qcarcam_hndl_t hndl) {
+    sim_state &state = sim();
+    std::unique_lock<std::mutex> lk(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    state.inputs.erase(in->desc);
+    in->closing = true;
+    in->sensor_cv.notify_all();
+    in->frame_cv.notify_all();
+    // no callback runs and no get_frame waits once close returns
+    in->idle_cv.wait(lk, [in]() { return 0 == in->callbacks && 0 == in->waiters; });
+    std::thread *sensor = in->sensor;
+    lk.unlock();
+    sensor->join();
+    delete sensor;
+    lk.lock();
+    for (auto &slot : in->slots) {
+        if (SLOT_HELD == slot.state) {
+            --state.counters.held_buffers;
+            if (!slot.stranded) {
+                ++state.counters.held_at_close;
+            }
+        }
+    }
+    if (in->started) {
+        --state.counters.started_handles;
+    }
+    --state.counters.open_handles;
+    ++state.counters.closes;
+    delete in;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_g_param(qcarcam_hndl_t hndl, qcarcam_param_t param, qcarcam_param_value_t *p_value) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in || nullptr == p_value) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    switch (param) {
+    case QCARCAM_PARAM_EVENT_MASK:
+        p_value->uint_value = in->event_mask;
+        return QCARCAM_RET_OK;
+    case QCARCAM_PARAM_FRAME_RATE:
+        p_value->frame_rate_config = in->rate;
+        return QCARCAM_RET_OK;
+    default:
+        return QCARCAM_RET_UNSUPPORTED;
+    }
+}
+qcarcam_ret_t qcarcam_s_param(qcarcam_hndl_t hndl, qcarcam_param_t param, const qcarcam_param_value_t *p_value) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in || nullptr == p_value) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    switch (param) {
+    case QCARCAM_PARAM_EVENT_CB:
+        in->callback = reinterpret_cast<qcarcam_event_cb_t>(p_value->ptr_value);
+        return QCARCAM_RET_OK;
+    case QCARCAM_PARAM_EVENT_MASK:
+        in->event_mask = p_value->uint_value;
+        return QCARCAM_RET_OK;
+    case QCARCAM_PARAM_FRAME_RATE:
+        if (QCARCAM_FRAMEDROP_MANUAL == p_value->frame_rate_config.frame_drop_mode &&
+            (0 == p_value->frame_rate_config.frame_drop_period || p_value->frame_rate_config.frame_drop_period > 31)) {
+            return QCARCAM_RET_BADPARAM;
+        }
+        if (QCARCAM_FRAMEDROP_MANUAL == p_value->frame_rate_config.frame_drop_mode && state.config.reject_frame_drop) {
+            return QCARCAM_RET_UNSUPPORTED;
+        }
+        in->rate = p_value->frame_rate_config;
+        in->sensor_frames = 0;
+        return QCARCAM_RET_OK;
+    default:
+        return QCARCAM_RET_OK;
+    }
+}
+qcarcam_ret_t qcarcam_s_buffers(qcarcam_hndl_t hndl, qcarcam_buffers_t *p_buffers) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in || nullptr == p_buffers || nullptr == p_buffers->buffers || 0 == p_buffers->n_buffers ||
+        p_buffers->n_buffers > QCARCAM_MAX_NUM_BUFFERS) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (in->started) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    std::vector<sim_slot> slots(p_buffers->n_buffers);
+    for (unsigned int i = 0;i < p_buffers->n_buffers;++i) {
+        const qcarcam_buffer_t &buffer = p_buffers->buffers[i];
+        if (0 == buffer.n_planes || nullptr == buffer.planes[0].p_buf) {
+            return QCARCAM_RET_BADPARAM;
+        }
+        uint32_t size = 0;
+        for (unsigned int p = 0;p < buffer.n_planes && p < QCARCAM_MAX_NUM_PLANES;++p) {
+            size += buffer.planes[p].size;
+        }
+        if (p_buffers->flags & QCARCAM_BUFFER_FLAG_OS_HNDL) {
+            // the Screen buffer itself, as SCREEN_PROPERTY_EGL_HANDLE gave it out
+            if (!known(state.buffers, buffer.planes[0].p_buf, __func__)) {
+                return QCARCAM_RET_BADPARAM;
+            }
+            sim_buffer *buf = static_cast<sim_buffer *>(buffer.planes[0].p_buf);
+            if (size > buf->size) {
+                bad_call("capture planes larger than the Screen buffer");
+                return QCARCAM_RET_BADPARAM;
+            }
+            slots[i].buffer = buf;
+            slots[i].data = buf->data;
+        }
+        else {
+            slots[i].data = static_cast<uint8_t *>(buffer.planes[0].p_buf);
+        }
+        slots[i].size = size;
+        slots[i].line = buffer.planes[0].stride;
+    }
+    in->slots.swap(slots);
+    in->ready.clear();
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_s_input_buffers(qcarcam_hndl_t, qcarcam_buffers_t *) {
+    return QCARCAM_RET_UNSUPPORTED;
+}
+qcarcam_ret_t qcarcam_start(qcarcam_hndl_t hndl) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (in->started || in->slots.empty()) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    in->started = true;
+    in->paused = false;
+    ++state.counters.started_handles;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_stop(qcarcam_hndl_t hndl) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (!in->started) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    // frames not fetched yet go back to the driver, held ones stay with the client
+    for (unsigned int idx : in->ready) {
+        in->slots[idx].state = SLOT_FREE;
+    }
+    in->ready.clear();
+    in->started = false;
+    in->paused = false;
+    --state.counters.started_handles;
+    in->frame_cv.notify_all();
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_pause(qcarcam_hndl_t hndl) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (!in->started || in->paused) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    in->paused = true;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_resume(qcarcam_hndl_t hndl) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (!in->started || !in->paused) {
+        return QCARCAM_RET_BADSTATE;
+    }
+    in->paused = false;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_get_frame(qcarcam_hndl_t hndl, qcarcam_frame_info_t *p_frame_info,
+                                unsigned long long timeout, unsigned int) {
+    sim_state &state = sim();
+    std::unique_lock<std::mutex> lk(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in || nullptr == p_frame_info) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    ++in->waiters;
+    in->frame_cv.wait_for(lk, std::chrono::nanoseconds(timeout), [in]() {
+        return !in->ready.empty() || in->closing || !in->started; });
+    --in->waiters;
+    in->idle_cv.notify_all();
+    if (in->closing || in->ready.empty()) {
+        return in->closing || !in->started ? QCARCAM_RET_BADSTATE : QCARCAM_RET_TIMEOUT;
+    }
+    sim_slot &slot = in->slots[in->ready.front()];
+    in->ready.pop_front();
+    slot.state = SLOT_HELD;
+    *p_frame_info = slot.info;
+    ++state.counters.frames_delivered;
+    ++state.counters.held_buffers;
+    return QCARCAM_RET_OK;
+}
+qcarcam_ret_t qcarcam_release_frame(qcarcam_hndl_t hndl, unsigned int idx) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_input *in = find_input(hndl, __func__);
+    if (nullptr == in) {
+        return QCARCAM_RET_BADPARAM;
+    }
+    if (idx >= in->slots.size() || in->slots[idx].state != SLOT_HELD) {
+        bad_call("qcarcam_release_frame of a buffer the client does not hold");
+        return QCARCAM_RET_BADPARAM;
+    }
+    sim_slot &slot = in->slots[idx];
+    if (!slot.stranded && chance(in->rng, state.config.release_fail_rate)) {
+        slot.stranded = true;
+        ++state.counters.injected_release_failures;
+        return QCARCAM_RET_FAILED;
+    }
+    slot.state = SLOT_FREE;
+    slot.stranded = false;
+    ++state.counters.frames_released;
+    --state.counters.held_buffers;
+    return QCARCAM_RET_OK;
+}
+int screen_create_context(screen_context_t *pctx, int) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (nullptr == pctx) {
+        return fail(EINVAL);
+    }
+    sim_context *ctx = new sim_context();
+    state.contexts.insert(ctx);
+    ++state.counters.contexts;
+    *pctx = reinterpret_cast<screen_context_t>(ctx);
+    return 0;
+}
+int screen_destroy_context(screen_context_t ctx) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.contexts, ctx, __func__)) {
+        return fail(EINVAL);
+    }
+    sim_context *context = reinterpret_cast<sim_context *>(ctx);
+    // Screen takes the windows of a context with it, the client should have destroyed them
+    std::vector<sim_window *> orphans;
+    for (auto *win : state.windows) {
+        if (win->ctx == context) {
+            orphans.push_back(win);
+        }
+    }
+    for (size_t i = 0;i < orphans.size();++i) {
+        bad_call("screen_destroy_context with windows left");
+    }
+    for (auto *win : orphans) {
+        destroy_window(win);
+    }
+    state.contexts.erase(context);
+    delete context;
+    --state.counters.contexts;
+    return 0;
+}
+int screen_get_context_property_iv(screen_context_t ctx, int pname, int *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.contexts, ctx, __func__) || nullptr == param || pname != SCREEN_PROPERTY_DISPLAY_COUNT) {
+        return fail(EINVAL);
+    }
+    *param = static_cast<int>(state.displays.size());
+    return 0;
+}
+int screen_get_context_property_pv(screen_context_t ctx, int pname, void **param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.contexts, ctx, __func__) || nullptr == param || pname != SCREEN_PROPERTY_DISPLAYS) {
+        return fail(EINVAL);
+    }
+    for (unsigned int i = 0;i < state.displays.size();++i) {
+        param[i] = &state.displays[i];
+    }
+    return 0;
+}
+int screen_get_display_property_iv(screen_display_t disp, int pname, int *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    sim_display *display = find_display(disp, __func__);
+    if (nullptr == display || nullptr == param) {
+        return fail(EINVAL);
+    }
+    switch (pname) {
+    case SCREEN_PROPERTY_ID:
+        *param = display->id;
+        return 0;
+    case SCREEN_PROPERTY_SIZE:
+        param[0] = display->size[0];
+        param[1] = display->size[1];
+        return 0;
+    default:
+        return fail(EINVAL);
+    }
+}
+int screen_create_window(screen_window_t *pwin, screen_context_t ctx) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (nullptr == pwin || !known(state.contexts, ctx, __func__)) {
+        return fail(EINVAL);
+    }
+    sim_window *win = new sim_window();
+    win->ctx = reinterpret_cast<sim_context *>(ctx);
+    ++win->ctx->windows;
+    state.windows.insert(win);
+    ++state.counters.windows;
+    *pwin = reinterpret_cast<screen_window_t>(win);
+    return 0;
+}
+int screen_destroy_window(screen_window_t win) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__)) {
+        return fail(EINVAL);
+    }
+    destroy_window(reinterpret_cast<sim_window *>(win));
+    return 0;
+}
+int screen_set_window_property_iv(screen_window_t win, int pname, const int *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || nullptr == param) {
+        return fail(EINVAL);
+    }
+    sim_window *window = reinterpret_cast<sim_window *>(win);
+    if (SCREEN_PROPERTY_FORMAT == pname) {
+        window->format = param[0];
+    }
+    else if (SCREEN_PROPERTY_BUFFER_SIZE == pname) {
+        if (param[0] <= 0 || param[1] <= 0) {
+            return fail(EINVAL);
+        }
+        window->buffer_size[0] = param[0];
+        window->buffer_size[1] = param[1];
+    }
+    window->props[pname].assign(param, param + property_count(pname));
+    return 0;
+}
+int screen_get_window_property_iv(screen_window_t win, int pname, int *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || nullptr == param) {
+        return fail(EINVAL);
+    }
+    sim_window *window = reinterpret_cast<sim_window *>(win);
+    if (SCREEN_PROPERTY_RENDER_BUFFER_COUNT == pname) {
+        *param = static_cast<int>(window->buffers.size());
+        return 0;
+    }
+    auto it = window->props.find(pname);
+    if (it != window->props.end()) {
+        std::copy(it->second.begin(), it->second.end(), param);
+    }
+    else if (SCREEN_PROPERTY_SIZE == pname && window->display != nullptr) {
+        param[0] = window->display->size[0];
+        param[1] = window->display->size[1];
+    }
+    else {
+        std::fill(param, param + property_count(pname), 0);
+    }
+    return 0;
+}
+int screen_set_window_property_pv(screen_window_t win, int pname, void **param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || nullptr == param || pname != SCREEN_PROPERTY_DISPLAY) {
+        return fail(EINVAL);
+    }
+    sim_display *display = find_display(param[0], __func__);
+    if (nullptr == display) {
+        return fail(EINVAL);
+    }
+    reinterpret_cast<sim_window *>(win)->display = display;
+    return 0;
+}
+int screen_get_window_property_pv(screen_window_t win, int pname, void **param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || nullptr == param || pname != SCREEN_PROPERTY_RENDER_BUFFERS) {
+        return fail(EINVAL);
+    }
+    sim_window *window = reinterpret_cast<sim_window *>(win);
+    for (unsigned int i = 0;i < window->buffers.size();++i) {
+        param[i] = window->buffers[i];
+    }
+    return 0;
+}
+int screen_create_window_buffers(screen_window_t win, int count) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || count <= 0) {
+        return fail(EINVAL);
+    }
+    sim_window *window = reinterpret_cast<sim_window *>(win);
+    sim_buffer layout;
+    if (!window->buffers.empty() || window->buffer_size[0] <= 0 ||
+        !buffer_layout(window->format, window->buffer_size[0], window->buffer_size[1], layout)) {
+        return fail(EINVAL);
+    }
+    for (int i = 0;i < count;++i) {
+        sim_buffer *buf = new sim_buffer(layout);
+        void *data = nullptr;
+        if (posix_memalign(&data, SIM_BUFFER_ALIGN, buf->size)) {
+            delete buf;
+            free_buffers(window);
+            return fail(ENOMEM);
+        }
+        memset(data, 0, buf->size);
+        buf->data = static_cast<uint8_t *>(data);
+        buf->owner = window;
+        window->buffers.push_back(buf);
+        state.buffers.insert(buf);
+        ++state.counters.window_buffers;
+    }
+    return 0;
+}
+int screen_destroy_window_buffers(screen_window_t win) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__)) {
+        return fail(EINVAL);
+    }
+    free_buffers(reinterpret_cast<sim_window *>(win));
+    return 0;
+}
+int screen_share_window_buffers(screen_window_t win, screen_window_t share) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || !known(state.windows, share, __func__) || win == share) {
+        return fail(EINVAL);
+    }
+    reinterpret_cast<sim_window *>(win)->share = reinterpret_cast<sim_window *>(share);
+    return 0;
+}
+int screen_get_buffer_property_iv(screen_buffer_t buf, int pname, int *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.buffers, buf, __func__) || nullptr == param) {
+        return fail(EINVAL);
+    }
+    sim_buffer *buffer = reinterpret_cast<sim_buffer *>(buf);
+    switch (pname) {
+    case SCREEN_PROPERTY_STRIDE:
+        *param = buffer->stride;
+        return 0;
+    case SCREEN_PROPERTY_PLANAR_OFFSETS:
+        std::copy(buffer->offsets, buffer->offsets + 3, param);
+        return 0;
+    case SCREEN_PROPERTY_BUFFER_SIZE:
+        param[0] = buffer->owner->buffer_size[0];
+        param[1] = buffer->owner->buffer_size[1];
+        return 0;
+    default:
+        return fail(EINVAL);
+    }
+}
+int screen_get_buffer_property_pv(screen_buffer_t buf, int pname, void **param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.buffers, buf, __func__) || nullptr == param) {
+        return fail(EINVAL);
+    }
+    sim_buffer *buffer = reinterpret_cast<sim_buffer *>(buf);
+    switch (pname) {
+    case SCREEN_PROPERTY_EGL_HANDLE:
+        *param = buffer;
+        return 0;
+    case SCREEN_PROPERTY_POINTER:
+        *param = buffer->data;
+        return 0;
+    default:
+        return fail(EINVAL);
+    }
+}
+int screen_get_buffer_property_llv(screen_buffer_t buf, int pname, long long *param) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.buffers, buf, __func__) || nullptr == param || pname != SCREEN_PROPERTY_PHYSICAL_ADDRESS) {
+        return fail(EINVAL);
+    }
+    *param = 0;                 // heap memory, nothing contiguous to hand out
+    return 0;
+}
+int screen_post_window(screen_window_t win, screen_buffer_t buf, int count, const int *dirty_rects, int) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.windows, win, __func__) || !known(state.buffers, buf, __func__) || count < 0 || (count > 0 && nullptr == dirty_rects)) {
+        return fail(EINVAL);
+    }
+    if (reinterpret_cast<sim_buffer *>(buf)->owner != reinterpret_cast<sim_window *>(win)) {
+        bad_call("screen_post_window of a buffer of another window");
+        return fail(EINVAL);
+    }
+    ++state.counters.posts;
+    return 0;
+}
+int screen_flush_context(screen_context_t ctx, int) {
+    sim_state &state = sim();
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!known(state.contexts, ctx, __func__)) {
+        return fail(EINVAL);
+    }
+    ++state.counters.flushes;
+    return 0;
+}
+int screen_wait_vsync(screen_display_t display) {
+    uint64_t period = 0;
+    {
+        sim_state &state = sim();
+        std::lock_guard<std::mutex> guard(state.mutex);
+        if (nullptr == find_display(display, __func__)) {
+            return fail(EINVAL);
+        }
+        period = static_cast<uint64_t>(1e9 / (state.config.refresh_hz > 0 ? state.config.refresh_hz : 60.0f));
+    }
+    uint64_t now = monotonic_ns();
+    std::this_thread::sleep_for(std::chrono::nanoseconds(period - now % period));
+    return 0;
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+namespace qnx_screen_camera {
+    // the simulated camera stack behind qcarcam_* and screen_* on a development host: every input is a
+    // sensor thread filling the buffers handed to qcarcam_s_buffers at fps, Screen buffers are heap memory.
+    // Fault rates are chances per produced frame
+    struct sim_config {
+        int inputs = 8;                         // < Reported by qcarcam_query_inputs with ids 0..inputs-1
+        int width = 1280;
+        int height = 720;
+        float fps = 30;
+        int displays = 2;
+        int display_size[2] = { 1920, 720 };
+        float refresh_hz = 60;                  // < screen_wait_vsync period
+        double get_frame_timeout_rate = 0;      // < The frame is lost after its FRAME_READY, get_frame waits for the next
+        double release_fail_rate = 0;           // < qcarcam_release_frame fails and the buffer stays with the client
+        double error_event_rate = 0;            // < A QCARCAM_EVENT_ERROR along with the frame
+        double signal_loss_rate = 0;            // < The input goes dark for signal_loss_ms, then reports VALID again
+        int signal_loss_ms = 200;
+        uint32_t seed = 1;
+        bool fill = false;                      // < Write every byte of a frame, otherwise only its first line
+        bool reject_frame_drop = false;         // < QCARCAM_PARAM_FRAME_RATE drop patterns fail, as on ISPs without them
+    };
+    struct sim_counters {
+        uint64_t frames_produced = 0;
+        uint64_t frames_delivered = 0;          // < Returned by qcarcam_get_frame
+        uint64_t frames_released = 0;
+        uint64_t frames_starved = 0;            // < Sensor frames without a free buffer
+        uint64_t frames_dropped = 0;            // < By the frame drop pattern
+        uint64_t injected_timeouts = 0;
+        uint64_t injected_release_failures = 0;
+        uint64_t injected_errors = 0;
+        uint64_t injected_signal_losses = 0;
+        uint64_t posts = 0;
+        uint64_t flushes = 0;
+        uint64_t closes = 0;
+        uint64_t held_at_close = 0;             // < Buffers the client still held at qcarcam_close, failed releases excluded
+        uint64_t bad_calls = 0;                 // < Calls on closed or unknown handles and buffers, double opens and releases
+        int open_handles = 0;
+        int started_handles = 0;
+        int contexts = 0;
+        int windows = 0;
+        int window_buffers = 0;
+        int held_buffers = 0;                   // < Delivered and not released, over the open handles
+    };
+    // what qcarcam_query_diagnostics writes: a sim_diag_info, then one sim_diag_input per open input while
+    // they fit. Each input counts its injected signal losses as CSI errors, its error events as IFE
+    // overflows and its frames without a free buffer as driver drops
+    struct sim_diag_input {
+        int32_t input_id;
+        uint32_t reserved;
+        uint64_t csi_errors;
+        uint64_t ife_overflows;
+        uint64_t frame_drops;
+        uint64_t other_errors;
+    };
+    struct sim_diag_info {
+        uint32_t count;
+        uint32_t reserved;
+    };
+    // before qcarcam_initialize; resets the counters
+    void sim_configure(const sim_config &config);
+    sim_counters sim_get_counters();
+}
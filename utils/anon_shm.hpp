@@ -0,0 +1,27 @@
+#pragma once
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "color_log.hpp"
+namespace qnx_screen_camera {
+    // anonymous shared memory object, memfd on linux hosts and SHM_ANON on QNX
+    inline int create_anon_shm(const char *name, size_t size) {
+#ifdef __QNX__
+        (void)name;
+        int fd = shm_open(SHM_ANON, O_RDWR | O_CREAT, 0600);
+#else
+        int fd = memfd_create(name, MFD_CLOEXEC);
+#endif
+        if (fd < 0) {
+            LOG_E("create shm %s error:%d", name, errno);
+            return -1;
+        }
+        if (ftruncate(fd, size) < 0) {
+            LOG_E("resize shm %s to %zu error:%d", name, size, errno);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+namespace qnx_screen_camera {
+    // CLOCK_MONOTONIC in ns, same time base as qcarcam_frame_info_t::timestamp
+    inline uint64_t monotonic_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+    }
+}
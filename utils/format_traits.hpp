@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <screen/screen.h>
+#include "qcarcam_types.h"
+namespace qnx_screen_camera {
+    // layout of one qcarcam colour pattern; bit depth and packing are folded in by format_traits_of
+    struct pattern_traits {
+        qcarcam_color_pattern_t pattern;
+        uint8_t planes;                 // < 0 for patterns the tree cannot lay out
+        uint8_t samples[2];             // < Samples per pixel in a row of each plane, 4:2:x chroma counts half
+        uint8_t chroma_h_shift;         // < Horizontal subsampling of the chroma
+        uint8_t chroma_v_shift;         // < Rows of plane 1 are height >> shift
+        int8_t luma_offset;             // < Sample of Y in a packed pixel pair, -1 planar luma, -2 no luma
+        int screen_format;              // < SCREEN_FORMAT_* of the 8 bit variant, -1 if screen has none
+    };
+    // the last entry is returned for unknown patterns
+    constexpr pattern_traits PATTERN_TRAITS[] = {
+        { QCARCAM_YUV_UYVY,   1, { 2, 0 }, 1, 0,  1, SCREEN_FORMAT_UYVY },
+        { QCARCAM_YUV_VYUY,   1, { 2, 0 }, 1, 0,  1, -1 },
+        { QCARCAM_YUV_YUYV,   1, { 2, 0 }, 1, 0,  0, SCREEN_FORMAT_YUY2 },
+        { QCARCAM_YUV_YVYU,   1, { 2, 0 }, 1, 0,  0, SCREEN_FORMAT_YVYU },
+        { QCARCAM_YUV_NV12,   2, { 1, 1 }, 1, 1, -1, SCREEN_FORMAT_NV12 },
+        { QCARCAM_YUV_NV21,   2, { 1, 1 }, 1, 1, -1, -1 },
+        { QCARCAM_RAW,        1, { 1, 0 }, 0, 0, -2, -1 },
+        { QCARCAM_BAYER_GBRG, 1, { 1, 0 }, 0, 0, -2, -1 },
+        { QCARCAM_BAYER_GRBG, 1, { 1, 0 }, 0, 0, -2, -1 },
+        { QCARCAM_BAYER_RGGB, 1, { 1, 0 }, 0, 0, -2, -1 },
+        { QCARCAM_BAYER_BGGR, 1, { 1, 0 }, 0, 0, -2, -1 },
+        { QCARCAM_RGB,        1, { 3, 0 }, 0, 0, -2, SCREEN_FORMAT_RGB888 },
+        { QCARCAM_RAW,        0, { 0, 0 }, 0, 0, -2, -1 },
+    };
+    constexpr size_t PATTERN_TRAITS_NUM = sizeof(PATTERN_TRAITS) / sizeof(PATTERN_TRAITS[0]);
+    struct format_traits {
+        uint8_t planes;                 // < 0 for formats the tree cannot lay out
+        uint8_t row_bits[2];            // < Bits per image pixel in a row of each plane
+        uint8_t bits_per_pixel;         // < Over all planes, what a frame costs in memory bandwidth
+        uint8_t chroma_h_shift;
+        uint8_t chroma_v_shift;
+        int8_t luma_offset;             // < Byte of Y in a packed 8 bit pixel pair, -1 planar luma, -2 none
+        int screen_format;              // < -1 if screen cannot show the format as is
+    };
+    constexpr const pattern_traits &pattern_traits_of(qcarcam_color_pattern_t pattern, size_t i = 0) {
+        return i + 1 >= PATTERN_TRAITS_NUM || PATTERN_TRAITS[i].pattern == pattern
+               ? PATTERN_TRAITS[i] : pattern_traits_of(pattern, i + 1);
+    }
+    // storage bits of one sample: MIPI packs the bit depth tightly, the plain packings pad it
+    constexpr uint32_t sample_bits(qcarcam_color_fmt_t format) {
+        return QCARCAM_PACK_MIPI == QCARCAM_COLOR_GET_PACK(format) ? QCARCAM_COLOR_GET_BITDEPTH(format)
+             : QCARCAM_PACK_PLAIN8 == QCARCAM_COLOR_GET_PACK(format) ? 8
+             : QCARCAM_PACK_PLAIN16 == QCARCAM_COLOR_GET_PACK(format) ? 16
+             : QCARCAM_PACK_PLAIN32 == QCARCAM_COLOR_GET_PACK(format) ? 32
+             : QCARCAM_PACK_FOURCC == QCARCAM_COLOR_GET_PACK(format) ? (QCARCAM_COLOR_GET_BITDEPTH(format) <= 8 ? 8 : 16)
+             : 0;
+    }
+    constexpr format_traits make_format_traits(const pattern_traits &p, uint32_t bits, bool is_8bit) {
+        return format_traits{ static_cast<uint8_t>(bits ? p.planes : 0),
+                              { static_cast<uint8_t>(p.samples[0] * bits), static_cast<uint8_t>(p.samples[1] * bits) },
+                              static_cast<uint8_t>(p.samples[0] * bits + ((p.samples[1] * bits) >> p.chroma_v_shift)),
+                              p.chroma_h_shift, p.chroma_v_shift,
+                              static_cast<int8_t>(is_8bit ? p.luma_offset : -2),
+                              is_8bit ? p.screen_format : -1 };
+    }
+    constexpr format_traits format_traits_of(qcarcam_color_fmt_t format) {
+        return make_format_traits(pattern_traits_of(QCARCAM_COLOR_GET_PATTERN(format)), sample_bits(format),
+                                  8 == sample_bits(format));
+    }
+    // bytes of a tightly packed row of plane p
+    constexpr uint32_t min_stride(qcarcam_color_fmt_t format, uint32_t width, int plane = 0) {
+        return (width * format_traits_of(format).row_bits[plane] + 7) / 8;
+    }
+    // a frame laid out in memory, plane 1 (if any) starts offset[1] bytes after plane 0
+    struct plane_layout {
+        int planes = 0;
+        uint32_t stride[2] = { 0 };
+        uint32_t height[2] = { 0 };
+        uint32_t offset[2] = { 0 };
+        uint32_t size = 0;              // < Bytes from the start of plane 0 to the end of the last plane
+    };
+    // stride0 and offset1 as the allocator chose them, 0 takes the tight values; plane 1 uses the
+    // stride of plane 0 scaled to its row bits, which is how NV12 shares one pitch for both planes
+    inline bool get_plane_layout(qcarcam_color_fmt_t format, uint32_t width, uint32_t height, uint32_t stride0,
+                                 uint32_t offset1, plane_layout &layout) {
+        const format_traits traits = format_traits_of(format);
+        if (0 == traits.planes || (stride0 && stride0 < min_stride(format, width))) {
+            return false;
+        }
+        layout.planes = traits.planes;
+        layout.stride[0] = stride0 ? stride0 : min_stride(format, width);
+        layout.height[0] = height;
+        layout.offset[0] = 0;
+        layout.size = layout.stride[0] * height;
+        if (traits.planes > 1) {
+            layout.stride[1] = layout.stride[0] * traits.row_bits[1] / traits.row_bits[0];
+            layout.height[1] = (height + (1u << traits.chroma_v_shift) - 1) >> traits.chroma_v_shift;
+            layout.offset[1] = offset1 >= layout.size ? offset1 : layout.size;
+            layout.size = layout.offset[1] + layout.stride[1] * layout.height[1];
+        }
+        return true;
+    }
+    // the 8 bit qcarcam format screen shows as screen_format, QCARCAM_FMT_MAX if none
+    inline qcarcam_color_fmt_t format_of_screen(int screen_format) {
+        for (size_t i = 0;i + 1 < PATTERN_TRAITS_NUM;++i) {
+            if (PATTERN_TRAITS[i].screen_format == screen_format) {
+                return static_cast<qcarcam_color_fmt_t>(QCARCAM_COLOR_FMT(PATTERN_TRAITS[i].pattern,
+                                                                          QCARCAM_BITDEPTH_8, QCARCAM_PACK_FOURCC));
+            }
+        }
+        return QCARCAM_FMT_MAX;
+    }
+    static_assert(16 == format_traits_of(QCARCAM_FMT_UYVY_8).bits_per_pixel, "UYVY is 2 bytes per pixel");
+    static_assert(12 == format_traits_of(QCARCAM_FMT_NV12).bits_per_pixel, "NV12 is 1.5 bytes per pixel");
+    static_assert(10 == format_traits_of(QCARCAM_FMT_MIPIRAW_10).bits_per_pixel, "MIPI RAW10 is packed");
+    static_assert(1 == format_traits_of(QCARCAM_FMT_UYVY_8).luma_offset, "Y is the second byte of UYVY");
+}
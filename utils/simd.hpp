@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+namespace qnx_screen_camera {
+    // 128 bit vectors through the GCC vector extension: NEON on the aarch64 target, SSE2 on x86 hosts,
+    // so the same kernel source is vectorized everywhere and can be checked off target
+    namespace simd {
+        typedef uint8_t u8x16 __attribute__((vector_size(16)));
+        typedef int8_t s8x16 __attribute__((vector_size(16)));
+        typedef uint16_t u16x8 __attribute__((vector_size(16)));
+        typedef int16_t s16x8 __attribute__((vector_size(16)));
+        typedef uint32_t u32x4 __attribute__((vector_size(16)));
+        typedef int32_t s32x4 __attribute__((vector_size(16)));
+        typedef float f32x4 __attribute__((vector_size(16)));
+        enum : int {
+            VEC_BYTES = 16,
+        };
+        template <typename V>
+        inline V load(const void *ptr) {       // unaligned
+            V v;
+            memcpy(&v, ptr, sizeof(V));
+            return v;
+        }
+        template <typename V>
+        inline void store(void *ptr, const V &v) {
+            memcpy(ptr, &v, sizeof(V));
+        }
+        template <typename V, typename T>
+        inline V splat(T value) {
+            V v;
+            for (unsigned int i = 0;i < sizeof(V) / sizeof(v[0]);++i) {
+                v[i] = value;
+            }
+            return v;
+        }
+        // lane select, mask lanes are all ones or all zeros
+        template <typename V, typename M>
+        inline V select(const M &mask, const V &a, const V &b) {
+            V m = (V)mask;
+            return (a & m) | (b & ~m);
+        }
+        // float lanes have no bitwise operators, their select goes through the integer view
+        inline f32x4 select(const s32x4 &mask, const f32x4 &a, const f32x4 &b) {
+            return (f32x4)select(mask, (s32x4)a, (s32x4)b);
+        }
+        template <typename V>
+        inline V vmin(const V &a, const V &b) {
+            return select(a < b, a, b);
+        }
+        template <typename V>
+        inline V vmax(const V &a, const V &b) {
+            return select(a > b, a, b);
+        }
+        template <typename V>
+        inline V absdiff(const V &a, const V &b) {
+            return vmax(a, b) - vmin(a, b);
+        }
+        template <typename V>
+        inline V clamp(const V &v, const V &lo, const V &hi) {
+            return vmin(vmax(v, lo), hi);
+        }
+        // byte permute: lane i of the result is lane idx[i] of a, or of b for idx[i] >= 16
+        inline u8x16 shuffle(const u8x16 &a, const u8x16 &b, const u8x16 &idx) {
+            return __builtin_shuffle(a, b, idx);
+        }
+        template <typename T, typename V>
+        inline T hsum(const V &v) {
+            T sum = 0;
+            for (unsigned int i = 0;i < sizeof(V) / sizeof(v[0]);++i) {
+                sum += v[i];
+            }
+            return sum;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <errno.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+namespace qnx_screen_camera {
+    // blocking helpers for stream sockets, false on error or peer close
+    inline bool recv_all(int fd, void *data, size_t len) {
+        char *ptr = static_cast<char *>(data);
+        while (len > 0) {
+            ssize_t n = recv(fd, ptr, len, 0);
+            if (n < 0 && EINTR == errno) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            ptr += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    inline bool send_all(int fd, const void *data, size_t len) {
+        const char *ptr = static_cast<const char *>(data);
+        while (len > 0) {
+            ssize_t n = send(fd, ptr, len, MSG_NOSIGNAL);
+            if (n < 0 && EINTR == errno) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            ptr += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    // send data together with a set of descriptors (SCM_RIGHTS), used once at connection setup
+    inline bool send_with_fds(int fd, const void *data, size_t len, const int *fds, int nfds) {
+        enum { MAX_FDS = 32 };
+        if (nfds > MAX_FDS) {
+            return false;
+        }
+        struct iovec iov;
+        iov.iov_base = const_cast<void *>(data);
+        iov.iov_len = len;
+        char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (nfds > 0) {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+            memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+        }
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        return n == static_cast<ssize_t>(len);
+    }
+    // receive data and up to max_fds descriptors, nfds returns how many arrived; on failure every
+    // descriptor that came with the message is closed and nfds is 0
+    inline bool recv_with_fds(int fd, void *data, size_t len, int *fds, int max_fds, int &nfds) {
+        enum { MAX_FDS = 32 };
+        nfds = 0;
+        if (max_fds > MAX_FDS) {
+            max_fds = MAX_FDS;
+        }
+        struct iovec iov;
+        iov.iov_base = data;
+        iov.iov_len = len;
+        char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = 0;
+        do {
+            n = recvmsg(fd, &msg, 0);
+        } while (n < 0 && EINTR == errno);
+        if (n < 0) {
+            return false;
+        }
+        bool ok = n == static_cast<ssize_t>(len) && 0 == (msg.msg_flags & MSG_CTRUNC);
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);cmsg != nullptr;cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (SOL_SOCKET == cmsg->cmsg_level && SCM_RIGHTS == cmsg->cmsg_type) {
+                int count = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+                for (int i = 0;i < count;++i) {
+                    int received = -1;
+                    memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                    if (ok && nfds < max_fds) {
+                        fds[nfds++] = received;
+                    }
+                    else {
+                        close(received);
+                    }
+                }
+            }
+        }
+        return ok;
+    }
+}
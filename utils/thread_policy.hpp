@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <string>
+#ifdef __QNX__
+#include <sys/neutrino.h>
+#endif
+#include "color_log.hpp"
+namespace qnx_screen_camera {
+    enum thread_policy_param : int {
+        THREAD_POLICY_INHERIT = -1,
+        THREAD_POLICY_MAX_CPUS = 64,
+    };
+    struct thread_policy {
+        int sched_policy = THREAD_POLICY_INHERIT;    // < SCHED_FIFO / SCHED_RR / SCHED_OTHER, inherit if -1
+        int priority = 0;                            // < Scheduling priority, only used with sched_policy
+        uint64_t cpu_mask = 0;                       // < CPU affinity bitmask, 0 keeps the inherited mask
+        bool lock_memory = false;                    // < Lock all process pages so capture never faults
+    };
+    inline bool same_thread_policy(const thread_policy &a, const thread_policy &b) {
+        return a.sched_policy == b.sched_policy && a.priority == b.priority && a.cpu_mask == b.cpu_mask &&
+               a.lock_memory == b.lock_memory;
+    }
+    // apply the policy to the calling thread, every pipeline thread calls this first thing
+    // returns the settings actually in effect afterwards, failures are logged and leave the old value
+    inline thread_policy apply_thread_policy(const thread_policy &policy, const std::string &name) {
+        pthread_t self = pthread_self();
+        if (!name.empty()) {
+            char thread_name[16] = { 0 };           // pthread name limit including terminator
+            strncpy(thread_name, name.c_str(), sizeof(thread_name) - 1);
+            pthread_setname_np(self, thread_name);
+        }
+        if (policy.sched_policy != THREAD_POLICY_INHERIT) {
+            sched_param param;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = policy.priority;
+            int rc = pthread_setschedparam(self, policy.sched_policy, &param);
+            if (rc) {
+                LOG_E("%s set sched policy:%d priority:%d error:%d", name.c_str(), policy.sched_policy, policy.priority, rc);
+            }
+        }
+#ifdef __QNX__
+        uint64_t runmask_set = 0;                   // no portable read back of the runmask, keep what was accepted
+#endif
+        if (policy.cpu_mask != 0) {
+#ifdef __QNX__
+            uintptr_t runmask = static_cast<uintptr_t>(policy.cpu_mask & 0xffffffffULL);
+            if (-1 == ThreadCtl(_NTO_TCTL_RUNMASK, reinterpret_cast<void *>(runmask))) {
+                LOG_E("%s set runmask:0x%llx error:%d", name.c_str(), (unsigned long long)policy.cpu_mask, errno);
+            } else {
+                runmask_set = runmask;
+            }
+#else
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (int i = 0;i < THREAD_POLICY_MAX_CPUS;++i) {
+                if (policy.cpu_mask & (1ULL << i)) {
+                    CPU_SET(i, &cpus);
+                }
+            }
+            int rc = pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+            if (rc) {
+                LOG_E("%s set affinity:0x%llx error:%d", name.c_str(), (unsigned long long)policy.cpu_mask, rc);
+            }
+#endif
+        }
+        static std::atomic<bool> memory_locked(false);         // mlockall is process wide, once it worked it holds
+        if (policy.lock_memory && !memory_locked) {
+            if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+                LOG_E("%s mlockall error:%d", name.c_str(), errno);
+            } else {
+                memory_locked = true;
+            }
+        }
+        thread_policy effective;
+        sched_param param;
+        int sched = 0;
+        if (0 == pthread_getschedparam(self, &sched, &param)) {
+            effective.sched_policy = sched;
+            effective.priority = param.sched_priority;
+        }
+#ifdef __QNX__
+        effective.cpu_mask = runmask_set;
+#else
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if (0 == pthread_getaffinity_np(self, sizeof(cpus), &cpus)) {
+            for (int i = 0;i < THREAD_POLICY_MAX_CPUS;++i) {
+                if (CPU_ISSET(i, &cpus)) {
+                    effective.cpu_mask |= (1ULL << i);
+                }
+            }
+        }
+#endif
+        effective.lock_memory = memory_locked;
+        LOG_I("thread %s policy:%d priority:%d cpu mask:0x%llx mlock:%d", name.c_str(), effective.sched_policy,
+                effective.priority, (unsigned long long)effective.cpu_mask, effective.lock_memory);
+        return effective;
+    }
+}
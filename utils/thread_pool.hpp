@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "thread_policy.hpp"
+namespace qnx_screen_camera {
+    // fixed set of workers sharing the pipeline thread policy
+    // parallel_for lets the calling thread take part, so it is safe to call from a pool task
+    // and still completes when every worker is busy elsewhere
+    class thread_pool {
+    public:
+        explicit thread_pool(int threads, const thread_policy &policy = thread_policy(),
+                             const std::string &name = "pool") {
+            if (threads < 0) {
+                threads = 0;
+            }
+            for (int i = 0;i < threads;++i) {
+                workers_.emplace_back([this, policy, name, i]() {
+                    apply_thread_policy(policy, name + std::to_string(i));
+                    this->run();
+                });
+            }
+        }
+        virtual ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                keep_running_ = false;
+            }
+            cv_.notify_all();
+            for (auto &worker : workers_) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+        inline int size() const {
+            return static_cast<int>(workers_.size());
+        }
+        void submit(const std::function<void()> &task) {
+            if (workers_.empty()) {
+                task();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                tasks_.push_back(task);
+            }
+            cv_.notify_one();
+        }
+        // run fn(i) for i in [0, count), returns when all are done
+        void parallel_for(int count, const std::function<void(int)> &fn) {
+            if (count <= 0) {
+                return;
+            }
+            struct job {
+                std::atomic<int> next{0};
+                std::atomic<int> done{0};
+                std::mutex mutex;
+                std::condition_variable cv;
+            };
+            auto state = std::make_shared<job>();
+            auto work = [state, count, &fn]() {
+                int i = 0;
+                while ((i = state->next++) < count) {
+                    fn(i);
+                    if (++state->done == count) {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        state->cv.notify_all();
+                    }
+                }
+            };
+            int helpers = std::min(size(), count - 1);
+            for (int i = 0;i < helpers;++i) {
+                submit(work);
+            }
+            work();
+            std::unique_lock<std::mutex> lk(state->mutex);
+            state->cv.wait(lk, [&]() { return state->done == count; });
+        }
+    private:
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [this]() { return !keep_running_ || !tasks_.empty(); });
+                    if (!keep_running_ && tasks_.empty()) {
+                        break;
+                    }
+                    task = tasks_.front();
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+    private:
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool keep_running_ = true;
+    };
+}
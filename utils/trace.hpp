@@ -0,0 +1,273 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "clock.hpp"
+#include "color_log.hpp"
+#include "single_instance.hpp"
+namespace qnx_screen_camera {
+    class tracer;
+    #define G_TRACER single_instance<tracer>::instance()
+    #define TRACE_DUMP_PATH "/tmp/qnx_screen_camera_trace.json"
+    enum trace_param : uint32_t {
+        TRACE_BUFFER_EVENTS = 8192,     // < Ring of each thread, a power of two
+        TRACE_MAX_THREADS = 64,         // < Threads traced at once, buffers of exited threads are reused
+        TRACE_NAME_BYTES = 16,          // < pthread name limit including terminator
+    };
+    struct trace_event {
+        const char *name = nullptr;     // < A string literal, only the pointer is kept
+        uint64_t begin_ns = 0;
+        uint64_t duration_ns = 0;
+        int64_t arg = 0;
+        char phase = 'X';               // < Chrome trace phase: 'X' complete, 'i' instant
+    };
+    // s as the body of a JSON string
+    inline std::string json_escape(const char *s) {
+        std::string out;
+        for (;s != nullptr && *s;++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if ('"' == c || '\\' == c) {
+                out += '\\';
+                out += static_cast<char>(c);
+            }
+            else if (c < 0x20) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\u%04x", c);
+                out += hex;
+            }
+            else {
+                out += static_cast<char>(c);
+            }
+        }
+        return out;
+    }
+    // events of one thread: the owner writes without locks, a dump copies the ring and drops whatever
+    // the owner may have overwritten meanwhile
+    class trace_buffer {
+    public:
+        explicit trace_buffer(int tid) : tid_(tid), events_(TRACE_BUFFER_EVENTS) {
+            pthread_getname_np(pthread_self(), name_, sizeof(name_));
+        }
+        // the owner thread exited, the events stay until the buffer is reused
+        inline void retire() {
+            retired_.store(true, std::memory_order_release);
+        }
+        inline bool retired() const {
+            return retired_.load(std::memory_order_acquire);
+        }
+        // capture time of the newest event, 0 if none
+        inline uint64_t last_ns() const {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            return head ? events_[(head - 1) & (TRACE_BUFFER_EVENTS - 1)].begin_ns : 0;
+        }
+        inline void push(const trace_event &event) {     // owner thread only
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            events_[head & (TRACE_BUFFER_EVENTS - 1)] = event;
+            head_.store(head + 1, std::memory_order_release);
+        }
+        void snapshot(std::vector<trace_event> &out) const {
+            uint64_t end = head_.load(std::memory_order_acquire);
+            uint64_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+            size_t base = out.size();
+            for (uint64_t i = begin;i < end;++i) {
+                out.push_back(events_[i & (TRACE_BUFFER_EVENTS - 1)]);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // event i is overwritten by the push of i + TRACE_BUFFER_EVENTS, which may be in flight at now
+            uint64_t now = head_.load(std::memory_order_relaxed);
+            uint64_t safe = now >= TRACE_BUFFER_EVENTS ? now - TRACE_BUFFER_EVENTS + 1 : 0;
+            if (safe > begin) {
+                out.erase(out.begin() + base, out.begin() + base + std::min(safe - begin, end - begin));
+            }
+        }
+        inline int tid() const {
+            return tid_;
+        }
+        inline const char *name() const {
+            return name_;
+        }
+    private:
+        int tid_;
+        char name_[TRACE_NAME_BYTES] = { 0 };
+        std::vector<trace_event> events_;
+        std::atomic<uint64_t> head_{0};             // < Events ever pushed
+        std::atomic<bool> retired_{false};
+    };
+    // a template so the flag is a constant initialized header static without a guard
+    template <typename T = void>
+    struct trace_state {
+        static std::atomic<bool> enabled;
+    };
+    template <typename T>
+    std::atomic<bool> trace_state<T>::enabled(false);
+    // the only cost of a trace point while tracing is off
+    inline bool tracing() {
+        return trace_state<>::enabled.load(std::memory_order_relaxed);
+    }
+    // process wide timeline of the trace points, written out as Chrome trace JSON which
+    // ui.perfetto.dev and chrome://tracing load as is
+    class tracer {
+    public:
+        tracer() {
+            // the destructor runs at thread exit and retires the thread's buffer
+            pthread_key_create(&exit_key_, [](void *value) {
+                auto held = static_cast<std::shared_ptr<trace_buffer> *>(value);
+                (*held)->retire();
+                delete held;
+            });
+        }
+        void start() {
+            start_ns_ = monotonic_ns();
+            trace_state<>::enabled.store(true, std::memory_order_release);
+            LOG_I("tracing started");
+        }
+        void stop() {
+            trace_state<>::enabled.store(false, std::memory_order_release);
+            LOG_I("tracing stopped");
+        }
+        inline void complete(const char *name, uint64_t begin_ns, uint64_t duration_ns, int64_t arg) {
+            trace_event event;
+            event.name = name;
+            event.begin_ns = begin_ns;
+            event.duration_ns = duration_ns;
+            event.arg = arg;
+            record(event);
+        }
+        inline void instant(const char *name, int64_t arg) {
+            trace_event event;
+            event.name = name;
+            event.begin_ns = monotonic_ns();
+            event.arg = arg;
+            event.phase = 'i';
+            record(event);
+        }
+        // events since the last start(), tracing may keep running meanwhile
+        bool dump(const std::string &path = TRACE_DUMP_PATH) {
+            std::vector<std::shared_ptr<trace_buffer>> buffers;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                buffers = buffers_;
+            }
+            FILE *file = fopen(path.c_str(), "w");
+            if (nullptr == file) {
+                LOG_E("open trace file %s error!", path.c_str());
+                return false;
+            }
+            int pid = static_cast<int>(getpid());
+            size_t written = 0;
+            const char *separator = "";
+            fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            std::vector<trace_event> events;
+            for (auto &buffer : buffers) {
+                fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        separator, pid, buffer->tid(), json_escape(buffer->name()).c_str());
+                separator = ",";
+                events.clear();
+                buffer->snapshot(events);
+                for (auto &event : events) {
+                    if (event.begin_ns < start_ns_) {
+                        continue;
+                    }
+                    if ('X' == event.phase) {
+                        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                                "\"args\":{\"arg\":%lld}}", json_escape(event.name).c_str(), event.begin_ns / 1e3, event.duration_ns / 1e3,
+                                pid, buffer->tid(), static_cast<long long>(event.arg));
+                    }
+                    else {
+                        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                                "\"args\":{\"arg\":%lld}}", json_escape(event.name).c_str(), event.begin_ns / 1e3, pid, buffer->tid(),
+                                static_cast<long long>(event.arg));
+                    }
+                    ++written;
+                }
+            }
+            fprintf(file, "\n]}\n");
+            bool ok = 0 == ferror(file);
+            fclose(file);
+            LOG_I("trace of %zu events from %zu threads written to %s", written, buffers.size(), path.c_str());
+            return ok;
+        }
+    private:
+        inline void record(const trace_event &event) {
+            static thread_local trace_buffer *local = nullptr;
+            static thread_local bool refused = false;
+            if (nullptr == local) {
+                if (refused) {
+                    return;
+                }
+                local = attach();
+                refused = nullptr == local;
+                if (refused) {
+                    return;
+                }
+            }
+            local->push(event);
+        }
+        // a new buffer for the calling thread; at the limit the buffer of the thread that exited longest
+        // ago is replaced, a dump still copying it keeps its own reference
+        trace_buffer *attach() {
+            std::lock_guard<std::mutex> guard(mutex_);
+            auto buffer = std::make_shared<trace_buffer>(++next_tid_);
+            if (buffers_.size() < TRACE_MAX_THREADS) {
+                buffers_.push_back(buffer);
+            }
+            else {
+                auto oldest = buffers_.end();
+                for (auto it = buffers_.begin();it != buffers_.end();++it) {
+                    if ((*it)->retired() && (buffers_.end() == oldest || (*it)->last_ns() < (*oldest)->last_ns())) {
+                        oldest = it;
+                    }
+                }
+                if (buffers_.end() == oldest) {
+                    LOG_W("trace buffers exhausted by %d live threads, thread not traced", TRACE_MAX_THREADS);
+                    return nullptr;
+                }
+                *oldest = buffer;
+            }
+            pthread_setspecific(exit_key_, new std::shared_ptr<trace_buffer>(buffer));
+            return buffer.get();
+        }
+    private:
+        std::mutex mutex_;
+        std::vector<std::shared_ptr<trace_buffer>> buffers_;    // < Kept after their threads exit until reused
+        int next_tid_ = 0;
+        pthread_key_t exit_key_;
+        std::atomic<uint64_t> start_ns_{0};
+    };
+    // times the enclosing scope into the calling thread's buffer when tracing is on
+    class trace_scope {
+    public:
+        explicit trace_scope(const char *name, int64_t arg = 0)
+            : name_(name), arg_(arg), begin_ns_(tracing() ? monotonic_ns() : 0) {
+        }
+        ~trace_scope() {
+            if (begin_ns_ != 0) {
+                G_TRACER.complete(name_, begin_ns_, monotonic_ns() - begin_ns_, arg_);
+            }
+        }
+        inline void set_arg(int64_t arg) {
+            arg_ = arg;
+        }
+    private:
+        const char *name_;
+        int64_t arg_;
+        uint64_t begin_ns_;
+    };
+    #define TRACE_CONCAT_(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+    #define TRACE_SCOPE(name, ...) \
+        qnx_screen_camera::trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name, ##__VA_ARGS__)
+    #define TRACE_INSTANT(name, arg)                  \
+        do {                                          \
+            if (qnx_screen_camera::tracing()) {       \
+                single_instance<qnx_screen_camera::tracer>::instance().instant(name, arg); \
+            }                                         \
+        } while (0)
+}